@@ -0,0 +1,534 @@
+//
+// Runs a matrix of RTL scenarios in parallel on several vehicles (e.g. one
+// SITL instance per port) from a single process.
+//
+// Every vehicle gets its own Mavsdk instance, and the maneuvers of all
+// vehicles run on one event loop. A vehicle which is done with a scenario
+// takes the next one from a shared queue, so faster vehicles simply fly
+// more scenarios, and the results are merged into one report at the end.
+//
+// The RTL parameters of every vehicle are fetched before its first
+// scenario. With a parameter sweep, the scenarios are flown once per value
+// of the parameter, which a vehicle sets before a scenario if its cached
+// value differs and restores once the queue is empty.
+//
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <math.h>
+
+#include <plugins/action/action.h>
+#include <plugins/telemetry/telemetry.h>
+
+#include "mavsdk.h"
+#include "condition_waiter.h"
+#include "console.h"
+#include "event_loop.h"
+#include "log_sink.h"
+#include "maneuver.h"
+#include "maneuver_steps.h"
+#include "param_cache.h"
+#include "phase_stats.h"
+#include "rate_scheduler.h"
+#include "rtl_maneuver.h"
+#include "sim_autopilot.h"
+#include "telemetry_monitor.h"
+
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+struct ScenarioResult {
+    bool run;
+    int return_value;
+    std::string connection_url;
+    LegTiming leg;
+    bool checked;
+    RtlVerdict verdict;
+    double duration_s;
+    double param_value; // of the sweep, NAN without one
+};
+
+// Flown, and the RTL followed its rules.
+bool scenario_passed(const ScenarioResult &result)
+{
+    return result.run && result.return_value == 0 && (!result.checked || result.verdict.passed);
+}
+
+struct InstanceReport {
+    std::string connection_url;
+    bool connected;
+    unsigned scenarios_run;
+    double busy_s;
+};
+
+void usage(std::string bin_name)
+{
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name
+              << " [-s scenarios.csv] [-o report.csv] [-p phase_stats_prefix] [-r return_alt,cone_dist,cone_angle] [-w NAME=value[,value...]] <connection_url> [<connection_url> ...]" << std::endl
+              << "Each connection URL is one vehicle, scenarios are spread over all of them." << std::endl
+              << "The scenario file has one \"lat_m,long_m,height_above_home,yaw\" line per scenario." << std::endl
+              << "With -p, command latencies of all vehicles are appended to <prefix>.csv and summarized in <prefix>.json." << std::endl
+              << "Every RTL is checked against the RTL parameters read from each vehicle. With -r (return_alt,cone_dist,cone_angle)" << std::endl
+              << "a vehicle has to have these values, or it flies no scenarios." << std::endl
+              << "With -w, all scenarios are flown once for each value of the parameter NAME, which is restored afterwards." << std::endl
+              << "For example, to use three simulators: udp://:14540 udp://:14541 udp://:14542" << std::endl
+              << "or three built-in simulated vehicles at 50x real time: sim://50 sim://50 sim://50" << std::endl;
+}
+
+
+
+double seconds_since(steady_clock::time_point start)
+{
+    return duration_cast<duration<double>>(steady_clock::now() - start).count();
+}
+
+
+
+struct Instance {
+    bool connecting;
+    // Declared before the Mavsdk instance so it outlives its callbacks.
+    std::atomic<bool> discovered;
+    Mavsdk dc;
+    std::unique_ptr<Autopilot> autopilot;
+    std::unique_ptr<RateScheduler> rates;
+    InstanceReport report;
+    std::vector<LegTiming> legs;
+    RtlChecks checks;
+    ParamCache params;
+    double param_before; // value of the swept parameter before the first scenario
+};
+
+// State shared by the maneuvers of all vehicles, only touched on the loop thread.
+struct Matrix {
+    const std::vector<RTLScenario> &scenarios;
+    std::vector<ScenarioResult> &results;
+    PhaseStats *phases;
+    const ParamSweep *sweep;
+    bool rtl_rules_given;
+    EventLoop &loop;
+    size_t next_scenario;
+    unsigned running;
+};
+
+
+
+bool connect_instance(const std::string &connection_url, Instance &instance, ConditionWaiter &discovery)
+{
+    instance.connecting = false;
+    instance.discovered = false;
+    instance.report.connection_url = connection_url;
+    instance.report.connected = false;
+    instance.report.scenarios_run = 0;
+    instance.report.busy_s = 0.0;
+
+    double speedup = 1.0;
+    if (parse_sim_url(connection_url, speedup)) {
+        instance.autopilot.reset(new SimAutopilot(speedup));
+        instance.connecting = true;
+        instance.discovered = true;
+        return true;
+    }
+
+    std::atomic<bool> *discovered = &instance.discovered;
+    instance.dc.register_on_discover([discovered, &discovery](uint64_t) {
+        *discovered = true;
+        discovery.notify();
+    });
+
+    const ConnectionResult connection_result = instance.dc.add_any_connection(connection_url);
+    if (connection_result != ConnectionResult::SUCCESS) {
+        log_error() << "[" << connection_url << "] Connection failed: " << connection_result_str(connection_result);
+        return false;
+    }
+    instance.connecting = true;
+    return true;
+}
+
+
+
+bool setup_instance(Instance &instance)
+{
+    const std::string &connection_url = instance.report.connection_url;
+    if (!instance.connecting) {
+        return false;
+    }
+    if (!instance.discovered) {
+        log_error() << "[" << connection_url << "] No system found";
+        return false;
+    }
+    if (!instance.autopilot) {
+        instance.autopilot.reset(new MavsdkAutopilot(instance.dc.system()));
+    }
+
+    instance.rates.reset(new RateScheduler(instance.autopilot->monitor()));
+    const Telemetry::Result set_rate_result = instance.rates->enter(FlightPhase::GROUND);
+    if (set_rate_result != Telemetry::Result::SUCCESS) {
+        log_error() << "[" << connection_url << "] Setting rate failed:" << Telemetry::result_str(set_rate_result);
+        return false;
+    }
+    instance.report.connected = true;
+    return true;
+}
+
+
+
+void instance_done(Matrix &matrix)
+{
+    if (--matrix.running == 0) {
+        matrix.loop.stop();
+    }
+}
+
+
+
+// Restores the swept parameter of a vehicle which is done with the scenarios.
+void finish_instance(Matrix &matrix, Instance &instance)
+{
+    if (!matrix.sweep || isnan(instance.param_before)) {
+        instance_done(matrix);
+        return;
+    }
+
+    const std::string &connection_url = instance.report.connection_url;
+    auto maneuver = std::make_shared<Maneuver>(connection_url, *instance.autopilot, matrix.loop);
+    maneuver->then("restore " + matrix.sweep->name, set_param_step(&instance.params, matrix.sweep->name, instance.param_before));
+    maneuver->start([&matrix, connection_url](Maneuver::Result result) {
+        if (result != Maneuver::Result::SUCCEEDED) {
+            log_error() << "[" << connection_url << "] Could not restore " << matrix.sweep->name;
+        }
+        instance_done(matrix);
+    });
+}
+
+
+
+void run_next_scenario(Matrix &matrix, Instance &instance);
+
+// Fetches the parameters of the vehicle in one batch and checks them, then starts its scenarios.
+void prepare_instance(Matrix &matrix, Instance &instance)
+{
+    const std::string &connection_url = instance.report.connection_url;
+    auto maneuver = std::make_shared<Maneuver>(connection_url, *instance.autopilot, matrix.loop);
+    maneuver->then("check RTL parameters", rtl_params_step(&instance.params, &instance.checks, matrix.rtl_rules_given));
+    if (matrix.sweep) {
+        maneuver->then("fetch " + matrix.sweep->name,
+                       fetch_params_step(&instance.params, std::vector<std::string>(1, matrix.sweep->name)));
+    }
+    maneuver->start([&matrix, &instance, connection_url](Maneuver::Result result) {
+        if (result != Maneuver::Result::SUCCEEDED) {
+            log_error() << "[" << connection_url << "] Parameters not as expected, no scenarios on this vehicle";
+            instance_done(matrix);
+            return;
+        }
+        ParamValue before;
+        if (matrix.sweep && instance.params.get(matrix.sweep->name, before)) {
+            instance.param_before = before.as_double();
+        }
+        run_next_scenario(matrix, instance);
+    });
+}
+
+
+
+// Starts the next scenario on the vehicle, or finishes it once the queue is empty.
+void run_next_scenario(Matrix &matrix, Instance &instance)
+{
+    if (matrix.next_scenario >= matrix.scenarios.size()) {
+        finish_instance(matrix, instance);
+        return;
+    }
+
+    const size_t index = matrix.next_scenario++;
+    const RTLScenario &scenario = matrix.scenarios[index];
+    const std::string &connection_url = instance.report.connection_url;
+    {
+        LogLine line = log_info();
+        line << "[" << connection_url << "] Scenario " << index << ": " << scenario.description;
+        if (matrix.sweep) {
+            line << ", " << matrix.sweep->name << " " << matrix.results[index].param_value;
+        }
+    }
+
+    instance.legs.clear();
+    instance.checks.verdicts.clear();
+    auto maneuver = std::make_shared<Maneuver>(connection_url, *instance.autopilot, matrix.loop);
+    maneuver->set_rate_scheduler(instance.rates.get());
+    maneuver->abort_if("pilot took over", pilot_took_over(instance.autopilot->monitor()));
+    maneuver->on_failure("return home", return_home_step(matrix.phases));
+    if (matrix.sweep) {
+        maneuver->then("set " + matrix.sweep->name, sweep_param_step(&instance.params, matrix.sweep->name,
+                                                                     matrix.results[index].param_value, &instance.checks));
+    }
+    add_goto_setpoint_and_RTL(*maneuver, scenario, &instance.legs, matrix.phases, &instance.checks);
+
+    const auto start = steady_clock::now();
+    maneuver->start([&matrix, &instance, index, start](Maneuver::Result maneuver_result) {
+        ScenarioResult &result = matrix.results[index];
+        result.run = true;
+        result.return_value = maneuver_result == Maneuver::Result::SUCCEEDED ? 0 : 1;
+        result.connection_url = instance.report.connection_url;
+        result.duration_s = seconds_since(start);
+        if (!instance.legs.empty()) {
+            result.leg = instance.legs.back();
+        }
+        if (!instance.checks.verdicts.empty()) {
+            result.checked = true;
+            result.verdict = instance.checks.verdicts.back();
+        }
+
+        instance.report.scenarios_run++;
+        instance.report.busy_s += result.duration_s;
+
+        if (result.return_value != 0 && instance.autopilot->monitor().armed()) {
+            // Leave this vehicle alone if it did not come back, the others keep going.
+            log_error() << "[" << instance.report.connection_url
+                        << "] Vehicle still armed after failed scenario, stopping this instance";
+            instance_done(matrix);
+            return;
+        }
+        run_next_scenario(matrix, instance);
+    });
+}
+
+
+
+void print_report(const std::vector<RTLScenario> &scenarios,
+                  const std::vector<ScenarioResult> &results,
+                  const std::vector<InstanceReport> &instances,
+                  const ParamSweep *sweep,
+                  double wall_time_s)
+{
+    log_info() << "";
+    log_info() << "RTL matrix results:";
+    {
+        LogLine header = log_info();
+        header << std::setw(4) << "#" << std::setw(9) << "lat_m" << std::setw(9) << "long_m"
+               << std::setw(9) << "height" << std::setw(7) << "yaw";
+        if (sweep) {
+            header << std::setw(17) << sweep->name;
+        }
+        header << std::setw(8) << "result" << std::setw(6) << "rtl" << std::setw(11) << "arrive_s"
+               << std::setw(11) << "total_s" << "  vehicle";
+    }
+
+    unsigned failed = 0;
+    double scenario_time_s = 0.0;
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        const RTLScenario &scenario = scenarios[i];
+        const ScenarioResult &result = results[i];
+        const char *verdict = !result.run ? "skipped" : (result.return_value == 0 ? "ok" : "FAILED");
+        const char *rtl = !result.checked ? "-" : (result.verdict.passed ? "ok" : "FAIL");
+        if (!scenario_passed(result)) {
+            failed++;
+        }
+        scenario_time_s += result.duration_s;
+
+        LogLine line = log_info();
+        line << std::setw(4) << i << std::setw(9) << scenario.lat_m << std::setw(9) << scenario.long_m
+             << std::setw(9) << scenario.height_above_home << std::setw(7) << scenario.yaw;
+        if (sweep) {
+            line << std::setw(17) << result.param_value;
+        }
+        line << std::setw(8) << verdict << std::setw(6) << rtl << std::fixed << std::setprecision(1)
+             << std::setw(11) << result.leg.time_to_arrive_s << std::setw(11) << result.duration_s
+             << std::defaultfloat << "  " << result.connection_url;
+    }
+
+    log_info() << "";
+    log_info() << "Per vehicle:";
+    unsigned connected = 0;
+    for (const auto &instance : instances) {
+        if (instance.connected) {
+            connected++;
+        }
+        log_info() << "  " << instance.connection_url << ": "
+                   << (instance.connected ? "" : "not connected, ") << instance.scenarios_run
+                   << " scenarios, busy " << instance.busy_s << " s";
+    }
+
+    log_info() << "";
+    LogLine line = log_info();
+    line << scenarios.size() - failed << "/" << scenarios.size()
+         << " scenarios ok, wall time " << wall_time_s << " s, sum of scenario times "
+         << scenario_time_s << " s";
+    if (connected > 0 && wall_time_s > 0.0) {
+        line << ", parallel efficiency " << 100.0 * scenario_time_s / (wall_time_s * connected) << " %";
+    }
+}
+
+
+
+bool write_csv_report(const std::string &path,
+                      const std::vector<RTLScenario> &scenarios,
+                      const std::vector<ScenarioResult> &results,
+                      const ParamSweep *sweep)
+{
+    std::ofstream file(path);
+    if (!file) {
+        log_error() << "Cannot write report " << path;
+        return false;
+    }
+
+    file << "index,lat_m,long_m,height_above_home,yaw,run,return_value,arrived,time_to_arrive_s,time_to_settle_s,"
+            "rtl_checked,rtl_passed,rtl_expected_altitude_m,rtl_max_altitude_m,rtl_descent_start_distance_m,"
+            "rtl_landing_distance_m,rtl_max_descent_speed_m_s,param_name,param_value,duration_s,connection_url\n";
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        const RTLScenario &scenario = scenarios[i];
+        const ScenarioResult &result = results[i];
+        file << i << "," << scenario.lat_m << "," << scenario.long_m << ","
+             << scenario.height_above_home << "," << scenario.yaw << "," << result.run << ","
+             << result.return_value << "," << result.leg.arrived << ","
+             << result.leg.time_to_arrive_s << "," << result.leg.time_to_settle_s << ","
+             << result.checked << "," << result.verdict.passed << "," << result.verdict.expected_altitude_m << ","
+             << result.verdict.max_altitude_m << "," << result.verdict.descent_start_distance_m << ","
+             << result.verdict.landing_distance_m << "," << result.verdict.max_descent_speed_m_s << ","
+             << (sweep ? sweep->name : "") << "," << result.param_value << "," << result.duration_s << "," << result.connection_url << "\n";
+    }
+    return true;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> connection_urls;
+    std::vector<RTLScenario> scenarios;
+    std::string scenario_path;
+    std::string report_path;
+    std::string phase_stats_prefix;
+    RtlRules rtl_rules;
+    bool rtl_rules_given = false;
+    ParamSweep sweep;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-s" && i + 1 < argc) {
+            scenario_path = argv[++i];
+        } else if (arg == "-o" && i + 1 < argc) {
+            report_path = argv[++i];
+        } else if (arg == "-p" && i + 1 < argc) {
+            phase_stats_prefix = argv[++i];
+        } else if (arg == "-r" && i + 1 < argc) {
+            if (!parse_rtl_rules(argv[++i], rtl_rules)) {
+                usage(argv[0]);
+                return 1;
+            }
+            rtl_rules_given = true;
+        } else if (arg == "-w" && i + 1 < argc) {
+            if (!parse_param_sweep(argv[++i], sweep)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            connection_urls.push_back(arg);
+        }
+    }
+
+    if (connection_urls.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (scenario_path.empty()) {
+        scenarios = default_rtl_scenarios();
+    } else if (!load_rtl_scenarios(scenario_path, scenarios)) {
+        return 1;
+    }
+
+    // All scenarios for the first value, then for the next, so a vehicle seldom has to change it.
+    const ParamSweep *swept = sweep.values.empty() ? nullptr : &sweep;
+    std::vector<double> param_values(scenarios.size(), NAN);
+    if (swept) {
+        std::vector<RTLScenario> sweep_scenarios;
+        param_values.clear();
+        for (double value : sweep.values) {
+            sweep_scenarios.insert(sweep_scenarios.end(), scenarios.begin(), scenarios.end());
+            param_values.insert(param_values.end(), scenarios.size(), value);
+        }
+        scenarios.swap(sweep_scenarios);
+    }
+
+    log_info() << "Running " << scenarios.size() << " scenarios on " << connection_urls.size() << " vehicles";
+
+    ScenarioResult not_run = {false, 0, "", {0, 0, 0, false, NAN, NAN}, false, RtlVerdict(), 0.0, NAN};
+    std::vector<ScenarioResult> results(scenarios.size(), not_run);
+    for (size_t i = 0; i < results.size(); ++i) {
+        results[i].param_value = param_values[i];
+    }
+    PhaseStats phase_stats;
+    PhaseStats *phases = phase_stats_prefix.empty() ? nullptr : &phase_stats;
+
+    const auto start = steady_clock::now();
+
+    // Declared before the instances so it outlives their callbacks.
+    ConditionWaiter discovery;
+    std::vector<std::unique_ptr<Instance>> instances;
+    for (const auto &connection_url : connection_urls) {
+        instances.push_back(std::unique_ptr<Instance>(new Instance()));
+        instances.back()->checks.rules = rtl_rules;
+        instances.back()->param_before = NAN;
+        connect_instance(connection_url, *instances.back(), discovery);
+    }
+
+    // All vehicles are discovered in parallel.
+    discovery.wait_until([&instances]() {
+        for (const auto &instance : instances) {
+            if (instance->connecting && !instance->discovered) {
+                return false;
+            }
+        }
+        return true;
+    }, seconds(10));
+
+    EventLoop loop;
+    Matrix matrix = {scenarios, results, phases, swept, rtl_rules_given, loop, 0, 0};
+    for (auto &instance : instances) {
+        if (setup_instance(*instance)) {
+            matrix.running++;
+            Instance *vehicle = instance.get();
+            loop.post([&matrix, vehicle]() { prepare_instance(matrix, *vehicle); });
+        }
+    }
+    if (matrix.running > 0) {
+        loop.run();
+    }
+
+    std::vector<InstanceReport> reports;
+    LinkUsage link_usage = LinkUsage();
+    for (const auto &instance : instances) {
+        reports.push_back(instance->report);
+        if (instance->rates) {
+            add_link_usage(link_usage, instance->rates->usage());
+        }
+    }
+
+    print_report(scenarios, results, reports, swept, seconds_since(start));
+    print_link_usage(link_usage, default_rate_profile());
+
+    if (!report_path.empty() && !write_csv_report(report_path, scenarios, results, swept)) {
+        return 1;
+    }
+
+    if (phases && !export_phase_stats(phase_stats, phase_stats_prefix)) {
+        return 1;
+    }
+
+    for (const auto &result : results) {
+        if (!scenario_passed(result)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,252 @@
+//
+// Replays PX4 ULog files, e.g. of a batch of SITL runs, through the RTL
+// checks the maneuvers run live, at the speed the logs can be read.
+//
+// Every log is one task on a work-stealing pool: logs differ a lot in size,
+// so idle workers take over the logs still queued on busy ones rather than
+// the batch waiting for the worker which happened to get the largest. The
+// results are merged into one report once all logs are read.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "console.h"
+#include "log_sink.h"
+#include "rtl_analyzer.h"
+#include "rtl_replay.h"
+#include "work_stealing_pool.h"
+
+
+using namespace std::chrono;
+
+void usage(std::string bin_name)
+{
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name
+              << " [-j threads] [-r return_alt,cone_dist,cone_angle] [-o report.csv] <log.ulg|directory> [...]" << std::endl
+              << "Checks every RTL in the logs, directories are searched for .ulg files recursively." << std::endl
+              << "The rules come from the RTL parameters in each log, -r is used for logs without them." << std::endl
+              << "-j sets the number of threads, one per hardware thread by default." << std::endl
+              << "With -o, every RTL is written to a CSV report." << std::endl;
+}
+
+
+
+bool has_ulog_extension(const std::string &path)
+{
+    const std::string extension = ".ulg";
+    return path.size() > extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+
+
+// Regular files are taken whatever their name, directories searched for .ulg files. Links to
+// directories are only followed when given, so a link loop cannot make the search endless.
+void collect_logs(const std::string &path, bool given, std::vector<std::string> &logs)
+{
+    struct stat path_stat;
+    if (stat(path.c_str(), &path_stat) != 0) {
+        if (given) {
+            log_error() << "Cannot read " << path;
+        }
+        return;
+    }
+    struct stat link_stat;
+    if (!given && S_ISDIR(path_stat.st_mode) &&
+        (lstat(path.c_str(), &link_stat) != 0 || S_ISLNK(link_stat.st_mode))) {
+        return;
+    }
+    if (S_ISREG(path_stat.st_mode)) {
+        if (given || has_ulog_extension(path)) {
+            logs.push_back(path);
+        }
+        return;
+    }
+    if (!S_ISDIR(path_stat.st_mode)) {
+        return;
+    }
+
+    DIR *directory = opendir(path.c_str());
+    if (!directory) {
+        log_error() << "Cannot read directory " << path;
+        return;
+    }
+    while (const struct dirent *entry = readdir(directory)) {
+        const std::string name = entry->d_name;
+        if (name != "." && name != "..") {
+            collect_logs(path + "/" + name, false, logs);
+        }
+    }
+    closedir(directory);
+}
+
+
+
+bool log_failed(const LogReplayResult &result)
+{
+    if (!result.read) {
+        return true;
+    }
+    for (const auto &verdict : result.verdicts) {
+        if (!verdict.passed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+void print_report(const std::vector<LogReplayResult> &results,
+                  unsigned threads,
+                  uint64_t steals,
+                  double wall_time_s)
+{
+    size_t rtls = 0;
+    size_t failed = 0;
+    size_t interrupted = 0;
+    size_t unreadable = 0;
+    size_t truncated = 0;
+    size_t bytes = 0;
+    double read_time_s = 0.0;
+
+    for (const auto &result : results) {
+        bytes += result.bytes;
+        read_time_s += result.seconds;
+        interrupted += result.interrupted;
+        if (!result.read) {
+            unreadable++;
+            log_error() << result.path << ": " << result.error;
+            continue;
+        }
+        if (result.truncated) {
+            truncated++;
+            log_info() << result.path << ": truncated, checked up to the end of the last complete message";
+        }
+        for (const auto &verdict : result.verdicts) {
+            rtls++;
+            if (!verdict.passed) {
+                failed++;
+                log_error() << result.path << ", " << verdict.scenario << ": " << rtl_verdict_failures(verdict);
+            }
+        }
+    }
+
+    log_info() << "";
+    log_info() << results.size() << " logs, " << unreadable << " unreadable, " << truncated << " truncated";
+    log_info() << rtls << " RTLs checked, " << rtls - failed << " passed, " << failed << " failed, "
+               << interrupted << " interrupted";
+    LogLine line = log_info();
+    line << std::fixed << std::setprecision(2) << bytes / 1e6 << " MB in " << wall_time_s << " s on "
+         << threads << " threads";
+    if (wall_time_s > 0.0) {
+        line << ", " << bytes / 1e6 / wall_time_s << " MB/s";
+    }
+    line << ", sum of log times " << read_time_s << " s, " << steals << " logs stolen";
+}
+
+
+
+bool write_csv_report(const std::string &path, const std::vector<LogReplayResult> &results)
+{
+    std::ofstream file(path);
+    if (!file) {
+        log_error() << "Cannot write report " << path;
+        return false;
+    }
+
+    file << "log,rtl,passed,start_distance_m,start_altitude_m,expected_altitude_m,max_altitude_m,"
+            "descent_start_distance_m,landing_distance_m,max_descent_speed_m_s,samples,failures\n";
+    for (const auto &result : results) {
+        for (const auto &verdict : result.verdicts) {
+            file << result.path << "," << verdict.scenario << "," << verdict.passed << ","
+                 << verdict.start_distance_m << "," << verdict.start_altitude_m << ","
+                 << verdict.expected_altitude_m << "," << verdict.max_altitude_m << ","
+                 << verdict.descent_start_distance_m << "," << verdict.landing_distance_m << ","
+                 << verdict.max_descent_speed_m_s << "," << verdict.samples << ",\""
+                 << rtl_verdict_failures(verdict) << "\"\n";
+        }
+    }
+    return true;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths;
+    std::string report_path;
+    RtlRules rtl_rules;
+    unsigned threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-o" && i + 1 < argc) {
+            report_path = argv[++i];
+        } else if (arg == "-r" && i + 1 < argc) {
+            if (!parse_rtl_rules(argv[++i], rtl_rules)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> logs;
+    for (const auto &path : paths) {
+        collect_logs(path, true, logs);
+    }
+    std::sort(logs.begin(), logs.end());
+    if (logs.empty()) {
+        log_error() << "No logs found";
+        return 1;
+    }
+
+    const auto start = steady_clock::now();
+
+    // Every task writes only its own result, the vector is not resized while they run.
+    std::vector<LogReplayResult> results(logs.size());
+    WorkStealingPool pool(threads);
+    log_info() << "Replaying " << logs.size() << " logs on " << pool.threads() << " threads";
+    for (size_t i = 0; i < logs.size(); ++i) {
+        LogReplayResult *result = &results[i];
+        const std::string *log = &logs[i];
+        pool.post([result, log, &rtl_rules]() { *result = replay_rtl_log(*log, rtl_rules); });
+    }
+    pool.wait();
+
+    print_report(results, pool.threads(), pool.steals(),
+                 duration_cast<duration<double>>(steady_clock::now() - start).count());
+
+    if (!report_path.empty() && !write_csv_report(report_path, results)) {
+        return 1;
+    }
+
+    for (const auto &result : results) {
+        if (log_failed(result)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -10,313 +10,258 @@
 #include <plugins/action/action.h>
 //#include <dronecode_sdk.h>
 #include <plugins/telemetry/telemetry.h>
+#include <plugins/mavlink_passthrough/mavlink_passthrough.h>
 #include <iostream>
-#include <thread>
+#include <memory>
+#include <vector>
 #include <math.h>
 
 #include "mavsdk.h"
+#include "console.h"
+#include "flight_recorder.h"
+#include "geofence.h"
+#include "log_downloader.h"
+#include "log_sink.h"
+#include "maneuver.h"
+#include "maneuver_steps.h"
+#include "phase_stats.h"
+#include "rate_scheduler.h"
+#include "rtl_maneuver.h"
+#include "sim_autopilot.h"
+#include "telemetry_monitor.h"
 
 
 using namespace mavsdk;
-using namespace std::this_thread;
 using namespace std::chrono;
 
-#define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
-#define TELEMETRY_CONSOLE_TEXT "\033[34m" // Turn text on console blue
-#define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
+const double flight_record_rate_hz = 100.0;
+
+// Heartbeats come at 1 Hz, a vehicle which sent none for this long is not there.
+const seconds discovery_timeout(5);
 
 void usage(std::string bin_name)
 {
-    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " <connection_url>" << std::endl
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " [-l log_directory] [-p phase_stats_prefix] [-r return_alt,cone_dist,cone_angle] [-g geofence_file] <connection_url> [flight_record_file]" << std::endl
               << "Connection URL format should be :" << std::endl
               << " For TCP : tcp://[server_host][:server_port]" << std::endl
               << " For UDP : udp://[bind_host][:bind_port]" << std::endl
               << " For Serial : serial:///path/to/serial/dev[:baudrate]" << std::endl
-              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl;
+              << " For the built-in simulated vehicle : sim://[speedup], e.g. sim://50 runs 50x faster than real time" << std::endl
+              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl
+              << "If a flight record file is given, telemetry is recorded into it at " << flight_record_rate_hz << " Hz." << std::endl
+              << "With -l, the logs the vehicle wrote during the maneuvers are downloaded into log_directory." << std::endl
+              << "With -p, command latencies are appended to <prefix>.csv and summarized over all runs in <prefix>.json." << std::endl
+              << "Every RTL is checked against RTL_RETURN_ALT, RTL_MIN_DIST (the cone distance) and RTL_CONE_ANG," << std::endl
+              << "which are read from the vehicle. With -r the vehicle has to have these values, or nothing is flown." << std::endl
+              << "With -g, the way to every setpoint is checked against the fence and zones of the file before arming," << std::endl
+              << "one \"fence|zone altitude_m|- lat,lon lat,lon lat,lon ...\" polygon per line." << std::endl;
 }
 
-
-
-void component_discovered(ComponentType component_type)
-{
-    std::cout << NORMAL_CONSOLE_TEXT << "Discovered a component with type "
-              << unsigned(component_type) << std::endl;
-}
-
-
-
-int detect_system(int argc, char **argv, Mavsdk &dc)
-{
+struct Options {
     std::string connection_url;
-    ConnectionResult connection_result;
-
-    if (argc == 2) {
-        connection_url = argv[1];
-        connection_result = dc.add_any_connection(connection_url);
-    } else {
-        usage(argv[0]);
-        return 1;
-    }
-
-    if (connection_result != ConnectionResult::SUCCESS) {
-        std::cout << ERROR_CONSOLE_TEXT
-                  << "Connection failed: " << connection_result_str(connection_result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        return 1;
-    }
-
-    return 0;
-}
-
-
-
-int system_setup(Mavsdk &dc, System &system)
+    std::string flight_record_file;
+    std::string log_directory;
+    std::string phase_stats_prefix;
+    std::string geofence_path;
+    RtlRules rtl_rules;
+    bool rtl_rules_given;
+};
+
+bool parse_options(int argc, char **argv, Options &options)
 {
-    bool discovered_system = false;
-
-    // We don't need to specify the UUID if it's only one system anyway.
-    // If there were multiple, we could specify it with:
-    // dc.system(uint64_t uuid);
-
-    std::cout << "Waiting to discover system..." << std::endl;
-    dc.register_on_discover([&discovered_system](uint64_t uuid) {
-        std::cout << "Discovered system with UUID: " << uuid << std::endl;
-        discovered_system = true;
-    });
-
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    sleep_for(seconds(2));
-
-    if (!discovered_system) {
-        std::cout << ERROR_CONSOLE_TEXT << "No system found, exiting." << NORMAL_CONSOLE_TEXT
-                  << std::endl;
-        return 1;
+    std::vector<std::string> positional;
+    options.rtl_rules_given = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-l" && i + 1 < argc) {
+            options.log_directory = argv[++i];
+        } else if (arg == "-p" && i + 1 < argc) {
+            options.phase_stats_prefix = argv[++i];
+        } else if (arg == "-g" && i + 1 < argc) {
+            options.geofence_path = argv[++i];
+        } else if (arg == "-r" && i + 1 < argc) {
+            if (!parse_rtl_rules(argv[++i], options.rtl_rules)) {
+                return false;
+            }
+            options.rtl_rules_given = true;
+        } else {
+            positional.push_back(arg);
+        }
     }
 
-    // Register a callback so we get told when components (camera, gimbal) etc
-    // are found.
-    system.register_component_discovered_callback(component_discovered);
-
-    return 0;
-}
-
-
-
-Telemetry::Position calculate_setpoint(double lat_m, double long_m, double height_above_home, Telemetry::Position current_position){
-    // calculate new setpoint
-    Telemetry::Position new_position;
-
-    new_position.latitude_deg = current_position.latitude_deg + lat_m / 111111;  // because 1 deg lat == 111'111 meters
-    new_position.longitude_deg = current_position.longitude_deg + long_m / (111111*cos(new_position.latitude_deg));
-    new_position.absolute_altitude_m = current_position.absolute_altitude_m - current_position.relative_altitude_m + height_above_home;
-
-    return new_position;
-}
-
-
-
-int arm_and_takeoff(Telemetry *telemetry, Action *action)
-{
-        // Check if vehicle is ready to arm
-    while (telemetry->health_all_ok() != true) {
-        std::cout << "Vehicle is getting ready to arm" << std::endl;
-        sleep_for(seconds(1));
+    if (positional.size() < 1 || positional.size() > 2) {
+        return false;
     }
-
-    // Arm vehicle
-    std::cout << "Arming..." << std::endl;
-    const Action::Result arm_result = action->arm();
-
-    if (arm_result != Action::Result::SUCCESS) {
-        std::cout << ERROR_CONSOLE_TEXT << "Arming failed:" << Action::result_str(arm_result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        return 1;
-    }
-
-    // Take off
-    auto takeoff_altitude_result = action->get_takeoff_altitude().second;
-    std::cout << "Taking off to height " << takeoff_altitude_result << " meters" << std::endl;
-    const Action::Result takeoff_result = action->takeoff();
-    if (takeoff_result != Action::Result::SUCCESS) {
-        std::cout << ERROR_CONSOLE_TEXT << "Takeoff failed:" << Action::result_str(takeoff_result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        return 1;
-    }
-
-    // wait until drone has reached takeoff height
-    while ((action->get_takeoff_altitude().second - 0.2) > telemetry->position().relative_altitude_m) {
-        std::cout << TELEMETRY_CONSOLE_TEXT
-        << "Relative height: " << telemetry->position().relative_altitude_m
-        <<  NORMAL_CONSOLE_TEXT<< std::endl;
-        sleep_for(seconds(1));
+    options.connection_url = positional[0];
+    if (positional.size() == 2) {
+        options.flight_record_file = positional[1];
     }
-    return 0;
+    return true;
 }
 
 
 
-int trigger_RTL(Telemetry *telemetry, Action *action)
+void component_discovered(ComponentType component_type)
 {
-    // Make RTL right over home position
-    std::cout << "trigger RTL" << std::endl;
-    const Action::Result rtl_result = action->return_to_launch();
-    if (rtl_result != Action::Result::SUCCESS) {
-        //RTL failed, so exit (in reality might send kill command.)
-        return 1;
-    }
-
-    // We are relying on auto-disarming but let's keep watching the telemetry until it is disarmed
-    while (telemetry->armed()) {
-        // show height in terminal
-        std::cout << TELEMETRY_CONSOLE_TEXT
-        << "Relative height: " << telemetry->position().relative_altitude_m
-        <<  NORMAL_CONSOLE_TEXT<< std::endl;
-
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
-    std::cout << "Disarmed, ready for next part of maneuver." << std::endl;
-
-    return 0;
+    log_info() << "Discovered a component with type " << unsigned(component_type);
 }
 
 
 
-int goto_setpoint_and_RTL(Telemetry *telemetry, Action *action, double lat_m, double long_m, double height_above_home, double yaw)
+int main(int argc, char **argv)
 {
-    // calculate new position in longitude and latitude and height above sea level
-    Telemetry::Position position_setpoint = calculate_setpoint(lat_m, long_m, height_above_home, telemetry->position());
-
-    // take off to start maneuver
-    auto return_value = arm_and_takeoff(telemetry, action);
-    if (return_value != 0){
-        return return_value;
-    }
-
-    // send the drone away from home to a new setpoint
-    const Action::Result location_result = action->goto_location(position_setpoint.latitude_deg, position_setpoint.longitude_deg, position_setpoint.absolute_altitude_m, yaw);
-    if (location_result != Action::Result::SUCCESS) {
-        std::cout << ERROR_CONSOLE_TEXT << "going to new location failed failed:" << Action::result_str(location_result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
         return 1;
     }
 
-    // TODO: wait until new setpoint is reached
-    int i = 0;
-    while (i < 15)
-    {
-        // show height in terminal
-        std::cout << TELEMETRY_CONSOLE_TEXT
-        << "Relative height: " << telemetry->position().relative_altitude_m
-        <<  NORMAL_CONSOLE_TEXT<< std::endl;
-        sleep_for(seconds(1));
-        i++;
+    // Rejected before connecting if it cannot be read.
+    std::vector<FencePolygon> fence_polygons;
+    Geofence geofence;
+    if (!options.geofence_path.empty() &&
+        (!load_geofence(options.geofence_path, fence_polygons) || !geofence.build(fence_polygons))) {
+        log_error() << "Cannot use geofence file " << options.geofence_path;
+        return 1;
     }
+    const Geofence *fence = geofence.empty() ? nullptr : &geofence;
 
-    return_value = trigger_RTL(telemetry, action);
-
-    return return_value;
-}
-
-
-
-int main(int argc, char **argv)
-{
     Mavsdk dc;
+    std::unique_ptr<Autopilot> autopilot;
+    std::shared_ptr<MavlinkPassthrough> passthrough;
+    std::unique_ptr<LogDownloader> log_downloader;
+    int return_value = 0;
+
+    double speedup = 1.0;
+    if (parse_sim_url(options.connection_url, speedup)) {
+        log_info() << "Simulating the vehicle at " << speedup << "x real time";
+        autopilot.reset(new SimAutopilot(speedup));
+    } else {
+        // Goes on with the first heartbeat instead of waiting a fixed time.
+        if (!connect_system(dc, options.connection_url, discovery_timeout)) {
+            return 1;
+        }
 
-    int return_value = detect_system(argc, argv, dc);
-    if (return_value != 0){
-        return return_value;
-    }
+        System &system = dc.system();
 
-    System &system = dc.system();
+        // Register a callback so we get told when components (camera, gimbal) etc
+        // are found.
+        system.register_component_discovered_callback(component_discovered);
 
-    return_value = system_setup(dc, system);
-    if (return_value != 0){
-        return return_value;
+        autopilot.reset(new MavsdkAutopilot(system));
+        passthrough = std::make_shared<MavlinkPassthrough>(system);
+        log_downloader.reset(new LogDownloader(*passthrough));
     }
 
-    auto telemetry = std::make_shared<Telemetry>(system);
-    auto action = std::make_shared<Action>(system);
+    TelemetryMonitor &monitor = autopilot->monitor();
+
+    // Remember which logs are already on the vehicle, only the new ones are downloaded.
+    std::vector<LogEntry> logs_before;
+    if (!options.log_directory.empty()) {
+        if (!log_downloader) {
+            log_error() << "The simulated vehicle has no logs to download";
+            return 1;
+        }
+        if (!log_downloader->list_entries(logs_before)) {
+            return 1;
+        }
+    }
 
-    // We want to listen to the altitude of the drone at 1 Hz.
-    const Telemetry::Result set_rate_result = telemetry->set_rate_position(1.0);
+    // The telemetry rates follow the phases of the flight, starting low on the ground.
+    RateScheduler rates(monitor);
+    const Telemetry::Result set_rate_result = rates.enter(FlightPhase::GROUND);
     if (set_rate_result != Telemetry::Result::SUCCESS) {
-        std::cout << ERROR_CONSOLE_TEXT
-                  << "Setting rate failed:" << Telemetry::result_str(set_rate_result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
+        log_error() << "Setting rate failed:" << Telemetry::result_str(set_rate_result);
         return 1;
     }
 
-    std::cout << "Trigger RTL at takeoff height and directly above home" << std::endl;
-    return_value = arm_and_takeoff(telemetry.get(), action.get());
-    if (return_value != 0){
-        return return_value;
+    FlightRecorder recorder(monitor);
+    if (!options.flight_record_file.empty() && !recorder.start(options.flight_record_file, flight_record_rate_hz)) {
+        return 1;
     }
 
-    // land directly over home position (from takeoff height)
-    return_value = trigger_RTL(telemetry.get(), action.get());
+    // show height in terminal, the sink writes it at most once per second even while streaming faster
+    monitor.add_position_listener([](const Telemetry::Position &position) {
+        log_telemetry() << "Relative height: " << position.relative_altitude_m;
+    });
 
-    if (return_value != 0){
-        return return_value;
+    std::vector<LegTiming> legs;
+    RtlChecks checks;
+    checks.rules = options.rtl_rules;
+    ParamCache params;
+    PhaseStats phase_stats;
+    PhaseStats *phases = options.phase_stats_prefix.empty() ? nullptr : &phase_stats;
+
+    // All commands and waits run as one maneuver on the event loop of this thread, while the
+    // listeners above keep printing and recording.
+    EventLoop loop;
+    auto maneuver = std::make_shared<Maneuver>("", *autopilot, loop);
+    maneuver->set_rate_scheduler(&rates);
+    maneuver->abort_if("pilot took over", pilot_took_over(monitor));
+    maneuver->on_failure("return home", return_home_step(phases));
+    maneuver->then("check RTL parameters", rtl_params_step(&params, &checks, options.rtl_rules_given));
+
+    log_info() << "Trigger RTL at takeoff height and directly above home";
+    add_takeoff_and_RTL(*maneuver, phases, &checks);
+
+    for (const auto &scenario : default_rtl_scenarios()) {
+        add_goto_setpoint_and_RTL(*maneuver, scenario, &legs, phases, &checks, fence);
     }
 
-    // set a new setpoint away from home
-    double lat_m = 3;
-    double long_m = 0;
-    double height_above_home = 1;
-    double yaw = 0;
-    std::cout << "Fly less than RTL_CONE_DIST meters away (default: 5m). Drone should not rise up to RTL_RETURN_ALT but only to a height given by a cone" << std::endl;
-    return_value = goto_setpoint_and_RTL(telemetry.get(), action.get(), lat_m, long_m, height_above_home, yaw);
-
-    if (return_value != 0){
-        return return_value;
+    maneuver->start([&loop, &return_value](Maneuver::Result result) {
+        return_value = result == Maneuver::Result::SUCCEEDED ? 0 : 1;
+        loop.stop();
+    });
+    loop.run();
+
+    print_leg_timings(legs);
+    print_rtl_checks(checks.verdicts);
+    print_link_usage(rates.usage(), rates.profile());
+    for (const auto &verdict : checks.verdicts) {
+        if (!verdict.passed) {
+            return_value = 1;
+        }
     }
 
-    // set a new setpoint away from home
-    lat_m = 6;
-    long_m = 0;
-    height_above_home = 4;
-    yaw = 0;
-    std::cout << "Fly away more than RTL_CONE_DIST (drone should rise all the way up to RTL_RETURN_ALT)" << std::endl;
-    return_value = goto_setpoint_and_RTL(telemetry.get(), action.get(), lat_m, long_m, height_above_home, yaw);
-
-    if (return_value != 0){
-        return return_value;
+    if (phases && !export_phase_stats(phase_stats, options.phase_stats_prefix)) {
+        return_value = 1;
     }
 
-    // set a new setpoint away from home
-    lat_m = 10;
-    long_m = 0;
-    height_above_home = 35;
-    yaw = 0;
-    std::cout << "Fly away more than RTL_CONE_DIST and above RTL_RETURN_ALT" << std::endl;
-    return_value = goto_setpoint_and_RTL(telemetry.get(), action.get(), lat_m, long_m, height_above_home, yaw);
-
-    if (return_value != 0){
-        return return_value;
+    recorder.stop();
+    if (!options.flight_record_file.empty()) {
+        log_info() << "Recorded " << recorder.records_written() << " telemetry samples to " << options.flight_record_file;
     }
 
-    // set a new setpoint away from home
-    lat_m = 3;
-    long_m = 0;
-    height_above_home = 15;
-    yaw = 0;
-    std::cout << "Fly away less than RTL_CONE_DIST but above the cone" << std::endl;
-    return_value = goto_setpoint_and_RTL(telemetry.get(), action.get(), lat_m, long_m, height_above_home, yaw);
-
-    // TODO: Download logfiles after flight (code below stops downloading at 89%...)
-    // The log files are also stored here(directly from SITL):  Firmware/build/posix_sitl_default/tmp/rootfs/fs/microsd/log
-
-    // auto log_files = std::make_shared<LogFiles>(system);
-    // const std::string file_path = "/home/philipp/.log";
-    // unsigned id = 1;
-    // std::pair<LogFiles::Result, std::vector<LogFiles::Entry> > log_files_entries = log_files->get_entries();
-    // auto nr_of_entries = log_files_entries.second.size();
-    // auto byte_size = log_files_entries.second[1].size_bytes;
-    // std::cout << "Nr of Log files: " << nr_of_entries << std::endl;
-    // std::cout << "byte size of file 1 :" << byte_size << std::endl;
-    // LogFiles::Result Log_result = log_files->download_log_file(id, file_path);
+    if (!options.log_directory.empty()) {
+        // The vehicle closes a log on disarm, so all logs of the maneuvers are complete now.
+        std::vector<LogEntry> logs_after;
+        log_downloader->list_entries(logs_after);
+
+        for (const auto &entry : new_log_entries(logs_before, logs_after)) {
+            const std::string path = options.log_directory + "/log_" + std::to_string(entry.id) + "_"
+                                     + std::to_string(entry.time_utc) + ".ulg";
+            log_info() << "Downloading log " << entry.id << " (" << entry.size_bytes << " bytes)";
+
+            // A download that gave up continues from its .part file.
+            LogDownloadResult result = log_downloader->download(entry, path);
+            for (int attempt = 1; attempt < 3 && !result.complete; attempt++) {
+                result = log_downloader->download(entry, path);
+            }
+            if (!result.complete) {
+                log_error() << "Log " << entry.id << " incomplete, partial data in " << path << ".part";
+                return_value = 1;
+                continue;
+            }
+            LogLine line = log_info();
+            line << "Saved " << path << ": " << result.bytes << " bytes in " << result.seconds << " s ("
+                 << result.throughput_kib_s() << " KiB/s, " << result.rerequests << " re-requests";
+            if (result.resumed_from > 0) {
+                line << ", resumed at " << result.resumed_from;
+            }
+            line << ")";
+        }
+        log_downloader->end_transfer();
+    }
 
     return return_value;
-}
\ No newline at end of file
+}
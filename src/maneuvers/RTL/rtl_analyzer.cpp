@@ -0,0 +1,135 @@
+#include "rtl_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "geodesy.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+namespace {
+
+const double deg_to_rad = M_PI / 180.0;
+
+} // namespace
+
+bool parse_rtl_rules(const std::string &text, RtlRules &rules)
+{
+    std::string fields_text = text;
+    std::replace(fields_text.begin(), fields_text.end(), ',', ' ');
+    std::istringstream fields(fields_text);
+    RtlRules parsed = rules;
+    if (!(fields >> parsed.return_altitude_m >> parsed.cone_distance_m >> parsed.cone_angle_deg)) {
+        return false;
+    }
+    rules = parsed;
+    return true;
+}
+
+float expected_rtl_altitude(const RtlRules &rules, float distance_m, float altitude_m)
+{
+    float return_altitude_m = rules.return_altitude_m;
+    if (distance_m < rules.cone_distance_m) {
+        const float cone_altitude_m = distance_m / std::tan(rules.cone_angle_deg * deg_to_rad);
+        return_altitude_m = std::min(return_altitude_m, cone_altitude_m);
+    }
+    return std::max(return_altitude_m, altitude_m);
+}
+
+std::string rtl_verdict_failures(const RtlVerdict &verdict)
+{
+    std::string failures;
+    auto add = [&failures](const char *failure) {
+        failures += failures.empty() ? failure : std::string(", ") + failure;
+    };
+    if (verdict.samples == 0) {
+        add("no telemetry");
+        return failures;
+    }
+    if (!verdict.climbed) {
+        add("did not climb to the return altitude");
+    }
+    if (!verdict.within_limit) {
+        add("climbed above the return altitude or cone");
+    }
+    if (!verdict.descended_at_home) {
+        add("descended before reaching home");
+    }
+    if (!verdict.landed_at_home) {
+        add("did not land at home");
+    }
+    return failures;
+}
+
+RtlAnalyzer::RtlAnalyzer(const RtlRules &rules, const Telemetry::Position &home) :
+    _rules(rules),
+    _home(home),
+    _last_altitude_m(NAN)
+{
+    _verdict.samples = 0;
+    _verdict.start_distance_m = NAN;
+    _verdict.start_altitude_m = NAN;
+    _verdict.expected_altitude_m = NAN;
+    _verdict.max_altitude_m = NAN;
+    _verdict.descent_start_distance_m = NAN;
+    _verdict.max_descent_speed_m_s = 0.0f;
+    _verdict.landing_distance_m = NAN;
+    _verdict.climbed = false;
+    _verdict.within_limit = false;
+    _verdict.descended_at_home = false;
+    _verdict.landed_at_home = false;
+    _verdict.passed = false;
+}
+
+void RtlAnalyzer::update(time_point now, const Telemetry::Position &position)
+{
+    double north_m, east_m;
+    geodesy::north_east_between(_home.latitude_deg, _home.longitude_deg,
+                                position.latitude_deg, position.longitude_deg, north_m, east_m);
+    const float distance_m = static_cast<float>(std::sqrt(north_m * north_m + east_m * east_m));
+    const float altitude_m = position.relative_altitude_m;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_verdict.samples++ == 0) {
+        _verdict.start_distance_m = distance_m;
+        _verdict.start_altitude_m = altitude_m;
+        _verdict.expected_altitude_m = expected_rtl_altitude(_rules, distance_m, altitude_m);
+        _verdict.max_altitude_m = altitude_m;
+    } else {
+        const double dt_s = duration_cast<duration<double>>(now - _last_time).count();
+        if (dt_s > 0.0) {
+            _verdict.max_descent_speed_m_s = std::max(_verdict.max_descent_speed_m_s,
+                                                      float((_last_altitude_m - altitude_m) / dt_s));
+        }
+    }
+
+    _verdict.max_altitude_m = std::max(_verdict.max_altitude_m, altitude_m);
+    if (std::isnan(_verdict.descent_start_distance_m) &&
+        altitude_m < _verdict.max_altitude_m - _rules.altitude_tolerance_m) {
+        _verdict.descent_start_distance_m = distance_m;
+    }
+    _verdict.landing_distance_m = distance_m;
+    _last_time = now;
+    _last_altitude_m = altitude_m;
+}
+
+RtlVerdict RtlAnalyzer::verdict() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    RtlVerdict verdict = _verdict;
+    if (verdict.samples == 0) {
+        return verdict;
+    }
+
+    const float tolerance_m = _rules.altitude_tolerance_m;
+    verdict.climbed = verdict.max_altitude_m >= verdict.expected_altitude_m - tolerance_m;
+    verdict.within_limit = verdict.max_altitude_m <= verdict.expected_altitude_m + tolerance_m;
+    verdict.descended_at_home = !(verdict.descent_start_distance_m > _rules.home_radius_m);
+    verdict.landed_at_home = verdict.landing_distance_m <= _rules.home_radius_m &&
+                             _last_altitude_m <= tolerance_m;
+    verdict.passed = verdict.climbed && verdict.within_limit && verdict.descended_at_home &&
+                     verdict.landed_at_home;
+    return verdict;
+}
@@ -0,0 +1,92 @@
+//
+// Checks RTL flights against the rules of the RTL mode while they happen.
+//
+// The vehicle first climbs to RTL_RETURN_ALT, or only up to a cone around
+// home when it is closer than the cone distance, and not at all if it is
+// already higher. It keeps that altitude on the way back and only descends
+// and lands once it is above home. RtlAnalyzer is fed the position samples
+// of one RTL, from the trigger until the vehicle has disarmed, and only
+// keeps running values (highest altitude, where the descent started,
+// fastest descent, ...), so a sample costs the same at any rate and length
+// of the flight. verdict() compares them with the rules.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include <plugins/telemetry/telemetry.h>
+
+// Parameters of the vehicle, and how close the flight has to follow them.
+struct RtlRules {
+    float return_altitude_m; // RTL_RETURN_ALT
+    float cone_distance_m;   // closer than this, RTL only climbs to the cone
+    float cone_angle_deg;    // RTL_CONE_ANG, from the vertical
+    float altitude_tolerance_m;
+    float home_radius_m; // horizontal distance which counts as above home
+
+    // The defaults of the simulated vehicle.
+    RtlRules() :
+        return_altitude_m(30.0f),
+        cone_distance_m(5.0f),
+        cone_angle_deg(45.0f),
+        altitude_tolerance_m(1.0f),
+        home_radius_m(2.0f)
+    {}
+};
+
+// Reads "return_altitude_m,cone_distance_m,cone_angle_deg", false if malformed.
+bool parse_rtl_rules(const std::string &text, RtlRules &rules);
+
+// Altitude above home the vehicle should return at, triggered distance_m from home at altitude_m.
+float expected_rtl_altitude(const RtlRules &rules, float distance_m, float altitude_m);
+
+struct RtlVerdict {
+    std::string scenario;
+    size_t samples;
+
+    // When RTL was triggered.
+    float start_distance_m;
+    float start_altitude_m;
+    float expected_altitude_m;
+
+    float max_altitude_m;
+    float descent_start_distance_m; // NAN if it never descended
+    float max_descent_speed_m_s;
+    float landing_distance_m;
+
+    bool climbed;          // reached the expected altitude
+    bool within_limit;     // never above it, i.e. respected the cone and the return altitude
+    bool descended_at_home; // did not descend before it was above home
+    bool landed_at_home;
+    bool passed;
+};
+
+// The rules a verdict failed, empty if it passed.
+std::string rtl_verdict_failures(const RtlVerdict &verdict);
+
+// Thread safe, the samples usually come from the position listener of a TelemetryMonitor.
+class RtlAnalyzer {
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    RtlAnalyzer(const RtlRules &rules, const mavsdk::Telemetry::Position &home);
+
+    // The first sample is the position at the trigger.
+    void update(time_point now, const mavsdk::Telemetry::Position &position);
+
+    // Checks the flight so far, meant to be called once the vehicle has disarmed.
+    RtlVerdict verdict() const;
+
+private:
+    const RtlRules _rules;
+    const mavsdk::Telemetry::Position _home;
+
+    mutable std::mutex _mutex;
+    RtlVerdict _verdict;
+    time_point _last_time;
+    float _last_altitude_m;
+};
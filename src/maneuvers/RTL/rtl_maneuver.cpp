@@ -0,0 +1,436 @@
+//
+// Building blocks of the RTL maneuver, shared by the single vehicle test and
+// the parallel test matrix.
+//
+//
+// Author: Philipp Andermatt <ph.andermatt@gmail.com>
+
+#include "rtl_maneuver.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <math.h>
+
+#include "arrival_detector.h"
+#include "geodesy.h"
+#include "log_sink.h"
+#include "maneuver_steps.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+// Closer than this to a setpoint, horizontally and vertically, the telemetry runs at the rates of
+// the arrival phase.
+const float arrival_phase_distance_m = 3.0f;
+
+
+
+std::vector<RTLScenario> default_rtl_scenarios()
+{
+    std::vector<RTLScenario> scenarios;
+    scenarios.push_back({3, 0, 1, 0, "Fly less than RTL_CONE_DIST meters away (default: 5m). Drone should not rise up to RTL_RETURN_ALT but only to a height given by a cone"});
+    scenarios.push_back({6, 0, 4, 0, "Fly away more than RTL_CONE_DIST (drone should rise all the way up to RTL_RETURN_ALT)"});
+    scenarios.push_back({10, 0, 35, 0, "Fly away more than RTL_CONE_DIST and above RTL_RETURN_ALT"});
+    scenarios.push_back({3, 0, 15, 0, "Fly away less than RTL_CONE_DIST but above the cone"});
+    return scenarios;
+}
+
+
+
+bool parse_rtl_scenario(const std::string &text, RTLScenario &scenario)
+{
+    std::string line = text;
+    for (auto &c : line) {
+        if (c == ',') {
+            c = ' ';
+        }
+    }
+
+    RTLScenario parsed;
+    std::istringstream fields(line);
+    if (!(fields >> parsed.lat_m >> parsed.long_m >> parsed.height_above_home >> parsed.yaw)) {
+        return false;
+    }
+    std::ostringstream description;
+    description << "Fly to (" << parsed.lat_m << ", " << parsed.long_m << ") m at "
+                << parsed.height_above_home << " m above home";
+    parsed.description = description.str();
+    scenario = parsed;
+    return true;
+}
+
+
+
+bool load_rtl_scenarios(const std::string &path, std::vector<RTLScenario> &scenarios)
+{
+    std::ifstream file(path);
+    if (!file) {
+        log_error() << "Cannot open scenario file " << path;
+        return false;
+    }
+
+    std::string line;
+    unsigned line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        RTLScenario scenario;
+        if (!parse_rtl_scenario(line, scenario)) {
+            log_error() << path << ":" << line_number << ": expected lat_m,long_m,height_above_home,yaw";
+            return false;
+        }
+        scenarios.push_back(scenario);
+    }
+    return true;
+}
+
+
+
+namespace {
+
+// Remembers where the vehicle is, i.e. home as long as it has not taken off.
+Maneuver::step_t remember_home_step(std::shared_ptr<Telemetry::Position> home)
+{
+    return [home](Maneuver &maneuver, Maneuver::done_t done) {
+        *home = maneuver.monitor().position();
+        done(true);
+    };
+}
+
+// Where the scenario goes, from home, before the vehicle takes off. The same setpoint is checked
+// against the fence and flown.
+Maneuver::step_t plan_setpoint_step(const RTLScenario &scenario, std::shared_ptr<const Telemetry::Position> home, std::shared_ptr<Telemetry::Position> setpoint)
+{
+    return [scenario, home, setpoint](Maneuver &, Maneuver::done_t done) {
+        *setpoint = calculate_setpoint(scenario.lat_m, scenario.long_m, scenario.height_above_home, *home);
+        done(true);
+    };
+}
+
+// The leg from home to the setpoint, from the ground so zones below the flight altitude count too.
+Maneuver::step_t check_setpoint_step(const RTLScenario &scenario, std::shared_ptr<const Telemetry::Position> home, std::shared_ptr<const Telemetry::Position> setpoint, const Geofence *fence)
+{
+    return [scenario, home, setpoint, fence](Maneuver &maneuver, Maneuver::done_t done) {
+        const std::vector<FenceViolation> violations = fence->check_leg(*home, *setpoint);
+        if (!violations.empty()) {
+            maneuver.log(LogLevel::ERROR) << "Setpoint " << scenario.lat_m << "," << scenario.long_m << ","
+                                          << scenario.height_above_home << " violates the geofence, not flying it:";
+            print_fence_violations(violations);
+        }
+        done(violations.empty());
+    };
+}
+
+// RTL, checked if checks are given.
+void add_RTL(Maneuver &maneuver, const std::string &scenario, std::shared_ptr<Telemetry::Position> home, RtlChecks *checks, PhaseStats *phases)
+{
+    if (checks) {
+        maneuver.then("return to launch", checked_return_to_launch_step(scenario, home, checks, phases));
+    } else {
+        maneuver.then("return to launch", return_to_launch_step(phases));
+    }
+}
+
+const char *const return_altitude_param = "RTL_RETURN_ALT";
+const char *const cone_distance_param = "RTL_MIN_DIST";
+const char *const cone_angle_param = "RTL_CONE_ANG";
+
+// Parameter values which count as the same as the rules, PX4 stores the cone angle as integer.
+const float rule_tolerance = 0.5f;
+
+std::string describe_rules(const RtlRules &rules)
+{
+    std::ostringstream text;
+    text << return_altitude_param << " " << rules.return_altitude_m << ", " << cone_distance_param << " "
+         << rules.cone_distance_m << ", " << cone_angle_param << " " << rules.cone_angle_deg;
+    return text.str();
+}
+
+} // namespace
+
+
+
+std::vector<std::string> rtl_param_names()
+{
+    std::vector<std::string> names;
+    names.push_back(return_altitude_param);
+    names.push_back(cone_distance_param);
+    names.push_back(cone_angle_param);
+    return names;
+}
+
+
+
+bool rtl_rules_from_params(const ParamCache &params, RtlRules &rules)
+{
+    ParamValue return_altitude, cone_distance, cone_angle;
+    if (!params.get(return_altitude_param, return_altitude) || !params.get(cone_distance_param, cone_distance) ||
+        !params.get(cone_angle_param, cone_angle)) {
+        return false;
+    }
+    rules.return_altitude_m = static_cast<float>(return_altitude.as_double());
+    rules.cone_distance_m = static_cast<float>(cone_distance.as_double());
+    rules.cone_angle_deg = static_cast<float>(cone_angle.as_double());
+    return true;
+}
+
+
+
+void add_takeoff_and_RTL(Maneuver &maneuver, PhaseStats *phases, RtlChecks *checks)
+{
+    auto home = std::make_shared<Telemetry::Position>();
+    maneuver.then("wait until ready", ready_step());
+    maneuver.then("remember home", remember_home_step(home));
+    maneuver.then("arm", arm_step(phases));
+    maneuver.then("take off", takeoff_step(phases));
+    // land directly over home position (from takeoff height)
+    add_RTL(maneuver, "RTL directly above home", home, checks, phases);
+}
+
+
+
+Maneuver::step_t goto_setpoint_step(const RTLScenario &scenario, std::shared_ptr<const Telemetry::Position> planned, std::vector<LegTiming> *legs, PhaseStats *phases)
+{
+    return [scenario, planned, legs, phases](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        TelemetryMonitor *monitor = &maneuver.monitor();
+        const Clock *clock = &maneuver.autopilot().clock();
+
+        // set a new setpoint away from home
+        maneuver.log() << scenario.description;
+
+        const Telemetry::Position setpoint = *planned;
+
+        maneuver.enter_flight_phase(FlightPhase::CRUISE);
+
+        auto detector = std::make_shared<ArrivalDetector>(setpoint, ArrivalCriteria());
+        detector->reset(clock->now());
+
+        const auto position_handle = monitor->add_position_listener(
+            [detector, clock](const Telemetry::Position &position) {
+                detector->update_position(clock->now(), position);
+            });
+        const auto speed_handle = monitor->add_ground_speed_listener(
+            [detector, clock](const Telemetry::GroundSpeedNED &speed) {
+                detector->update_speed(clock->now(),
+                                       sqrtf(speed.velocity_north_m_s * speed.velocity_north_m_s +
+                                             speed.velocity_east_m_s * speed.velocity_east_m_s +
+                                             speed.velocity_down_m_s * speed.velocity_down_m_s));
+            });
+        maneuver.on_step_end([monitor, position_handle, speed_handle]() {
+            monitor->remove_listener(position_handle);
+            monitor->remove_listener(speed_handle);
+        });
+
+        // send the drone away from home to a new setpoint
+        auto timer = std::make_shared<PhaseTimer>(phases, "goto_location", *clock);
+        maneuver.autopilot().goto_location_async(
+            setpoint.latitude_deg, setpoint.longitude_deg, setpoint.absolute_altitude_m, scenario.yaw,
+            m->in_step<Action::Result>([m, monitor, setpoint, scenario, legs, detector, timer, done](Action::Result result) {
+                timer->acked(result == Action::Result::SUCCESS);
+                if (result != Action::Result::SUCCESS) {
+                    m->log(LogLevel::ERROR) << "going to new location failed:" << Action::result_str(result);
+                    done(false);
+                    return;
+                }
+
+                const milliseconds timeout = seconds(120);
+                const auto arrived_done = [m, scenario, legs, detector, timer, done](bool arrived, double elapsed_s) {
+                    timer->completed(arrived);
+
+                    LegTiming leg = {scenario.lat_m, scenario.long_m, scenario.height_above_home, arrived, NAN, NAN};
+                    if (!arrived) {
+                        m->log(LogLevel::ERROR) << "Setpoint not reached after " << elapsed_s
+                                                << " s, still " << detector->last_distance_m() << " m away";
+                    } else {
+                        leg.time_to_arrive_s = duration_cast<duration<double>>(detector->time_to_arrive()).count();
+                        leg.time_to_settle_s = duration_cast<duration<double>>(detector->time_to_settle()).count();
+                        m->log() << "Setpoint reached after " << leg.time_to_arrive_s << " s (settled after "
+                                 << leg.time_to_settle_s << " s)";
+                    }
+                    legs->push_back(leg);
+                    done(arrived);
+                };
+                m->wait_until(
+                    [monitor, setpoint, detector]() {
+                        return detector->arrived() ||
+                               (detector->last_distance_m() < arrival_phase_distance_m &&
+                                fabsf(monitor->position().absolute_altitude_m - setpoint.absolute_altitude_m) <
+                                    arrival_phase_distance_m);
+                    },
+                    timeout,
+                    [m, detector, timeout, arrived_done](bool close, double elapsed_s) {
+                        if (!close || detector->arrived()) {
+                            arrived_done(close, elapsed_s);
+                            return;
+                        }
+                        // Position and velocity fast enough to notice the arrival right away once close.
+                        m->enter_flight_phase(FlightPhase::ARRIVAL);
+                        const double arrival_start_s = elapsed_s;
+                        m->wait_until([detector]() { return detector->arrived(); }, remaining_timeout(timeout, elapsed_s),
+                                      [arrival_start_s, arrived_done](bool arrived, double arrival_s) {
+                            arrived_done(arrived, arrival_start_s + arrival_s);
+                        });
+                    });
+            }));
+    };
+}
+
+
+
+Maneuver::step_t checked_return_to_launch_step(const std::string &scenario, std::shared_ptr<const Telemetry::Position> home, RtlChecks *checks, PhaseStats *phases)
+{
+    const Maneuver::step_t return_to_launch = return_to_launch_step(phases);
+    return [scenario, home, checks, return_to_launch](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        TelemetryMonitor *monitor = &maneuver.monitor();
+        const Clock *clock = &maneuver.autopilot().clock();
+
+        auto analyzer = std::make_shared<RtlAnalyzer>(checks->rules, *home);
+        analyzer->update(clock->now(), monitor->position());
+
+        // Every sample of the way home, it is checked as it arrives.
+        const auto position_handle = monitor->add_position_listener(
+            [analyzer, clock](const Telemetry::Position &position) {
+                analyzer->update(clock->now(), position);
+            });
+        maneuver.on_step_end([monitor, position_handle]() {
+            monitor->remove_listener(position_handle);
+        });
+
+        return_to_launch(maneuver, [m, scenario, analyzer, checks, done](bool disarmed) {
+            if (disarmed) {
+                RtlVerdict verdict = analyzer->verdict();
+                verdict.scenario = scenario;
+                if (verdict.passed) {
+                    m->log() << "RTL check passed: returned at " << verdict.max_altitude_m << " m (expected "
+                             << verdict.expected_altitude_m << " m), landed " << verdict.landing_distance_m
+                             << " m from home";
+                } else {
+                    m->log(LogLevel::ERROR) << "RTL check failed: " << rtl_verdict_failures(verdict)
+                                            << " (returned at " << verdict.max_altitude_m << " m, expected "
+                                            << verdict.expected_altitude_m << " m)";
+                }
+                checks->verdicts.push_back(verdict);
+            }
+            // A failed check is a finding, not a reason to stop the maneuver.
+            done(disarmed);
+        });
+    };
+}
+
+
+
+void add_goto_setpoint_and_RTL(Maneuver &maneuver, const RTLScenario &scenario, std::vector<LegTiming> *legs, PhaseStats *phases, RtlChecks *checks, const Geofence *fence)
+{
+    auto home = std::make_shared<Telemetry::Position>();
+    // take off to start maneuver
+    maneuver.then("wait until ready", ready_step());
+    maneuver.then("remember home", remember_home_step(home));
+    auto setpoint = std::make_shared<Telemetry::Position>();
+    maneuver.then("plan setpoint", plan_setpoint_step(scenario, home, setpoint));
+    if (fence) {
+        maneuver.then("check setpoint against geofence", check_setpoint_step(scenario, home, setpoint, fence));
+    }
+    maneuver.then("arm", arm_step(phases));
+    maneuver.then("take off", takeoff_step(phases));
+    maneuver.then(scenario.description, goto_setpoint_step(scenario, setpoint, legs, phases));
+    add_RTL(maneuver, scenario.description, home, checks, phases);
+}
+
+
+
+Maneuver::step_t rtl_params_step(ParamCache *params, RtlChecks *checks, bool rules_given)
+{
+    const Maneuver::step_t fetch = fetch_params_step(params, rtl_param_names());
+    return [params, checks, rules_given, fetch](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        fetch(maneuver, [m, params, checks, rules_given, done](bool) {
+            RtlRules vehicle_rules = checks->rules;
+            if (!rtl_rules_from_params(*params, vehicle_rules)) {
+                if (rules_given) {
+                    // The vehicle has to be known to have them, or nothing is flown.
+                    m->log(LogLevel::ERROR) << "RTL parameters not available, cannot check for "
+                                            << describe_rules(checks->rules);
+                    done(false);
+                    return;
+                }
+                m->log(LogLevel::ERROR) << "RTL parameters not available, checking against "
+                                        << describe_rules(checks->rules);
+                done(true);
+                return;
+            }
+
+            if (!rules_given) {
+                checks->rules = vehicle_rules;
+                m->log() << "Checking against the RTL parameters of the vehicle: " << describe_rules(vehicle_rules);
+                done(true);
+                return;
+            }
+
+            const RtlRules &expected = checks->rules;
+            if (fabsf(vehicle_rules.return_altitude_m - expected.return_altitude_m) > rule_tolerance ||
+                fabsf(vehicle_rules.cone_distance_m - expected.cone_distance_m) > rule_tolerance ||
+                fabsf(vehicle_rules.cone_angle_deg - expected.cone_angle_deg) > rule_tolerance) {
+                m->log(LogLevel::ERROR) << "The vehicle has " << describe_rules(vehicle_rules) << ", expected "
+                                        << describe_rules(expected);
+                done(false);
+                return;
+            }
+            done(true);
+        });
+    };
+}
+
+
+
+Maneuver::step_t sweep_param_step(ParamCache *params, const std::string &name, double value, RtlChecks *checks)
+{
+    const Maneuver::step_t set = set_param_step(params, name, value);
+    return [params, checks, set](Maneuver &maneuver, Maneuver::done_t done) {
+        set(maneuver, [params, checks, done](bool set) {
+            if (set && checks) {
+                rtl_rules_from_params(*params, checks->rules);
+            }
+            done(set);
+        });
+    };
+}
+
+
+
+void print_rtl_checks(const std::vector<RtlVerdict> &verdicts)
+{
+    log_info() << "RTL checks (returned at / expected altitude, descent started / landed from home):";
+    for (const auto &verdict : verdicts) {
+        LogLine line = log_info();
+        line << "  " << (verdict.passed ? "ok     " : "FAILED ") << std::fixed << std::setprecision(1)
+             << verdict.max_altitude_m << " / " << verdict.expected_altitude_m << " m, "
+             << verdict.descent_start_distance_m << " / " << verdict.landing_distance_m << " m: "
+             << verdict.scenario;
+        if (!verdict.passed) {
+            line << " (" << rtl_verdict_failures(verdict) << ")";
+        }
+    }
+}
+
+
+
+void print_leg_timings(const std::vector<LegTiming> &legs)
+{
+    log_info() << "Time to arrive per leg (lat_m, long_m, height_above_home):";
+    for (const auto &leg : legs) {
+        LogLine line = log_info();
+        line << "  (" << leg.lat_m << ", " << leg.long_m << ", " << leg.height_above_home << "): ";
+        if (leg.arrived) {
+            line << leg.time_to_arrive_s << " s, settled after " << leg.time_to_settle_s << " s";
+        } else {
+            line << "not reached";
+        }
+    }
+}
@@ -0,0 +1,96 @@
+//
+// Building blocks of the RTL maneuver, shared by the single vehicle test and
+// the parallel test matrix.
+//
+//
+// Author: Philipp Andermatt <ph.andermatt@gmail.com>
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "geofence.h"
+#include "maneuver.h"
+#include "param_cache.h"
+#include "phase_stats.h"
+#include "rtl_analyzer.h"
+
+// One flight away from home followed by RTL.
+struct RTLScenario {
+    double lat_m;
+    double long_m;
+    double height_above_home;
+    double yaw;
+    std::string description;
+};
+
+// Result of one leg away from home, kept for the summary at the end of the maneuver.
+struct LegTiming {
+    double lat_m;
+    double long_m;
+    double height_above_home;
+    bool arrived;
+    double time_to_arrive_s;
+    double time_to_settle_s;
+};
+
+// RTL flights checked against rules, one verdict per RTL.
+struct RtlChecks {
+    RtlRules rules;
+    std::vector<RtlVerdict> verdicts;
+};
+
+// The scenarios flown by maneuvers_RTL.
+std::vector<RTLScenario> default_rtl_scenarios();
+
+// Reads one "lat_m,long_m,height_above_home,yaw" scenario, false if malformed.
+bool parse_rtl_scenario(const std::string &text, RTLScenario &scenario);
+
+// Appends scenarios read from a file with one "lat_m,long_m,height_above_home,yaw" line each.
+// Empty lines and lines starting with '#' are skipped.
+bool load_rtl_scenarios(const std::string &path, std::vector<RTLScenario> &scenarios);
+
+// The parameters of the vehicle the rules of RtlRules stand for. The cone distance is
+// RTL_MIN_DIST, the RTL_CONE_DIST of the scenario descriptions.
+std::vector<std::string> rtl_param_names();
+
+// Takes the rules from the RTL parameters in params, false (and rules unchanged) if one is missing.
+bool rtl_rules_from_params(const ParamCache &params, RtlRules &rules);
+
+// The steps below run on a Maneuver (maneuver.h). If phases is given, the ack and completion
+// latency of every command is recorded into it. If checks is given, every RTL is checked
+// against its rules and the verdict appended to it.
+
+// Arms, takes off and triggers RTL right away, to land directly over home.
+void add_takeoff_and_RTL(Maneuver &maneuver, PhaseStats *phases = nullptr, RtlChecks *checks = nullptr);
+
+// Flies to setpoint, where the scenario goes as planned from home before takeoff, and waits until
+// the vehicle has arrived there. The leg is appended to legs, the step fails if the setpoint is not
+// reached.
+Maneuver::step_t goto_setpoint_step(const RTLScenario &scenario, std::shared_ptr<const mavsdk::Telemetry::Position> setpoint, std::vector<LegTiming> *legs, PhaseStats *phases = nullptr);
+
+// Arms, takes off, flies to the setpoint of the scenario and triggers RTL. If the setpoint is
+// not reached the maneuver fails, so its failure steps (return_home_step) bring the vehicle back.
+// If fence is given, the way to the setpoint is checked against it before arming, and nothing is
+// flown if it violates the fence.
+void add_goto_setpoint_and_RTL(Maneuver &maneuver, const RTLScenario &scenario, std::vector<LegTiming> *legs, PhaseStats *phases = nullptr, RtlChecks *checks = nullptr, const Geofence *fence = nullptr);
+
+// Like return_to_launch_step, and feeds the telemetry of the flight home into an RtlAnalyzer. home
+// is where the vehicle took off. A failed check does not fail the step.
+Maneuver::step_t checked_return_to_launch_step(const std::string &scenario, std::shared_ptr<const mavsdk::Telemetry::Position> home, RtlChecks *checks, PhaseStats *phases = nullptr);
+
+// Fetches the RTL parameters of the vehicle into params. If rules_given, the step fails unless
+// the vehicle has the parameters the rules of checks expect, also if they cannot be fetched.
+// Otherwise the rules are taken from the vehicle, and kept as they are if it has not got all of
+// the parameters.
+Maneuver::step_t rtl_params_step(ParamCache *params, RtlChecks *checks, bool rules_given);
+
+// Sets a parameter for the scenarios which follow (set_param_step), and the rules of checks
+// along with it if it is an RTL parameter.
+Maneuver::step_t sweep_param_step(ParamCache *params, const std::string &name, double value, RtlChecks *checks);
+
+void print_rtl_checks(const std::vector<RtlVerdict> &verdicts);
+
+void print_leg_timings(const std::vector<LegTiming> &legs);
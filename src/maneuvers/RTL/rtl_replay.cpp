@@ -0,0 +1,186 @@
+#include "rtl_replay.h"
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "param_cache.h"
+#include "rtl_maneuver.h"
+#include "ulog_reader.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+
+
+namespace {
+
+// vehicle_status_s::NAVIGATION_STATE_AUTO_RTL and ARMING_STATE_ARMED of PX4.
+const double nav_state_auto_rtl = 5;
+const double arming_state_armed = 2;
+
+struct ReplayFields {
+    ULogField timestamp;
+    ULogField latitude;
+    ULogField longitude;
+    ULogField altitude;
+    ULogField home_latitude;
+    ULogField home_longitude;
+    ULogField home_altitude;
+    ULogField nav_state;
+    ULogField arming_state;
+
+    bool valid() const
+    {
+        return timestamp.valid() && latitude.valid() && longitude.valid() && altitude.valid() &&
+               home_latitude.valid() && home_longitude.valid() && home_altitude.valid() &&
+               nav_state.valid() && arming_state.valid();
+    }
+};
+
+// What the replay knows about the vehicle, updated message by message.
+struct ReplayState {
+    const ULogReader *log;
+    RtlRules rules;
+    LogReplayResult *result;
+
+    bool have_home;
+    Telemetry::Position home;
+    bool have_position;
+    Telemetry::Position position;
+    uint64_t position_time_us;
+
+    bool armed;
+    bool in_rtl;
+    std::unique_ptr<RtlAnalyzer> analyzer;
+    std::string scenario;
+};
+
+RtlAnalyzer::time_point replay_time(uint64_t timestamp_us)
+{
+    return RtlAnalyzer::time_point(microseconds(timestamp_us));
+}
+
+// The rules of the parameters the log has at this point, defaults unless it has all of them.
+RtlRules rules_in_log(const ULogReader &log, const RtlRules &defaults)
+{
+    ParamCache params;
+    for (const auto &name : rtl_param_names()) {
+        ParamValue value;
+        if (log.param(name, value)) {
+            params.store(name, value);
+        }
+    }
+    RtlRules rules = defaults;
+    rtl_rules_from_params(params, rules);
+    return rules;
+}
+
+void update_status(ReplayState &state, bool armed, bool in_rtl)
+{
+    if (state.analyzer && (!armed || !in_rtl)) {
+        if (!armed) {
+            RtlVerdict verdict = state.analyzer->verdict();
+            verdict.scenario = state.scenario;
+            state.result->verdicts.push_back(verdict);
+        } else {
+            state.result->interrupted++;
+        }
+        state.analyzer.reset();
+    }
+
+    // Triggered now, the first sample is where the vehicle is.
+    if (armed && in_rtl && !state.in_rtl && !state.analyzer && state.have_home && state.have_position) {
+        std::ostringstream scenario;
+        scenario << "RTL at " << state.position_time_us / 1e6 << " s";
+        state.scenario = scenario.str();
+        state.analyzer.reset(new RtlAnalyzer(rules_in_log(*state.log, state.rules), state.home));
+        state.analyzer->update(replay_time(state.position_time_us), state.position);
+    }
+    state.armed = armed;
+    state.in_rtl = in_rtl;
+}
+
+} // namespace
+
+
+
+LogReplayResult replay_rtl_log(const std::string &path, const RtlRules &rules)
+{
+    const auto start = steady_clock::now();
+    LogReplayResult result;
+    result.path = path;
+    result.read = false;
+    result.truncated = false;
+    result.bytes = 0;
+    result.seconds = 0.0;
+    result.interrupted = 0;
+
+    ULogReader log;
+    if (!log.open(path)) {
+        result.error = log.error();
+        return result;
+    }
+    result.bytes = log.size_bytes();
+
+    ReplayFields fields;
+    fields.timestamp = log.field("vehicle_global_position", "timestamp");
+    fields.latitude = log.field("vehicle_global_position", "lat");
+    fields.longitude = log.field("vehicle_global_position", "lon");
+    fields.altitude = log.field("vehicle_global_position", "alt");
+    fields.home_latitude = log.field("home_position", "lat");
+    fields.home_longitude = log.field("home_position", "lon");
+    fields.home_altitude = log.field("home_position", "alt");
+    fields.nav_state = log.field("vehicle_status", "nav_state");
+    fields.arming_state = log.field("vehicle_status", "arming_state");
+
+    ReplayState state;
+    state.log = &log;
+    state.rules = rules;
+    state.result = &result;
+    state.have_home = false;
+    state.home = Telemetry::Position();
+    state.have_position = false;
+    state.position = Telemetry::Position();
+    state.position_time_us = 0;
+    state.armed = false;
+    state.in_rtl = false;
+
+    if (fields.valid()) {
+        ReplayState *s = &state;
+        const ReplayFields *f = &fields;
+        log.subscribe("home_position", 0, [s, f](const uint8_t *data) {
+            s->home.latitude_deg = f->home_latitude.read(data);
+            s->home.longitude_deg = f->home_longitude.read(data);
+            s->home.absolute_altitude_m = static_cast<float>(f->home_altitude.read(data));
+            s->home.relative_altitude_m = 0.0f;
+            s->have_home = true;
+        });
+        log.subscribe("vehicle_global_position", 0, [s, f](const uint8_t *data) {
+            s->position_time_us = static_cast<uint64_t>(f->timestamp.read(data));
+            s->position.latitude_deg = f->latitude.read(data);
+            s->position.longitude_deg = f->longitude.read(data);
+            s->position.absolute_altitude_m = static_cast<float>(f->altitude.read(data));
+            s->position.relative_altitude_m = s->position.absolute_altitude_m - s->home.absolute_altitude_m;
+            s->have_position = true;
+            if (s->analyzer) {
+                s->analyzer->update(replay_time(s->position_time_us), s->position);
+            }
+        });
+        log.subscribe("vehicle_status", 0, [s, f](const uint8_t *data) {
+            update_status(*s, f->arming_state.read(data) == arming_state_armed,
+                          f->nav_state.read(data) == nav_state_auto_rtl);
+        });
+    }
+
+    log.replay();
+    if (state.analyzer) {
+        result.interrupted++;
+    }
+    result.read = true;
+    result.truncated = log.truncated();
+    result.seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    return result;
+}
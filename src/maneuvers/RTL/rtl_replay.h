@@ -0,0 +1,33 @@
+//
+// Finds the RTLs in a PX4 ULog and checks them as they are checked live.
+//
+// An RTL starts when the armed vehicle switches to the RTL navigation state
+// and ends when it disarms. Its global positions from the trigger on go
+// through the same RtlAnalyzer as the telemetry of a live flight
+// (rtl_analyzer.h), against the RTL parameters the log has at the trigger.
+// An RTL which is left for another mode before the vehicle disarms, or in
+// which the log ends, is counted as interrupted and not checked.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "rtl_analyzer.h"
+
+struct LogReplayResult {
+    std::string path;
+    bool read;
+    std::string error; // why the log could not be read
+    bool truncated;
+    size_t bytes;
+    double seconds; // to read and check it
+    unsigned interrupted;
+    std::vector<RtlVerdict> verdicts;
+};
+
+// rules stand in for the RTL parameters of logs which do not have all of them. Logs without the topics
+// needed (vehicle_status, home_position, vehicle_global_position) simply have no RTLs.
+LogReplayResult replay_rtl_log(const std::string &path, const RtlRules &rules);
@@ -0,0 +1,198 @@
+#include "bench_harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+
+using namespace std::chrono;
+
+namespace {
+
+// Every allocation is prefixed with its size, so the delete side can keep track of the
+// live bytes.
+const std::size_t header_size = 16;
+
+std::size_t allocations = 0;
+std::size_t allocated_bytes = 0;
+std::size_t live_bytes = 0;
+std::size_t peak_bytes = 0;
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    void *block = std::malloc(size + header_size);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *static_cast<std::size_t *>(block) = size;
+    allocations++;
+    allocated_bytes += size;
+    live_bytes += size;
+    peak_bytes = std::max(peak_bytes, live_bytes);
+    return static_cast<char *>(block) + header_size;
+}
+
+// Not inlined, otherwise GCC sees free() on a pointer from operator new and warns.
+__attribute__((noinline)) void operator delete(void *pointer) noexcept
+{
+    if (!pointer) {
+        return;
+    }
+    void *block = static_cast<char *>(pointer) - header_size;
+    live_bytes -= *static_cast<std::size_t *>(block);
+    std::free(block);
+}
+
+void BenchmarkSuite::add(const std::string &name, std::size_t ops, body_t body, std::size_t bytes_per_op)
+{
+    _benchmarks.push_back({name, ops, body, bytes_per_op});
+}
+
+std::vector<BenchmarkResult> BenchmarkSuite::run(const std::string &filter, unsigned repetitions) const
+{
+    std::vector<BenchmarkResult> results;
+    for (const auto &benchmark : _benchmarks) {
+        if (benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        // Warm up caches and let lazily allocated state settle.
+        benchmark.body(benchmark.ops);
+
+        BenchmarkResult result = {benchmark.name, benchmark.ops, 1e300, 0.0, 0.0, 0, 0.0, 0.0};
+        for (unsigned i = 0; i < repetitions; ++i) {
+            const std::size_t allocations_before = allocations;
+            const std::size_t bytes_before = allocated_bytes;
+            const std::size_t live_before = live_bytes;
+            peak_bytes = live_bytes;
+
+            const auto start = steady_clock::now();
+            benchmark.body(benchmark.ops);
+            const double ns = duration_cast<duration<double, std::nano>>(steady_clock::now() - start).count();
+
+            result.ns_per_op = std::min(result.ns_per_op, ns / benchmark.ops);
+            result.allocs_per_op = double(allocations - allocations_before) / benchmark.ops;
+            result.bytes_allocated_per_op = double(allocated_bytes - bytes_before) / benchmark.ops;
+            result.peak_bytes = peak_bytes - live_before;
+        }
+        result.ops_per_s = 1e9 / result.ns_per_op;
+        result.mib_per_s = result.ops_per_s * benchmark.bytes_per_op / (1024.0 * 1024.0);
+        results.push_back(result);
+    }
+    return results;
+}
+
+void print_results(const std::vector<BenchmarkResult> &results)
+{
+    std::cout << std::left << std::setw(44) << "benchmark" << std::right << std::setw(12)
+              << "ns/op" << std::setw(12) << "allocs/op" << std::setw(12) << "bytes/op"
+              << std::setw(12) << "KiB peak" << std::setw(14) << "ops/s" << std::setw(10) << "MiB/s" << std::endl;
+    for (const auto &result : results) {
+        std::cout << std::left << std::setw(44) << result.name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(12) << result.ns_per_op << std::setw(12)
+                  << result.allocs_per_op << std::setw(12) << std::setprecision(1)
+                  << result.bytes_allocated_per_op << std::setw(12) << result.peak_bytes / 1024.0
+                  << std::setw(14) << std::setprecision(0)
+                  << result.ops_per_s << std::setw(10) << std::setprecision(1);
+        if (result.mib_per_s > 0.0) {
+            std::cout << result.mib_per_s;
+        } else {
+            std::cout << "-";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+bool write_json(const std::string &path, const std::vector<BenchmarkResult> &results)
+{
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    file << std::setprecision(9) << "{\"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult &result = results[i];
+        file << "  {\"name\": \"" << result.name << "\", \"ops\": " << result.ops
+             << ", \"ns_per_op\": " << result.ns_per_op << ", \"allocs_per_op\": " << result.allocs_per_op
+             << ", \"bytes_allocated_per_op\": " << result.bytes_allocated_per_op
+             << ", \"peak_bytes\": " << result.peak_bytes
+             << ", \"ops_per_s\": " << result.ops_per_s << ", \"mib_per_s\": " << result.mib_per_s << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "]}\n";
+    return bool(file);
+}
+
+namespace {
+
+bool read_number(const std::string &line, const std::string &key, double &value)
+{
+    const std::string pattern = "\"" + key + "\": ";
+    const size_t position = line.find(pattern);
+    if (position == std::string::npos) {
+        return false;
+    }
+    value = std::strtod(line.c_str() + position + pattern.size(), nullptr);
+    return true;
+}
+
+} // namespace
+
+bool compare_with_baseline(const std::string &path,
+                           const std::vector<BenchmarkResult> &results,
+                           double tolerance)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Cannot read baseline " << path << std::endl;
+        return false;
+    }
+
+    std::map<std::string, std::pair<double, double>> baseline;
+    std::string line;
+    while (std::getline(file, line)) {
+        const std::string name_key = "\"name\": \"";
+        const size_t name_start = line.find(name_key);
+        if (name_start == std::string::npos) {
+            continue;
+        }
+        const size_t name_end = line.find('"', name_start + name_key.size());
+        const std::string name = line.substr(name_start + name_key.size(), name_end - name_start - name_key.size());
+        double ns_per_op = 0.0;
+        double allocs_per_op = 0.0;
+        if (read_number(line, "ns_per_op", ns_per_op) && read_number(line, "allocs_per_op", allocs_per_op)) {
+            baseline[name] = std::make_pair(ns_per_op, allocs_per_op);
+        }
+    }
+
+    bool ok = true;
+    for (const auto &result : results) {
+        const auto entry = baseline.find(result.name);
+        if (entry == baseline.end()) {
+            continue;
+        }
+        const double base_ns = entry->second.first;
+        const double base_allocs = entry->second.second;
+        if (result.allocs_per_op > base_allocs + 1e-9) {
+            std::cout << "REGRESSION " << result.name << ": " << result.allocs_per_op
+                      << " allocs/op, baseline " << base_allocs << std::endl;
+            ok = false;
+        }
+        if (result.ns_per_op > base_ns * (1.0 + tolerance)) {
+            std::cout << "REGRESSION " << result.name << ": " << result.ns_per_op
+                      << " ns/op, baseline " << base_ns << " (+" << tolerance * 100.0 << "% allowed)"
+                      << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,85 @@
+//
+// Small harness for the benchmarks in this directory.
+//
+// Every benchmark runs a fixed number of operations on fixed inputs, so two
+// runs do exactly the same work. Each one is repeated and the fastest run
+// is reported, together with the heap allocations per operation and the
+// peak heap usage of a run, counted by replacing the global operator
+// new/delete. Benchmarks run one at a time on the main thread.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+    std::string name;
+    std::size_t ops;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_allocated_per_op;
+    std::size_t peak_bytes; // heap in use at most during a run, above what was in use before
+    double ops_per_s;
+    double mib_per_s; // 0 if the benchmark has no payload size
+};
+
+class BenchmarkSuite {
+public:
+    // Runs ops operations.
+    typedef std::function<void(std::size_t ops)> body_t;
+
+    // bytes_per_op is the payload one operation processes, 0 if that doesn't apply.
+    void add(const std::string &name, std::size_t ops, body_t body, std::size_t bytes_per_op = 0);
+
+    // Runs all benchmarks whose name contains filter.
+    std::vector<BenchmarkResult> run(const std::string &filter, unsigned repetitions) const;
+
+private:
+    struct Benchmark {
+        std::string name;
+        std::size_t ops;
+        body_t body;
+        std::size_t bytes_per_op;
+    };
+
+    std::vector<Benchmark> _benchmarks;
+};
+
+void print_results(const std::vector<BenchmarkResult> &results);
+
+// One benchmark per line, so the file is easy to diff as well as to parse.
+bool write_json(const std::string &path, const std::vector<BenchmarkResult> &results);
+
+// Compares with a file written by write_json. A benchmark regressed if it allocates more
+// per operation, or is more than tolerance (e.g. 0.1 for 10%) slower.
+bool compare_with_baseline(const std::string &path,
+                           const std::vector<BenchmarkResult> &results,
+                           double tolerance);
+
+// Keeps the compiler from dropping the computation of value.
+template<typename T>
+inline void do_not_optimize(const T &value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Deterministic generator for benchmark inputs, the same on every run and platform.
+struct Lcg {
+    uint64_t state;
+    double next()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<double>(state >> 11) / 9007199254740992.0;
+    }
+};
+
+void register_geodesy_benchmarks(BenchmarkSuite &suite);
+void register_geofence_benchmarks(BenchmarkSuite &suite);
+void register_mission_benchmarks(BenchmarkSuite &suite);
+void register_survey_benchmarks(BenchmarkSuite &suite);
+void register_telemetry_benchmarks(BenchmarkSuite &suite);
+void register_trajectory_benchmarks(BenchmarkSuite &suite);
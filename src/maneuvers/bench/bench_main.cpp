@@ -0,0 +1,73 @@
+//
+// Benchmarks of the code paths which don't need a vehicle.
+//
+// Usage: maneuvers_bench [-f filter] [-r repetitions] [-j results.json]
+//                        [-b baseline.json] [-t tolerance]
+//
+// With -b the results are compared against an earlier -j output and the
+// exit code is 1 if any benchmark regressed, so it can gate a CI job.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "bench_harness.h"
+
+void usage(const std::string &bin_name)
+{
+    std::cout << "Usage : " << bin_name
+              << " [-f filter] [-r repetitions] [-j results.json] [-b baseline.json] [-t tolerance]" << std::endl
+              << "  -f  only run benchmarks whose name contains filter" << std::endl
+              << "  -r  runs per benchmark, the fastest is reported (default 7)" << std::endl
+              << "  -j  write the results as JSON" << std::endl
+              << "  -b  fail if slower than tolerance (default 0.1) or more allocations than baseline" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    std::string filter;
+    std::string json_path;
+    std::string baseline_path;
+    unsigned repetitions = 7;
+    double tolerance = 0.1;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-f" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "-r" && i + 1 < argc) {
+            repetitions = std::max(1u, static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10)));
+        } else if (arg == "-j" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "-b" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (arg == "-t" && i + 1 < argc) {
+            tolerance = std::strtod(argv[++i], nullptr);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    BenchmarkSuite suite;
+    register_geodesy_benchmarks(suite);
+    register_geofence_benchmarks(suite);
+    register_mission_benchmarks(suite);
+    register_survey_benchmarks(suite);
+    register_telemetry_benchmarks(suite);
+    register_trajectory_benchmarks(suite);
+
+    const std::vector<BenchmarkResult> results = suite.run(filter, repetitions);
+    std::cout << "Best of " << repetitions << " runs" << std::endl;
+    print_results(results);
+
+    if (!json_path.empty() && !write_json(json_path, results)) {
+        return 1;
+    }
+    if (!baseline_path.empty() && !compare_with_baseline(baseline_path, results, tolerance)) {
+        return 1;
+    }
+    return 0;
+}
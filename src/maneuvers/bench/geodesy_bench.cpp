@@ -0,0 +1,73 @@
+//
+// Per-point geodesy functions against the batch kernels, on the same
+// pseudo-random bearing/radius and north/east offsets around one origin.
+// One operation is one projected point.
+//
+
+#include <memory>
+#include <vector>
+
+#include "bench_harness.h"
+#include "geodesy.h"
+
+using namespace mavsdk;
+
+namespace {
+
+const std::size_t point_count = 200000;
+
+struct GeodesyInputs {
+    Telemetry::Position origin;
+    std::vector<double> radius, bearing, north, east;
+    std::vector<double> latitude, longitude;
+    std::vector<Telemetry::Position> points;
+};
+
+} // namespace
+
+void register_geodesy_benchmarks(BenchmarkSuite &suite)
+{
+    auto in = std::make_shared<GeodesyInputs>();
+    in->origin = {47.397742, 8.545594, 488.0f, 0.0f};
+    in->radius.resize(point_count);
+    in->bearing.resize(point_count);
+    in->north.resize(point_count);
+    in->east.resize(point_count);
+    in->latitude.resize(point_count);
+    in->longitude.resize(point_count);
+    in->points.resize(point_count);
+
+    Lcg lcg = {42};
+    for (std::size_t i = 0; i < point_count; ++i) {
+        in->radius[i] = lcg.next() * 5000.0;
+        in->bearing[i] = lcg.next() * 360.0;
+        in->north[i] = (lcg.next() - 0.5) * 10000.0;
+        in->east[i] = (lcg.next() - 0.5) * 10000.0;
+    }
+
+    suite.add("geodesy/computeHorizontalLocation", point_count, [in](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i) {
+            in->points[i] = computeHorizontalLocation(in->origin, in->radius[i], in->bearing[i]);
+        }
+        do_not_optimize(in->points[ops - 1]);
+    });
+
+    suite.add("geodesy/destination_points", point_count, [in](std::size_t ops) {
+        geodesy::destination_points(in->origin.latitude_deg, in->origin.longitude_deg, in->radius.data(),
+                                    in->bearing.data(), ops, in->latitude.data(), in->longitude.data());
+        do_not_optimize(in->latitude[ops - 1]);
+    });
+
+    suite.add("geodesy/calculate_setpoint", point_count, [in](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i) {
+            in->points[i] = calculate_setpoint(in->north[i], in->east[i], 10.0, in->origin);
+        }
+        do_not_optimize(in->points[ops - 1]);
+    });
+
+    suite.add("geodesy/offset_north_east", point_count, [in](std::size_t ops) {
+        geodesy::offset_north_east(in->origin.latitude_deg, in->origin.longitude_deg, in->north.data(),
+                                   in->east.data(), ops, in->latitude.data(), in->longitude.data());
+        do_not_optimize(in->latitude[ops - 1]);
+    });
+}
@@ -0,0 +1,200 @@
+//
+// Checking a survey mission of about 10000 items against a fence and a
+// growing number of zones, one operation is one leg of the mission. With
+// the grid the time per leg should hardly grow with the number of zones.
+// The naive benchmarks test every leg against every edge and every
+// waypoint against every polygon, as a plain loop would. The build
+// benchmarks time building the grid, one operation is one edge.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "geodesy.h"
+#include "geofence.h"
+#include "mission_builder.h"
+#include "survey_planner.h"
+
+namespace {
+
+const double origin_lat_deg = 47.397742;
+const double origin_lon_deg = 8.545594;
+
+// Octagons spread over a square of this size around the survey area.
+const double zone_area_m = 3000.0;
+const double zone_radius_m = 15.0;
+const std::size_t zone_vertices = 8;
+
+struct GeofenceInputs {
+    MissionBuilder mission;
+    std::vector<FencePolygon> polygons;
+    Geofence fence;
+};
+
+FenceVertex vertex_at(double north_m, double east_m)
+{
+    FenceVertex vertex;
+    geodesy::offset_north_east(origin_lat_deg, origin_lon_deg, north_m, east_m, vertex.latitude_deg,
+                               vertex.longitude_deg);
+    return vertex;
+}
+
+// A fence around all zones and zones on a regular grid. Most are obstacles below the survey
+// altitude, every tenth is a no-fly zone.
+std::vector<FencePolygon> fence_and_zones(std::size_t zone_count)
+{
+    std::vector<FencePolygon> polygons;
+    const double low_m = -0.5 * (zone_area_m - 1500.0);
+    const double high_m = low_m + zone_area_m;
+
+    FencePolygon fence;
+    fence.kind = FenceKind::INCLUSION;
+    fence.altitude_m = 120.0f;
+    fence.vertices.push_back(vertex_at(low_m - 10.0, low_m - 10.0));
+    fence.vertices.push_back(vertex_at(high_m + 10.0, low_m - 10.0));
+    fence.vertices.push_back(vertex_at(high_m + 10.0, high_m + 10.0));
+    fence.vertices.push_back(vertex_at(low_m - 10.0, high_m + 10.0));
+    polygons.push_back(fence);
+
+    const std::size_t per_side = static_cast<std::size_t>(std::ceil(std::sqrt(double(zone_count))));
+    const double spacing_m = zone_area_m / per_side;
+    for (std::size_t i = 0; i < zone_count; ++i) {
+        const double center_north_m = low_m + (i / per_side + 0.5) * spacing_m;
+        const double center_east_m = low_m + (i % per_side + 0.5) * spacing_m;
+        FencePolygon zone;
+        zone.kind = FenceKind::EXCLUSION;
+        zone.altitude_m = i % 10 == 0 ? INFINITY : 20.0f;
+        for (std::size_t j = 0; j < zone_vertices; ++j) {
+            const double angle = 2.0 * M_PI * j / zone_vertices;
+            zone.vertices.push_back(vertex_at(center_north_m + zone_radius_m * std::cos(angle),
+                                              center_east_m + zone_radius_m * std::sin(angle)));
+        }
+        polygons.push_back(zone);
+    }
+    return polygons;
+}
+
+std::shared_ptr<GeofenceInputs> make_inputs(std::size_t zone_count)
+{
+    auto in = std::make_shared<GeofenceInputs>();
+    std::vector<SurveyPoint> area;
+    area.push_back({0.0, 0.0});
+    area.push_back({1500.0, 0.0});
+    area.push_back({1500.0, 1500.0});
+    area.push_back({0.0, 1500.0});
+    SurveySettings settings;
+    settings.waypoint_spacing_m = survey_geometry(settings).photo_spacing_m;
+    plan_survey(origin_lat_deg, origin_lon_deg, area, settings, in->mission);
+
+    in->polygons = fence_and_zones(zone_count);
+    in->fence.build(in->polygons);
+    return in;
+}
+
+struct Point {
+    double north_m;
+    double east_m;
+};
+
+double orientation(const Point &a, const Point &b, const Point &c)
+{
+    return (b.north_m - a.north_m) * (c.east_m - a.east_m) - (b.east_m - a.east_m) * (c.north_m - a.north_m);
+}
+
+bool crosses(const Point &a, const Point &b, const Point &c, const Point &d)
+{
+    return (orientation(a, b, c) > 0.0) != (orientation(a, b, d) > 0.0) &&
+           (orientation(c, d, a) > 0.0) != (orientation(c, d, b) > 0.0);
+}
+
+bool inside(const std::vector<Point> &polygon, const Point &point)
+{
+    bool result = false;
+    for (std::size_t i = 0; i < polygon.size(); ++i) {
+        const Point &a = polygon[i];
+        const Point &b = polygon[(i + 1) % polygon.size()];
+        if ((a.north_m > point.north_m) != (b.north_m > point.north_m) &&
+            point.east_m < a.east_m + (point.north_m - a.north_m) * (b.east_m - a.east_m) / (b.north_m - a.north_m)) {
+            result = !result;
+        }
+    }
+    return result;
+}
+
+Point local_point(double latitude_deg, double longitude_deg)
+{
+    Point point;
+    geodesy::north_east_between(origin_lat_deg, origin_lon_deg, latitude_deg, longitude_deg, point.north_m,
+                                point.east_m);
+    return point;
+}
+
+// Legs times edges, the count of legs meeting a polygon they may not.
+std::size_t naive_check(const GeofenceInputs &in)
+{
+    std::vector<std::vector<Point>> polygons;
+    for (const auto &polygon : in.polygons) {
+        std::vector<Point> points;
+        for (const auto &vertex : polygon.vertices) {
+            points.push_back(local_point(vertex.latitude_deg, vertex.longitude_deg));
+        }
+        polygons.push_back(points);
+    }
+
+    std::size_t violations = 0;
+    Point from = {0.0, 0.0};
+    float from_altitude_m = 0.0f;
+    for (const auto &item : in.mission.items()) {
+        const Point to = local_point(item.latitude_deg, item.longitude_deg);
+        const float lowest_m = std::min(from_altitude_m, item.relative_altitude_m);
+        for (std::size_t p = 0; p < polygons.size(); ++p) {
+            const std::vector<Point> &polygon = polygons[p];
+            const bool is_fence = in.polygons[p].kind == FenceKind::INCLUSION;
+            if (!is_fence && lowest_m >= in.polygons[p].altitude_m) {
+                continue;
+            }
+            bool met = inside(polygon, from) != is_fence;
+            for (std::size_t i = 0; i < polygon.size() && !met; ++i) {
+                met = crosses(from, to, polygon[i], polygon[(i + 1) % polygon.size()]);
+            }
+            violations += met ? 1 : 0;
+        }
+        from = to;
+        from_altitude_m = item.relative_altitude_m;
+    }
+    return violations;
+}
+
+} // namespace
+
+void register_geofence_benchmarks(BenchmarkSuite &suite)
+{
+    const std::size_t zone_counts[] = {10, 100, 1000};
+    for (const std::size_t zone_count : zone_counts) {
+        auto in = make_inputs(zone_count);
+        const std::string zones = "/zones_" + std::to_string(zone_count);
+
+        suite.add("geofence/check_mission" + zones, in->mission.size(), [in](std::size_t) {
+            const std::vector<FenceViolation> violations =
+                in->fence.check_mission(origin_lat_deg, origin_lon_deg, 0.0f, in->mission);
+            do_not_optimize(violations);
+        });
+
+        if (zone_count <= 100) {
+            suite.add("geofence/naive" + zones, in->mission.size(), [in](std::size_t) {
+                const std::size_t violations = naive_check(*in);
+                do_not_optimize(violations);
+            });
+        }
+
+        suite.add("geofence/build" + zones, in->fence.edge_count(), [in](std::size_t) {
+            Geofence fence;
+            fence.build(in->polygons);
+            do_not_optimize(fence);
+        });
+    }
+}
@@ -0,0 +1,136 @@
+//
+// Building the items of a large survey-like mission, one operation is one
+// mission item: single items, assembling the vector the SDK uploads the way
+// mission.cpp used to, and the contiguous MissionBuilder. The mission file
+// benchmarks load the same mission from a mission file, including mapping
+// the file and checking it.
+//
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench_harness.h"
+#include "geodesy.h"
+#include "mission_builder.h"
+#include "mission_file.h"
+
+using namespace mavsdk;
+
+namespace {
+
+const std::size_t item_count = 10000;
+
+struct MissionInputs {
+    std::vector<double> latitude, longitude;
+};
+
+// Mission file which is removed with the last benchmark using it.
+struct TemporaryMissionFile {
+    std::string path;
+    ~TemporaryMissionFile() { unlink(path.c_str()); }
+};
+
+} // namespace
+
+void register_mission_benchmarks(BenchmarkSuite &suite)
+{
+    auto in = std::make_shared<MissionInputs>();
+    std::vector<double> north(item_count), east(item_count);
+    for (std::size_t i = 0; i < item_count; ++i) {
+        north[i] = (i / 100) * 10.0;
+        east[i] = (i % 100) * 10.0;
+    }
+    in->latitude.resize(item_count);
+    in->longitude.resize(item_count);
+    geodesy::offset_north_east(47.397742, 8.545594, north.data(), east.data(), item_count,
+                               in->latitude.data(), in->longitude.data());
+
+    suite.add("mission/make_mission_item", item_count, [in](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i) {
+            const auto item = make_mission_item(in->latitude[i], in->longitude[i], 10.0f, 2.0f, true, -60.f, -90.f, 0.0f, MissionItem::CameraAction::START_PHOTO_INTERVAL);
+            do_not_optimize(item);
+        }
+    });
+
+    suite.add("mission/make_mission_item_record", item_count, [in](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i) {
+            const auto record = make_mission_item_record(in->latitude[i], in->longitude[i], 10.0f, 2.0f, true, -60.f, -90.f, 0.0f, MissionItem::CameraAction::START_PHOTO_INTERVAL);
+            do_not_optimize(record);
+        }
+    }, sizeof(MissionItemRecord));
+
+    suite.add("mission/vector_push_back", item_count, [in](std::size_t ops) {
+        std::vector<std::shared_ptr<MissionItem>> mission_items;
+        for (std::size_t i = 0; i < ops; ++i) {
+            mission_items.push_back(make_mission_item(in->latitude[i], in->longitude[i], 10.0f, 2.0f, true, -60.f, -90.f, 0.0f, MissionItem::CameraAction::START_PHOTO_INTERVAL));
+        }
+        do_not_optimize(mission_items);
+    });
+
+    suite.add("mission/builder_add_item", item_count, [in](std::size_t ops) {
+        MissionBuilder builder;
+        builder.reserve(ops);
+        for (std::size_t i = 0; i < ops; ++i) {
+            builder.add_item(in->latitude[i], in->longitude[i], 10.0f, 2.0f, true, -60.f, -90.f, 0.0f, MissionItem::CameraAction::START_PHOTO_INTERVAL);
+        }
+        do_not_optimize(builder);
+    }, sizeof(MissionItemRecord));
+
+    suite.add("mission/builder_add_positions", item_count, [in](std::size_t ops) {
+        MissionBuilder builder;
+        builder.add_positions(in->latitude.data(), in->longitude.data(), ops,
+                              make_mission_item_record(0.0, 0.0, 10.0f, 2.0f, true, -60.f, -90.f, 0.0f, MissionItem::CameraAction::START_PHOTO_INTERVAL));
+        do_not_optimize(builder);
+    }, sizeof(MissionItemRecord));
+
+    suite.add("mission/builder_build", item_count, [in](std::size_t ops) {
+        MissionBuilder builder;
+        builder.reserve(ops);
+        for (std::size_t i = 0; i < ops; ++i) {
+            builder.add_item(in->latitude[i], in->longitude[i], 10.0f, 2.0f, true, -60.f, -90.f, 0.0f, MissionItem::CameraAction::START_PHOTO_INTERVAL);
+        }
+        const auto mission_items = builder.build();
+        do_not_optimize(mission_items);
+    });
+
+    MissionBuilder survey;
+    survey.add_positions(in->latitude.data(), in->longitude.data(), item_count,
+                         make_mission_item_record(0.0, 0.0, 10.0f, 2.0f, true, -60.f, -90.f, 0.0f, MissionItem::CameraAction::START_PHOTO_INTERVAL));
+    char path[] = "/tmp/maneuvers_bench_mission_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+    auto file = std::make_shared<TemporaryMissionFile>();
+    file->path = path;
+    if (!write_mission_file(file->path, survey.items())) {
+        return;
+    }
+
+    // One operation is one record, each run loads the whole file.
+    suite.add("mission/file_open", item_count, [file](std::size_t) {
+        MissionFileReader reader;
+        reader.open(file->path);
+        do_not_optimize(reader.record_count());
+    }, sizeof(MissionFileRecord));
+
+    suite.add("mission/file_load_builder", item_count, [file](std::size_t) {
+        MissionFileReader reader;
+        reader.open(file->path);
+        MissionBuilder builder;
+        reader.append_to(builder);
+        do_not_optimize(builder);
+    }, sizeof(MissionFileRecord));
+
+    suite.add("mission/file_load_items", item_count, [file](std::size_t) {
+        MissionFileReader reader;
+        reader.open(file->path);
+        const auto mission_items = reader.mission_items();
+        do_not_optimize(mission_items);
+    }, sizeof(MissionFileRecord));
+}
@@ -0,0 +1,79 @@
+//
+// Planning survey missions over a concave area of about 1.5 x 1.5 km,
+// which gives more than 10000 waypoints with a waypoint per photo. One
+// operation is one planned mission item, each run plans the whole survey.
+//
+
+#include <memory>
+#include <vector>
+
+#include "bench_harness.h"
+#include "mission_builder.h"
+#include "survey_planner.h"
+
+namespace {
+
+const double origin_lat_deg = 47.397742;
+const double origin_lon_deg = 8.545594;
+
+// Max items per segment, as PX4.
+const std::size_t segment_items = 2000;
+
+struct SurveyInputs {
+    std::vector<SurveyPoint> area;
+    SurveySettings settings;
+};
+
+// An L shape, so lines cross it in one or two parts.
+std::vector<SurveyPoint> survey_area()
+{
+    std::vector<SurveyPoint> area;
+    area.push_back({0.0, 0.0});
+    area.push_back({1500.0, 0.0});
+    area.push_back({1500.0, 700.0});
+    area.push_back({700.0, 800.0});
+    area.push_back({600.0, 1500.0});
+    area.push_back({0.0, 1500.0});
+    return area;
+}
+
+std::size_t planned_items(const SurveyInputs &in, SurveyPattern pattern)
+{
+    SurveySettings settings = in.settings;
+    settings.pattern = pattern;
+    MissionBuilder mission;
+    plan_survey(origin_lat_deg, origin_lon_deg, in.area, settings, mission);
+    return mission.size();
+}
+
+} // namespace
+
+void register_survey_benchmarks(BenchmarkSuite &suite)
+{
+    auto in = std::make_shared<SurveyInputs>();
+    in->area = survey_area();
+    in->settings.waypoint_spacing_m = survey_geometry(in->settings).photo_spacing_m;
+
+    const std::size_t lawnmower_items = planned_items(*in, SurveyPattern::LAWNMOWER);
+    suite.add("survey/lawnmower", lawnmower_items, [in](std::size_t) {
+        MissionBuilder mission;
+        plan_survey(origin_lat_deg, origin_lon_deg, in->area, in->settings, mission);
+        do_not_optimize(mission);
+    }, sizeof(MissionItemRecord));
+
+    const std::size_t spiral_items = planned_items(*in, SurveyPattern::SPIRAL);
+    suite.add("survey/spiral", spiral_items, [in](std::size_t) {
+        SurveySettings settings = in->settings;
+        settings.pattern = SurveyPattern::SPIRAL;
+        MissionBuilder mission;
+        plan_survey(origin_lat_deg, origin_lon_deg, in->area, settings, mission);
+        do_not_optimize(mission);
+    }, sizeof(MissionItemRecord));
+
+    auto survey = std::make_shared<MissionBuilder>();
+    plan_survey(origin_lat_deg, origin_lon_deg, in->area, in->settings, *survey);
+    suite.add("survey/split_mission", survey->size(), [survey](std::size_t) {
+        const std::vector<MissionBuilder> segments = split_mission(*survey, segment_items);
+        do_not_optimize(segments);
+    }, sizeof(MissionItemRecord));
+}
@@ -0,0 +1,122 @@
+//
+// Per-sample cost of handling telemetry: waking waiters, feeding the
+// arrival detector and passing flight records through the recorder's ring
+// buffer. One operation is one sample. The monitor benchmarks publish into
+// and read from the snapshot of a TelemetryMonitor, the contended read
+// while another thread keeps publishing positions.
+//
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "arrival_detector.h"
+#include "bench_harness.h"
+#include "condition_waiter.h"
+#include "flight_recorder.h"
+#include "geodesy.h"
+#include "spsc_ring_buffer.h"
+#include "telemetry_monitor.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+namespace {
+
+const std::size_t sample_count = 100000;
+
+struct TelemetryInputs {
+    std::vector<Telemetry::Position> positions;
+    std::vector<float> speeds;
+};
+
+} // namespace
+
+void register_telemetry_benchmarks(BenchmarkSuite &suite)
+{
+    // A vehicle slowing down towards its setpoint.
+    auto in = std::make_shared<TelemetryInputs>();
+    const Telemetry::Position home = {47.397742, 8.545594, 488.0f, 0.0f};
+    Lcg lcg = {7};
+    for (std::size_t i = 0; i < sample_count; ++i) {
+        const double remaining = 20.0 * (sample_count - i) / sample_count;
+        in->positions.push_back(calculate_setpoint(remaining + lcg.next() * 0.2, lcg.next() * 0.2, 10.0, home));
+        in->speeds.push_back(static_cast<float>(remaining * 0.5));
+    }
+    const Telemetry::Position target = calculate_setpoint(0.0, 0.0, 10.0, home);
+
+    auto waiter = std::make_shared<ConditionWaiter>();
+    suite.add("telemetry/condition_waiter_notify", sample_count, [waiter](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i) {
+            waiter->notify();
+        }
+    });
+
+    suite.add("telemetry/arrival_detector_update", sample_count, [in, target](std::size_t ops) {
+        ArrivalDetector detector(target, ArrivalCriteria());
+        auto now = steady_clock::time_point();
+        detector.reset(now);
+        for (std::size_t i = 0; i < ops; ++i) {
+            now += milliseconds(50);
+            detector.update_position(now, in->positions[i]);
+            detector.update_speed(now, in->speeds[i]);
+        }
+        do_not_optimize(detector);
+    });
+
+    auto ring = std::make_shared<SpscRingBuffer<FlightRecord>>(4096);
+    suite.add("telemetry/flight_record_ring", sample_count, [in, ring](std::size_t ops) {
+        FlightRecord record = {};
+        record.type = static_cast<uint16_t>(FlightRecordType::POSITION);
+        for (std::size_t i = 0; i < ops; ++i) {
+            record.time_us = i * 10000;
+            record.sequence = static_cast<uint32_t>(i);
+            record.position.latitude_deg = in->positions[i].latitude_deg;
+            record.position.longitude_deg = in->positions[i].longitude_deg;
+            record.position.absolute_altitude_m = in->positions[i].absolute_altitude_m;
+            record.position.relative_altitude_m = in->positions[i].relative_altitude_m;
+            ring->try_push(record);
+            if ((i & 63) == 63) {
+                // The writer thread drains in batches.
+                FlightRecord out;
+                while (ring->try_pop(out)) {
+                    do_not_optimize(out);
+                }
+            }
+        }
+        FlightRecord out;
+        while (ring->try_pop(out)) {
+        }
+    }, sizeof(FlightRecord));
+
+    auto monitor = std::make_shared<TelemetryMonitor>(real_clock());
+    suite.add("telemetry/monitor_publish_position", sample_count, [in, monitor](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i) {
+            monitor->publish_position(in->positions[i]);
+        }
+    });
+
+    suite.add("telemetry/monitor_snapshot", sample_count, [monitor](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i) {
+            const TelemetrySnapshot snapshot = monitor->snapshot();
+            do_not_optimize(snapshot);
+        }
+    }, sizeof(TelemetrySnapshot));
+
+    suite.add("telemetry/monitor_snapshot_contended", sample_count, [in, monitor](std::size_t ops) {
+        std::atomic<bool> reading(true);
+        std::thread writer([in, monitor, &reading]() {
+            for (std::size_t i = 0; reading.load(std::memory_order_relaxed); i = (i + 1) % sample_count) {
+                monitor->publish_position(in->positions[i]);
+            }
+        });
+        for (std::size_t i = 0; i < ops; ++i) {
+            const TelemetrySnapshot snapshot = monitor->snapshot();
+            do_not_optimize(snapshot);
+        }
+        reading = false;
+        writer.join();
+    }, sizeof(TelemetrySnapshot));
+}
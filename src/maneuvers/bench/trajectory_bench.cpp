@@ -0,0 +1,29 @@
+//
+// Precomputing an offboard trajectory, a circle of ten laps streamed at
+// 100 Hz. One operation is one setpoint.
+//
+
+#include "bench_harness.h"
+#include "trajectory.h"
+
+namespace {
+
+const double rate_hz = 100.0;
+
+} // namespace
+
+void register_trajectory_benchmarks(BenchmarkSuite &suite)
+{
+    TrajectorySample start = {};
+    start.down_m = -10.0f;
+    CircleSettings settings;
+    settings.radius_m = 20.0f;
+    settings.speed_m_s = 5.0f;
+    settings.laps = 10.0f;
+
+    const std::size_t samples = circle_trajectory(start, settings, rate_hz).samples.size();
+    suite.add("trajectory/circle", samples, [start, settings](std::size_t) {
+        const Trajectory trajectory = circle_trajectory(start, settings, rate_hz);
+        do_not_optimize(trajectory);
+    }, sizeof(TrajectorySample));
+}
@@ -0,0 +1,101 @@
+#include "arrival_detector.h"
+
+#include <cmath>
+
+#include "geodesy.h"
+
+using namespace mavsdk;
+
+ArrivalDetector::ArrivalDetector(const Telemetry::Position &target,
+                                 const ArrivalCriteria &criteria) :
+    _target(target),
+    _criteria(criteria)
+{
+    reset(std::chrono::steady_clock::now());
+}
+
+void ArrivalDetector::reset(time_point start)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _start = start;
+    _inside_since = start;
+    _settled_at = start;
+    _inside = false;
+    _arrived = false;
+    _has_position = false;
+    _has_speed = false;
+    _horizontal_distance_m = NAN;
+    _vertical_distance_m = NAN;
+    _speed_m_s = NAN;
+}
+
+void ArrivalDetector::update_position(time_point now, const Telemetry::Position &position)
+{
+    double north_m, east_m;
+    geodesy::north_east_between(_target.latitude_deg, _target.longitude_deg,
+                                position.latitude_deg, position.longitude_deg, north_m, east_m);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _horizontal_distance_m = static_cast<float>(std::sqrt(north_m * north_m + east_m * east_m));
+    _vertical_distance_m = std::fabs(position.absolute_altitude_m - _target.absolute_altitude_m);
+    _has_position = true;
+    evaluate(now);
+}
+
+void ArrivalDetector::update_speed(time_point now, float speed_m_s)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _speed_m_s = speed_m_s;
+    _has_speed = true;
+    evaluate(now);
+}
+
+void ArrivalDetector::evaluate(time_point now)
+{
+    if (_arrived || !_has_position || !_has_speed) {
+        return;
+    }
+
+    const bool inside = _horizontal_distance_m <= _criteria.acceptance_radius_m &&
+                        _vertical_distance_m <= _criteria.acceptance_altitude_m &&
+                        _speed_m_s <= _criteria.max_speed_m_s;
+
+    if (!inside) {
+        _inside = false;
+        return;
+    }
+
+    if (!_inside) {
+        _inside = true;
+        _inside_since = now;
+    }
+
+    if (now - _inside_since >= _criteria.settle_time) {
+        _arrived = true;
+        _settled_at = now;
+    }
+}
+
+bool ArrivalDetector::arrived() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _arrived;
+}
+
+std::chrono::steady_clock::duration ArrivalDetector::time_to_arrive() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inside_since - _start;
+}
+
+std::chrono::steady_clock::duration ArrivalDetector::time_to_settle() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _settled_at - _start;
+}
+
+float ArrivalDetector::last_distance_m() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _horizontal_distance_m;
+}
@@ -0,0 +1,68 @@
+//
+// Decides when the vehicle has arrived at a setpoint.
+//
+// The vehicle counts as arrived once it has been within the acceptance
+// radius and below the speed limit for the whole settle window. Fed from
+// the position and ground speed listeners of the TelemetryMonitor.
+//
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+#include <plugins/telemetry/telemetry.h>
+
+struct ArrivalCriteria {
+    float acceptance_radius_m;
+    float acceptance_altitude_m;
+    float max_speed_m_s;
+    std::chrono::milliseconds settle_time;
+
+    ArrivalCriteria() :
+        acceptance_radius_m(0.5f),
+        acceptance_altitude_m(0.5f),
+        max_speed_m_s(0.3f),
+        settle_time(1000)
+    {}
+};
+
+class ArrivalDetector {
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    ArrivalDetector(const mavsdk::Telemetry::Position &target, const ArrivalCriteria &criteria);
+
+    // Restart the detection, e.g. right after the setpoint has been commanded.
+    void reset(time_point start);
+
+    void update_position(time_point now, const mavsdk::Telemetry::Position &position);
+    void update_speed(time_point now, float speed_m_s);
+
+    bool arrived() const;
+
+    // Time from reset() until the vehicle entered the acceptance region for good, and until the
+    // settle window was over. Only valid once arrived() returns true.
+    std::chrono::steady_clock::duration time_to_arrive() const;
+    std::chrono::steady_clock::duration time_to_settle() const;
+
+    float last_distance_m() const;
+
+private:
+    void evaluate(time_point now);
+
+    const mavsdk::Telemetry::Position _target;
+    const ArrivalCriteria _criteria;
+
+    mutable std::mutex _mutex;
+    time_point _start;
+    time_point _inside_since;
+    time_point _settled_at;
+    bool _inside;
+    bool _arrived;
+    bool _has_position;
+    bool _has_speed;
+    float _horizontal_distance_m;
+    float _vertical_distance_m;
+    float _speed_m_s;
+};
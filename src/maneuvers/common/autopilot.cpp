@@ -0,0 +1,302 @@
+#include "autopilot.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "log_sink.h"
+
+using namespace mavsdk;
+
+namespace {
+
+// PARAM_VALUE carries every value in a float, integers bytewise as PX4 sends them.
+ParamValue decode_param_value(const mavlink_param_value_t &param_value)
+{
+    if (param_value.param_type == MAV_PARAM_TYPE_REAL32) {
+        return ParamValue::from_float(param_value.param_value);
+    }
+    int32_t value;
+    std::memcpy(&value, &param_value.param_value, sizeof(value));
+    return ParamValue::from_int(value);
+}
+
+} // namespace
+
+MavsdkAutopilot::MavsdkAutopilot(System &system) :
+    _mission_count(-1),
+    _action(std::make_shared<Action>(system)),
+    _mission(std::make_shared<Mission>(system)),
+    _offboard(std::make_shared<Offboard>(system)),
+    _param(std::make_shared<Param>(system)),
+    _telemetry(std::make_shared<Telemetry>(system)),
+    _passthrough(std::make_shared<MavlinkPassthrough>(system)),
+    _monitor(*_telemetry)
+{
+    _passthrough->subscribe_message_async(MAVLINK_MSG_ID_MISSION_COUNT, [this](const mavlink_message_t &message) {
+        if (message.sysid != _passthrough->get_target_sysid()) {
+            return;
+        }
+        mavlink_mission_count_t mission_count;
+        mavlink_msg_mission_count_decode(&message, &mission_count);
+        if (mission_count.mission_type != MAV_MISSION_TYPE_MISSION) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mission_count_mutex);
+            _mission_count = mission_count.count;
+        }
+        _mission_count_waiter.notify();
+    });
+
+    // Only the parameters of a batch being fetched are kept, the Param plugin handles the rest.
+    _passthrough->subscribe_message_async(MAVLINK_MSG_ID_PARAM_VALUE, [this](const mavlink_message_t &message) {
+        if (message.sysid != _passthrough->get_target_sysid()) {
+            return;
+        }
+        mavlink_param_value_t param_value;
+        mavlink_msg_param_value_decode(&message, &param_value);
+        const std::string name(param_value.param_id, strnlen(param_value.param_id, sizeof(param_value.param_id)));
+        {
+            std::lock_guard<std::mutex> lock(_params_mutex);
+            if (_params_wanted.count(name) == 0) {
+                return;
+            }
+            _params_received[name] = decode_param_value(param_value);
+        }
+        _params_waiter.notify();
+    });
+}
+
+void MavsdkAutopilot::subscribe_mission_progress(Mission::progress_callback_t callback)
+{
+    _mission->subscribe_progress(callback);
+}
+
+bool MavsdkAutopilot::mission_finished()
+{
+    return _mission->mission_finished();
+}
+
+void MavsdkAutopilot::arm_async(Action::result_callback_t callback)
+{
+    _action->arm_async(callback);
+}
+
+void MavsdkAutopilot::disarm_async(Action::result_callback_t callback)
+{
+    _action->disarm_async(callback);
+}
+
+void MavsdkAutopilot::takeoff_async(Action::result_callback_t callback)
+{
+    _action->takeoff_async(callback);
+}
+
+void MavsdkAutopilot::get_takeoff_altitude_async(takeoff_altitude_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(_action->get_takeoff_altitude()); });
+}
+
+void MavsdkAutopilot::goto_location_async(double latitude_deg,
+                                          double longitude_deg,
+                                          float altitude_amsl_m,
+                                          float yaw_deg,
+                                          Action::result_callback_t callback)
+{
+    _commands.post([this, latitude_deg, longitude_deg, altitude_amsl_m, yaw_deg, callback]() {
+        callback(_action->goto_location(latitude_deg, longitude_deg, altitude_amsl_m, yaw_deg));
+    });
+}
+
+void MavsdkAutopilot::return_to_launch_async(Action::result_callback_t callback)
+{
+    _action->return_to_launch_async(callback);
+}
+
+void MavsdkAutopilot::upload_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
+                                           Mission::result_callback_t callback)
+{
+    _mission->upload_mission_async(mission_items, callback);
+}
+
+void MavsdkAutopilot::start_mission_async(Mission::result_callback_t callback)
+{
+    _mission->start_mission_async(callback);
+}
+
+void MavsdkAutopilot::download_mission_async(Mission::mission_items_and_result_callback_t callback)
+{
+    _mission->download_mission_async(callback);
+}
+
+void MavsdkAutopilot::mission_count_async(mission_count_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(mission_count()); });
+}
+
+std::pair<Mission::Result, int> MavsdkAutopilot::mission_count()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mission_count_mutex);
+        _mission_count = -1;
+    }
+
+    // Start a mission download, which the vehicle answers with the number of items.
+    for (unsigned attempt = 0; attempt < 3; ++attempt) {
+        mavlink_message_t message;
+        mavlink_msg_mission_request_list_pack(_passthrough->get_our_sysid(),
+                                              _passthrough->get_our_compid(),
+                                              &message,
+                                              _passthrough->get_target_sysid(),
+                                              _passthrough->get_target_compid(),
+                                              MAV_MISSION_TYPE_MISSION);
+        _passthrough->send_message(message);
+
+        int count = -1;
+        const WaitResult received = _mission_count_waiter.wait_until(
+            [this, &count]() {
+                std::lock_guard<std::mutex> lock(_mission_count_mutex);
+                count = _mission_count;
+                return count >= 0;
+            },
+            std::chrono::milliseconds(500));
+        if (!received.satisfied) {
+            continue;
+        }
+
+        // The items are not needed, end the download right away.
+        mavlink_msg_mission_ack_pack(_passthrough->get_our_sysid(),
+                                     _passthrough->get_our_compid(),
+                                     &message,
+                                     _passthrough->get_target_sysid(),
+                                     _passthrough->get_target_compid(),
+                                     MAV_MISSION_ACCEPTED,
+                                     MAV_MISSION_TYPE_MISSION);
+        _passthrough->send_message(message);
+        return std::make_pair(Mission::Result::SUCCESS, count);
+    }
+    return std::make_pair(Mission::Result::TIMEOUT, 0);
+}
+
+void MavsdkAutopilot::set_offboard_position_ned(const Offboard::PositionNEDYaw &setpoint)
+{
+    _offboard->set_position_ned(setpoint);
+}
+
+void MavsdkAutopilot::set_offboard_velocity_ned(const Offboard::VelocityNEDYaw &setpoint)
+{
+    _offboard->set_velocity_ned(setpoint);
+}
+
+void MavsdkAutopilot::start_offboard_async(Offboard::result_callback_t callback)
+{
+    _offboard->start_async(callback);
+}
+
+void MavsdkAutopilot::stop_offboard_async(Offboard::result_callback_t callback)
+{
+    _offboard->stop_async(callback);
+}
+
+void MavsdkAutopilot::get_params_async(const std::vector<std::string> &names, get_params_callback_t callback)
+{
+    _commands.post([this, names, callback]() { callback(get_params(names)); });
+}
+
+void MavsdkAutopilot::set_param_async(const std::string &name, const ParamValue &value, param_result_callback_t callback)
+{
+    _commands.post([this, name, value, callback]() {
+        if (value.type == ParamValue::Type::INT32) {
+            callback(_param->set_param_int(name, value.int_value));
+        } else {
+            callback(_param->set_param_float(name, value.float_value));
+        }
+    });
+}
+
+std::pair<Param::Result, ParamTable> MavsdkAutopilot::get_params(const std::vector<std::string> &names)
+{
+    const size_t max_name_length = sizeof(mavlink_param_value_t::param_id);
+    for (const auto &name : names) {
+        if (name.size() > max_name_length) {
+            return std::make_pair(Param::Result::PARAM_NAME_TOO_LONG, ParamTable());
+        }
+    }
+
+    size_t wanted = 0;
+    {
+        std::lock_guard<std::mutex> lock(_params_mutex);
+        _params_wanted = std::set<std::string>(names.begin(), names.end());
+        _params_received.clear();
+        wanted = _params_wanted.size();
+    }
+
+    // Request everything still missing back to back, the vehicle answers in a row.
+    for (unsigned attempt = 0; attempt < 3; ++attempt) {
+        std::vector<std::string> missing;
+        {
+            std::lock_guard<std::mutex> lock(_params_mutex);
+            for (const auto &name : _params_wanted) {
+                if (_params_received.count(name) == 0) {
+                    missing.push_back(name);
+                }
+            }
+        }
+        if (missing.empty()) {
+            break;
+        }
+
+        for (const auto &name : missing) {
+            mavlink_message_t message;
+            mavlink_msg_param_request_read_pack(_passthrough->get_our_sysid(),
+                                                _passthrough->get_our_compid(),
+                                                &message,
+                                                _passthrough->get_target_sysid(),
+                                                _passthrough->get_target_compid(),
+                                                name.c_str(),
+                                                -1);
+            _passthrough->send_message(message);
+        }
+
+        _params_waiter.wait_until(
+            [this, wanted]() {
+                std::lock_guard<std::mutex> lock(_params_mutex);
+                return _params_received.size() == wanted;
+            },
+            std::chrono::milliseconds(500));
+    }
+
+    ParamTable received;
+    {
+        std::lock_guard<std::mutex> lock(_params_mutex);
+        received.swap(_params_received);
+        _params_wanted.clear();
+    }
+    const Param::Result result = received.size() == wanted ? Param::Result::SUCCESS : Param::Result::TIMEOUT;
+    return std::make_pair(result, received);
+}
+
+bool connect_system(Mavsdk &dc, const std::string &connection_url, std::chrono::milliseconds timeout)
+{
+    // Shared with the callback, which stays registered after this returns.
+    auto discovered = std::make_shared<std::atomic<bool>>(false);
+    auto discovery = std::make_shared<ConditionWaiter>();
+    dc.register_on_discover([discovered, discovery](uint64_t uuid) {
+        log_info() << "Discovered system with UUID: " << uuid;
+        *discovered = true;
+        discovery->notify();
+    });
+
+    const ConnectionResult connection_result = dc.add_any_connection(connection_url);
+    if (connection_result != ConnectionResult::SUCCESS) {
+        log_error() << "Connection failed: " << connection_result_str(connection_result);
+        return false;
+    }
+
+    log_info() << "Waiting to discover system...";
+    if (!discovery->wait_until([discovered]() { return discovered->load(); }, timeout).satisfied) {
+        log_error() << "No system found on " << connection_url;
+        return false;
+    }
+    return true;
+}
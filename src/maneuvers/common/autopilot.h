@@ -0,0 +1,162 @@
+//
+// The commands the maneuvers send to a vehicle.
+//
+// MavsdkAutopilot forwards them to a real vehicle or SITL through MAVSDK,
+// SimAutopilot (sim_autopilot.h) flies an in-process model instead. Both
+// report the vehicle state through a TelemetryMonitor and measure time with
+// the clock of that monitor.
+//
+// The commands return right away and call the callback from an SDK or
+// worker thread with the result, so the maneuver engine (maneuver.h) never
+// blocks while a command is on its way.
+//
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mavsdk.h>
+#include <system.h>
+#include <plugins/action/action.h>
+#include <plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <plugins/mission/mission.h>
+#include <plugins/offboard/offboard.h>
+#include <plugins/param/param.h>
+#include <plugins/telemetry/telemetry.h>
+
+#include "clock.h"
+#include "condition_waiter.h"
+#include "param_cache.h"
+#include "serial_executor.h"
+#include "telemetry_monitor.h"
+
+class Autopilot {
+public:
+    typedef std::function<void(std::pair<mavsdk::Action::Result, float>)>
+        takeoff_altitude_callback_t;
+    typedef std::function<void(std::pair<mavsdk::Mission::Result, int>)> mission_count_callback_t;
+    typedef std::function<void(std::pair<mavsdk::Param::Result, ParamTable>)> get_params_callback_t;
+    typedef std::function<void(mavsdk::Param::Result)> param_result_callback_t;
+
+    virtual ~Autopilot() = default;
+
+    virtual TelemetryMonitor &monitor() = 0;
+    const Clock &clock() { return monitor().clock(); }
+
+    virtual void subscribe_mission_progress(mavsdk::Mission::progress_callback_t callback) = 0;
+    virtual bool mission_finished() = 0;
+
+    virtual void arm_async(mavsdk::Action::result_callback_t callback) = 0;
+    virtual void disarm_async(mavsdk::Action::result_callback_t callback) = 0;
+    virtual void takeoff_async(mavsdk::Action::result_callback_t callback) = 0;
+    virtual void get_takeoff_altitude_async(takeoff_altitude_callback_t callback) = 0;
+    virtual void goto_location_async(double latitude_deg,
+                                     double longitude_deg,
+                                     float altitude_amsl_m,
+                                     float yaw_deg,
+                                     mavsdk::Action::result_callback_t callback) = 0;
+    virtual void return_to_launch_async(mavsdk::Action::result_callback_t callback) = 0;
+    virtual void
+    upload_mission_async(const std::vector<std::shared_ptr<mavsdk::MissionItem>> &mission_items,
+                         mavsdk::Mission::result_callback_t callback) = 0;
+    virtual void start_mission_async(mavsdk::Mission::result_callback_t callback) = 0;
+    virtual void
+    download_mission_async(mavsdk::Mission::mission_items_and_result_callback_t callback) = 0;
+
+    // Number of items of the mission on the vehicle, a single round trip instead of a download.
+    // Counted in the vehicle's own items, which need not match the number of MissionItems.
+    virtual void mission_count_async(mission_count_callback_t callback) = 0;
+
+    // Offboard setpoints in the local frame of the vehicle (origin at home), only queued for
+    // sending, so they can be streamed from a time critical thread. They have to be streamed
+    // before offboard control starts and without gaps while it is active.
+    virtual void set_offboard_position_ned(const mavsdk::Offboard::PositionNEDYaw &setpoint) = 0;
+    virtual void set_offboard_velocity_ned(const mavsdk::Offboard::VelocityNEDYaw &setpoint) = 0;
+    virtual void start_offboard_async(mavsdk::Offboard::result_callback_t callback) = 0;
+    virtual void stop_offboard_async(mavsdk::Offboard::result_callback_t callback) = 0;
+
+    // Fetches several parameters in one go: all requests are sent before the answers are
+    // awaited. The table holds the parameters received, the result is TIMEOUT if one is missing.
+    virtual void get_params_async(const std::vector<std::string> &names, get_params_callback_t callback) = 0;
+
+    // Sets a parameter of the type the vehicle has for it, once the vehicle has confirmed it.
+    virtual void set_param_async(const std::string &name, const ParamValue &value, param_result_callback_t callback) = 0;
+};
+
+class MavsdkAutopilot : public Autopilot {
+public:
+    explicit MavsdkAutopilot(mavsdk::System &system);
+
+    TelemetryMonitor &monitor() override { return _monitor; }
+
+    void subscribe_mission_progress(mavsdk::Mission::progress_callback_t callback) override;
+    bool mission_finished() override;
+
+    void arm_async(mavsdk::Action::result_callback_t callback) override;
+    void disarm_async(mavsdk::Action::result_callback_t callback) override;
+    void takeoff_async(mavsdk::Action::result_callback_t callback) override;
+    void get_takeoff_altitude_async(takeoff_altitude_callback_t callback) override;
+    void goto_location_async(double latitude_deg,
+                             double longitude_deg,
+                             float altitude_amsl_m,
+                             float yaw_deg,
+                             mavsdk::Action::result_callback_t callback) override;
+    void return_to_launch_async(mavsdk::Action::result_callback_t callback) override;
+    void upload_mission_async(const std::vector<std::shared_ptr<mavsdk::MissionItem>> &mission_items,
+                              mavsdk::Mission::result_callback_t callback) override;
+    void start_mission_async(mavsdk::Mission::result_callback_t callback) override;
+    void download_mission_async(mavsdk::Mission::mission_items_and_result_callback_t callback) override;
+    void mission_count_async(mission_count_callback_t callback) override;
+
+    void set_offboard_position_ned(const mavsdk::Offboard::PositionNEDYaw &setpoint) override;
+    void set_offboard_velocity_ned(const mavsdk::Offboard::VelocityNEDYaw &setpoint) override;
+    void start_offboard_async(mavsdk::Offboard::result_callback_t callback) override;
+    void stop_offboard_async(mavsdk::Offboard::result_callback_t callback) override;
+
+    void get_params_async(const std::vector<std::string> &names, get_params_callback_t callback) override;
+    void set_param_async(const std::string &name, const ParamValue &value, param_result_callback_t callback) override;
+
+    mavsdk::Telemetry &telemetry() { return *_telemetry; }
+
+private:
+    MavsdkAutopilot(const MavsdkAutopilot &) = delete;
+    MavsdkAutopilot &operator=(const MavsdkAutopilot &) = delete;
+
+    std::pair<mavsdk::Mission::Result, int> mission_count();
+    std::pair<mavsdk::Param::Result, ParamTable> get_params(const std::vector<std::string> &names);
+
+    // Last MISSION_COUNT received, -1 while waiting for one.
+    std::mutex _mission_count_mutex;
+    int _mission_count;
+    ConditionWaiter _mission_count_waiter;
+
+    // PARAM_VALUEs of the batch being fetched.
+    std::mutex _params_mutex;
+    std::set<std::string> _params_wanted;
+    ParamTable _params_received;
+    ConditionWaiter _params_waiter;
+
+    std::shared_ptr<mavsdk::Action> _action;
+    std::shared_ptr<mavsdk::Mission> _mission;
+    std::shared_ptr<mavsdk::Offboard> _offboard;
+    std::shared_ptr<mavsdk::Param> _param;
+    std::shared_ptr<mavsdk::Telemetry> _telemetry;
+    std::shared_ptr<mavsdk::MavlinkPassthrough> _passthrough;
+    TelemetryMonitor _monitor;
+
+    // The Action plugin has no asynchronous goto_location and get_takeoff_altitude, and the
+    // Param plugin no asynchronous commands at all, they run here. Declared last so it finishes
+    // before the plugins go away.
+    SerialExecutor _commands;
+};
+
+// Adds the connection and returns as soon as a system is discovered on it, false if the
+// connection fails or no system shows up within timeout.
+bool connect_system(mavsdk::Mavsdk &dc, const std::string &connection_url, std::chrono::milliseconds timeout);
@@ -0,0 +1,49 @@
+#include "clock.h"
+
+#include <thread>
+
+using namespace std::chrono;
+
+namespace {
+
+class SteadyClock : public Clock {
+public:
+    time_point now() const override { return steady_clock::now(); }
+    duration to_real(duration d) const override { return d; }
+};
+
+} // namespace
+
+void Clock::sleep_for(duration d) const
+{
+    std::this_thread::sleep_for(to_real(d));
+}
+
+void Clock::sleep_until(time_point t) const
+{
+    const auto remaining = t - now();
+    if (remaining > duration::zero()) {
+        std::this_thread::sleep_until(steady_clock::now() + to_real(remaining));
+    }
+}
+
+const Clock &real_clock()
+{
+    static const SteadyClock clock;
+    return clock;
+}
+
+ScaledClock::ScaledClock(double speedup) :
+    _origin(steady_clock::now()),
+    _speedup(speedup)
+{}
+
+Clock::time_point ScaledClock::now() const
+{
+    return _origin + duration_cast<duration>((steady_clock::now() - _origin) * _speedup);
+}
+
+Clock::duration ScaledClock::to_real(duration d) const
+{
+    return duration_cast<duration>(d / _speedup);
+}
@@ -0,0 +1,52 @@
+//
+// Time source of the maneuvers.
+//
+// Waits, timeouts and timestamps go through a Clock instead of using
+// steady_clock and sleep_for directly, so a simulated vehicle can run the
+// same maneuvers faster than real time.
+//
+
+#pragma once
+
+#include <chrono>
+
+class Clock {
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+    typedef std::chrono::steady_clock::duration duration;
+
+    virtual ~Clock() = default;
+
+    virtual time_point now() const = 0;
+
+    // Real time which passes while this clock advances by d.
+    virtual duration to_real(duration d) const = 0;
+
+    void sleep_for(duration d) const;
+
+    // Sleeps until this clock shows t, without accumulating the error of successive sleep_for.
+    void sleep_until(time_point t) const;
+
+    double seconds_since(time_point start) const
+    {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(now() - start).count();
+    }
+};
+
+// steady_clock itself.
+const Clock &real_clock();
+
+// Runs speedup times faster than real time, starting at the time it was created.
+class ScaledClock : public Clock {
+public:
+    explicit ScaledClock(double speedup);
+
+    time_point now() const override;
+    duration to_real(duration d) const override;
+
+    double speedup() const { return _speedup; }
+
+private:
+    const time_point _origin;
+    const double _speedup;
+};
@@ -0,0 +1,26 @@
+#include "condition_waiter.h"
+
+void ConditionWaiter::notify()
+{
+    // Taking the mutex makes sure a waiter is either before its predicate check or already
+    // blocked in wait, so the notification cannot get lost in between.
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+    }
+    _cv.notify_all();
+}
+
+WaitResult ConditionWaiter::wait_until(const std::function<bool()> &predicate,
+                                       std::chrono::milliseconds timeout)
+{
+    const auto start = _clock.now();
+    const auto deadline = std::chrono::steady_clock::now() + _clock.to_real(timeout);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    const bool satisfied = _cv.wait_until(lock, deadline, predicate);
+
+    WaitResult result;
+    result.satisfied = satisfied;
+    result.elapsed = _clock.now() - start;
+    return result;
+}
@@ -0,0 +1,48 @@
+//
+// Event-driven waiting on a predicate.
+//
+// Instead of polling with sleep_for, waiters block on a condition variable
+// which is kicked by notify() from the SDK subscription callbacks, so a
+// predicate is re-evaluated as soon as the state it reads has changed.
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+#include "clock.h"
+
+struct WaitResult {
+    bool satisfied;
+    std::chrono::steady_clock::duration elapsed;
+
+    double elapsed_s() const
+    {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+    }
+};
+
+class ConditionWaiter {
+public:
+    // Timeouts and the elapsed time of a wait are measured with clock.
+    explicit ConditionWaiter(const Clock &clock = real_clock()) : _clock(clock) {}
+
+    // Call after the state read by any predicate has changed (e.g. from a telemetry callback).
+    void notify();
+
+    // Block until predicate() returns true or the timeout expires. The predicate is evaluated
+    // once immediately and then after every notify().
+    WaitResult wait_until(const std::function<bool()> &predicate,
+                          std::chrono::milliseconds timeout);
+
+private:
+    ConditionWaiter(const ConditionWaiter &) = delete;
+    ConditionWaiter &operator=(const ConditionWaiter &) = delete;
+
+    const Clock &_clock;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+};
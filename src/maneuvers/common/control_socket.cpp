@@ -0,0 +1,198 @@
+#include "control_socket.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "log_sink.h"
+
+namespace {
+
+// Longer requests are cut off, they are a word and a file name or a few numbers.
+const size_t max_request_size = 4096;
+
+// A client which connected has this long to send its request, so it cannot stall the others.
+const int request_timeout_s = 1;
+
+bool socket_address(const std::string &path, sockaddr_un &address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// Up to the first newline, false if the client sent none in time.
+bool read_request(int fd, std::string &request)
+{
+    timeval timeout = {request_timeout_s, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    request.clear();
+    char buffer[256];
+    while (request.size() < max_request_size) {
+        const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return false;
+        }
+        request.append(buffer, received);
+        const size_t newline = request.find('\n');
+        if (newline != std::string::npos) {
+            request.resize(newline);
+            if (!request.empty() && request.back() == '\r') {
+                request.pop_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+ControlConnection::ControlConnection(int fd) :
+    _fd(fd)
+{}
+
+ControlConnection::~ControlConnection()
+{
+    ::close(_fd);
+}
+
+bool ControlConnection::reply(const std::string &line)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const std::string message = line + "\n";
+    size_t sent = 0;
+    while (sent < message.size()) {
+        // No SIGPIPE if the client is gone.
+        const ssize_t result = send(_fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        sent += result;
+    }
+    return true;
+}
+
+ControlSocket::ControlSocket() :
+    _listen_fd(-1),
+    _wake_pipe{-1, -1}
+{}
+
+ControlSocket::~ControlSocket()
+{
+    stop();
+}
+
+bool ControlSocket::start(const std::string &path, request_callback_t callback)
+{
+    sockaddr_un address;
+    if (!socket_address(path, address)) {
+        log_error() << "Invalid control socket path " << path;
+        return false;
+    }
+
+    const int running = connect_control_socket(path);
+    if (running >= 0) {
+        ::close(running);
+        log_error() << "Another daemon is listening on " << path;
+        return false;
+    }
+    unlink(path.c_str());
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_listen_fd < 0 || bind(_listen_fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(_listen_fd, 16) != 0 || pipe2(_wake_pipe, O_CLOEXEC) != 0) {
+        log_error() << "Cannot listen on " << path << ": " << std::strerror(errno);
+        stop();
+        return false;
+    }
+
+    _path = path;
+    _callback = callback;
+    _thread = std::thread(&ControlSocket::run, this);
+    return true;
+}
+
+void ControlSocket::stop()
+{
+    if (_thread.joinable()) {
+        const char wake = 0;
+        if (write(_wake_pipe[1], &wake, 1) != 1) {
+            log_error() << "Cannot stop the control socket";
+        }
+        _thread.join();
+    }
+    for (int fd : {_listen_fd, _wake_pipe[0], _wake_pipe[1]}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    _listen_fd = -1;
+    _wake_pipe[0] = _wake_pipe[1] = -1;
+    if (!_path.empty()) {
+        unlink(_path.c_str());
+        _path.clear();
+    }
+}
+
+void ControlSocket::run()
+{
+    while (true) {
+        pollfd fds[2] = {{_listen_fd, POLLIN, 0}, {_wake_pipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error() << "Control socket failed: " << std::strerror(errno);
+            return;
+        }
+        if (fds[1].revents != 0) {
+            return;
+        }
+        if ((fds[0].revents & POLLIN) == 0) {
+            continue;
+        }
+
+        const int fd = accept4(_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        auto connection = std::make_shared<ControlConnection>(fd);
+        std::string request;
+        if (!read_request(fd, request)) {
+            connection->reply("error no request");
+            continue;
+        }
+        _callback(request, connection);
+    }
+}
+
+int connect_control_socket(const std::string &path)
+{
+    sockaddr_un address;
+    if (!socket_address(path, address)) {
+        return -1;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,69 @@
+//
+// Local control socket through which the maneuver daemon takes requests.
+//
+// A Unix domain socket, so requests can only come from the same machine, from
+// users who may write to the socket file. A listener thread accepts the
+// connections and reads one request line from each, then hands the line
+// and the connection to a callback, which usually posts them into the event
+// loop. The connection stays open for replies until the last reference to
+// it is dropped, so a client can follow its request until it is done.
+//
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+const char *const default_control_socket_path = "/tmp/maneuvers_daemon.sock";
+
+class ControlConnection {
+public:
+    // Takes over the socket, which is closed with the connection.
+    explicit ControlConnection(int fd);
+    ~ControlConnection();
+
+    // Thread safe. Sends the line and a newline, false once the client has gone away.
+    bool reply(const std::string &line);
+
+private:
+    ControlConnection(const ControlConnection &) = delete;
+    ControlConnection &operator=(const ControlConnection &) = delete;
+
+    std::mutex _mutex;
+    int _fd;
+};
+
+class ControlSocket {
+public:
+    // Called on the listener thread.
+    typedef std::function<void(const std::string &request, std::shared_ptr<ControlConnection> connection)>
+        request_callback_t;
+
+    ControlSocket();
+    ~ControlSocket();
+
+    // Fails if the socket cannot be created, or another process listens on path already. A
+    // socket file left behind by a process which is gone is replaced.
+    bool start(const std::string &path, request_callback_t callback);
+
+    // Stops taking requests and removes the socket file.
+    void stop();
+
+private:
+    ControlSocket(const ControlSocket &) = delete;
+    ControlSocket &operator=(const ControlSocket &) = delete;
+
+    void run();
+
+    std::string _path;
+    request_callback_t _callback;
+    int _listen_fd;
+    int _wake_pipe[2]; // written by stop() to end run()
+    std::thread _thread;
+};
+
+// Connects to the control socket at path, -1 if nothing listens there.
+int connect_control_socket(const std::string &path);
@@ -0,0 +1,66 @@
+#include "event_loop.h"
+
+using namespace std::chrono;
+
+EventLoop::EventLoop() :
+    _stopped(false)
+{}
+
+void EventLoop::post(task_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+}
+
+void EventLoop::post_after(steady_clock::duration delay, task_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _timers.insert(std::make_pair(steady_clock::now() + delay, std::move(task)));
+    }
+    _cv.notify_one();
+}
+
+void EventLoop::run()
+{
+    std::deque<task_t> ready;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopped) {
+        const auto now = steady_clock::now();
+        while (!_timers.empty() && _timers.begin()->first <= now) {
+            _tasks.push_back(std::move(_timers.begin()->second));
+            _timers.erase(_timers.begin());
+        }
+
+        if (_tasks.empty()) {
+            if (_timers.empty()) {
+                _cv.wait(lock);
+            } else {
+                _cv.wait_until(lock, _timers.begin()->first);
+            }
+            continue;
+        }
+
+        // Tasks usually post new ones, so they run without the lock.
+        ready.swap(_tasks);
+        lock.unlock();
+        while (!ready.empty()) {
+            ready.front()();
+            ready.pop_front();
+        }
+        lock.lock();
+    }
+    _stopped = false;
+}
+
+void EventLoop::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopped = true;
+    }
+    _cv.notify_one();
+}
@@ -0,0 +1,43 @@
+//
+// Single threaded event loop the maneuvers run on.
+//
+// SDK callbacks and telemetry listeners post their results into the loop,
+// so the state of a maneuver is only touched by the thread running the
+// loop, and one thread drives any number of maneuvers.
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+class EventLoop {
+public:
+    typedef std::function<void()> task_t;
+
+    EventLoop();
+
+    // Can be called from any thread, the tasks run in the order they were posted.
+    void post(task_t task);
+
+    // Runs the task once the delay (real time) has passed.
+    void post_after(std::chrono::steady_clock::duration delay, task_t task);
+
+    // Runs the posted tasks on the calling thread until stop() is called.
+    void run();
+    void stop();
+
+private:
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<task_t> _tasks;
+    std::multimap<std::chrono::steady_clock::time_point, task_t> _timers;
+    bool _stopped;
+};
@@ -0,0 +1,327 @@
+#include "flight_recorder.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_sink.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+namespace {
+
+const char header_magic[8] = {'M', 'N', 'V', 'F', 'L', 'T', '0', '1'};
+const char footer_magic[8] = {'M', 'N', 'V', 'I', 'D', 'X', '0', '1'};
+const uint32_t file_version = 1;
+
+// Records per index entry.
+const uint64_t index_block_records = 1024;
+
+// How long the writer sleeps when all buffers are empty. The buffers hold several seconds of
+// samples even at 100 Hz, so this only bounds the latency until samples reach the file.
+const milliseconds writer_idle_time(20);
+
+// The footer is only used if the records and the index it describes lie in the file, in the
+// order of the layout, so a damaged footer cannot point the reader outside the mapping.
+bool footer_consistent(const char *data, size_t size, const FlightRecordFileFooter &footer)
+{
+    const uint64_t records_end = size - sizeof(FlightRecordFileFooter);
+    const uint64_t max_records = (records_end - sizeof(FlightRecordFileHeader)) / sizeof(FlightRecord);
+    if (footer.record_count > max_records) {
+        return false;
+    }
+    const uint64_t index_start = sizeof(FlightRecordFileHeader) + footer.record_count * sizeof(FlightRecord);
+    if (footer.index_offset < index_start || footer.index_offset > records_end ||
+        footer.index_offset % alignof(FlightRecordIndexEntry) != 0 ||
+        footer.index_count > (records_end - footer.index_offset) / sizeof(FlightRecordIndexEntry)) {
+        return false;
+    }
+    const FlightRecordIndexEntry *index = reinterpret_cast<const FlightRecordIndexEntry *>(data + footer.index_offset);
+    for (uint64_t i = 0; i < footer.index_count; ++i) {
+        if (index[i].first_record > footer.record_count ||
+            index[i].records > footer.record_count - index[i].first_record) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+FlightRecorder::FlightRecorder(TelemetryMonitor &monitor) :
+    _monitor(monitor),
+    _file(nullptr),
+    _running(false),
+    _records_written(0)
+{}
+
+FlightRecorder::~FlightRecorder()
+{
+    stop();
+}
+
+bool FlightRecorder::start(const std::string &path, double rate_hz)
+{
+    if (_running) {
+        return false;
+    }
+
+    _file = std::fopen(path.c_str(), "wb");
+    if (!_file) {
+        log_error() << "Cannot open flight record " << path;
+        return false;
+    }
+
+    _start = _monitor.clock().now();
+    _records_written = 0;
+    _index.clear();
+
+    FlightRecordFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, header_magic, sizeof(header.magic));
+    header.version = file_version;
+    header.record_size = sizeof(FlightRecord);
+    header.start_time_unix_us =
+        duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    std::fwrite(&header, sizeof(header), 1, _file);
+
+    for (auto &stream : _streams) {
+        stream.sequence = 0;
+        stream.dropped = 0;
+    }
+
+    _running = true;
+    _thread = std::thread(&FlightRecorder::write_thread, this);
+
+    _monitor.set_minimum_rate(rate_hz);
+
+    _listeners.push_back(_monitor.add_position_listener([this](const Telemetry::Position &position) {
+        FlightRecord record;
+        record.position.latitude_deg = position.latitude_deg;
+        record.position.longitude_deg = position.longitude_deg;
+        record.position.absolute_altitude_m = position.absolute_altitude_m;
+        record.position.relative_altitude_m = position.relative_altitude_m;
+        push(FlightRecordType::POSITION, record);
+    }));
+    _listeners.push_back(_monitor.add_ground_speed_listener([this](const Telemetry::GroundSpeedNED &speed) {
+        FlightRecord record;
+        record.velocity.north_m_s = speed.velocity_north_m_s;
+        record.velocity.east_m_s = speed.velocity_east_m_s;
+        record.velocity.down_m_s = speed.velocity_down_m_s;
+        push(FlightRecordType::VELOCITY, record);
+    }));
+    _listeners.push_back(_monitor.add_attitude_listener([this](const Telemetry::EulerAngle &attitude) {
+        FlightRecord record;
+        record.attitude.roll_deg = attitude.roll_deg;
+        record.attitude.pitch_deg = attitude.pitch_deg;
+        record.attitude.yaw_deg = attitude.yaw_deg;
+        push(FlightRecordType::ATTITUDE, record);
+    }));
+    _listeners.push_back(_monitor.add_flight_mode_listener([this](const Telemetry::FlightMode &flight_mode) {
+        FlightRecord record;
+        record.flight_mode = static_cast<uint32_t>(flight_mode);
+        push(FlightRecordType::FLIGHT_MODE, record);
+    }));
+    _listeners.push_back(_monitor.add_armed_listener([this](const bool &armed) {
+        FlightRecord record;
+        record.armed = armed ? 1 : 0;
+        push(FlightRecordType::ARMED, record);
+    }));
+
+    return true;
+}
+
+void FlightRecorder::stop()
+{
+    if (!_running) {
+        return;
+    }
+
+    for (auto handle : _listeners) {
+        _monitor.remove_listener(handle);
+    }
+    _listeners.clear();
+    _monitor.set_minimum_rate(0.0);
+
+    _running = false;
+    _thread.join();
+
+    finish_file();
+}
+
+uint64_t FlightRecorder::dropped(FlightRecordType type) const
+{
+    return _streams[static_cast<unsigned>(type) - 1].dropped;
+}
+
+void FlightRecorder::push(FlightRecordType type, FlightRecord &record)
+{
+    Stream &stream = _streams[static_cast<unsigned>(type) - 1];
+
+    record.time_us = duration_cast<microseconds>(_monitor.clock().now() - _start).count();
+    record.type = static_cast<uint16_t>(type);
+    record.reserved = 0;
+    record.sequence = stream.sequence++;
+
+    if (!stream.buffer.try_push(record)) {
+        stream.dropped++;
+    }
+}
+
+size_t FlightRecorder::drain(std::vector<FlightRecord> &batch)
+{
+    batch.clear();
+    FlightRecord record;
+    for (auto &stream : _streams) {
+        while (stream.buffer.try_pop(record)) {
+            batch.push_back(record);
+        }
+    }
+    return batch.size();
+}
+
+void FlightRecorder::write_thread()
+{
+    std::vector<FlightRecord> batch;
+    batch.reserve(flight_record_type_count * 4096);
+
+    while (_running) {
+        if (drain(batch) == 0) {
+            std::this_thread::sleep_for(writer_idle_time);
+            continue;
+        }
+        write_batch(batch);
+    }
+
+    // The listeners are gone by now, pick up what they left behind.
+    while (drain(batch) > 0) {
+        write_batch(batch);
+    }
+}
+
+void FlightRecorder::write_batch(const std::vector<FlightRecord> &batch)
+{
+    std::fwrite(batch.data(), sizeof(FlightRecord), batch.size(), _file);
+
+    for (const auto &record : batch) {
+        if (_index.empty() || _index.back().records == index_block_records) {
+            FlightRecordIndexEntry entry = {_records_written, 0, record.time_us, record.time_us};
+            _index.push_back(entry);
+        }
+        FlightRecordIndexEntry &entry = _index.back();
+        entry.records++;
+        if (record.time_us < entry.min_time_us) {
+            entry.min_time_us = record.time_us;
+        }
+        if (record.time_us > entry.max_time_us) {
+            entry.max_time_us = record.time_us;
+        }
+        _records_written++;
+    }
+}
+
+void FlightRecorder::finish_file()
+{
+    FlightRecordFileFooter footer;
+    std::memset(&footer, 0, sizeof(footer));
+    footer.index_offset = sizeof(FlightRecordFileHeader) + _records_written * sizeof(FlightRecord);
+    footer.index_count = _index.size();
+    footer.record_count = _records_written;
+    for (unsigned i = 0; i < flight_record_type_count; ++i) {
+        footer.dropped[i] = _streams[i].dropped;
+    }
+    std::memcpy(footer.magic, footer_magic, sizeof(footer.magic));
+
+    std::fwrite(_index.data(), sizeof(FlightRecordIndexEntry), _index.size(), _file);
+    std::fwrite(&footer, sizeof(footer), 1, _file);
+    std::fclose(_file);
+    _file = nullptr;
+}
+
+FlightRecordReader::FlightRecordReader() :
+    _mapping(nullptr),
+    _size(0),
+    _header(nullptr),
+    _records(nullptr),
+    _record_count(0),
+    _index(nullptr),
+    _index_count(0),
+    _footer(nullptr)
+{}
+
+FlightRecordReader::~FlightRecordReader()
+{
+    close();
+}
+
+bool FlightRecordReader::open(const std::string &path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) < sizeof(FlightRecordFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    _size = file_stat.st_size;
+    _mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (_mapping == MAP_FAILED) {
+        _mapping = nullptr;
+        return false;
+    }
+
+    const char *data = static_cast<const char *>(_mapping);
+    _header = reinterpret_cast<const FlightRecordFileHeader *>(data);
+    if (std::memcmp(_header->magic, header_magic, sizeof(header_magic)) != 0 ||
+        _header->record_size != sizeof(FlightRecord)) {
+        close();
+        return false;
+    }
+    _records = reinterpret_cast<const FlightRecord *>(data + sizeof(FlightRecordFileHeader));
+
+    const FlightRecordFileFooter *footer =
+        _size >= sizeof(FlightRecordFileHeader) + sizeof(FlightRecordFileFooter) ?
+            reinterpret_cast<const FlightRecordFileFooter *>(data + _size - sizeof(FlightRecordFileFooter)) :
+            nullptr;
+
+    if (footer && std::memcmp(footer->magic, footer_magic, sizeof(footer_magic)) == 0) {
+        if (!footer_consistent(data, _size, *footer)) {
+            close();
+            return false;
+        }
+        _footer = footer;
+        _record_count = footer->record_count;
+        _index = reinterpret_cast<const FlightRecordIndexEntry *>(data + footer->index_offset);
+        _index_count = footer->index_count;
+    } else {
+        // Not closed cleanly, use every complete record.
+        _record_count = (_size - sizeof(FlightRecordFileHeader)) / sizeof(FlightRecord);
+    }
+    return true;
+}
+
+void FlightRecordReader::close()
+{
+    if (_mapping) {
+        munmap(_mapping, _size);
+    }
+    _mapping = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _records = nullptr;
+    _record_count = 0;
+    _index = nullptr;
+    _index_count = 0;
+    _footer = nullptr;
+}
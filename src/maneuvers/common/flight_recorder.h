@@ -0,0 +1,173 @@
+//
+// Records telemetry at a high rate into a compact binary file.
+//
+// The telemetry callbacks only copy the sample into a lock-free ring buffer
+// (one per stream, each stream has a single producer). A background thread
+// drains the buffers and writes the file, so the callbacks never wait for
+// the disk. When a buffer is full the sample is dropped and counted.
+//
+// File layout (little endian, fixed-size structs, can be mmap'ed as is):
+//   FlightRecordFileHeader
+//   FlightRecord * record_count          in the order they were written
+//   FlightRecordIndexEntry * index_count one per block of records
+//   FlightRecordFileFooter
+// If the recorder did not shut down cleanly the footer is missing, and the
+// records can still be read up to the end of the file.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "spsc_ring_buffer.h"
+#include "telemetry_monitor.h"
+
+enum class FlightRecordType : uint16_t {
+    POSITION = 1,
+    VELOCITY = 2,
+    ATTITUDE = 3,
+    FLIGHT_MODE = 4,
+    ARMED = 5,
+};
+
+const unsigned flight_record_type_count = 5;
+
+struct FlightRecordFileHeader {
+    char magic[8]; // "MNVFLT01"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t start_time_unix_us; // wall clock time of time_us == 0
+    uint8_t reserved[40];
+};
+
+struct FlightRecord {
+    uint64_t time_us; // since start of the recording, monotonic
+    uint16_t type;    // FlightRecordType
+    uint16_t reserved;
+    uint32_t sequence; // per stream, gaps show dropped samples
+    union {
+        struct {
+            double latitude_deg;
+            double longitude_deg;
+            float absolute_altitude_m;
+            float relative_altitude_m;
+        } position;
+        struct {
+            float north_m_s;
+            float east_m_s;
+            float down_m_s;
+        } velocity;
+        struct {
+            float roll_deg;
+            float pitch_deg;
+            float yaw_deg;
+        } attitude;
+        uint32_t flight_mode; // mavsdk::Telemetry::FlightMode
+        uint32_t armed;
+    };
+};
+
+// Records [first_record, first_record + records) have timestamps in [min_time_us, max_time_us].
+struct FlightRecordIndexEntry {
+    uint64_t first_record;
+    uint64_t records;
+    uint64_t min_time_us;
+    uint64_t max_time_us;
+};
+
+struct FlightRecordFileFooter {
+    uint64_t index_offset;
+    uint64_t index_count;
+    uint64_t record_count;
+    uint64_t dropped[flight_record_type_count]; // by FlightRecordType - 1
+    char magic[8]; // "MNVIDX01", last bytes of the file
+};
+
+static_assert(sizeof(FlightRecordFileHeader) == 64, "unexpected header size");
+static_assert(sizeof(FlightRecord) == 40, "unexpected record size");
+static_assert(sizeof(FlightRecordFileFooter) == 72, "unexpected footer size");
+
+class FlightRecorder {
+public:
+    explicit FlightRecorder(TelemetryMonitor &monitor);
+    ~FlightRecorder();
+
+    // Keeps the recorded streams at rate_hz or faster and starts writing to path.
+    bool start(const std::string &path, double rate_hz);
+
+    // Flushes the remaining samples and writes the index.
+    void stop();
+
+    uint64_t records_written() const { return _records_written; }
+    uint64_t dropped(FlightRecordType type) const;
+
+private:
+    FlightRecorder(const FlightRecorder &) = delete;
+    FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+    struct Stream {
+        Stream() : buffer(4096), sequence(0), dropped(0) {}
+        SpscRingBuffer<FlightRecord> buffer;
+        uint32_t sequence;
+        std::atomic<uint64_t> dropped;
+    };
+
+    void push(FlightRecordType type, FlightRecord &record);
+    void write_thread();
+    size_t drain(std::vector<FlightRecord> &batch);
+    void write_batch(const std::vector<FlightRecord> &batch);
+    void finish_file();
+
+    TelemetryMonitor &_monitor;
+    std::vector<TelemetryMonitor::listener_handle_t> _listeners;
+    Stream _streams[flight_record_type_count];
+
+    std::chrono::steady_clock::time_point _start;
+    std::FILE *_file;
+    std::thread _thread;
+    std::atomic<bool> _running;
+
+    uint64_t _records_written;
+    std::vector<FlightRecordIndexEntry> _index;
+};
+
+// Read-only view of a recording, the records are used straight from the mapped file.
+class FlightRecordReader {
+public:
+    FlightRecordReader();
+    ~FlightRecordReader();
+
+    // False if the file is not a recording, or its footer does not match the records and index.
+    bool open(const std::string &path);
+    void close();
+
+    const FlightRecordFileHeader *header() const { return _header; }
+    const FlightRecord *records() const { return _records; }
+    size_t record_count() const { return _record_count; }
+
+    // Empty if the file has no footer.
+    const FlightRecordIndexEntry *index() const { return _index; }
+    size_t index_count() const { return _index_count; }
+    const FlightRecordFileFooter *footer() const { return _footer; }
+
+private:
+    FlightRecordReader(const FlightRecordReader &) = delete;
+    FlightRecordReader &operator=(const FlightRecordReader &) = delete;
+
+    void *_mapping;
+    size_t _size;
+    const FlightRecordFileHeader *_header;
+    const FlightRecord *_records;
+    size_t _record_count;
+    const FlightRecordIndexEntry *_index;
+    size_t _index_count;
+    const FlightRecordFileFooter *_footer;
+};
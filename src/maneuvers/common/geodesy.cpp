@@ -0,0 +1,314 @@
+#include "geodesy.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace mavsdk;
+
+namespace geodesy {
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const double pi_2 = 1.57079632679489661923;
+const double pi_6 = 0.52359877559829887308;
+const double two_over_pi = 0.63661977236758134308;
+const double deg_to_rad = pi / 180.0;
+const double rad_to_deg = 180.0 / pi;
+const double sqrt3 = 1.73205080756887729353;
+const double tan_pi_12 = 0.26794919243112270647;
+
+// pi/2 split in three parts (33 + 33 + 53 bits) for the Cody-Waite range reduction.
+const double pi_2_part1 = 1.57079632673412561417e+00;
+const double pi_2_part2 = 6.07710050630396597660e-11;
+const double pi_2_part3 = 2.02226624879595063154e-21;
+
+// Adding and subtracting 1.5 * 2^52 rounds to the nearest integer without a libm call.
+const double round_magic = 6755399441055744.0;
+
+// Rounding and quadrant selection only use arithmetic and selects, so these inline kernels
+// vectorize. Taylor series are used on the reduced ranges, where they are accurate to about
+// one ulp with the number of terms below.
+inline void sincos_kernel(double x, double &sin_out, double &cos_out)
+{
+    // x = k * pi/2 + r with |r| <= pi/4
+    const double k = (x * two_over_pi + round_magic) - round_magic;
+    const double r = ((x - k * pi_2_part1) - k * pi_2_part2) - k * pi_2_part3;
+    const double r2 = r * r;
+
+    const double s =
+        r + r * r2 *
+                (-1.0 / 6.0 +
+                 r2 * (1.0 / 120.0 +
+                       r2 * (-1.0 / 5040.0 +
+                             r2 * (1.0 / 362880.0 +
+                                   r2 * (-1.0 / 39916800.0 +
+                                         r2 * (1.0 / 6227020800.0 +
+                                               r2 * (-1.0 / 1307674368000.0 +
+                                                     r2 * (1.0 / 355687428096000.0))))))));
+    const double c =
+        1.0 +
+        r2 * (-0.5 +
+              r2 * (1.0 / 24.0 +
+                    r2 * (-1.0 / 720.0 +
+                          r2 * (1.0 / 40320.0 +
+                                r2 * (-1.0 / 3628800.0 +
+                                      r2 * (1.0 / 479001600.0 +
+                                            r2 * (-1.0 / 87178291200.0 +
+                                                  r2 * (1.0 / 20922789888000.0))))))));
+
+    // quadrant = k mod 4, k/4 has a fractional part of 0, .25, .5 or .75, so shifting by
+    // .375 before rounding gives floor(k/4) without ties.
+    const double quadrant = k - 4.0 * (((k * 0.25 - 0.375) + round_magic) - round_magic);
+    const bool swap = (quadrant == 1.0) | (quadrant == 3.0);
+    const double sin_sign = quadrant >= 2.0 ? -1.0 : 1.0;
+    const double cos_sign = ((quadrant == 1.0) | (quadrant == 2.0)) ? -1.0 : 1.0;
+
+    sin_out = sin_sign * (swap ? c : s);
+    cos_out = cos_sign * (swap ? s : c);
+}
+
+// atan(t) for 0 <= t <= 1.
+inline double atan_kernel(double t)
+{
+    // atan(t) = pi/6 + atan((sqrt3 * t - 1) / (sqrt3 + t)) brings the argument below tan(pi/12).
+    const bool shift = t > tan_pi_12;
+    const double shifted = (sqrt3 * t - 1.0) / (sqrt3 + t);
+    const double u = shift ? shifted : t;
+    const double u2 = u * u;
+
+    double p = -1.0 / 29.0;
+    p = p * u2 + 1.0 / 27.0;
+    p = p * u2 - 1.0 / 25.0;
+    p = p * u2 + 1.0 / 23.0;
+    p = p * u2 - 1.0 / 21.0;
+    p = p * u2 + 1.0 / 19.0;
+    p = p * u2 - 1.0 / 17.0;
+    p = p * u2 + 1.0 / 15.0;
+    p = p * u2 - 1.0 / 13.0;
+    p = p * u2 + 1.0 / 11.0;
+    p = p * u2 - 1.0 / 9.0;
+    p = p * u2 + 1.0 / 7.0;
+    p = p * u2 - 1.0 / 5.0;
+    p = p * u2 + 1.0 / 3.0;
+    const double atan_u = u - u * u2 * p;
+
+    return shift ? pi_6 + atan_u : atan_u;
+}
+
+inline double atan2_kernel(double y, double x)
+{
+    const double ay = std::fabs(y);
+    const double ax = std::fabs(x);
+    const double larger = ay > ax ? ay : ax;
+    const double smaller = ay > ax ? ax : ay;
+    const double t = smaller / (larger > 0.0 ? larger : 1.0);
+
+    double r = atan_kernel(t);
+    r = ay > ax ? pi_2 - r : r;
+    r = x < 0.0 ? pi - r : r;
+    return std::copysign(r, y);
+}
+
+// Destination on the unit sphere, with the origin rotated to longitude 0:
+// p = cos(d) * origin + sin(d) * (cos(b) * north + sin(b) * east)
+inline void destination_kernel(double sin_lat,
+                               double cos_lat,
+                               double sin_d,
+                               double cos_d,
+                               double sin_b,
+                               double cos_b,
+                               double &y_lat,
+                               double &x_lat,
+                               double &y_lon,
+                               double &x_lon)
+{
+    const double px = cos_d * cos_lat - sin_d * cos_b * sin_lat;
+    const double py = sin_d * sin_b;
+    const double pz = cos_d * sin_lat + sin_d * cos_b * cos_lat;
+    y_lat = pz;
+    x_lat = std::sqrt(px * px + py * py);
+    y_lon = py;
+    x_lon = px;
+}
+
+// The batch functions are processed in blocks so the temporaries stay in L1.
+const std::size_t block_size = 256;
+
+} // namespace
+
+void destination_point(double lat_deg,
+                       double lon_deg,
+                       double distance_m,
+                       double bearing_deg,
+                       double &lat_out_deg,
+                       double &lon_out_deg)
+{
+    const double lat = lat_deg * deg_to_rad;
+    const double d = distance_m / earth_radius_m;
+    const double b = bearing_deg * deg_to_rad;
+
+    const double lat_new = std::asin(std::sin(lat) * std::cos(d) + std::cos(lat) * std::sin(d) * std::cos(b));
+    const double dlon = std::atan2(std::sin(b) * std::sin(d) * std::cos(lat),
+                                   std::cos(d) - std::sin(lat) * std::sin(lat_new));
+
+    lat_out_deg = lat_new * rad_to_deg;
+    lon_out_deg = lon_deg + dlon * rad_to_deg;
+}
+
+void offset_north_east(double lat_deg,
+                       double lon_deg,
+                       double north_m,
+                       double east_m,
+                       double &lat_out_deg,
+                       double &lon_out_deg)
+{
+    destination_point(lat_deg,
+                      lon_deg,
+                      std::sqrt(north_m * north_m + east_m * east_m),
+                      std::atan2(east_m, north_m) * rad_to_deg,
+                      lat_out_deg,
+                      lon_out_deg);
+}
+
+void north_east_between(double origin_lat_deg,
+                        double origin_lon_deg,
+                        double lat_deg,
+                        double lon_deg,
+                        double &north_m,
+                        double &east_m)
+{
+    const double lat0 = origin_lat_deg * deg_to_rad;
+    const double lat1 = lat_deg * deg_to_rad;
+    const double dlat = lat1 - lat0;
+    const double dlon = (lon_deg - origin_lon_deg) * deg_to_rad;
+
+    // Haversine distance and initial bearing.
+    const double h = std::sin(dlat / 2) * std::sin(dlat / 2) +
+                     std::cos(lat0) * std::cos(lat1) * std::sin(dlon / 2) * std::sin(dlon / 2);
+    const double distance = 2.0 * std::atan2(std::sqrt(h), std::sqrt(1.0 - h)) * earth_radius_m;
+    const double bearing = std::atan2(std::sin(dlon) * std::cos(lat1),
+                                      std::cos(lat0) * std::sin(lat1) -
+                                          std::sin(lat0) * std::cos(lat1) * std::cos(dlon));
+
+    north_m = distance * std::cos(bearing);
+    east_m = distance * std::sin(bearing);
+}
+
+void sincos(const double *__restrict__ x,
+            std::size_t count,
+            double *__restrict__ sin_out,
+            double *__restrict__ cos_out)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        sincos_kernel(x[i], sin_out[i], cos_out[i]);
+    }
+}
+
+void atan2(const double *__restrict__ y,
+           const double *__restrict__ x,
+           std::size_t count,
+           double *__restrict__ out)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        out[i] = atan2_kernel(y[i], x[i]);
+    }
+}
+
+void destination_points(double lat_deg,
+                        double lon_deg,
+                        const double *__restrict__ distance_m,
+                        const double *__restrict__ bearing_deg,
+                        std::size_t count,
+                        double *__restrict__ lat_out_deg,
+                        double *__restrict__ lon_out_deg)
+{
+    const double lat = lat_deg * deg_to_rad;
+    const double sin_lat = std::sin(lat);
+    const double cos_lat = std::cos(lat);
+
+    double sin_d[block_size], cos_d[block_size], sin_b[block_size], cos_b[block_size];
+    double y_lat[block_size], x_lat[block_size], y_lon[block_size], x_lon[block_size];
+
+    for (std::size_t start = 0; start < count; start += block_size) {
+        const std::size_t n = count - start < block_size ? count - start : block_size;
+
+        for (std::size_t i = 0; i < n; ++i) {
+            sincos_kernel(distance_m[start + i] / earth_radius_m, sin_d[i], cos_d[i]);
+            sincos_kernel(bearing_deg[start + i] * deg_to_rad, sin_b[i], cos_b[i]);
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            destination_kernel(sin_lat, cos_lat, sin_d[i], cos_d[i], sin_b[i], cos_b[i],
+                               y_lat[i], x_lat[i], y_lon[i], x_lon[i]);
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            lat_out_deg[start + i] = atan2_kernel(y_lat[i], x_lat[i]) * rad_to_deg;
+            lon_out_deg[start + i] = lon_deg + atan2_kernel(y_lon[i], x_lon[i]) * rad_to_deg;
+        }
+    }
+}
+
+void offset_north_east(double lat_deg,
+                       double lon_deg,
+                       const double *__restrict__ north_m,
+                       const double *__restrict__ east_m,
+                       std::size_t count,
+                       double *__restrict__ lat_out_deg,
+                       double *__restrict__ lon_out_deg)
+{
+    const double lat = lat_deg * deg_to_rad;
+    const double sin_lat = std::sin(lat);
+    const double cos_lat = std::cos(lat);
+
+    double sin_d[block_size], cos_d[block_size], sin_b[block_size], cos_b[block_size];
+    double y_lat[block_size], x_lat[block_size], y_lon[block_size], x_lon[block_size];
+
+    for (std::size_t start = 0; start < count; start += block_size) {
+        const std::size_t n = count - start < block_size ? count - start : block_size;
+
+        // The bearing only enters through its sine and cosine, which are the normalized
+        // offsets, so no trigonometry is needed for it.
+        for (std::size_t i = 0; i < n; ++i) {
+            const double north = north_m[start + i];
+            const double east = east_m[start + i];
+            const double distance = std::sqrt(north * north + east * east);
+            const bool zero = distance == 0.0;
+            const double inverse = 1.0 / (zero ? 1.0 : distance);
+            sin_b[i] = zero ? 0.0 : east * inverse;
+            cos_b[i] = zero ? 1.0 : north * inverse;
+            sincos_kernel(distance / earth_radius_m, sin_d[i], cos_d[i]);
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            destination_kernel(sin_lat, cos_lat, sin_d[i], cos_d[i], sin_b[i], cos_b[i],
+                               y_lat[i], x_lat[i], y_lon[i], x_lon[i]);
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            lat_out_deg[start + i] = atan2_kernel(y_lat[i], x_lat[i]) * rad_to_deg;
+            lon_out_deg[start + i] = lon_deg + atan2_kernel(y_lon[i], x_lon[i]) * rad_to_deg;
+        }
+    }
+}
+
+} // namespace geodesy
+
+Telemetry::Position computeHorizontalLocation(Telemetry::Position pos, double radius, double bearing)
+{
+    Telemetry::Position computepos = pos;
+    geodesy::destination_point(pos.latitude_deg, pos.longitude_deg, radius, bearing,
+                               computepos.latitude_deg, computepos.longitude_deg);
+    return computepos;
+}
+
+Telemetry::Position calculate_setpoint(double lat_m, double long_m, double height_above_home, Telemetry::Position current_position)
+{
+    // calculate new setpoint
+    Telemetry::Position new_position;
+
+    geodesy::offset_north_east(current_position.latitude_deg, current_position.longitude_deg,
+                               lat_m, long_m,
+                               new_position.latitude_deg, new_position.longitude_deg);
+    new_position.absolute_altitude_m = current_position.absolute_altitude_m - current_position.relative_altitude_m + height_above_home;
+    new_position.relative_altitude_m = height_above_home;
+
+    return new_position;
+}
@@ -0,0 +1,77 @@
+//
+// Geodesy shared by all maneuvers.
+//
+// All functions use the same spherical Earth model, so a point computed from
+// a bearing and a distance, from north/east offsets or converted back into
+// local offsets is always consistent. The batch functions work on contiguous
+// arrays and are written so the compiler can vectorize them (no branches or
+// libm calls inside the loops); they agree with the scalar versions to well
+// below a millimeter.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include <plugins/telemetry/telemetry.h>
+
+namespace geodesy {
+
+// Mean Earth radius.
+const double earth_radius_m = 6371000.0;
+
+// Point reached from (lat_deg, lon_deg) after distance_m along the great circle with the given
+// initial bearing (degrees clockwise from north).
+void destination_point(double lat_deg,
+                       double lon_deg,
+                       double distance_m,
+                       double bearing_deg,
+                       double &lat_out_deg,
+                       double &lon_out_deg);
+
+// Point offset by north_m/east_m from the origin, i.e. distance hypot(north_m, east_m) towards
+// bearing atan2(east_m, north_m).
+void offset_north_east(double lat_deg,
+                       double lon_deg,
+                       double north_m,
+                       double east_m,
+                       double &lat_out_deg,
+                       double &lon_out_deg);
+
+// Inverse of offset_north_east: north/east offset of the point from the origin.
+void north_east_between(double origin_lat_deg,
+                        double origin_lon_deg,
+                        double lat_deg,
+                        double lon_deg,
+                        double &north_m,
+                        double &east_m);
+
+// Batch version of destination_point for count offsets from the same origin.
+void destination_points(double lat_deg,
+                        double lon_deg,
+                        const double *distance_m,
+                        const double *bearing_deg,
+                        std::size_t count,
+                        double *lat_out_deg,
+                        double *lon_out_deg);
+
+// Batch version of offset_north_east for count offsets from the same origin.
+void offset_north_east(double lat_deg,
+                       double lon_deg,
+                       const double *north_m,
+                       const double *east_m,
+                       std::size_t count,
+                       double *lat_out_deg,
+                       double *lon_out_deg);
+
+// Vectorizable math kernels used by the batch functions, exposed for the benchmark.
+void sincos(const double *x, std::size_t count, double *sin_out, double *cos_out);
+void atan2(const double *y, const double *x, std::size_t count, double *out);
+
+} // namespace geodesy
+
+// Position at the given distance and bearing (degrees) from pos, keeping its altitudes.
+mavsdk::Telemetry::Position computeHorizontalLocation(mavsdk::Telemetry::Position pos, double radius, double bearing);
+
+// Position lat_m north and long_m east of current_position at height_above_home.
+mavsdk::Telemetry::Position calculate_setpoint(double lat_m, double long_m, double height_above_home, mavsdk::Telemetry::Position current_position);
@@ -0,0 +1,425 @@
+#include "geofence.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include "geodesy.h"
+#include "log_sink.h"
+
+namespace {
+
+// Aims at about one edge per cell.
+const double edges_per_cell = 1.0;
+
+// Bounds the grid for fences spread far apart, 4M cells at most.
+const size_t max_cells_per_side = 2048;
+
+// Segments are rasterized this much wider, so rounding never loses a cell at a cell border.
+const double cell_margin_m = 1e-3;
+
+enum class Contact { NONE, CROSSING, TOUCHING };
+
+double orientation(double north0, double east0, double north1, double east1, double north, double east)
+{
+    return (north1 - north0) * (east - east0) - (east1 - east0) * (north - north0);
+}
+
+// With the point known to be on the line through the segment.
+bool within(double north0, double east0, double north1, double east1, double north, double east)
+{
+    return std::min(north0, north1) <= north && north <= std::max(north0, north1) &&
+           std::min(east0, east1) <= east && east <= std::max(east0, east1);
+}
+
+// CROSSING if the segments cross at a point inside both, TOUCHING if they meet at an end or overlap.
+Contact contact(double a_north, double a_east, double b_north, double b_east,
+                double c_north, double c_east, double d_north, double d_east)
+{
+    const double c_side = orientation(a_north, a_east, b_north, b_east, c_north, c_east);
+    const double d_side = orientation(a_north, a_east, b_north, b_east, d_north, d_east);
+    const double a_side = orientation(c_north, c_east, d_north, d_east, a_north, a_east);
+    const double b_side = orientation(c_north, c_east, d_north, d_east, b_north, b_east);
+
+    if (((c_side > 0.0 && d_side < 0.0) || (c_side < 0.0 && d_side > 0.0)) &&
+        ((a_side > 0.0 && b_side < 0.0) || (a_side < 0.0 && b_side > 0.0))) {
+        return Contact::CROSSING;
+    }
+    if ((c_side == 0.0 && within(a_north, a_east, b_north, b_east, c_north, c_east)) ||
+        (d_side == 0.0 && within(a_north, a_east, b_north, b_east, d_north, d_east)) ||
+        (a_side == 0.0 && within(c_north, c_east, d_north, d_east, a_north, a_east)) ||
+        (b_side == 0.0 && within(c_north, c_east, d_north, d_east, b_north, b_east))) {
+        return Contact::TOUCHING;
+    }
+    return Contact::NONE;
+}
+
+// Cell index of a coordinate, clamped to [0, count - 1]. Coordinates beyond the grid give -1 or count.
+long cell_index(double offset_m, double cell_size_m, size_t count)
+{
+    const double index = std::floor(offset_m / cell_size_m);
+    if (index < 0.0) {
+        return -1;
+    }
+    if (index >= double(count)) {
+        return static_cast<long>(count);
+    }
+    return static_cast<long>(index);
+}
+
+} // namespace
+
+const char *fence_violation_str(FenceViolationType type)
+{
+    switch (type) {
+        case FenceViolationType::OUTSIDE_FENCE: return "outside the fence";
+        case FenceViolationType::ABOVE_FENCE: return "above the fence";
+        case FenceViolationType::IN_ZONE: return "in a zone";
+    }
+    return "unknown";
+}
+
+Geofence::Geofence() :
+    _origin_latitude_deg(0.0),
+    _origin_longitude_deg(0.0),
+    _fence(0),
+    _min_north_m(0.0),
+    _min_east_m(0.0),
+    _cell_size_m(1.0),
+    _rows(0),
+    _columns(0)
+{}
+
+bool Geofence::build(const std::vector<FencePolygon> &polygons)
+{
+    _polygons.clear();
+    _edges.clear();
+    _cell_start.clear();
+    _cell_edges.clear();
+    _fence = 0;
+    _rows = 0;
+    _columns = 0;
+
+    bool has_fence = false;
+    for (const auto &polygon : polygons) {
+        if (polygon.vertices.size() < 3 || (polygon.kind == FenceKind::INCLUSION && has_fence)) {
+            return false;
+        }
+        has_fence = has_fence || polygon.kind == FenceKind::INCLUSION;
+    }
+    if (polygons.empty()) {
+        return true;
+    }
+
+    _origin_latitude_deg = polygons[0].vertices[0].latitude_deg;
+    _origin_longitude_deg = polygons[0].vertices[0].longitude_deg;
+    _fence = polygons.size();
+
+    double max_north_m = -INFINITY, max_east_m = -INFINITY;
+    _min_north_m = INFINITY;
+    _min_east_m = INFINITY;
+    std::vector<Waypoint> corners;
+    for (size_t i = 0; i < polygons.size(); ++i) {
+        const FencePolygon &polygon = polygons[i];
+        if (polygon.kind == FenceKind::INCLUSION) {
+            _fence = i;
+        }
+
+        corners.clear();
+        for (const auto &vertex : polygon.vertices) {
+            corners.push_back(to_local(vertex.latitude_deg, vertex.longitude_deg, 0.0f));
+            _min_north_m = std::min(_min_north_m, corners.back().north_m);
+            _min_east_m = std::min(_min_east_m, corners.back().east_m);
+            max_north_m = std::max(max_north_m, corners.back().north_m);
+            max_east_m = std::max(max_east_m, corners.back().east_m);
+        }
+
+        // Closed, the last vertex connects back to the first.
+        const Polygon entry = {polygon.kind, polygon.altitude_m, _edges.size(), corners.size()};
+        _polygons.push_back(entry);
+        for (size_t j = 0; j < corners.size(); ++j) {
+            const Waypoint &from = corners[j];
+            const Waypoint &to = corners[(j + 1) % corners.size()];
+            const Edge edge = {from.north_m, from.east_m, to.north_m, to.east_m, static_cast<uint32_t>(i)};
+            _edges.push_back(edge);
+        }
+    }
+
+    const double height_m = max_north_m - _min_north_m;
+    const double width_m = max_east_m - _min_east_m;
+    _cell_size_m = std::sqrt(std::max(height_m * width_m, 1.0) * edges_per_cell / _edges.size());
+    _cell_size_m = std::max(_cell_size_m, std::max(height_m, width_m) / max_cells_per_side);
+    _rows = static_cast<size_t>(height_m / _cell_size_m) + 1;
+    _columns = static_cast<size_t>(width_m / _cell_size_m) + 1;
+
+    // Counted first, so the edges of all cells go into one array.
+    std::vector<size_t> cells;
+    _cell_start.assign(_rows * _columns + 1, 0);
+    for (const auto &edge : _edges) {
+        cells_along(edge.north0_m, edge.east0_m, edge.north1_m, edge.east1_m, cells);
+        for (const size_t cell : cells) {
+            ++_cell_start[cell + 1];
+        }
+    }
+    for (size_t i = 1; i < _cell_start.size(); ++i) {
+        _cell_start[i] += _cell_start[i - 1];
+    }
+    _cell_edges.resize(_cell_start.back());
+    std::vector<uint32_t> filled(_cell_start.begin(), _cell_start.end() - 1);
+    for (size_t i = 0; i < _edges.size(); ++i) {
+        const Edge &edge = _edges[i];
+        cells_along(edge.north0_m, edge.east0_m, edge.north1_m, edge.east1_m, cells);
+        for (const size_t cell : cells) {
+            _cell_edges[filled[cell]++] = static_cast<uint32_t>(i);
+        }
+    }
+    return true;
+}
+
+Geofence::Waypoint Geofence::to_local(double latitude_deg, double longitude_deg, float altitude_m) const
+{
+    Waypoint waypoint;
+    geodesy::north_east_between(_origin_latitude_deg, _origin_longitude_deg, latitude_deg, longitude_deg,
+                                waypoint.north_m, waypoint.east_m);
+    waypoint.altitude_m = altitude_m;
+    return waypoint;
+}
+
+std::vector<FenceViolation> Geofence::check_mission(double start_latitude_deg,
+                                                    double start_longitude_deg,
+                                                    float start_altitude_m,
+                                                    const MissionBuilder &mission) const
+{
+    if (_polygons.empty()) {
+        return std::vector<FenceViolation>();
+    }
+    std::vector<Waypoint> path;
+    path.reserve(mission.size() + 1);
+    path.push_back(to_local(start_latitude_deg, start_longitude_deg, start_altitude_m));
+    for (const auto &item : mission.items()) {
+        path.push_back(to_local(item.latitude_deg, item.longitude_deg, item.relative_altitude_m));
+    }
+    return check_path(path);
+}
+
+std::vector<FenceViolation> Geofence::check_leg(const mavsdk::Telemetry::Position &from,
+                                                const mavsdk::Telemetry::Position &to) const
+{
+    if (_polygons.empty()) {
+        return std::vector<FenceViolation>();
+    }
+    std::vector<Waypoint> path;
+    path.push_back(to_local(from.latitude_deg, from.longitude_deg, from.relative_altitude_m));
+    path.push_back(to_local(to.latitude_deg, to.longitude_deg, to.relative_altitude_m));
+    return check_path(path);
+}
+
+std::vector<FenceViolation> Geofence::check_path(const std::vector<Waypoint> &path) const
+{
+    std::vector<FenceViolation> violations;
+
+    // Where the current leg starts, and the polygons that is in.
+    std::vector<char> inside(_polygons.size(), 0);
+    std::vector<uint32_t> inside_list;
+    for (size_t i = 0; i < _polygons.size(); ++i) {
+        if (contains(i, path[0].north_m, path[0].east_m)) {
+            inside[i] = 1;
+            inside_list.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // Leg number of the last leg which tested an edge, and which met a polygon.
+    std::vector<uint32_t> edge_leg(_edges.size(), 0);
+    std::vector<uint32_t> polygon_leg(_polygons.size(), 0);
+    std::vector<char> crossed_odd(_polygons.size(), 0);
+    std::vector<char> touched(_polygons.size(), 0);
+    std::vector<uint32_t> met;
+    std::vector<size_t> cells;
+
+    for (size_t leg = 1; leg < path.size(); ++leg) {
+        const Waypoint &from = path[leg - 1];
+        const Waypoint &to = path[leg];
+        const uint32_t stamp = static_cast<uint32_t>(leg);
+
+        met.clear();
+        cells_along(from.north_m, from.east_m, to.north_m, to.east_m, cells);
+        for (const size_t cell : cells) {
+            for (uint32_t i = _cell_start[cell]; i < _cell_start[cell + 1]; ++i) {
+                const uint32_t edge_index = _cell_edges[i];
+                if (edge_leg[edge_index] == stamp) {
+                    continue;
+                }
+                edge_leg[edge_index] = stamp;
+
+                const Edge &edge = _edges[edge_index];
+                const Contact result = contact(from.north_m, from.east_m, to.north_m, to.east_m,
+                                               edge.north0_m, edge.east0_m, edge.north1_m, edge.east1_m);
+                if (result == Contact::NONE) {
+                    continue;
+                }
+                const uint32_t polygon = edge.polygon;
+                if (polygon_leg[polygon] != stamp) {
+                    polygon_leg[polygon] = stamp;
+                    crossed_odd[polygon] = 0;
+                    touched[polygon] = 0;
+                    met.push_back(polygon);
+                }
+                if (result == Contact::CROSSING) {
+                    crossed_odd[polygon] ^= 1;
+                } else {
+                    touched[polygon] = 1;
+                }
+            }
+        }
+
+        // A leg meeting the border of a polygon counts as entering or leaving it.
+        const float lowest_m = std::min(from.altitude_m, to.altitude_m);
+        const float highest_m = std::max(from.altitude_m, to.altitude_m);
+        const size_t item = leg - 1;
+        auto check_zone = [&](uint32_t polygon) {
+            if (_polygons[polygon].kind == FenceKind::EXCLUSION && lowest_m < _polygons[polygon].altitude_m) {
+                const FenceViolation violation = {item, polygon, FenceViolationType::IN_ZONE};
+                violations.push_back(violation);
+            }
+        };
+        for (const uint32_t polygon : inside_list) {
+            check_zone(polygon);
+        }
+        for (const uint32_t polygon : met) {
+            if (!inside[polygon]) {
+                check_zone(polygon);
+            }
+        }
+        if (_fence < _polygons.size()) {
+            if (!inside[_fence] || polygon_leg[_fence] == stamp) {
+                const FenceViolation violation = {item, _fence, FenceViolationType::OUTSIDE_FENCE};
+                violations.push_back(violation);
+            } else if (highest_m > _polygons[_fence].altitude_m) {
+                const FenceViolation violation = {item, _fence, FenceViolationType::ABOVE_FENCE};
+                violations.push_back(violation);
+            }
+        }
+
+        // Each crossing changes sides. Touching leaves it open, so the end is looked up instead.
+        for (const uint32_t polygon : met) {
+            const char now_inside = touched[polygon] ? char(contains(polygon, to.north_m, to.east_m))
+                                                     : char(inside[polygon] ^ crossed_odd[polygon]);
+            if (now_inside == inside[polygon]) {
+                continue;
+            }
+            inside[polygon] = now_inside;
+            if (now_inside) {
+                inside_list.push_back(polygon);
+            } else {
+                inside_list.erase(std::find(inside_list.begin(), inside_list.end(), polygon));
+            }
+        }
+    }
+    return violations;
+}
+
+bool Geofence::contains(size_t polygon, double north_m, double east_m) const
+{
+    const Polygon &entry = _polygons[polygon];
+    bool result = false;
+    for (size_t i = entry.first_edge; i < entry.first_edge + entry.edge_count; ++i) {
+        const Edge &edge = _edges[i];
+        if ((edge.north0_m > north_m) != (edge.north1_m > north_m) &&
+            east_m < edge.east0_m + (north_m - edge.north0_m) * (edge.east1_m - edge.east0_m) /
+                                        (edge.north1_m - edge.north0_m)) {
+            result = !result;
+        }
+    }
+    return result;
+}
+
+void Geofence::cells_along(double north0_m, double east0_m, double north1_m, double east1_m,
+                           std::vector<size_t> &cells) const
+{
+    cells.clear();
+    const double low_m = std::min(north0_m, north1_m) - _min_north_m;
+    const double high_m = std::max(north0_m, north1_m) - _min_north_m;
+    const long first_row = std::max(cell_index(low_m - cell_margin_m, _cell_size_m, _rows), 0L);
+    const long last_row = std::min(cell_index(high_m + cell_margin_m, _cell_size_m, _rows), long(_rows) - 1);
+
+    for (long row = first_row; row <= last_row; ++row) {
+        // The part of the segment within this row.
+        double east_a_m = east0_m, east_b_m = east1_m;
+        if (north0_m != north1_m) {
+            const double band_low_m = std::max(_min_north_m + row * _cell_size_m, low_m + _min_north_m);
+            const double band_high_m = std::min(_min_north_m + (row + 1) * _cell_size_m, high_m + _min_north_m);
+            const double slope = (east1_m - east0_m) / (north1_m - north0_m);
+            east_a_m = east0_m + (band_low_m - north0_m) * slope;
+            east_b_m = east0_m + (band_high_m - north0_m) * slope;
+        }
+        const long first_column = std::max(
+            cell_index(std::min(east_a_m, east_b_m) - _min_east_m - cell_margin_m, _cell_size_m, _columns), 0L);
+        const long last_column = std::min(
+            cell_index(std::max(east_a_m, east_b_m) - _min_east_m + cell_margin_m, _cell_size_m, _columns),
+            long(_columns) - 1);
+        for (long column = first_column; column <= last_column; ++column) {
+            cells.push_back(size_t(row) * _columns + size_t(column));
+        }
+    }
+}
+
+bool load_geofence(const std::string &path, std::vector<FencePolygon> &polygons)
+{
+    std::ifstream file(path);
+    if (!file) {
+        log_error() << "Cannot open geofence file " << path;
+        return false;
+    }
+
+    std::string line;
+    unsigned line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        std::string kind, altitude;
+        fields >> kind >> altitude;
+
+        FencePolygon polygon;
+        polygon.kind = kind == "fence" ? FenceKind::INCLUSION : FenceKind::EXCLUSION;
+        polygon.altitude_m = INFINITY;
+        bool valid = kind == "fence" || kind == "zone";
+        if (valid && altitude != "-") {
+            std::istringstream altitude_field(altitude);
+            valid = static_cast<bool>(altitude_field >> polygon.altitude_m) && altitude_field.eof();
+        }
+        std::vector<double> coordinates;
+        double coordinate;
+        while (valid && fields >> coordinate) {
+            coordinates.push_back(coordinate);
+        }
+        for (size_t i = 0; i + 1 < coordinates.size(); i += 2) {
+            const FenceVertex vertex = {coordinates[i], coordinates[i + 1]};
+            polygon.vertices.push_back(vertex);
+        }
+        if (!valid || !fields.eof() || coordinates.size() % 2 != 0 || polygon.vertices.size() < 3) {
+            log_error() << path << ":" << line_number
+                        << ": expected fence|zone altitude_m|- lat,lon lat,lon lat,lon ...";
+            return false;
+        }
+        polygons.push_back(polygon);
+    }
+    return true;
+}
+
+void print_fence_violations(const std::vector<FenceViolation> &violations, size_t max_listed)
+{
+    for (size_t i = 0; i < violations.size() && i < max_listed; ++i) {
+        const FenceViolation &violation = violations[i];
+        log_error() << "  leg to item " << violation.item << ": " << fence_violation_str(violation.type)
+                    << " (polygon " << violation.polygon << ")";
+    }
+    if (violations.size() > max_listed) {
+        log_error() << "  and " << violations.size() - max_listed << " more";
+    }
+}
@@ -0,0 +1,142 @@
+//
+// Checks missions and setpoints against a geofence and no-fly zones before
+// they are sent to the vehicle.
+//
+// The fence is a polygon the vehicle has to stay inside of, and below its
+// altitude. Zones are polygons it must not enter below their top, no-fly
+// areas without a top or obstacles such as buildings. Every leg, from one
+// waypoint to the next, is checked against all of them.
+//
+// The polygon edges are kept in a uniform grid over a local north/east
+// frame, with about one edge per cell. A leg only tests the edges in the
+// cells it passes, and whether a waypoint lies inside a polygon follows
+// from the edges crossed since the start, so checking a mission costs time
+// about linear in its legs and the edges near them instead of legs times
+// edges.
+//
+// The local frame is that of geodesy::north_east_between, accurate over the
+// few kilometers a mission spans.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "mission_builder.h"
+
+enum class FenceKind {
+    INCLUSION, // the fence, only one per Geofence
+    EXCLUSION  // a zone
+};
+
+struct FenceVertex {
+    double latitude_deg;
+    double longitude_deg;
+};
+
+struct FencePolygon {
+    FenceKind kind;
+    // Above home. The highest a leg may go inside the fence, or the top of a zone, above which
+    // legs may pass. INFINITY for no limit.
+    float altitude_m;
+    std::vector<FenceVertex> vertices;
+};
+
+enum class FenceViolationType {
+    OUTSIDE_FENCE, // leaves the fence, or starts outside of it
+    ABOVE_FENCE,
+    IN_ZONE // enters a zone below its top, or starts in one
+};
+
+const char *fence_violation_str(FenceViolationType type);
+
+struct FenceViolation {
+    size_t item;    // of the mission, the leg from the item before (or the start) to this one
+    size_t polygon; // as given to Geofence::build
+    FenceViolationType type;
+};
+
+class Geofence {
+public:
+    Geofence();
+
+    // Replaces the polygons. False (and the fence empty) if a polygon has fewer than three
+    // vertices or more than one is an inclusion fence.
+    bool build(const std::vector<FencePolygon> &polygons);
+
+    bool empty() const { return _polygons.empty(); }
+    size_t polygon_count() const { return _polygons.size(); }
+    size_t edge_count() const { return _edges.size(); }
+
+    // The legs from the start through all items of the mission, in order. The start altitude is
+    // above home like those of the items. At most one violation per leg and polygon.
+    std::vector<FenceViolation> check_mission(double start_latitude_deg,
+                                              double start_longitude_deg,
+                                              float start_altitude_m,
+                                              const MissionBuilder &mission) const;
+
+    // One leg at relative altitudes, its violations refer to item 0.
+    std::vector<FenceViolation> check_leg(const mavsdk::Telemetry::Position &from,
+                                          const mavsdk::Telemetry::Position &to) const;
+
+private:
+    struct Waypoint {
+        double north_m;
+        double east_m;
+        float altitude_m;
+    };
+
+    struct Edge {
+        double north0_m;
+        double east0_m;
+        double north1_m;
+        double east1_m;
+        uint32_t polygon;
+    };
+
+    struct Polygon {
+        FenceKind kind;
+        float altitude_m;
+        size_t first_edge;
+        size_t edge_count;
+    };
+
+    Waypoint to_local(double latitude_deg, double longitude_deg, float altitude_m) const;
+    std::vector<FenceViolation> check_path(const std::vector<Waypoint> &path) const;
+
+    // Ray casting over all edges of the polygon, only needed for the start and after a leg
+    // touched an edge.
+    bool contains(size_t polygon, double north_m, double east_m) const;
+
+    // Every cell a segment may touch, a few more near cell borders but never fewer.
+    void cells_along(double north0_m, double east0_m, double north1_m, double east1_m,
+                     std::vector<size_t> &cells) const;
+
+    double _origin_latitude_deg;
+    double _origin_longitude_deg;
+    std::vector<Polygon> _polygons;
+    std::vector<Edge> _edges;
+    size_t _fence; // index of the inclusion polygon, the polygon count if there is none
+
+    double _min_north_m;
+    double _min_east_m;
+    double _cell_size_m;
+    size_t _rows;
+    size_t _columns;
+    // The edges of cell i are _cell_edges[_cell_start[i]] up to _cell_edges[_cell_start[i + 1]].
+    std::vector<uint32_t> _cell_start;
+    std::vector<uint32_t> _cell_edges;
+};
+
+// Appends the polygons of a file with one polygon per line,
+//   fence|zone altitude_m|- lat,lon lat,lon lat,lon ...
+// where '-' means no altitude limit. Empty lines and lines starting with '#' are skipped.
+bool load_geofence(const std::string &path, std::vector<FencePolygon> &polygons);
+
+// Lists the first max_listed violations and how many there are.
+void print_fence_violations(const std::vector<FenceViolation> &violations, size_t max_listed = 20);
@@ -0,0 +1,279 @@
+#include "log_downloader.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "log_sink.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+namespace {
+
+// Bytes per LOG_DATA message.
+const uint32_t chunk_size = 90;
+
+// Bytes requested at once. Large enough to keep the link busy, small enough that a lost
+// request doesn't cost much.
+const uint32_t window_size = chunk_size * 512;
+
+// Without any chunk in order for this long, the window is requested again.
+const milliseconds stall_timeout(500);
+
+// After a gap, wait this long before asking again, the rest of the old window is still
+// arriving out of order.
+const milliseconds gap_holdoff(100);
+
+// Give up after this many re-requests in a row without progress.
+const unsigned max_rerequests_without_progress = 20;
+
+} // namespace
+
+LogDownloader::LogDownloader(MavlinkPassthrough &passthrough) :
+    _passthrough(passthrough),
+    _shared(std::make_shared<Shared>())
+{
+    _shared->expected_entries = 0;
+    _shared->list_received = false;
+
+    std::shared_ptr<Shared> shared = _shared;
+
+    _passthrough.subscribe_message_async(MAVLINK_MSG_ID_LOG_ENTRY, [shared](const mavlink_message_t &message) {
+        if (!shared->active) {
+            return;
+        }
+        mavlink_log_entry_t log_entry;
+        mavlink_msg_log_entry_decode(&message, &log_entry);
+        {
+            std::lock_guard<std::mutex> lock(shared->entries_mutex);
+            shared->expected_entries = log_entry.num_logs;
+            shared->list_received = true;
+            if (log_entry.num_logs > 0) {
+                LogEntry entry = {log_entry.id, log_entry.time_utc, log_entry.size};
+                shared->entries.push_back(entry);
+            }
+        }
+        shared->waiter.notify();
+    });
+
+    _passthrough.subscribe_message_async(MAVLINK_MSG_ID_LOG_DATA, [shared](const mavlink_message_t &message) {
+        if (!shared->active) {
+            return;
+        }
+        mavlink_log_data_t chunk;
+        mavlink_msg_log_data_decode(&message, &chunk);
+        if (!shared->chunks.try_push(chunk)) {
+            shared->dropped_chunks++;
+        }
+        shared->waiter.notify();
+    });
+}
+
+LogDownloader::~LogDownloader()
+{
+    _shared->active = false;
+}
+
+bool LogDownloader::list_entries(std::vector<LogEntry> &entries, milliseconds timeout)
+{
+    {
+        std::lock_guard<std::mutex> lock(_shared->entries_mutex);
+        _shared->entries.clear();
+        _shared->expected_entries = 0;
+        _shared->list_received = false;
+    }
+
+    mavlink_message_t message;
+    mavlink_msg_log_request_list_pack(_passthrough.get_our_sysid(),
+                                      _passthrough.get_our_compid(),
+                                      &message,
+                                      _passthrough.get_target_sysid(),
+                                      _passthrough.get_target_compid(),
+                                      0,
+                                      0xffff);
+    _passthrough.send_message(message);
+
+    std::shared_ptr<Shared> shared = _shared;
+    const WaitResult result = _shared->waiter.wait_until(
+        [shared]() {
+            std::lock_guard<std::mutex> lock(shared->entries_mutex);
+            return shared->list_received && shared->entries.size() >= shared->expected_entries;
+        },
+        timeout);
+
+    std::lock_guard<std::mutex> lock(_shared->entries_mutex);
+    entries = _shared->entries;
+    std::sort(entries.begin(), entries.end(), [](const LogEntry &a, const LogEntry &b) { return a.id < b.id; });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const LogEntry &a, const LogEntry &b) { return a.id == b.id; }),
+                  entries.end());
+
+    if (!result.satisfied) {
+        log_error() << "Log list incomplete, got " << entries.size() << " of "
+                    << _shared->expected_entries << " entries";
+    }
+    return result.satisfied;
+}
+
+void LogDownloader::request_data(uint16_t id, uint32_t offset, uint32_t count)
+{
+    mavlink_message_t message;
+    mavlink_msg_log_request_data_pack(_passthrough.get_our_sysid(),
+                                      _passthrough.get_our_compid(),
+                                      &message,
+                                      _passthrough.get_target_sysid(),
+                                      _passthrough.get_target_compid(),
+                                      id,
+                                      offset,
+                                      count);
+    _passthrough.send_message(message);
+}
+
+LogDownloadResult LogDownloader::download(const LogEntry &entry, const std::string &path)
+{
+    LogDownloadResult result = {entry.id, false, path, 0, 0, 0, 0.0};
+    const std::string part_path = path + ".part";
+
+    std::FILE *file = std::fopen(part_path.c_str(), "ab");
+    if (!file) {
+        log_error() << "Cannot open " << part_path;
+        return result;
+    }
+    std::fseek(file, 0, SEEK_END);
+    uint32_t offset = static_cast<uint32_t>(std::max(0L, std::ftell(file)));
+    if (offset > entry.size_bytes) {
+        // Not the log we think it is, start over.
+        std::fclose(file);
+        file = std::fopen(part_path.c_str(), "wb");
+        if (!file) {
+            return result;
+        }
+        offset = 0;
+    }
+    result.resumed_from = offset;
+
+    // Leftovers of an earlier download must not be taken for our data.
+    mavlink_log_data_t chunk;
+    while (_shared->chunks.try_pop(chunk)) {
+    }
+
+    const auto start = steady_clock::now();
+    auto last_progress = start;
+    auto last_request = start;
+    unsigned rerequests_without_progress = 0;
+
+    if (offset < entry.size_bytes) {
+        request_data(entry.id, offset, window_size);
+    }
+    uint32_t window_end = offset + window_size;
+
+    std::shared_ptr<Shared> shared = _shared;
+    bool end_of_log = false;
+    bool write_failed = false;
+    while (offset < entry.size_bytes && !end_of_log && !write_failed) {
+        shared->waiter.wait_until([shared]() { return shared->chunks.size() > 0; }, stall_timeout);
+
+        bool gap = false;
+        while (shared->chunks.try_pop(chunk)) {
+            if (chunk.id != entry.id) {
+                continue;
+            }
+            if (chunk.count == 0) {
+                // The vehicle has no data from chunk.ofs on. Older than what we already have, it
+                // can only be a stale answer.
+                if (chunk.ofs >= offset) {
+                    end_of_log = true;
+                    break;
+                }
+            } else if (chunk.ofs == offset) {
+                // Straight to disk, stdio only buffers a few KiB.
+                if (std::fwrite(chunk.data, 1, chunk.count, file) != chunk.count) {
+                    write_failed = true;
+                    break;
+                }
+                offset += chunk.count;
+                result.bytes += chunk.count;
+                last_progress = steady_clock::now();
+                rerequests_without_progress = 0;
+            } else if (chunk.ofs > offset) {
+                gap = true;
+            }
+        }
+
+        if (write_failed) {
+            break;
+        }
+        if (offset >= entry.size_bytes) {
+            break;
+        }
+        if (end_of_log) {
+            log_error() << "Log " << entry.id << " ends at " << offset << " of " << entry.size_bytes
+                        << " bytes, truncated";
+            break;
+        }
+
+        const auto now = steady_clock::now();
+        const bool stalled = now - last_progress > stall_timeout && now - last_request > stall_timeout;
+        const bool window_done = offset >= window_end;
+
+        if (window_done) {
+            request_data(entry.id, offset, window_size);
+            window_end = offset + window_size;
+            last_request = now;
+        } else if (stalled || (gap && now - last_request > gap_holdoff)) {
+            if (++rerequests_without_progress > max_rerequests_without_progress) {
+                log_error() << "Log " << entry.id << " stalled at " << offset
+                            << " of " << entry.size_bytes << " bytes, giving up";
+                break;
+            }
+            request_data(entry.id, offset, window_size);
+            window_end = offset + window_size;
+            last_request = now;
+            result.rerequests++;
+        }
+    }
+
+    // Buffered data which cannot be written only fails here.
+    if (std::fclose(file) != 0) {
+        write_failed = true;
+    }
+    result.seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    if (write_failed) {
+        // Whatever is on disk may have a hole, so it cannot be resumed from.
+        log_error() << "Cannot write " << part_path << ", log " << entry.id << " not downloaded";
+        std::remove(part_path.c_str());
+        return result;
+    }
+    result.complete = offset >= entry.size_bytes;
+
+    if (result.complete && std::rename(part_path.c_str(), path.c_str()) != 0) {
+        log_error() << "Cannot rename " << part_path << " to " << path;
+        result.complete = false;
+    }
+    return result;
+}
+
+void LogDownloader::end_transfer()
+{
+    mavlink_message_t message;
+    mavlink_msg_log_request_end_pack(_passthrough.get_our_sysid(),
+                                     _passthrough.get_our_compid(),
+                                     &message,
+                                     _passthrough.get_target_sysid(),
+                                     _passthrough.get_target_compid());
+    _passthrough.send_message(message);
+}
+
+std::vector<LogEntry> new_log_entries(const std::vector<LogEntry> &before,
+                                      const std::vector<LogEntry> &after)
+{
+    std::vector<LogEntry> entries;
+    for (const auto &entry : after) {
+        const bool known = std::any_of(before.begin(), before.end(), [&entry](const LogEntry &old) {
+            return old.id == entry.id && old.time_utc == entry.time_utc;
+        });
+        if (!known) {
+            entries.push_back(entry);
+        }
+    }
+    return entries;
+}
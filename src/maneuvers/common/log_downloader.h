@@ -0,0 +1,88 @@
+//
+// Downloads log files from the vehicle using the MAVLink log protocol.
+//
+// Unlike LogFiles::download_log_file, the data is requested in windows from
+// an explicit offset. Chunks arriving in order are appended straight to
+// "<path>.part", a gap or a stall re-requests from the last good offset,
+// and an interrupted download continues where the .part file ends. Several
+// logs can be fetched one after the other over the same connection.
+//
+// The LOG_DATA callback only queues the chunk in a lock-free ring buffer;
+// all file I/O happens on the thread calling download().
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <plugins/mavlink_passthrough/mavlink_passthrough.h>
+
+#include "condition_waiter.h"
+#include "spsc_ring_buffer.h"
+
+struct LogEntry {
+    uint16_t id;
+    uint32_t time_utc;
+    uint32_t size_bytes;
+};
+
+struct LogDownloadResult {
+    uint16_t id;
+    bool complete;
+    std::string path;
+    uint32_t resumed_from; // bytes already on disk before this download
+    uint32_t bytes;        // bytes received by this download
+    unsigned rerequests;   // windows requested again after a gap or stall
+    double seconds;
+
+    double throughput_kib_s() const { return seconds > 0.0 ? bytes / 1024.0 / seconds : 0.0; }
+};
+
+class LogDownloader {
+public:
+    explicit LogDownloader(mavsdk::MavlinkPassthrough &passthrough);
+    ~LogDownloader();
+
+    // Asks the vehicle for its list of logs.
+    bool list_entries(std::vector<LogEntry> &entries,
+                      std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    // Downloads one log to path, continuing from path + ".part" if it exists.
+    LogDownloadResult download(const LogEntry &entry, const std::string &path);
+
+    // Tells the vehicle the transfer is over, so it can resume normal logging.
+    void end_transfer();
+
+private:
+    LogDownloader(const LogDownloader &) = delete;
+    LogDownloader &operator=(const LogDownloader &) = delete;
+
+    // Shared with the SDK callbacks, which can't be unsubscribed and may outlive us.
+    struct Shared {
+        Shared() : active(true), chunks(8192), dropped_chunks(0) {}
+        std::atomic<bool> active;
+        SpscRingBuffer<mavlink_log_data_t> chunks;
+        std::atomic<uint32_t> dropped_chunks;
+        ConditionWaiter waiter;
+
+        std::mutex entries_mutex;
+        std::vector<LogEntry> entries;
+        uint16_t expected_entries;
+        bool list_received;
+    };
+
+    void request_data(uint16_t id, uint32_t offset, uint32_t count);
+
+    mavsdk::MavlinkPassthrough &_passthrough;
+    std::shared_ptr<Shared> _shared;
+};
+
+// Entries of after which were not in before, i.e. the logs written in between.
+std::vector<LogEntry> new_log_entries(const std::vector<LogEntry> &before,
+                                      const std::vector<LogEntry> &after);
@@ -0,0 +1,335 @@
+#include "log_sink.h"
+
+#include <cstring>
+
+#include "console.h"
+
+using namespace std::chrono;
+
+namespace {
+
+// How long the writer sleeps when the queue is empty, which bounds the latency of a line.
+const milliseconds writer_idle_time(10);
+
+// Telemetry lines seen recently, more are forgotten.
+const size_t max_repeat_keys = 256;
+
+// Hash of a line without its numbers, so "height: 10.2" and "height: 10.4" are the same.
+uint64_t repeat_key(const char *text, size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; ++i) {
+        const char c = text[i];
+        if ((c >= '0' && c <= '9') || c == '.' || c == '-') {
+            continue;
+        }
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Fixed buffer the text of a LogLine is rendered into. Output beyond it is dropped.
+class LineStreambuf : public std::streambuf {
+public:
+    LineStreambuf() :
+        _truncated(false)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        setp(_text, _text + LogSink::max_line_length);
+        _truncated = false;
+    }
+
+    const char *text() const { return pbase(); }
+    size_t length() const { return pptr() - pbase(); }
+    bool truncated() const { return _truncated; }
+
+    // Marks a cut line.
+    void mark_truncated() { std::memcpy(_text + LogSink::max_line_length - 3, "...", 3); }
+
+protected:
+    int_type overflow(int_type) override
+    {
+        _truncated = true;
+        return traits_type::eof();
+    }
+
+private:
+    char _text[LogSink::max_line_length];
+    bool _truncated;
+};
+
+} // namespace
+
+const size_t LogSink::max_line_length;
+
+struct LogSink::Slot {
+    std::atomic<uint64_t> sequence;
+    steady_clock::time_point time;
+    LogLevel level;
+    uint16_t length;
+    char text[max_line_length];
+};
+
+LogSink::LogSink(FILE *output, size_t capacity, milliseconds telemetry_interval) :
+    _output(output),
+    _telemetry_interval(telemetry_interval),
+    _mask([capacity]() {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        return size - 1;
+    }()),
+    _slots(new Slot[_mask + 1]),
+    _push_position(0),
+    _written_position(0),
+    _written(0),
+    _dropped(0),
+    _suppressed(0),
+    _running(true),
+    _dropped_reported(0)
+{
+    // A slot is free for position p when its sequence is p, and holds the line of p at p + 1.
+    for (size_t i = 0; i <= _mask; ++i) {
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _writer = std::thread(&LogSink::write_loop, this);
+}
+
+LogSink::~LogSink()
+{
+    _running = false;
+    _writer.join();
+}
+
+bool LogSink::push(LogLevel level, const char *text, size_t length)
+{
+    // Claim the next free slot, or give up if the writer has not freed it yet.
+    uint64_t position = _push_position.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &_slots[position & _mask];
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const int64_t difference = static_cast<int64_t>(sequence - position);
+        if (difference == 0) {
+            if (_push_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            position = _push_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time = steady_clock::now();
+    slot->level = level;
+    slot->length = static_cast<uint16_t>(length < max_line_length ? length : max_line_length);
+    std::memcpy(slot->text, text, slot->length);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+void LogSink::flush()
+{
+    const uint64_t pushed = _push_position.load(std::memory_order_acquire);
+    while (_written_position.load(std::memory_order_acquire) < pushed) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    std::fflush(_output);
+}
+
+LogSink::Stats LogSink::stats() const
+{
+    Stats stats;
+    stats.written = _written.load();
+    stats.dropped = _dropped.load();
+    stats.suppressed = _suppressed.load();
+    return stats;
+}
+
+void LogSink::write_loop()
+{
+    for (;;) {
+        // Read before writing, so everything pushed before the destructor is written.
+        const bool running = _running;
+        if (write_queued() == 0) {
+            std::fflush(_output);
+            if (!running) {
+                return;
+            }
+            std::this_thread::sleep_for(writer_idle_time);
+        }
+    }
+}
+
+size_t LogSink::write_queued()
+{
+    size_t count = 0;
+    uint64_t position = _written_position.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = _slots[position & _mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            break;
+        }
+        write_line(slot);
+        slot.sequence.store(position + _mask + 1, std::memory_order_release);
+        ++position;
+        ++count;
+        _written_position.store(position, std::memory_order_release);
+    }
+
+    const uint64_t dropped = _dropped.load(std::memory_order_relaxed);
+    if (dropped != _dropped_reported) {
+        std::fprintf(_output, ERROR_CONSOLE_TEXT "%llu log lines dropped" NORMAL_CONSOLE_TEXT "\n",
+                     static_cast<unsigned long long>(dropped - _dropped_reported));
+        _dropped_reported = dropped;
+    }
+    return count;
+}
+
+void LogSink::write_line(const Slot &slot)
+{
+    size_t length = slot.length;
+    if (length > 0 && slot.text[length - 1] == '\n') {
+        --length;
+    }
+
+    uint64_t suppressed = 0;
+    if (slot.level == LogLevel::TELEMETRY) {
+        if (_repeats.size() > max_repeat_keys) {
+            _repeats.clear();
+        }
+        const uint64_t key = repeat_key(slot.text, length);
+        auto found = _repeats.find(key);
+        if (found != _repeats.end() && slot.time - found->second.last_written < _telemetry_interval) {
+            ++found->second.suppressed;
+            _suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (found != _repeats.end()) {
+            suppressed = found->second.suppressed;
+        }
+        Repeats &repeats = _repeats[key];
+        repeats.last_written = slot.time;
+        repeats.suppressed = 0;
+    }
+
+    switch (slot.level) {
+        case LogLevel::INFO:
+            break;
+        case LogLevel::TELEMETRY:
+            std::fputs(TELEMETRY_CONSOLE_TEXT, _output);
+            break;
+        case LogLevel::ERROR:
+            std::fputs(ERROR_CONSOLE_TEXT, _output);
+            break;
+    }
+    std::fwrite(slot.text, 1, length, _output);
+    if (suppressed > 0) {
+        std::fprintf(_output, " (%llu similar lines left out)", static_cast<unsigned long long>(suppressed));
+    }
+    if (slot.level != LogLevel::INFO) {
+        std::fputs(NORMAL_CONSOLE_TEXT, _output);
+    }
+    std::fputc('\n', _output);
+    _written.fetch_add(1, std::memory_order_relaxed);
+}
+
+LogSink &log_sink()
+{
+    static LogSink sink;
+    return sink;
+}
+
+// Rendering buffer of one thread. A line started while another is still open on the same
+// thread gets a buffer of its own.
+struct LogLine::Buffer {
+    Buffer() :
+        stream(&streambuf),
+        in_use(false)
+    {
+        default_flags = stream.flags();
+    }
+
+    void reset()
+    {
+        streambuf.reset();
+        stream.clear();
+        stream.flags(default_flags);
+        stream.precision(6);
+        stream.width(0);
+        stream.fill(' ');
+    }
+
+    LineStreambuf streambuf;
+    std::ostream stream;
+    std::ios_base::fmtflags default_flags;
+    bool in_use;
+};
+
+LogLine::LogLine(LogSink &sink, LogLevel level) :
+    _sink(&sink),
+    _level(level),
+    _owns_buffer(false)
+{
+    // Lives as long as the thread, one per thread which logs.
+    static thread_local Buffer thread_buffer;
+    if (thread_buffer.in_use) {
+        _buffer = new Buffer();
+        _owns_buffer = true;
+    } else {
+        _buffer = &thread_buffer;
+    }
+    _buffer->in_use = true;
+    _stream = &_buffer->stream;
+}
+
+LogLine::LogLine(LogLine &&other) :
+    _sink(other._sink),
+    _level(other._level),
+    _buffer(other._buffer),
+    _stream(other._stream),
+    _owns_buffer(other._owns_buffer)
+{
+    other._buffer = nullptr;
+    other._owns_buffer = false;
+}
+
+LogLine::~LogLine()
+{
+    if (!_buffer) {
+        return;
+    }
+    if (_buffer->streambuf.truncated()) {
+        _buffer->streambuf.mark_truncated();
+    }
+    _sink->push(_level, _buffer->streambuf.text(), _buffer->streambuf.length());
+    if (_owns_buffer) {
+        delete _buffer;
+        return;
+    }
+    _buffer->reset();
+    _buffer->in_use = false;
+}
+
+LogLine log_info()
+{
+    return LogLine(log_sink(), LogLevel::INFO);
+}
+
+LogLine log_telemetry()
+{
+    return LogLine(log_sink(), LogLevel::TELEMETRY);
+}
+
+LogLine log_error()
+{
+    return LogLine(log_sink(), LogLevel::ERROR);
+}
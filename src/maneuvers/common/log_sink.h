@@ -0,0 +1,129 @@
+//
+// Asynchronous console output shared by the maneuvers.
+//
+// std::cout << ... << std::endl writes and flushes on the calling thread,
+// which is often an SDK callback thread. A LogLine is rendered into a buffer
+// of its thread instead and copied into a slot of a bounded lock-free queue
+// when it goes out of scope:
+//   log_info() << "Taking off to " << altitude << " m";
+// A background thread colours the lines by level and writes them, flushing
+// only when the queue runs empty. If the queue is full, lines are dropped
+// and counted rather than blocking the caller, and the writer reports how
+// many. Telemetry lines which only differ in their numbers are written at
+// most once per telemetry interval, the next one says how many were left
+// out. Lines longer than LogSink::max_line_length are cut.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+
+enum class LogLevel { INFO, TELEMETRY, ERROR };
+
+class LogSink {
+public:
+    static const size_t max_line_length = 224;
+
+    struct Stats {
+        uint64_t written;
+        uint64_t dropped; // queue full
+        uint64_t suppressed; // repeated telemetry
+    };
+
+    // capacity is rounded up to a power of two.
+    explicit LogSink(FILE *output = stdout,
+                     size_t capacity = 1024,
+                     std::chrono::milliseconds telemetry_interval = std::chrono::seconds(1));
+
+    // Writes all lines still queued.
+    ~LogSink();
+
+    // Queues one line, false if it was dropped. Never blocks.
+    bool push(LogLevel level, const char *text, size_t length);
+
+    // Waits until all lines pushed so far are written, e.g. before printing with std::cout.
+    void flush();
+
+    Stats stats() const;
+
+private:
+    LogSink(const LogSink &) = delete;
+    LogSink &operator=(const LogSink &) = delete;
+
+    struct Slot;
+
+    struct Repeats {
+        std::chrono::steady_clock::time_point last_written;
+        uint64_t suppressed;
+    };
+
+    void write_loop();
+    size_t write_queued();
+    void write_line(const Slot &slot);
+
+    FILE *const _output;
+    const std::chrono::steady_clock::duration _telemetry_interval;
+    const size_t _mask;
+    std::unique_ptr<Slot[]> _slots;
+    std::atomic<uint64_t> _push_position;
+    std::atomic<uint64_t> _written_position;
+    std::atomic<uint64_t> _written;
+    std::atomic<uint64_t> _dropped;
+    std::atomic<uint64_t> _suppressed;
+    std::atomic<bool> _running;
+
+    // Only used by the writer.
+    std::unordered_map<uint64_t, Repeats> _repeats;
+    uint64_t _dropped_reported;
+
+    std::thread _writer;
+};
+
+// The sink of the process, writing to stdout. Queued lines are written at exit.
+LogSink &log_sink();
+
+// One line, pushed to the sink when it goes out of scope. Takes anything an std::ostream takes.
+class LogLine {
+public:
+    LogLine(LogSink &sink, LogLevel level);
+    LogLine(LogLine &&other);
+    ~LogLine();
+
+    template<typename T>
+    LogLine &operator<<(const T &value)
+    {
+        *_stream << value;
+        return *this;
+    }
+
+    // For manipulators such as std::endl, a trailing newline is dropped.
+    LogLine &operator<<(std::ostream &(*manipulator)(std::ostream &))
+    {
+        *_stream << manipulator;
+        return *this;
+    }
+
+private:
+    LogLine(const LogLine &) = delete;
+    LogLine &operator=(const LogLine &) = delete;
+
+    struct Buffer;
+
+    LogSink *_sink;
+    LogLevel _level;
+    Buffer *_buffer;
+    std::ostream *_stream;
+    bool _owns_buffer;
+};
+
+LogLine log_info();
+LogLine log_telemetry();
+LogLine log_error();
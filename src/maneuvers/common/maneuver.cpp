@@ -0,0 +1,238 @@
+#include "maneuver.h"
+
+Maneuver::Maneuver(const std::string &name, Autopilot &autopilot, EventLoop &loop) :
+    _name(name),
+    _autopilot(autopilot),
+    _loop(loop),
+    _rate_scheduler(nullptr),
+    _running(false),
+    _failed(false),
+    _next_step(0),
+    _generation(0),
+    _wait({false, 0, nullptr, Clock::time_point(), nullptr}),
+    _update_listener(0),
+    _evaluate_pending(false)
+{}
+
+void Maneuver::then(const std::string &description, step_t step)
+{
+    _steps.push_back({description, step});
+}
+
+void Maneuver::on_failure(const std::string &description, step_t step)
+{
+    _failure_steps.push_back({description, step});
+}
+
+void Maneuver::abort_if(const std::string &reason, condition_t condition)
+{
+    _abort_conditions.push_back(std::make_pair(reason, condition));
+}
+
+void Maneuver::start(finished_t finished)
+{
+    _finished = finished;
+
+    auto self = shared_from_this();
+    _loop.post([self]() {
+        // Weak, the monitor may outlive the maneuver.
+        std::weak_ptr<Maneuver> weak_self = self;
+        self->_update_listener = self->monitor().add_update_listener([weak_self]() {
+            auto maneuver = weak_self.lock();
+            if (maneuver) {
+                maneuver->notify();
+            }
+        });
+        self->_running = true;
+        self->run_next_step();
+        self->evaluate();
+    });
+}
+
+void Maneuver::abort(const std::string &reason)
+{
+    auto self = shared_from_this();
+    _loop.post([self, reason]() {
+        if (!self->_running) {
+            return;
+        }
+        self->log(LogLevel::ERROR) << "Aborted: " << reason;
+        self->finish(Result::ABORTED);
+    });
+}
+
+void Maneuver::wait_until(condition_t condition, std::chrono::milliseconds timeout, wait_done_t done)
+{
+    const unsigned id = ++_wait.id;
+    _wait.active = true;
+    _wait.condition = condition;
+    _wait.start = _autopilot.clock().now();
+    _wait.done = done;
+
+    auto self = shared_from_this();
+    _loop.post_after(_autopilot.clock().to_real(timeout), [self, id]() {
+        if (self->_wait.active && self->_wait.id == id) {
+            self->finish_wait(false);
+        }
+    });
+
+    // The condition may already hold, without any telemetry to come.
+    notify();
+}
+
+void Maneuver::on_step_end(std::function<void()> cleanup)
+{
+    _step_cleanup.push_back(cleanup);
+}
+
+void Maneuver::notify()
+{
+    // Telemetry arrives much faster than the loop needs to look at it, one pending
+    // evaluation is enough.
+    if (_evaluate_pending.exchange(true)) {
+        return;
+    }
+    auto self = shared_from_this();
+    _loop.post([self]() {
+        self->_evaluate_pending = false;
+        self->evaluate();
+    });
+}
+
+void Maneuver::enter_flight_phase(FlightPhase phase)
+{
+    if (!_rate_scheduler || _rate_scheduler->phase() == phase) {
+        return;
+    }
+    // The vehicle confirms the rates later, the outcome is reported back on the loop.
+    auto self = shared_from_this();
+    _rate_scheduler->enter_async(phase, [self, phase](mavsdk::Telemetry::Result result) {
+        if (result == mavsdk::Telemetry::Result::SUCCESS) {
+            return;
+        }
+        self->_loop.post([self, phase, result]() {
+            self->log(LogLevel::ERROR) << "Setting rates for " << flight_phase_str(phase)
+                                       << " failed:" << mavsdk::Telemetry::result_str(result);
+        });
+    });
+}
+
+LogLine Maneuver::log(LogLevel level)
+{
+    LogLine line(log_sink(), level);
+    if (!_name.empty()) {
+        line << "[" << _name << "] ";
+    }
+    return line;
+}
+
+void Maneuver::end_step()
+{
+    ++_generation;
+    _wait.active = false;
+    _wait.done = nullptr;
+    _wait.condition = nullptr;
+
+    std::vector<std::function<void()>> cleanup;
+    cleanup.swap(_step_cleanup);
+    for (const auto &function : cleanup) {
+        function();
+    }
+}
+
+void Maneuver::run_next_step()
+{
+    end_step();
+
+    const std::vector<Step> &steps = _failed ? _failure_steps : _steps;
+    if (_next_step >= steps.size()) {
+        finish(_failed ? Result::FAILED : Result::SUCCEEDED);
+        return;
+    }
+    const Step &step = steps[_next_step++];
+
+    auto self = shared_from_this();
+    const unsigned generation = _generation;
+    step.step(*this, [self, generation](bool success) {
+        self->_loop.post([self, generation, success]() { self->step_done(generation, success); });
+    });
+}
+
+void Maneuver::step_done(unsigned generation, bool success)
+{
+    if (!_running || generation != _generation) {
+        return;
+    }
+    if (success) {
+        run_next_step();
+        return;
+    }
+
+    const std::vector<Step> &steps = _failed ? _failure_steps : _steps;
+    log(LogLevel::ERROR) << "Step failed: " << steps[_next_step - 1].description;
+    if (_failed) {
+        finish(Result::FAILED);
+        return;
+    }
+    _failed = true;
+    _next_step = 0;
+    run_next_step();
+}
+
+void Maneuver::evaluate()
+{
+    if (!_running) {
+        return;
+    }
+    for (const auto &abort_condition : _abort_conditions) {
+        if (abort_condition.second()) {
+            log(LogLevel::ERROR) << "Aborted: " << abort_condition.first;
+            finish(Result::ABORTED);
+            return;
+        }
+    }
+    if (_wait.active && _wait.condition()) {
+        finish_wait(true);
+    }
+}
+
+void Maneuver::finish_wait(bool satisfied)
+{
+    // The callback usually starts the next wait, so take everything out of _wait first.
+    const wait_done_t done = std::move(_wait.done);
+    const double elapsed_s = _autopilot.clock().seconds_since(_wait.start);
+    _wait.active = false;
+    _wait.done = nullptr;
+    _wait.condition = nullptr;
+    done(satisfied, elapsed_s);
+}
+
+void Maneuver::finish(Result result)
+{
+    _running = false;
+    end_step();
+    monitor().remove_listener(_update_listener);
+
+    if (_finished) {
+        _finished(result);
+    }
+}
+
+const char *maneuver_result_str(Maneuver::Result result)
+{
+    switch (result) {
+        case Maneuver::Result::SUCCEEDED:
+            return "succeeded";
+        case Maneuver::Result::FAILED:
+            return "failed";
+        case Maneuver::Result::ABORTED:
+            return "aborted";
+    }
+    return "unknown";
+}
+
+std::chrono::milliseconds remaining_timeout(std::chrono::milliseconds timeout, double elapsed_s)
+{
+    const std::chrono::milliseconds elapsed(static_cast<int64_t>(elapsed_s * 1000.0));
+    return elapsed < timeout ? timeout - elapsed : std::chrono::milliseconds(0);
+}
@@ -0,0 +1,153 @@
+//
+// Maneuvers as non-blocking state machines on an EventLoop.
+//
+// A maneuver is a list of steps. A step sends a command through the
+// asynchronous Autopilot functions and waits for its effect with
+// wait_until(), then reports success or failure through its done callback.
+// Command results and telemetry updates are posted into the loop, where the
+// step continues, so nothing blocks and one loop drives the maneuvers of
+// any number of vehicles. Abort conditions are checked on every telemetry
+// update while the maneuver runs, not only between commands.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "autopilot.h"
+#include "event_loop.h"
+#include "log_sink.h"
+#include "rate_scheduler.h"
+#include "telemetry_monitor.h"
+
+class Maneuver : public std::enable_shared_from_this<Maneuver> {
+public:
+    enum class Result { SUCCEEDED, FAILED, ABORTED };
+
+    // Can be called from any thread, exactly once per step.
+    typedef std::function<void(bool success)> done_t;
+    typedef std::function<void(Maneuver &maneuver, done_t done)> step_t;
+    typedef std::function<bool()> condition_t;
+    typedef std::function<void(bool satisfied, double elapsed_s)> wait_done_t;
+    typedef std::function<void(Result result)> finished_t;
+
+    // Log lines are prefixed with the name unless it is empty.
+    Maneuver(const std::string &name, Autopilot &autopilot, EventLoop &loop);
+
+    // Steps run one after the other, the maneuver fails at the first step that fails.
+    void then(const std::string &description, step_t step);
+
+    // Run after a step failed (not after an abort), e.g. to bring the vehicle home.
+    void on_failure(const std::string &description, step_t step);
+
+    // Aborts the maneuver as soon as condition() holds.
+    void abort_if(const std::string &reason, condition_t condition);
+
+    // finished is called on the loop thread.
+    void start(finished_t finished);
+
+    // Can be called from any thread. The current step is abandoned and no other step runs.
+    void abort(const std::string &reason);
+
+    // For steps: calls done(true, ...) on the loop thread once condition() holds, or
+    // done(false, ...) when the timeout on the clock of the autopilot has passed. The condition
+    // is checked on every telemetry update and on notify().
+    void wait_until(condition_t condition, std::chrono::milliseconds timeout, wait_done_t done);
+
+    // For steps: runs on the loop thread once the current step is over, however it ended, e.g.
+    // to remove listeners.
+    void on_step_end(std::function<void()> cleanup);
+
+    // For steps: wraps a command callback so it runs on the loop thread, and not at all once the
+    // step is over.
+    template<typename T>
+    std::function<void(T)> in_step(std::function<void(T)> callback);
+
+    // Checks the conditions again, for state which does not come with telemetry.
+    void notify();
+
+    // The telemetry rates follow the flight phases the steps enter. Without a scheduler
+    // (the default) entering a phase does nothing. The scheduler has to outlive the maneuver.
+    void set_rate_scheduler(RateScheduler *scheduler) { _rate_scheduler = scheduler; }
+
+    // For steps, on the loop thread: changes the rates without waiting for the vehicle, a failure
+    // is logged once it confirms. Not from a wait_until() condition, which only observes.
+    void enter_flight_phase(FlightPhase phase);
+
+    const std::string &name() const { return _name; }
+    Autopilot &autopilot() { return _autopilot; }
+    TelemetryMonitor &monitor() { return _autopilot.monitor(); }
+    EventLoop &loop() { return _loop; }
+
+    // A line of the sink, prefixed with the name.
+    LogLine log(LogLevel level = LogLevel::INFO);
+
+private:
+    Maneuver(const Maneuver &) = delete;
+    Maneuver &operator=(const Maneuver &) = delete;
+
+    struct Step {
+        std::string description;
+        step_t step;
+    };
+
+    struct Wait {
+        bool active;
+        unsigned id;
+        condition_t condition;
+        Clock::time_point start;
+        wait_done_t done;
+    };
+
+    void end_step();
+    void run_next_step();
+    void step_done(unsigned generation, bool success);
+    void evaluate();
+    void finish_wait(bool satisfied);
+    void finish(Result result);
+
+    const std::string _name;
+    Autopilot &_autopilot;
+    EventLoop &_loop;
+    RateScheduler *_rate_scheduler;
+
+    std::vector<Step> _steps;
+    std::vector<Step> _failure_steps;
+    std::vector<std::pair<std::string, condition_t>> _abort_conditions;
+    finished_t _finished;
+
+    // Only touched on the loop thread.
+    bool _running;
+    bool _failed;
+    size_t _next_step;
+    unsigned _generation; // changes whenever the current step does, so stale results are dropped
+    Wait _wait;
+    std::vector<std::function<void()>> _step_cleanup;
+    TelemetryMonitor::listener_handle_t _update_listener;
+
+    std::atomic<bool> _evaluate_pending;
+};
+
+template<typename T>
+std::function<void(T)> Maneuver::in_step(std::function<void(T)> callback)
+{
+    auto self = shared_from_this();
+    const unsigned generation = _generation;
+    return [self, generation, callback](T value) {
+        self->_loop.post([self, generation, callback, value]() {
+            if (self->_running && self->_generation == generation) {
+                callback(value);
+            }
+        });
+    };
+}
+
+const char *maneuver_result_str(Maneuver::Result result);
+
+// For steps which wait in stages: what is left of timeout after the elapsed_s of the stages before.
+std::chrono::milliseconds remaining_timeout(std::chrono::milliseconds timeout, double elapsed_s);
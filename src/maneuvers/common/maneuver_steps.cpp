@@ -0,0 +1,244 @@
+#include "maneuver_steps.h"
+
+#include <memory>
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+// The last part of an RTL descent, from this height above home on, is watched at the rates of the
+// descent phase.
+const float descent_phase_height_m = 10.0f;
+
+Maneuver::step_t ready_step()
+{
+    return [](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        TelemetryMonitor *monitor = &maneuver.monitor();
+
+        maneuver.enter_flight_phase(FlightPhase::GROUND);
+
+        // Check if vehicle is ready to arm
+        maneuver.log() << "Vehicle is getting ready to arm";
+        maneuver.wait_until([monitor]() { return monitor->health_all_ok(); }, minutes(2),
+                            [m, done](bool ready, double elapsed_s) {
+            if (!ready) {
+                m->log(LogLevel::ERROR) << "Vehicle not ready to arm after " << elapsed_s << " s";
+            } else {
+                m->log() << "Vehicle ready to arm after " << elapsed_s << " s";
+            }
+            done(ready);
+        });
+    };
+}
+
+Maneuver::step_t arm_step(PhaseStats *phases)
+{
+    return [phases](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        TelemetryMonitor *monitor = &maneuver.monitor();
+
+        maneuver.log() << "Arming...";
+        auto timer = std::make_shared<PhaseTimer>(phases, "arm", maneuver.autopilot().clock());
+        maneuver.autopilot().arm_async(m->in_step<Action::Result>([m, monitor, timer, done](Action::Result result) {
+            timer->acked(result == Action::Result::SUCCESS);
+            if (result != Action::Result::SUCCESS) {
+                m->log(LogLevel::ERROR) << "Arming failed:" << Action::result_str(result);
+                done(false);
+                return;
+            }
+            m->wait_until([monitor]() { return monitor->armed(); }, seconds(10),
+                          [timer, done](bool armed, double) {
+                timer->completed(armed);
+                done(armed);
+            });
+        }));
+    };
+}
+
+Maneuver::step_t takeoff_step(PhaseStats *phases)
+{
+    return [phases](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        TelemetryMonitor *monitor = &maneuver.monitor();
+
+        typedef std::pair<Action::Result, float> altitude_t;
+        maneuver.autopilot().get_takeoff_altitude_async(m->in_step<altitude_t>([m, monitor, phases, done](altitude_t altitude) {
+            const float takeoff_altitude = altitude.second;
+            m->log() << "Taking off to height " << takeoff_altitude << " meters";
+
+            m->enter_flight_phase(FlightPhase::TAKEOFF);
+            auto timer = std::make_shared<PhaseTimer>(phases, "takeoff", m->autopilot().clock());
+            m->autopilot().takeoff_async(m->in_step<Action::Result>([m, monitor, takeoff_altitude, timer, done](Action::Result result) {
+                timer->acked(result == Action::Result::SUCCESS);
+                if (result != Action::Result::SUCCESS) {
+                    m->log(LogLevel::ERROR) << "Takeoff failed:" << Action::result_str(result);
+                    done(false);
+                    return;
+                }
+
+                // wait until drone has reached takeoff height
+                m->wait_until(
+                    [monitor, takeoff_altitude]() {
+                        return monitor->position().relative_altitude_m >= takeoff_altitude - 0.2f;
+                    },
+                    seconds(60),
+                    [m, timer, done](bool reached, double elapsed_s) {
+                        timer->completed(reached);
+                        if (!reached) {
+                            m->log(LogLevel::ERROR) << "Takeoff height not reached after " << elapsed_s << " s";
+                        } else {
+                            m->log() << "Takeoff height reached after " << elapsed_s << " s";
+                        }
+                        done(reached);
+                    });
+            }));
+        }));
+    };
+}
+
+Maneuver::step_t return_to_launch_step(PhaseStats *phases)
+{
+    return [phases](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        TelemetryMonitor *monitor = &maneuver.monitor();
+
+        maneuver.enter_flight_phase(FlightPhase::RETURN);
+        maneuver.log() << "trigger RTL";
+        auto timer = std::make_shared<PhaseTimer>(phases, "return_to_launch", maneuver.autopilot().clock());
+        maneuver.autopilot().return_to_launch_async(m->in_step<Action::Result>([m, monitor, timer, done](Action::Result result) {
+            timer->acked(result == Action::Result::SUCCESS);
+            if (result != Action::Result::SUCCESS) {
+                //RTL failed, so give up (in reality might send kill command.)
+                m->log(LogLevel::ERROR) << "RTL failed:" << Action::result_str(result);
+                done(false);
+                return;
+            }
+
+            // We are relying on auto-disarming but let's keep watching the telemetry until it is disarmed,
+            // closer once it descends towards the ground
+            const milliseconds timeout = minutes(5);
+            const auto disarmed_done = [m, timer, done](bool disarmed, double elapsed_s) {
+                timer->completed(disarmed);
+                if (!disarmed) {
+                    m->log(LogLevel::ERROR) << "Still armed " << elapsed_s << " s after RTL";
+                } else {
+                    m->enter_flight_phase(FlightPhase::GROUND);
+                    m->log() << "Disarmed after " << elapsed_s
+                             << " s, ready for next part of maneuver.";
+                }
+                done(disarmed);
+            };
+            m->wait_until(
+                [monitor]() {
+                    const TelemetrySnapshot telemetry = monitor->snapshot();
+                    return !telemetry.armed || (telemetry.ground_speed.velocity_down_m_s > 0.5f &&
+                                                telemetry.position.relative_altitude_m < descent_phase_height_m);
+                },
+                timeout,
+                [m, monitor, timeout, disarmed_done](bool satisfied, double elapsed_s) {
+                    if (!satisfied || !monitor->armed()) {
+                        disarmed_done(satisfied, elapsed_s);
+                        return;
+                    }
+                    m->enter_flight_phase(FlightPhase::DESCENT);
+                    const double descent_start_s = elapsed_s;
+                    m->wait_until([monitor]() { return !monitor->armed(); }, remaining_timeout(timeout, elapsed_s),
+                                  [descent_start_s, disarmed_done](bool disarmed, double descent_s) {
+                        disarmed_done(disarmed, descent_start_s + descent_s);
+                    });
+                });
+        }));
+    };
+}
+
+Maneuver::step_t return_home_step(PhaseStats *phases)
+{
+    const Maneuver::step_t rtl = return_to_launch_step(phases);
+    return [rtl](Maneuver &maneuver, Maneuver::done_t done) {
+        if (!maneuver.monitor().armed()) {
+            done(true);
+            return;
+        }
+        rtl(maneuver, done);
+    };
+}
+
+Maneuver::step_t fetch_params_step(ParamCache *params, const std::vector<std::string> &names)
+{
+    return [params, names](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        const std::vector<std::string> missing = params->missing(names);
+        if (missing.empty()) {
+            done(true);
+            return;
+        }
+
+        const Clock *clock = &maneuver.autopilot().clock();
+        const Clock::time_point start = clock->now();
+        typedef std::pair<Param::Result, ParamTable> params_t;
+        maneuver.autopilot().get_params_async(missing, m->in_step<params_t>([m, params, missing, clock, start, done](params_t fetched) {
+            params->store(fetched.second);
+            if (fetched.first != Param::Result::SUCCESS) {
+                LogLine line = m->log(LogLevel::ERROR);
+                line << "Fetching parameters failed:" << Param::result_str(fetched.first) << ", missing";
+                for (const auto &name : params->missing(missing)) {
+                    line << " " << name;
+                }
+                done(false);
+                return;
+            }
+            m->log() << "Fetched " << missing.size() << " parameters in "
+                     << duration_cast<duration<double>>(clock->now() - start).count() << " s";
+            done(true);
+        }));
+    };
+}
+
+Maneuver::step_t set_param_step(ParamCache *params, const std::string &name, double value)
+{
+    const Maneuver::step_t fetch = fetch_params_step(params, std::vector<std::string>(1, name));
+    return [params, name, value, fetch](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        fetch(maneuver, [m, params, name, value, done](bool fetched) {
+            ParamValue current;
+            if (!fetched || !params->get(name, current)) {
+                done(false);
+                return;
+            }
+            const ParamValue wanted = ParamValue::of_type(current.type, value);
+            if (wanted == current) {
+                done(true);
+                return;
+            }
+
+            m->autopilot().set_param_async(name, wanted, m->in_step<Param::Result>([m, params, name, wanted, done](Param::Result result) {
+                if (result != Param::Result::SUCCESS) {
+                    m->log(LogLevel::ERROR) << "Setting " << name << " failed:" << Param::result_str(result);
+                    done(false);
+                    return;
+                }
+                params->store(name, wanted);
+                m->log() << name << " set to " << wanted.as_double();
+                done(true);
+            }));
+        });
+    };
+}
+
+Maneuver::condition_t pilot_took_over(TelemetryMonitor &monitor)
+{
+    TelemetryMonitor *m = &monitor;
+    return [m]() {
+        switch (m->flight_mode()) {
+            case Telemetry::FlightMode::MANUAL:
+            case Telemetry::FlightMode::ALTCTL:
+            case Telemetry::FlightMode::POSCTL:
+            case Telemetry::FlightMode::ACRO:
+            case Telemetry::FlightMode::RATTITUDE:
+            case Telemetry::FlightMode::STABILIZED:
+                return true;
+            default:
+                return false;
+        }
+    };
+}
@@ -0,0 +1,41 @@
+//
+// Steps shared by the maneuvers, see maneuver.h.
+//
+// If phases is given, the ack and completion latency of the command of the
+// step is recorded into it.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "maneuver.h"
+#include "param_cache.h"
+#include "phase_stats.h"
+
+// Waits until the vehicle is healthy and ready to arm.
+Maneuver::step_t ready_step();
+
+// Arms the vehicle and waits until it reports being armed.
+Maneuver::step_t arm_step(PhaseStats *phases = nullptr);
+
+// Takes off and waits until the takeoff altitude is reached.
+Maneuver::step_t takeoff_step(PhaseStats *phases = nullptr);
+
+// Triggers RTL and waits until the vehicle has landed and disarmed.
+Maneuver::step_t return_to_launch_step(PhaseStats *phases = nullptr);
+
+// For Maneuver::on_failure: like return_to_launch_step, nothing to do if the vehicle is disarmed.
+Maneuver::step_t return_home_step(PhaseStats *phases = nullptr);
+
+// Fetches the parameters which are not in the cache yet, all in one batch, into the cache.
+// Fails if the vehicle did not answer for all of them.
+Maneuver::step_t fetch_params_step(ParamCache *params, const std::vector<std::string> &names);
+
+// Sets a parameter to value, converted to the type the vehicle has for it, and caches it. Only
+// fetches it first if it is not cached, and nothing is sent if it already has the value.
+Maneuver::step_t set_param_step(ParamCache *params, const std::string &name, double value);
+
+// For Maneuver::abort_if: the pilot switched to a manual mode and has the vehicle now.
+Maneuver::condition_t pilot_took_over(TelemetryMonitor &monitor);
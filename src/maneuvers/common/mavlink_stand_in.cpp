@@ -0,0 +1,267 @@
+#include "mavlink_stand_in.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <plugins/mavlink_passthrough/mavlink_passthrough.h>
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+namespace {
+
+const uint8_t stand_in_sysid = 1;
+const uint8_t stand_in_compid = 1; // MAV_COMP_ID_AUTOPILOT1
+
+// Where the simulated vehicle starts, plus the sequence number in 1e-7 degrees.
+const int32_t base_latitude_e7 = 473977420;
+const int32_t base_longitude_e7 = 85455940;
+const int32_t altitude_mm = 488000;
+
+// Keeps the north velocity within its int16 field.
+const int32_t ground_speed_offset_cm_s = MavlinkStandIn::sequence_count / 2;
+
+const double yaw_step_deg = 360.0 / MavlinkStandIn::sequence_count;
+
+uint32_t wrap_sequence(int64_t sequence)
+{
+    const int64_t count = MavlinkStandIn::sequence_count;
+    return static_cast<uint32_t>(((sequence % count) + count) % count);
+}
+
+size_t message_index(StandInMessage message)
+{
+    return message == StandInMessage::GLOBAL_POSITION_INT ? 0 : 1;
+}
+
+} // namespace
+
+MavlinkStandIn::MavlinkStandIn(int port) :
+    _port(port),
+    _fd(-1),
+    _running(false),
+    _rate_hz(0.0),
+    _rate_changed(false),
+    _missed(0),
+    _send_errors(0),
+    _sent_at(new std::atomic<int64_t>[message_kinds * sequence_count])
+{
+    for (auto &sent : _sent) {
+        sent.store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < message_kinds * sequence_count; ++i) {
+        _sent_at[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+MavlinkStandIn::~MavlinkStandIn()
+{
+    stop();
+}
+
+bool MavlinkStandIn::start()
+{
+    if (_fd >= 0) {
+        return true;
+    }
+    _fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (_fd < 0) {
+        return false;
+    }
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(_port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // Connected, so the SDK takes the ephemeral port as the vehicle's and replies there.
+    if (connect(_fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    _boot = real_clock().now();
+    _running = true;
+    _rate_changed = true;
+    _thread = std::thread(&MavlinkStandIn::run, this);
+    return true;
+}
+
+void MavlinkStandIn::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _wake.notify_one();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+void MavlinkStandIn::set_rate(double rate_hz)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rate_hz = std::max(0.0, rate_hz);
+        _rate_changed = true;
+    }
+    _wake.notify_one();
+}
+
+uint64_t MavlinkStandIn::sent(StandInMessage message) const
+{
+    return _sent[message_index(message)].load();
+}
+
+bool MavlinkStandIn::sent_at(StandInMessage message, uint32_t sequence, Clock::time_point &time) const
+{
+    if (sequence >= sequence_count) {
+        return false;
+    }
+    const int64_t ticks = _sent_at[message_index(message) * sequence_count + sequence].load(std::memory_order_acquire);
+    if (ticks == 0) {
+        return false;
+    }
+    time = Clock::time_point(Clock::duration(ticks));
+    return true;
+}
+
+uint32_t MavlinkStandIn::sequence_of(const Telemetry::Position &position)
+{
+    return wrap_sequence(std::llround(position.latitude_deg * 1e7) - base_latitude_e7);
+}
+
+uint32_t MavlinkStandIn::sequence_of(const Telemetry::GroundSpeedNED &ground_speed)
+{
+    return wrap_sequence(std::lround(ground_speed.velocity_north_m_s * 100.0) + ground_speed_offset_cm_s);
+}
+
+// The yaw is sent in the middle of its step, far from the rounding of the SDK's conversion.
+uint32_t MavlinkStandIn::sequence_of(const Telemetry::EulerAngle &attitude)
+{
+    return wrap_sequence(static_cast<int64_t>(std::floor((attitude.yaw_deg + 180.0) / yaw_step_deg)));
+}
+
+void MavlinkStandIn::run()
+{
+    const Clock &clock = real_clock();
+    Clock::time_point heartbeat_deadline = clock.now();
+    Clock::time_point stream_deadline = heartbeat_deadline;
+    Clock::duration period = Clock::duration::zero();
+    uint32_t sequence = 0;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_running) {
+        if (_rate_changed) {
+            _rate_changed = false;
+            period = _rate_hz > 0.0 ? duration_cast<Clock::duration>(duration<double>(1.0 / _rate_hz))
+                                    : Clock::duration::zero();
+            stream_deadline = clock.now();
+        }
+        const bool streaming = period > Clock::duration::zero();
+        const Clock::time_point deadline = streaming ? std::min(heartbeat_deadline, stream_deadline) : heartbeat_deadline;
+        if (_wake.wait_until(lock, deadline, [this]() { return !_running || _rate_changed; })) {
+            continue;
+        }
+        lock.unlock();
+
+        const Clock::time_point now = clock.now();
+        if (now >= heartbeat_deadline) {
+            send_heartbeat();
+            heartbeat_deadline += seconds(1);
+        }
+        if (streaming && now >= stream_deadline) {
+            // Serve the latest deadline which has passed, like the OffboardSender.
+            const Clock::duration late = now - stream_deadline;
+            if (late >= period) {
+                const Clock::duration::rep missed = late / period;
+                _missed.fetch_add(static_cast<uint64_t>(missed), std::memory_order_relaxed);
+                stream_deadline += period * missed;
+            }
+            send_stream(sequence);
+            sequence = (sequence + 1) % sequence_count;
+            stream_deadline += period;
+        }
+        lock.lock();
+    }
+}
+
+void MavlinkStandIn::send_heartbeat()
+{
+    mavlink_heartbeat_t heartbeat;
+    std::memset(&heartbeat, 0, sizeof(heartbeat));
+    heartbeat.type = MAV_TYPE_QUADROTOR;
+    heartbeat.autopilot = MAV_AUTOPILOT_PX4;
+    heartbeat.base_mode = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED;
+    heartbeat.system_status = MAV_STATE_STANDBY;
+    heartbeat.mavlink_version = 3;
+
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_encode(stand_in_sysid, stand_in_compid, &message, &heartbeat);
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    send(buffer, mavlink_msg_to_send_buffer(buffer, &message));
+}
+
+void MavlinkStandIn::send_stream(uint32_t sequence)
+{
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    mavlink_message_t message;
+
+    // Encoded from zeroed structs, so extension fields of newer dialects stay unset.
+    mavlink_global_position_int_t position;
+    std::memset(&position, 0, sizeof(position));
+    position.time_boot_ms = time_boot_ms();
+    position.lat = base_latitude_e7 + static_cast<int32_t>(sequence);
+    position.lon = base_longitude_e7;
+    position.alt = altitude_mm;
+    position.vx = static_cast<int16_t>(static_cast<int32_t>(sequence) - ground_speed_offset_cm_s);
+    position.hdg = UINT16_MAX;
+    mavlink_msg_global_position_int_encode(stand_in_sysid, stand_in_compid, &message, &position);
+    send_stamped(StandInMessage::GLOBAL_POSITION_INT, sequence, buffer, mavlink_msg_to_send_buffer(buffer, &message));
+
+    const double yaw_rad = ((sequence + 0.5) * yaw_step_deg - 180.0) * M_PI / 180.0;
+    mavlink_attitude_quaternion_t attitude;
+    std::memset(&attitude, 0, sizeof(attitude));
+    attitude.time_boot_ms = time_boot_ms();
+    attitude.q1 = static_cast<float>(cos(0.5 * yaw_rad));
+    attitude.q4 = static_cast<float>(sin(0.5 * yaw_rad));
+    mavlink_msg_attitude_quaternion_encode(stand_in_sysid, stand_in_compid, &message, &attitude);
+    send_stamped(StandInMessage::ATTITUDE_QUATERNION, sequence, buffer, mavlink_msg_to_send_buffer(buffer, &message));
+}
+
+// The time is stored before the send, so it is there before the SDK can see the message.
+void MavlinkStandIn::send_stamped(StandInMessage message, uint32_t sequence, const uint8_t *buffer, size_t length)
+{
+    const size_t index = message_index(message);
+    _sent_at[index * sequence_count + sequence].store(real_clock().now().time_since_epoch().count(),
+                                                      std::memory_order_release);
+    if (send(buffer, length)) {
+        _sent[index].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Until the SDK listens on the port, sends fail with ECONNREFUSED and are only counted.
+bool MavlinkStandIn::send(const uint8_t *buffer, size_t length)
+{
+    if (::send(_fd, buffer, length, 0) != static_cast<ssize_t>(length)) {
+        _send_errors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+uint32_t MavlinkStandIn::time_boot_ms() const
+{
+    return static_cast<uint32_t>(duration_cast<milliseconds>(real_clock().now() - _boot).count());
+}
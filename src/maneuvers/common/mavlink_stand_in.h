@@ -0,0 +1,93 @@
+//
+// Stands in for an autopilot on a local UDP port, to measure how long
+// telemetry takes through the SDK without a vehicle or a simulator.
+//
+// A thread sends a heartbeat every second, which is enough for the SDK to
+// discover a system, and GLOBAL_POSITION_INT and ATTITUDE_QUATERNION at a
+// rate which can be changed while it runs. Like the OffboardSender it sends
+// at fixed deadlines and skips, and counts, those it is too late for.
+//
+// Every message carries a sequence number in values the SDK hands on to the
+// callbacks: the latitude in 1e-7 degrees, the north velocity in cm/s and
+// the yaw in steps of 360 / sequence_count degrees. The time each message
+// was handed to the socket is kept per sequence number, so a callback can
+// tell how long the message took from the wire to it. Sequence numbers
+// wrap, the table covers the last sequence_count messages of each kind.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "clock.h"
+
+enum class StandInMessage {
+    GLOBAL_POSITION_INT, // position and ground speed callbacks
+    ATTITUDE_QUATERNION  // attitude callbacks
+};
+
+class MavlinkStandIn {
+public:
+    static const uint32_t sequence_count = 30000;
+
+    // Sends from an ephemeral port to 127.0.0.1:port, as system 1 component 1 like PX4.
+    explicit MavlinkStandIn(int port);
+    ~MavlinkStandIn();
+
+    // Opens the socket and starts sending heartbeats, false if the socket cannot be opened.
+    bool start();
+    void stop();
+
+    // Streams both messages at rate_hz from now on, 0 stops them. Heartbeats go on regardless.
+    void set_rate(double rate_hz);
+
+    uint64_t sent(StandInMessage message) const;
+    // Deadlines of the streams which had already passed when the one before was served.
+    uint64_t missed() const { return _missed.load(); }
+    uint64_t send_errors() const { return _send_errors.load(); }
+
+    // When the message with this sequence number was last sent, false if it never was.
+    bool sent_at(StandInMessage message, uint32_t sequence, Clock::time_point &time) const;
+
+    // The sequence number a message was sent with, from what the SDK made of it.
+    static uint32_t sequence_of(const mavsdk::Telemetry::Position &position);
+    static uint32_t sequence_of(const mavsdk::Telemetry::GroundSpeedNED &ground_speed);
+    static uint32_t sequence_of(const mavsdk::Telemetry::EulerAngle &attitude);
+
+private:
+    MavlinkStandIn(const MavlinkStandIn &) = delete;
+    MavlinkStandIn &operator=(const MavlinkStandIn &) = delete;
+
+    static const size_t message_kinds = 2;
+
+    void run();
+    void send_heartbeat();
+    void send_stream(uint32_t sequence);
+    void send_stamped(StandInMessage message, uint32_t sequence, const uint8_t *buffer, size_t length);
+    bool send(const uint8_t *buffer, size_t length);
+    uint32_t time_boot_ms() const;
+
+    const int _port;
+    int _fd;
+    Clock::time_point _boot;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _running;
+    double _rate_hz;
+    bool _rate_changed;
+    std::thread _thread;
+
+    std::atomic<uint64_t> _sent[message_kinds];
+    std::atomic<uint64_t> _missed;
+    std::atomic<uint64_t> _send_errors;
+    // steady_clock ticks per message kind and sequence number, 0 for never.
+    std::unique_ptr<std::atomic<int64_t>[]> _sent_at;
+};
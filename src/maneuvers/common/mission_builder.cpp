@@ -0,0 +1,118 @@
+#include "mission_builder.h"
+
+using namespace mavsdk;
+
+MissionItemRecord make_mission_item_record(double latitude_deg,
+                                           double longitude_deg,
+                                           float relative_altitude_m,
+                                           float speed_m_s,
+                                           bool is_fly_through,
+                                           float gimbal_pitch_deg,
+                                           float gimbal_yaw_deg,
+                                           float loiter_time_s,
+                                           MissionItem::CameraAction camera_action)
+{
+    MissionItemRecord record;
+    record.latitude_deg = latitude_deg;
+    record.longitude_deg = longitude_deg;
+    record.relative_altitude_m = relative_altitude_m;
+    record.speed_m_s = speed_m_s;
+    record.gimbal_pitch_deg = gimbal_pitch_deg;
+    record.gimbal_yaw_deg = gimbal_yaw_deg;
+    record.loiter_time_s = loiter_time_s;
+    record.camera_action = static_cast<uint8_t>(camera_action);
+    record.fly_through = is_fly_through ? 1 : 0;
+    return record;
+}
+
+MissionItemRecord make_mission_item_record(const MissionItem &item)
+{
+    return make_mission_item_record(item.get_latitude_deg(),
+                                    item.get_longitude_deg(),
+                                    item.get_relative_altitude_m(),
+                                    item.get_speed_m_s(),
+                                    item.get_fly_through(),
+                                    item.get_gimbal_pitch_deg(),
+                                    item.get_gimbal_yaw_deg(),
+                                    item.get_loiter_time_s(),
+                                    item.get_camera_action());
+}
+
+void MissionBuilder::add_item(double latitude_deg,
+                              double longitude_deg,
+                              float relative_altitude_m,
+                              float speed_m_s,
+                              bool is_fly_through,
+                              float gimbal_pitch_deg,
+                              float gimbal_yaw_deg,
+                              float loiter_time_s,
+                              MissionItem::CameraAction camera_action)
+{
+    _items.push_back(make_mission_item_record(latitude_deg,
+                                              longitude_deg,
+                                              relative_altitude_m,
+                                              speed_m_s,
+                                              is_fly_through,
+                                              gimbal_pitch_deg,
+                                              gimbal_yaw_deg,
+                                              loiter_time_s,
+                                              camera_action));
+}
+
+void MissionBuilder::add_positions(const double *latitude_deg,
+                                   const double *longitude_deg,
+                                   std::size_t count,
+                                   const MissionItemRecord &prototype)
+{
+    const std::size_t first = _items.size();
+    _items.resize(first + count, prototype);
+    for (std::size_t i = 0; i < count; ++i) {
+        _items[first + i].latitude_deg = latitude_deg[i];
+        _items[first + i].longitude_deg = longitude_deg[i];
+    }
+}
+
+std::vector<std::shared_ptr<MissionItem>> MissionBuilder::build() const
+{
+    std::vector<std::shared_ptr<MissionItem>> mission_items;
+    mission_items.reserve(_items.size());
+    for (const auto &record : _items) {
+        mission_items.push_back(make_mission_item(record));
+    }
+    return mission_items;
+}
+
+std::shared_ptr<MissionItem> make_mission_item(const MissionItemRecord &record)
+{
+    // make_shared puts the item and its control block into a single allocation.
+    auto new_item = std::make_shared<MissionItem>();
+    new_item->set_position(record.latitude_deg, record.longitude_deg);
+    new_item->set_relative_altitude(record.relative_altitude_m);
+    new_item->set_speed(record.speed_m_s);
+    new_item->set_fly_through(record.fly_through != 0);
+    new_item->set_gimbal_pitch_and_yaw(record.gimbal_pitch_deg, record.gimbal_yaw_deg);
+    new_item->set_loiter_time(record.loiter_time_s);
+    new_item->set_camera_action(static_cast<MissionItem::CameraAction>(record.camera_action));
+    return new_item;
+}
+
+std::shared_ptr<MissionItem> make_mission_item(double latitude_deg,
+                                               double longitude_deg,
+                                               float relative_altitude_m,
+                                               float speed_m_s,
+                                               bool is_fly_through,
+                                               float gimbal_pitch_deg,
+                                               float gimbal_yaw_deg,
+                                               float loiter_time_s,
+                                               MissionItem::CameraAction camera_action)
+{
+    std::shared_ptr<MissionItem> new_item(new MissionItem());
+    new_item->set_position(latitude_deg, longitude_deg);
+    new_item->set_relative_altitude(relative_altitude_m);
+    new_item->set_speed(speed_m_s);
+    new_item->set_fly_through(is_fly_through);
+    new_item->set_gimbal_pitch_and_yaw(gimbal_pitch_deg, gimbal_yaw_deg);
+    new_item->set_loiter_time(loiter_time_s);
+    new_item->set_camera_action(camera_action);
+    return new_item;
+}
@@ -0,0 +1,102 @@
+//
+// Builds missions in a compact, contiguous layout.
+//
+// The SDK wants a vector of shared_ptr<MissionItem>, which costs an
+// allocation per item and scatters the items over the heap. MissionBuilder
+// keeps plain records in one vector while the mission is generated and only
+// creates the SDK items when the mission is uploaded.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <plugins/mission/mission.h>
+
+// Everything make_mission_item() sets, in 40 bytes.
+struct MissionItemRecord {
+    double latitude_deg;
+    double longitude_deg;
+    float relative_altitude_m;
+    float speed_m_s;
+    float gimbal_pitch_deg;
+    float gimbal_yaw_deg;
+    float loiter_time_s;
+    uint8_t camera_action; // mavsdk::MissionItem::CameraAction
+    uint8_t fly_through;
+};
+
+class MissionBuilder {
+public:
+    MissionBuilder() = default;
+    MissionBuilder(MissionBuilder &&) = default;
+    MissionBuilder &operator=(MissionBuilder &&) = default;
+
+    void reserve(std::size_t count) { _items.reserve(count); }
+    void clear() { _items.clear(); }
+    std::size_t size() const { return _items.size(); }
+    bool empty() const { return _items.empty(); }
+
+    // Same arguments as make_mission_item().
+    void add_item(double latitude_deg,
+                  double longitude_deg,
+                  float relative_altitude_m,
+                  float speed_m_s,
+                  bool is_fly_through,
+                  float gimbal_pitch_deg,
+                  float gimbal_yaw_deg,
+                  float loiter_time_s,
+                  mavsdk::MissionItem::CameraAction camera_action);
+
+    void add_item(const MissionItemRecord &item) { _items.push_back(item); }
+
+    // Appends one item per position, all other fields taken from prototype. Meant for the
+    // output of the batch geodesy functions.
+    void add_positions(const double *latitude_deg,
+                       const double *longitude_deg,
+                       std::size_t count,
+                       const MissionItemRecord &prototype);
+
+    const std::vector<MissionItemRecord> &items() const { return _items; }
+    MissionItemRecord &operator[](std::size_t index) { return _items[index]; }
+    const MissionItemRecord &operator[](std::size_t index) const { return _items[index]; }
+
+    // Creates the SDK items, to be called right before uploading.
+    std::vector<std::shared_ptr<mavsdk::MissionItem>> build() const;
+
+private:
+    MissionBuilder(const MissionBuilder &) = delete;
+    MissionBuilder &operator=(const MissionBuilder &) = delete;
+
+    std::vector<MissionItemRecord> _items;
+};
+
+MissionItemRecord make_mission_item_record(double latitude_deg,
+                                           double longitude_deg,
+                                           float relative_altitude_m,
+                                           float speed_m_s,
+                                           bool is_fly_through,
+                                           float gimbal_pitch_deg,
+                                           float gimbal_yaw_deg,
+                                           float loiter_time_s,
+                                           mavsdk::MissionItem::CameraAction camera_action);
+
+// Record of an SDK item, e.g. of a downloaded mission.
+MissionItemRecord make_mission_item_record(const mavsdk::MissionItem &item);
+
+// Creates one SDK item from a record.
+std::shared_ptr<mavsdk::MissionItem> make_mission_item(const MissionItemRecord &record);
+
+// convenience function for a single mission item
+std::shared_ptr<mavsdk::MissionItem> make_mission_item(double latitude_deg,
+                                                       double longitude_deg,
+                                                       float relative_altitude_m,
+                                                       float speed_m_s,
+                                                       bool is_fly_through,
+                                                       float gimbal_pitch_deg,
+                                                       float gimbal_yaw_deg,
+                                                       float loiter_time_s,
+                                                       mavsdk::MissionItem::CameraAction camera_action);
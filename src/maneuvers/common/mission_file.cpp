@@ -0,0 +1,221 @@
+#include "mission_file.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace mavsdk;
+
+namespace {
+
+const char header_magic[8] = {'M', 'N', 'V', 'M', 'I', 'S', '0', '1'};
+const uint32_t file_version = 1;
+
+// Reflected CRC-32 (as used by zlib), slicing-by-8: table n is the CRC of a byte followed
+// by n zero bytes, so 8 bytes are folded in per step instead of one.
+struct Crc32Table {
+    uint32_t entries[8][256];
+
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            entries[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int n = 1; n < 8; ++n) {
+                entries[n][i] = (entries[n - 1][i] >> 8) ^ entries[0][entries[n - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const Crc32Table crc32_table;
+
+int32_t degrees_to_e7(double degrees)
+{
+    return static_cast<int32_t>(std::lround(degrees * 1e7));
+}
+
+} // namespace
+
+MissionFileRecord make_mission_file_record(const MissionItemRecord &item)
+{
+    MissionFileRecord record;
+    record.latitude_e7 = degrees_to_e7(item.latitude_deg);
+    record.longitude_e7 = degrees_to_e7(item.longitude_deg);
+    record.relative_altitude_m = item.relative_altitude_m;
+    record.speed_m_s = item.speed_m_s;
+    record.gimbal_pitch_deg = item.gimbal_pitch_deg;
+    record.gimbal_yaw_deg = item.gimbal_yaw_deg;
+    record.loiter_time_s = item.loiter_time_s;
+    record.camera_action = item.camera_action;
+    record.fly_through = item.fly_through;
+    record.reserved = 0;
+    return record;
+}
+
+MissionItemRecord make_mission_item_record(const MissionFileRecord &record)
+{
+    MissionItemRecord item;
+    item.latitude_deg = record.latitude_e7 * 1e-7;
+    item.longitude_deg = record.longitude_e7 * 1e-7;
+    item.relative_altitude_m = record.relative_altitude_m;
+    item.speed_m_s = record.speed_m_s;
+    item.gimbal_pitch_deg = record.gimbal_pitch_deg;
+    item.gimbal_yaw_deg = record.gimbal_yaw_deg;
+    item.loiter_time_s = record.loiter_time_s;
+    item.camera_action = record.camera_action;
+    item.fly_through = record.fly_through;
+    return item;
+}
+
+uint32_t mission_file_crc32(const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    const uint32_t(*table)[256] = crc32_table.entries;
+    uint32_t crc = 0xFFFFFFFFu;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        // The file format is little endian, like the hosts this runs on.
+        uint32_t low, high;
+        std::memcpy(&low, bytes + i, sizeof(low));
+        std::memcpy(&high, bytes + i + 4, sizeof(high));
+        low ^= crc;
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+    }
+    for (; i < size; ++i) {
+        crc = table[0][(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+bool write_mission_file(const std::string &path, const std::vector<MissionItemRecord> &items)
+{
+    std::vector<MissionFileRecord> records;
+    records.reserve(items.size());
+    for (const auto &item : items) {
+        records.push_back(make_mission_file_record(item));
+    }
+
+    MissionFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, header_magic, sizeof(header_magic));
+    header.version = file_version;
+    header.record_size = sizeof(MissionFileRecord);
+    header.record_count = records.size();
+    header.records_crc32 = mission_file_crc32(records.data(), records.size() * sizeof(MissionFileRecord));
+
+    // Written next to the old one and renamed, so an interrupted write leaves no half file.
+    const std::string temporary_path = path + ".tmp";
+    FILE *file = std::fopen(temporary_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(records.data(), sizeof(MissionFileRecord), records.size(), file) == records.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+MissionFileReader::MissionFileReader() :
+    _mapping(nullptr),
+    _size(0),
+    _records(nullptr),
+    _record_count(0)
+{}
+
+MissionFileReader::~MissionFileReader()
+{
+    close();
+}
+
+bool MissionFileReader::open(const std::string &path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) < sizeof(MissionFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    _size = file_stat.st_size;
+    _mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (_mapping == MAP_FAILED) {
+        _mapping = nullptr;
+        return false;
+    }
+
+    const char *data = static_cast<const char *>(_mapping);
+    const MissionFileHeader *header = reinterpret_cast<const MissionFileHeader *>(data);
+    const size_t records_size = _size - sizeof(MissionFileHeader);
+    if (std::memcmp(header->magic, header_magic, sizeof(header_magic)) != 0 ||
+        header->version != file_version ||
+        header->record_size != sizeof(MissionFileRecord) ||
+        header->record_count == 0 ||
+        records_size / sizeof(MissionFileRecord) != header->record_count ||
+        records_size % sizeof(MissionFileRecord) != 0) {
+        close();
+        return false;
+    }
+
+    // One sequential pass, which also pulls the records into the page cache for the conversion.
+    const char *records = data + sizeof(MissionFileHeader);
+    if (mission_file_crc32(records, records_size) != header->records_crc32) {
+        close();
+        return false;
+    }
+    _records = reinterpret_cast<const MissionFileRecord *>(records);
+    _record_count = header->record_count;
+    return true;
+}
+
+void MissionFileReader::close()
+{
+    if (_mapping) {
+        munmap(_mapping, _size);
+    }
+    _mapping = nullptr;
+    _size = 0;
+    _records = nullptr;
+    _record_count = 0;
+}
+
+void MissionFileReader::append_to(MissionBuilder &builder) const
+{
+    builder.reserve(builder.size() + _record_count);
+    for (size_t i = 0; i < _record_count; ++i) {
+        builder.add_item(make_mission_item_record(_records[i]));
+    }
+}
+
+std::vector<std::shared_ptr<MissionItem>> MissionFileReader::mission_items() const
+{
+    std::vector<std::shared_ptr<MissionItem>> mission_items;
+    mission_items.reserve(_record_count);
+    for (size_t i = 0; i < _record_count; ++i) {
+        mission_items.push_back(make_mission_item(make_mission_item_record(_records[i])));
+    }
+    return mission_items;
+}
@@ -0,0 +1,85 @@
+//
+// Compact binary mission file, for large missions planned offline.
+//
+// File layout (little endian, fixed-size structs, used straight from the
+// mapped file):
+//   MissionFileHeader
+//   MissionFileRecord * record_count
+// The header holds a CRC-32 of the records, so a truncated or corrupted
+// file is rejected before anything is flown. maneuvers_mission_convert
+// writes these files from QGroundControl plans.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <plugins/mission/mission.h>
+
+#include "mission_builder.h"
+
+struct MissionFileHeader {
+    char magic[8]; // "MNVMIS01"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t record_count;
+    uint32_t records_crc32;
+    uint8_t reserved[36];
+};
+
+// One mission item, positions at the 1e-7 degree resolution of MAVLink.
+struct MissionFileRecord {
+    int32_t latitude_e7;
+    int32_t longitude_e7;
+    float relative_altitude_m;
+    float speed_m_s;
+    float gimbal_pitch_deg;
+    float gimbal_yaw_deg;
+    float loiter_time_s;
+    uint8_t camera_action; // mavsdk::MissionItem::CameraAction
+    uint8_t fly_through;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(MissionFileHeader) == 64, "unexpected header size");
+static_assert(sizeof(MissionFileRecord) == 32, "unexpected record size");
+
+MissionFileRecord make_mission_file_record(const MissionItemRecord &item);
+MissionItemRecord make_mission_item_record(const MissionFileRecord &record);
+
+uint32_t mission_file_crc32(const void *data, size_t size);
+
+bool write_mission_file(const std::string &path, const std::vector<MissionItemRecord> &items);
+
+// Read-only view of a mission file.
+class MissionFileReader {
+public:
+    MissionFileReader();
+    ~MissionFileReader();
+
+    // Fails unless header, size and checksum are valid and the file has at least one record.
+    bool open(const std::string &path);
+    void close();
+
+    const MissionFileRecord *records() const { return _records; }
+    size_t record_count() const { return _record_count; }
+
+    // Appends the records, without any other allocation than growing the builder.
+    void append_to(MissionBuilder &builder) const;
+
+    // The items for the SDK, one allocation per item as the SDK wants them.
+    std::vector<std::shared_ptr<mavsdk::MissionItem>> mission_items() const;
+
+private:
+    MissionFileReader(const MissionFileReader &) = delete;
+    MissionFileReader &operator=(const MissionFileReader &) = delete;
+
+    void *_mapping;
+    size_t _size;
+    const MissionFileRecord *_records;
+    size_t _record_count;
+};
@@ -0,0 +1,248 @@
+#include "mission_sync.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include "log_sink.h"
+
+using namespace mavsdk;
+
+namespace {
+
+const uint64_t fnv_offset_basis = 14695981039346656037ull;
+const uint64_t fnv_prime = 1099511628211ull;
+
+void fnv_add(uint64_t &hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= fnv_prime;
+    }
+}
+
+void fnv_add_degrees(uint64_t &hash, double degrees)
+{
+    const int32_t value = static_cast<int32_t>(std::lround(degrees * 1e7));
+    fnv_add(hash, &value, sizeof(value));
+}
+
+void fnv_add_float(uint64_t &hash, float value)
+{
+    // All unset fields hash the same.
+    if (std::isnan(value)) {
+        value = NAN;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    fnv_add(hash, &bits, sizeof(bits));
+}
+
+struct SyncState {
+    Autopilot *autopilot;
+    std::string fingerprint_path;
+    std::vector<MissionItemRecord> records;
+    MissionFingerprint fingerprint;
+    MissionSyncReport report;
+    MissionSync::callback_t callback;
+};
+
+void finish(const std::shared_ptr<SyncState> &state, Mission::Result result)
+{
+    state->report.result = result;
+    state->callback(state->report);
+}
+
+void upload(const std::shared_ptr<SyncState> &state)
+{
+    std::vector<std::shared_ptr<MissionItem>> mission_items;
+    mission_items.reserve(state->records.size());
+    for (const auto &record : state->records) {
+        mission_items.push_back(make_mission_item(record));
+    }
+
+    state->autopilot->upload_mission_async(mission_items, [state](Mission::Result result) {
+        state->report.uploaded = true;
+        if (result != Mission::Result::SUCCESS) {
+            // Nobody knows what the vehicle holds now.
+            std::remove(state->fingerprint_path.c_str());
+            finish(state, result);
+            return;
+        }
+
+        // Remember the size the vehicle reports for it, which is what the next sync checks.
+        state->autopilot->mission_count_async([state](std::pair<Mission::Result, int> count) {
+            state->fingerprint.vehicle_item_count =
+                count.first == Mission::Result::SUCCESS ? count.second : -1;
+            if (!save_mission_fingerprint(state->fingerprint_path, state->fingerprint)) {
+                // The old fingerprint must not outlive the mission it describes, without one the
+                // next sync uploads in full.
+                log_error() << "Cannot write the mission fingerprint " << state->fingerprint_path;
+                std::remove(state->fingerprint_path.c_str());
+            }
+            finish(state, Mission::Result::SUCCESS);
+        });
+    });
+}
+
+} // namespace
+
+uint64_t mission_item_hash(const MissionItemRecord &item)
+{
+    uint64_t hash = fnv_offset_basis;
+    fnv_add_degrees(hash, item.latitude_deg);
+    fnv_add_degrees(hash, item.longitude_deg);
+    fnv_add_float(hash, item.relative_altitude_m);
+    fnv_add_float(hash, item.speed_m_s);
+    fnv_add_float(hash, item.gimbal_pitch_deg);
+    fnv_add_float(hash, item.gimbal_yaw_deg);
+    fnv_add_float(hash, item.loiter_time_s);
+    fnv_add(hash, &item.camera_action, sizeof(item.camera_action));
+    fnv_add(hash, &item.fly_through, sizeof(item.fly_through));
+    return hash;
+}
+
+MissionFingerprint mission_fingerprint(const std::vector<MissionItemRecord> &items)
+{
+    MissionFingerprint fingerprint;
+    fingerprint.mission_hash = fnv_offset_basis;
+    fingerprint.vehicle_item_count = -1;
+    fingerprint.item_hashes.reserve(items.size());
+    for (const auto &item : items) {
+        const uint64_t item_hash = mission_item_hash(item);
+        fingerprint.item_hashes.push_back(item_hash);
+        fnv_add(fingerprint.mission_hash, &item_hash, sizeof(item_hash));
+    }
+    return fingerprint;
+}
+
+bool load_mission_fingerprint(const std::string &path, MissionFingerprint &fingerprint)
+{
+    std::ifstream file(path);
+    size_t count = 0;
+    if (!(file >> std::hex >> fingerprint.mission_hash >> std::dec >> fingerprint.vehicle_item_count >> count)) {
+        return false;
+    }
+    fingerprint.item_hashes.resize(count);
+    for (auto &item_hash : fingerprint.item_hashes) {
+        if (!(file >> std::hex >> item_hash)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool save_mission_fingerprint(const std::string &path, const MissionFingerprint &fingerprint)
+{
+    // Written next to the old one and renamed, so an interrupted write leaves no half file.
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path);
+        file << std::hex << fingerprint.mission_hash << std::dec << " "
+             << fingerprint.vehicle_item_count << " " << fingerprint.item_hashes.size() << "\n"
+             << std::hex;
+        for (const auto item_hash : fingerprint.item_hashes) {
+            file << item_hash << "\n";
+        }
+        file.close();
+        if (!file) {
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+void mission_changed_range(const MissionFingerprint &previous, const MissionFingerprint &current,
+                           size_t &changed_first, size_t &changed_count)
+{
+    const size_t old_count = previous.item_hashes.size();
+    const size_t new_count = current.item_hashes.size();
+
+    size_t first = 0;
+    while (first < new_count && first < old_count
+           && previous.item_hashes[first] == current.item_hashes[first]) {
+        ++first;
+    }
+    // Items the mission no longer has changed as well, a shorter mission is not the same one.
+    size_t end = old_count > new_count ? old_count : first;
+    for (size_t i = first; i < new_count; ++i) {
+        if (i >= old_count || previous.item_hashes[i] != current.item_hashes[i]) {
+            end = std::max(end, i + 1);
+        }
+    }
+    changed_first = first;
+    changed_count = end - first;
+}
+
+MissionSync::MissionSync(Autopilot &autopilot, const std::string &fingerprint_path, bool verify) :
+    _autopilot(autopilot),
+    _fingerprint_path(fingerprint_path),
+    _verify(verify)
+{}
+
+void MissionSync::sync_async(const MissionBuilder &mission, callback_t callback)
+{
+    // Everything the callbacks need lives here, they may outlive this object.
+    auto state = std::make_shared<SyncState>();
+    state->autopilot = &_autopilot;
+    state->fingerprint_path = _fingerprint_path;
+    state->records = mission.items();
+    state->fingerprint = mission_fingerprint(state->records);
+    state->report.result = Mission::Result::UNKNOWN;
+    state->report.uploaded = false;
+    state->report.items = state->records.size();
+    state->report.changed_first = 0;
+    state->report.changed_count = state->records.size();
+    state->callback = callback;
+
+    MissionFingerprint previous;
+    if (!load_mission_fingerprint(_fingerprint_path, previous)) {
+        upload(state);
+        return;
+    }
+    if (previous.mission_hash != state->fingerprint.mission_hash) {
+        mission_changed_range(previous, state->fingerprint, state->report.changed_first,
+                              state->report.changed_count);
+        upload(state);
+        return;
+    }
+
+    // From here on the mission is the last one uploaded, and only uploaded again if the vehicle
+    // does not hold it any more, which makes every item a changed one.
+    if (previous.vehicle_item_count < 0) {
+        upload(state);
+        return;
+    }
+
+    if (_verify) {
+        _autopilot.download_mission_async([state](Mission::Result result, std::vector<std::shared_ptr<MissionItem>> mission_items) {
+            if (result == Mission::Result::SUCCESS && mission_items.size() == state->records.size()) {
+                std::vector<MissionItemRecord> downloaded;
+                downloaded.reserve(mission_items.size());
+                for (const auto &item : mission_items) {
+                    downloaded.push_back(make_mission_item_record(*item));
+                }
+                if (mission_fingerprint(downloaded).mission_hash == state->fingerprint.mission_hash) {
+                    finish(state, Mission::Result::SUCCESS);
+                    return;
+                }
+            }
+            upload(state);
+        });
+        return;
+    }
+
+    const int previous_count = previous.vehicle_item_count;
+    _autopilot.mission_count_async([state, previous_count](std::pair<Mission::Result, int> count) {
+        if (count.first == Mission::Result::SUCCESS && count.second == previous_count) {
+            finish(state, Mission::Result::SUCCESS);
+            return;
+        }
+        upload(state);
+    });
+}
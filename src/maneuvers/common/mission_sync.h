@@ -0,0 +1,77 @@
+//
+// Skips mission uploads which would not change anything on the vehicle.
+//
+// The fingerprint of the last mission uploaded to a vehicle (a hash per item,
+// one over the whole mission and the number of items the vehicle reported
+// afterwards) is kept in a small file per vehicle. A new mission is hashed
+// and compared to it first. Only if they match, one MISSION_REQUEST_LIST
+// round trip checks that the vehicle still holds a mission of that size, and
+// the upload is skipped. With verify, the mission is downloaded and compared
+// instead, which also notices another ground station having uploaded a
+// mission of the same size in between.
+//
+// Neither PX4 nor the SDK support writing part of a mission
+// (MISSION_WRITE_PARTIAL_LIST), so a changed mission is uploaded in full.
+// The range of changed items is still reported.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <plugins/mission/mission.h>
+
+#include "autopilot.h"
+#include "mission_builder.h"
+
+struct MissionFingerprint {
+    uint64_t mission_hash;
+    int vehicle_item_count; // as reported by the vehicle, negative if unknown
+    std::vector<uint64_t> item_hashes;
+};
+
+// FNV-1a over the fields of the item, positions at the 1e-7 degree resolution of MAVLink.
+uint64_t mission_item_hash(const MissionItemRecord &item);
+
+MissionFingerprint mission_fingerprint(const std::vector<MissionItemRecord> &items);
+
+// Text file with the mission hash, the vehicle item count and one item hash per line.
+bool load_mission_fingerprint(const std::string &path, MissionFingerprint &fingerprint);
+bool save_mission_fingerprint(const std::string &path, const MissionFingerprint &fingerprint);
+
+// Range of item positions at which current differs from previous, including the positions of
+// items previous has beyond the end of current.
+void mission_changed_range(const MissionFingerprint &previous, const MissionFingerprint &current,
+                           size_t &changed_first, size_t &changed_count);
+
+struct MissionSyncReport {
+    mavsdk::Mission::Result result;
+    bool uploaded;
+    size_t items;
+    // Item positions which differ from the last mission uploaded. Everything without a
+    // fingerprint, or if the vehicle does not hold the last mission any more. Items removed from
+    // the end count, so this can be more than items.
+    size_t changed_first;
+    size_t changed_count;
+};
+
+class MissionSync {
+public:
+    typedef std::function<void(const MissionSyncReport &)> callback_t;
+
+    // fingerprint_path is the fingerprint file of the vehicle behind autopilot.
+    MissionSync(Autopilot &autopilot, const std::string &fingerprint_path, bool verify = false);
+
+    // Uploads the mission unless the vehicle already has it. The callback is called from an
+    // SDK or worker thread.
+    void sync_async(const MissionBuilder &mission, callback_t callback);
+
+private:
+    Autopilot &_autopilot;
+    const std::string _fingerprint_path;
+    const bool _verify;
+};
@@ -0,0 +1,151 @@
+#include "offboard_sender.h"
+
+#include <algorithm>
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+OffboardSender::OffboardSender(Autopilot &autopilot, std::shared_ptr<const Trajectory> trajectory, SetpointType type) :
+    _autopilot(autopilot),
+    _trajectory(trajectory),
+    _type(type),
+    _running(false),
+    _play(false),
+    _finished(false),
+    _sent(0),
+    _missed(0),
+    _jitter_sum_us(0),
+    _jitter_max_us(0)
+{
+    for (auto &bucket : _jitter_histogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+OffboardSender::~OffboardSender()
+{
+    stop();
+}
+
+void OffboardSender::start()
+{
+    if (_running || _trajectory->samples.empty()) {
+        return;
+    }
+    send(_trajectory->samples.front());
+    _running = true;
+    _thread = std::thread(&OffboardSender::run, this);
+}
+
+void OffboardSender::play()
+{
+    _play = true;
+}
+
+void OffboardSender::stop()
+{
+    _running = false;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void OffboardSender::run()
+{
+    const Clock &clock = _autopilot.clock();
+    const Clock::duration period = duration_cast<Clock::duration>(duration<double>(1.0 / _trajectory->rate_hz));
+    const auto &samples = _trajectory->samples;
+
+    // The first sample went out in start().
+    uint64_t tick = 1;
+    Clock::time_point deadline = clock.now() + period;
+    bool playing = false;
+    uint64_t play_tick = 0;
+
+    while (_running) {
+        clock.sleep_until(deadline);
+        Clock::duration late = clock.now() - deadline;
+
+        // Serve the latest deadline which has passed, the skipped samples are not sent late.
+        if (late >= period) {
+            const Clock::duration::rep missed = late / period;
+            _missed.fetch_add(static_cast<uint64_t>(missed), std::memory_order_relaxed);
+            tick += missed;
+            deadline += period * missed;
+            late -= period * missed;
+        }
+
+        if (!playing && _play) {
+            playing = true;
+            play_tick = tick;
+        }
+        size_t index = 0;
+        if (playing) {
+            index = static_cast<size_t>(std::min<uint64_t>(tick - play_tick, samples.size() - 1));
+            if (index + 1 == samples.size()) {
+                _finished = true;
+            }
+        }
+
+        send(samples[index]);
+        record_jitter(late);
+        ++tick;
+        deadline += period;
+    }
+}
+
+void OffboardSender::send(const TrajectorySample &sample)
+{
+    switch (_type) {
+        case SetpointType::POSITION:
+            _autopilot.set_offboard_position_ned({sample.north_m, sample.east_m, sample.down_m, sample.yaw_deg});
+            break;
+        case SetpointType::VELOCITY:
+            _autopilot.set_offboard_velocity_ned({sample.north_m_s, sample.east_m_s, sample.down_m_s, sample.yaw_deg});
+            break;
+    }
+    _sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+void OffboardSender::record_jitter(Clock::duration late)
+{
+    const uint64_t late_us = static_cast<uint64_t>(std::max<int64_t>(0, duration_cast<microseconds>(late).count()));
+    size_t bucket = 0;
+    while (bucket + 1 < jitter_buckets && (late_us >> bucket) != 0) {
+        ++bucket;
+    }
+    _jitter_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    _jitter_sum_us.fetch_add(late_us, std::memory_order_relaxed);
+
+    // Only this thread writes it.
+    if (late_us > _jitter_max_us.load(std::memory_order_relaxed)) {
+        _jitter_max_us.store(late_us, std::memory_order_relaxed);
+    }
+}
+
+OffboardSendStats OffboardSender::stats() const
+{
+    OffboardSendStats stats;
+    stats.sent = _sent.load();
+    stats.missed = _missed.load();
+
+    uint64_t counts[jitter_buckets];
+    uint64_t total = 0;
+    for (size_t i = 0; i < jitter_buckets; ++i) {
+        counts[i] = _jitter_histogram[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    stats.mean_jitter_ms = total > 0 ? _jitter_sum_us.load() / 1000.0 / total : 0.0;
+    stats.max_jitter_ms = _jitter_max_us.load() / 1000.0;
+
+    stats.p99_jitter_ms = 0.0;
+    uint64_t below = 0;
+    for (size_t i = 0; i < jitter_buckets && total > 0; ++i) {
+        below += counts[i];
+        if (below * 100 >= total * 99) {
+            stats.p99_jitter_ms = std::min(double(uint64_t(1) << i) / 1000.0, stats.max_jitter_ms);
+            break;
+        }
+    }
+    return stats;
+}
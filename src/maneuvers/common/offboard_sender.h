@@ -0,0 +1,81 @@
+//
+// Streams a trajectory as offboard setpoints from a thread of its own.
+//
+// Setpoints are due at fixed deadlines, start + k / rate on the clock of the
+// autopilot, and the thread sleeps until the next deadline rather than for a
+// period, so the time a send takes does not make the rate drift. How late
+// each send is goes into a fixed histogram. A deadline which has already
+// passed by the time the one before was served is counted as missed and
+// skipped, so the vehicle stays on the schedule of the trajectory instead of
+// falling behind it. Nothing is allocated while streaming.
+//
+// With a simulated vehicle the clock is scaled, and so are the deadlines and
+// the jitter.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "autopilot.h"
+#include "trajectory.h"
+
+enum class SetpointType { POSITION, VELOCITY };
+
+struct OffboardSendStats {
+    uint64_t sent;
+    uint64_t missed; // deadlines skipped because the sender was too late
+    double mean_jitter_ms;
+    double p99_jitter_ms; // upper bound of the histogram bucket
+    double max_jitter_ms;
+};
+
+class OffboardSender {
+public:
+    OffboardSender(Autopilot &autopilot, std::shared_ptr<const Trajectory> trajectory, SetpointType type);
+    ~OffboardSender();
+
+    // Sends the first sample and keeps streaming it, offboard control can be started after this.
+    void start();
+
+    // Moves along the trajectory from the next deadline on.
+    void play();
+
+    // The last sample has been sent, it is repeated until stop().
+    bool finished() const { return _finished; }
+
+    void stop();
+
+    // Can be called while streaming.
+    OffboardSendStats stats() const;
+
+private:
+    OffboardSender(const OffboardSender &) = delete;
+    OffboardSender &operator=(const OffboardSender &) = delete;
+
+    // Bucket i counts sends late by less than 2^i microseconds (and at least half of that).
+    static const size_t jitter_buckets = 32;
+
+    void run();
+    void send(const TrajectorySample &sample);
+    void record_jitter(Clock::duration late);
+
+    Autopilot &_autopilot;
+    const std::shared_ptr<const Trajectory> _trajectory;
+    const SetpointType _type;
+
+    std::atomic<bool> _running;
+    std::atomic<bool> _play;
+    std::atomic<bool> _finished;
+    std::thread _thread;
+
+    std::atomic<uint64_t> _sent;
+    std::atomic<uint64_t> _missed;
+    std::atomic<uint64_t> _jitter_sum_us;
+    std::atomic<uint64_t> _jitter_max_us;
+    std::atomic<uint64_t> _jitter_histogram[jitter_buckets];
+};
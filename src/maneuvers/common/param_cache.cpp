@@ -0,0 +1,94 @@
+#include "param_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <sstream>
+
+ParamValue ParamValue::from_float(float value)
+{
+    ParamValue param = {Type::FLOAT, value, 0};
+    return param;
+}
+
+ParamValue ParamValue::from_int(int32_t value)
+{
+    ParamValue param = {Type::INT32, 0.0f, value};
+    return param;
+}
+
+ParamValue ParamValue::of_type(Type type, double value)
+{
+    return type == Type::INT32 ? from_int(static_cast<int32_t>(std::lround(value)))
+                               : from_float(static_cast<float>(value));
+}
+
+double ParamValue::as_double() const
+{
+    return type == Type::INT32 ? double(int_value) : double(float_value);
+}
+
+bool ParamValue::operator==(const ParamValue &other) const
+{
+    if (type != other.type) {
+        return false;
+    }
+    return type == Type::INT32 ? int_value == other.int_value : float_value == other.float_value;
+}
+
+bool ParamCache::get(const std::string &name, ParamValue &value) const
+{
+    const auto found = _values.find(name);
+    if (found == _values.end()) {
+        return false;
+    }
+    value = found->second;
+    return true;
+}
+
+void ParamCache::store(const std::string &name, const ParamValue &value)
+{
+    _values[name] = value;
+}
+
+void ParamCache::store(const ParamTable &values)
+{
+    for (const auto &value : values) {
+        _values[value.first] = value.second;
+    }
+}
+
+std::vector<std::string> ParamCache::missing(const std::vector<std::string> &names) const
+{
+    std::vector<std::string> result;
+    std::set<std::string> seen;
+    for (const auto &name : names) {
+        if (_values.count(name) == 0 && seen.insert(name).second) {
+            result.push_back(name);
+        }
+    }
+    return result;
+}
+
+bool parse_param_sweep(const std::string &text, ParamSweep &sweep)
+{
+    const size_t equals = text.find('=');
+    if (equals == 0 || equals == std::string::npos) {
+        return false;
+    }
+
+    ParamSweep parsed;
+    parsed.name = text.substr(0, equals);
+    std::string values_text = text.substr(equals + 1);
+    std::replace(values_text.begin(), values_text.end(), ',', ' ');
+    std::istringstream fields(values_text);
+    double value;
+    while (fields >> value) {
+        parsed.values.push_back(value);
+    }
+    if (!fields.eof() || parsed.values.empty()) {
+        return false;
+    }
+    sweep = parsed;
+    return true;
+}
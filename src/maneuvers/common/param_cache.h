@@ -0,0 +1,69 @@
+//
+// Parameters of a vehicle, fetched once and kept locally.
+//
+// Reading parameters one by one costs a round trip each. The Autopilot
+// instead sends the requests of a whole batch at once and collects the
+// answers as they arrive (get_params_async in autopilot.h), so a batch costs
+// about one round trip. The cache keeps what was fetched, and set_param_step
+// (maneuver_steps.h) only goes to the vehicle if a value actually changes,
+// so a parameter sweep between flights costs one round trip per change and
+// never refetches the table.
+//
+// Not thread safe, the cache is only touched from the event loop of the
+// maneuvers using it.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// PX4 parameters are either floats or 32 bit integers.
+struct ParamValue {
+    enum class Type { FLOAT, INT32 };
+
+    Type type;
+    float float_value;
+    int32_t int_value;
+
+    static ParamValue from_float(float value);
+    static ParamValue from_int(int32_t value);
+
+    // value converted to the given type, integers are rounded.
+    static ParamValue of_type(Type type, double value);
+
+    double as_double() const;
+
+    bool operator==(const ParamValue &other) const;
+    bool operator!=(const ParamValue &other) const { return !(*this == other); }
+};
+
+typedef std::map<std::string, ParamValue> ParamTable;
+
+class ParamCache {
+public:
+    // False if name has not been fetched or set yet.
+    bool get(const std::string &name, ParamValue &value) const;
+
+    void store(const std::string &name, const ParamValue &value);
+    void store(const ParamTable &values);
+
+    // The names which are not cached, in the order given and without duplicates.
+    std::vector<std::string> missing(const std::vector<std::string> &names) const;
+
+    const ParamTable &values() const { return _values; }
+
+private:
+    ParamTable _values;
+};
+
+// A parameter set to each of the values in turn.
+struct ParamSweep {
+    std::string name;
+    std::vector<double> values;
+};
+
+// Reads "NAME=value[,value...]", false if malformed.
+bool parse_param_sweep(const std::string &text, ParamSweep &sweep);
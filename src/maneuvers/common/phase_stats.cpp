@@ -0,0 +1,284 @@
+#include "phase_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include "log_sink.h"
+
+using namespace std::chrono;
+
+namespace {
+
+// Identifies the samples of this process in the CSV file.
+const std::string this_run = std::to_string(static_cast<long long>(std::time(nullptr)));
+
+const char csv_header[] = "run,phase,event,success,seconds";
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() :
+    _count(0),
+    _sum_s(0.0),
+    _min_s(std::numeric_limits<double>::infinity()),
+    _max_s(0.0)
+{
+    _buckets.fill(0);
+}
+
+unsigned LatencyHistogram::bucket_index(double seconds)
+{
+    const double ms = seconds * 1000.0;
+    if (!(ms >= 1.0)) {
+        return 0;
+    }
+    const double index = 1.0 + std::floor(std::log2(ms) * buckets_per_octave);
+    return static_cast<unsigned>(std::min(index, double(bucket_count - 1)));
+}
+
+double LatencyHistogram::upper_bound_s(unsigned index)
+{
+    return std::exp2(double(index) / buckets_per_octave) / 1000.0;
+}
+
+void LatencyHistogram::add(double seconds)
+{
+    _buckets[bucket_index(seconds)]++;
+    _count++;
+    _sum_s += seconds;
+    _min_s = std::min(_min_s, seconds);
+    _max_s = std::max(_max_s, seconds);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (unsigned i = 0; i < bucket_count; i++) {
+        _buckets[i] += other._buckets[i];
+    }
+    _count += other._count;
+    _sum_s += other._sum_s;
+    _min_s = std::min(_min_s, other._min_s);
+    _max_s = std::max(_max_s, other._max_s);
+}
+
+double LatencyHistogram::percentile_s(double fraction) const
+{
+    if (_count == 0) {
+        return 0.0;
+    }
+    const double wanted = std::max(1.0, std::ceil(fraction * _count));
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < bucket_count; i++) {
+        seen += _buckets[i];
+        if (seen >= wanted) {
+            // The bucket bound can be above anything we have actually seen.
+            return std::min(upper_bound_s(i), _max_s);
+        }
+    }
+    return _max_s;
+}
+
+const char *phase_event_str(PhaseEvent event)
+{
+    switch (event) {
+        case PhaseEvent::ACK:
+            return "ack";
+        case PhaseEvent::COMPLETION:
+            return "completion";
+    }
+    return "unknown";
+}
+
+void PhaseStats::record(const std::string &phase, PhaseEvent event, bool success, double seconds)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _samples.push_back({phase, event, success, seconds});
+    _sample_runs.push_back(this_run);
+}
+
+std::vector<PhaseSample> PhaseStats::samples() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _samples;
+}
+
+bool PhaseStats::append_csv(const std::string &path) const
+{
+    bool is_new = true;
+    {
+        std::ifstream existing(path);
+        is_new = !existing || existing.peek() == std::ifstream::traits_type::eof();
+    }
+
+    std::ofstream file(path, std::ios::app);
+    if (!file) {
+        log_error() << "Cannot open " << path;
+        return false;
+    }
+    if (is_new) {
+        file << csv_header << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    file << std::setprecision(9);
+    for (size_t i = 0; i < _samples.size(); i++) {
+        const PhaseSample &sample = _samples[i];
+        file << _sample_runs[i] << "," << sample.phase << "," << phase_event_str(sample.event) << ","
+             << (sample.success ? 1 : 0) << "," << sample.seconds << "\n";
+    }
+    return bool(file);
+}
+
+bool PhaseStats::load_csv(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line == csv_header) {
+            continue;
+        }
+        for (auto &c : line) {
+            if (c == ',') {
+                c = ' ';
+            }
+        }
+        std::istringstream fields(line);
+        std::string run;
+        std::string event;
+        PhaseSample sample;
+        int success = 0;
+        if (!(fields >> run >> sample.phase >> event >> success >> sample.seconds)) {
+            log_info() << path << ": skipping malformed line";
+            continue;
+        }
+        sample.event = event == "ack" ? PhaseEvent::ACK : PhaseEvent::COMPLETION;
+        sample.success = success != 0;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _samples.push_back(sample);
+        _sample_runs.push_back(run);
+    }
+    return true;
+}
+
+PhaseStats::SeriesMap PhaseStats::series() const
+{
+    SeriesMap result;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &sample : _samples) {
+        Series &series = result[std::make_pair(sample.phase, sample.event)];
+        if (sample.success) {
+            series.histogram.add(sample.seconds);
+        } else {
+            series.failures++;
+        }
+    }
+    return result;
+}
+
+bool PhaseStats::write_json(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file) {
+        log_error() << "Cannot open " << path;
+        return false;
+    }
+
+    file << std::setprecision(9) << "{\n  \"phases\": [";
+    bool first = true;
+    for (const auto &entry : series()) {
+        const LatencyHistogram &histogram = entry.second.histogram;
+        file << (first ? "\n" : ",\n") << "    {\"phase\": \"" << entry.first.first << "\", \"event\": \""
+             << phase_event_str(entry.first.second) << "\", \"count\": " << histogram.count()
+             << ", \"failures\": " << entry.second.failures;
+        if (histogram.count() > 0) {
+            file << ", \"min_s\": " << histogram.min_s() << ", \"mean_s\": " << histogram.mean_s()
+                 << ", \"p50_s\": " << histogram.percentile_s(0.5)
+                 << ", \"p90_s\": " << histogram.percentile_s(0.9)
+                 << ", \"p99_s\": " << histogram.percentile_s(0.99) << ", \"max_s\": " << histogram.max_s();
+        }
+        file << ",\n     \"buckets\": [";
+        bool first_bucket = true;
+        for (unsigned i = 0; i < LatencyHistogram::bucket_count; i++) {
+            if (histogram.bucket(i) == 0) {
+                continue;
+            }
+            file << (first_bucket ? "" : ", ") << "{\"le_s\": " << LatencyHistogram::upper_bound_s(i)
+                 << ", \"count\": " << histogram.bucket(i) << "}";
+            first_bucket = false;
+        }
+        file << "]}";
+        first = false;
+    }
+    file << "\n  ]\n}\n";
+    return bool(file);
+}
+
+void PhaseStats::print_summary() const
+{
+    log_info() << "Phase latencies (s):";
+    log_info() << std::left << std::setw(20) << "phase" << std::setw(12) << "event" << std::right
+               << std::setw(6) << "n" << std::setw(6) << "fail" << std::setw(10) << "min"
+               << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "max";
+    for (const auto &entry : series()) {
+        const LatencyHistogram &histogram = entry.second.histogram;
+        log_info() << std::left << std::setw(20) << entry.first.first << std::setw(12)
+                   << phase_event_str(entry.first.second) << std::right << std::setw(6)
+                   << histogram.count() << std::setw(6) << entry.second.failures << std::fixed
+                   << std::setprecision(3) << std::setw(10)
+                   << (histogram.count() > 0 ? histogram.min_s() : 0.0) << std::setw(10)
+                   << histogram.percentile_s(0.5) << std::setw(10) << histogram.percentile_s(0.9)
+                   << std::setw(10) << histogram.max_s() << std::defaultfloat;
+    }
+}
+
+PhaseTimer::PhaseTimer(PhaseStats *stats, const std::string &phase, const Clock &clock) :
+    _stats(stats),
+    _phase(phase),
+    _clock(clock),
+    _start(clock.now())
+{}
+
+double PhaseTimer::elapsed_s() const
+{
+    return _clock.seconds_since(_start);
+}
+
+void PhaseTimer::acked(bool success)
+{
+    if (_stats) {
+        _stats->record(_phase, PhaseEvent::ACK, success, elapsed_s());
+    }
+}
+
+void PhaseTimer::completed(bool success)
+{
+    if (_stats) {
+        _stats->record(_phase, PhaseEvent::COMPLETION, success, elapsed_s());
+    }
+}
+
+bool export_phase_stats(const PhaseStats &stats, const std::string &prefix)
+{
+    const std::string csv_path = prefix + ".csv";
+    const std::string json_path = prefix + ".json";
+    if (!stats.append_csv(csv_path)) {
+        return false;
+    }
+
+    PhaseStats all_runs;
+    if (!all_runs.load_csv(csv_path) || !all_runs.write_json(json_path)) {
+        return false;
+    }
+    all_runs.print_summary();
+    log_info() << "Phase latencies of all runs in " << csv_path << " written to " << json_path;
+    return true;
+}
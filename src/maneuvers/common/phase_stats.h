@@ -0,0 +1,131 @@
+//
+// Latency of the phases of a maneuver, e.g. arm, takeoff or RTL.
+//
+// A phase starts when its command is sent. "ack" is the time until the
+// command has been acknowledged, "completion" the time until the vehicle has
+// done what was asked (e.g. RTL until disarmed). All times come from a
+// monotonic Clock and are collected into log-scale histograms.
+//
+// Samples are appended to a CSV file, so histograms can be built over many
+// runs by loading that file again, and exported as JSON.
+//
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "clock.h"
+
+// Histogram with buckets growing by 2^(1/4), from 1 ms to several hours.
+class LatencyHistogram {
+public:
+    static const unsigned buckets_per_octave = 4;
+    static const unsigned bucket_count = 96;
+
+    LatencyHistogram();
+
+    void add(double seconds);
+    void merge(const LatencyHistogram &other);
+
+    uint64_t count() const { return _count; }
+    double min_s() const { return _min_s; }
+    double max_s() const { return _max_s; }
+    double mean_s() const { return _count > 0 ? _sum_s / _count : 0.0; }
+
+    // Upper bound of the bucket holding the given fraction (0..1) of the samples.
+    double percentile_s(double fraction) const;
+
+    uint64_t bucket(unsigned index) const { return _buckets[index]; }
+
+    // Bucket 0 holds everything below 1 ms, bucket i everything below upper_bound_s(i).
+    static double upper_bound_s(unsigned index);
+    static unsigned bucket_index(double seconds);
+
+private:
+    std::array<uint64_t, bucket_count> _buckets;
+    uint64_t _count;
+    double _sum_s;
+    double _min_s;
+    double _max_s;
+};
+
+enum class PhaseEvent { ACK, COMPLETION };
+
+struct PhaseSample {
+    std::string phase;
+    PhaseEvent event;
+    bool success;
+    double seconds;
+};
+
+// Thread safe, so the workers of the test matrix can share one.
+class PhaseStats {
+public:
+    PhaseStats() = default;
+
+    void record(const std::string &phase, PhaseEvent event, bool success, double seconds);
+
+    std::vector<PhaseSample> samples() const;
+
+    // Appends the samples to a CSV file (run,phase,event,success,seconds), writing the header
+    // if the file is new. run identifies this process, it is the unix time it was started at.
+    bool append_csv(const std::string &path) const;
+
+    // Adds the samples of a CSV file written by append_csv.
+    bool load_csv(const std::string &path);
+
+    // Histograms of successful samples and failure counts per phase and event.
+    bool write_json(const std::string &path) const;
+
+    void print_summary() const;
+
+private:
+    PhaseStats(const PhaseStats &) = delete;
+    PhaseStats &operator=(const PhaseStats &) = delete;
+
+    struct Series {
+        Series() : failures(0) {}
+        LatencyHistogram histogram;
+        uint64_t failures;
+    };
+
+    typedef std::map<std::pair<std::string, PhaseEvent>, Series> SeriesMap;
+
+    SeriesMap series() const;
+
+    mutable std::mutex _mutex;
+    std::vector<PhaseSample> _samples;
+    std::vector<std::string> _sample_runs;
+};
+
+// Times one phase. stats may be null, then nothing is recorded.
+class PhaseTimer {
+public:
+    PhaseTimer(PhaseStats *stats, const std::string &phase, const Clock &clock = real_clock());
+
+    // The command was acknowledged (or rejected).
+    void acked(bool success = true);
+
+    // The vehicle has done what the command asked for (or gave up).
+    void completed(bool success = true);
+
+    double elapsed_s() const;
+
+private:
+    PhaseStats *_stats;
+    std::string _phase;
+    const Clock &_clock;
+    Clock::time_point _start;
+};
+
+const char *phase_event_str(PhaseEvent event);
+
+// Appends the samples of stats to prefix.csv, then writes the histograms over all runs in
+// prefix.csv to prefix.json and prints them.
+bool export_phase_stats(const PhaseStats &stats, const std::string &prefix);
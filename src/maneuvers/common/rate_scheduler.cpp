@@ -0,0 +1,241 @@
+#include "rate_scheduler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+
+#include "log_sink.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+namespace {
+
+// MAVLink 2 header and checksum, the messages are not signed.
+const uint64_t frame_overhead_bytes = 12;
+
+// GLOBAL_POSITION_INT carries position and ground speed, ATTITUDE_QUATERNION the attitude.
+const uint64_t global_position_frame_bytes = frame_overhead_bytes + 28;
+const uint64_t attitude_frame_bytes = frame_overhead_bytes + 32;
+
+const char *const flight_phase_names[flight_phase_count] = {
+    "ground", "takeoff", "cruise", "tracking", "arrival", "return", "descent"};
+
+size_t index_of(FlightPhase phase)
+{
+    return static_cast<size_t>(phase);
+}
+
+} // namespace
+
+const char *flight_phase_str(FlightPhase phase)
+{
+    return flight_phase_names[index_of(phase)];
+}
+
+RateProfile default_rate_profile()
+{
+    RateProfile profile;
+    profile[index_of(FlightPhase::GROUND)] = {1.0, 1.0};
+    profile[index_of(FlightPhase::TAKEOFF)] = {10.0, 1.0};
+    profile[index_of(FlightPhase::CRUISE)] = {2.0, 1.0};
+    profile[index_of(FlightPhase::TRACKING)] = {10.0, 1.0};
+    profile[index_of(FlightPhase::ARRIVAL)] = {50.0, 1.0};
+    profile[index_of(FlightPhase::RETURN)] = {10.0, 1.0};
+    profile[index_of(FlightPhase::DESCENT)] = {50.0, 1.0};
+    return profile;
+}
+
+PhaseRates peak_rates(const RateProfile &profile)
+{
+    PhaseRates peak = {0.0, 0.0};
+    for (const auto &rates : profile) {
+        peak.position_hz = std::max(peak.position_hz, rates.position_hz);
+        peak.attitude_hz = std::max(peak.attitude_hz, rates.attitude_hz);
+    }
+    return peak;
+}
+
+uint64_t PhaseLinkUsage::link_bytes() const
+{
+    // Position and ground speed are two streams of the SDK but one message on the link.
+    return std::max(position_messages, ground_speed_messages) * global_position_frame_bytes +
+           attitude_messages * attitude_frame_bytes;
+}
+
+void add_link_usage(LinkUsage &total, const LinkUsage &usage)
+{
+    for (size_t i = 0; i < flight_phase_count; ++i) {
+        total[i].seconds += usage[i].seconds;
+        total[i].position_messages += usage[i].position_messages;
+        total[i].ground_speed_messages += usage[i].ground_speed_messages;
+        total[i].attitude_messages += usage[i].attitude_messages;
+    }
+}
+
+uint64_t fixed_rate_link_bytes(const LinkUsage &usage, const PhaseRates &rates)
+{
+    double seconds = 0.0;
+    for (const auto &phase : usage) {
+        seconds += phase.seconds;
+    }
+    return static_cast<uint64_t>(seconds * (rates.position_hz * global_position_frame_bytes +
+                                            rates.attitude_hz * attitude_frame_bytes));
+}
+
+void print_link_usage(const LinkUsage &usage, const RateProfile &profile)
+{
+    log_info() << "Telemetry link usage per flight phase:";
+    log_info() << std::left << std::setw(10) << "phase" << std::right << std::setw(10) << "time_s"
+               << std::setw(12) << "position_hz" << std::setw(10) << "messages" << std::setw(10) << "bytes"
+               << std::setw(10) << "bytes/s";
+
+    double seconds = 0.0;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < flight_phase_count; ++i) {
+        const PhaseLinkUsage &phase = usage[i];
+        if (phase.seconds <= 0.0) {
+            continue;
+        }
+        seconds += phase.seconds;
+        bytes += phase.link_bytes();
+        log_info() << std::left << std::setw(10) << flight_phase_names[i] << std::right << std::fixed
+                   << std::setprecision(1) << std::setw(10) << phase.seconds << std::setw(12)
+                   << profile[i].position_hz << std::setw(10)
+                   << phase.position_messages + phase.ground_speed_messages + phase.attitude_messages
+                   << std::setw(10) << phase.link_bytes() << std::setw(10) << phase.link_bytes() / phase.seconds
+                   << std::defaultfloat;
+    }
+
+    const PhaseRates peak = peak_rates(profile);
+    const uint64_t fixed_bytes = fixed_rate_link_bytes(usage, peak);
+    LogLine line = log_info();
+    line << bytes << " bytes in " << seconds << " s, a fixed " << peak.position_hz << " Hz position and "
+         << peak.attitude_hz << " Hz attitude would have taken " << fixed_bytes << " bytes";
+    if (fixed_bytes > 0) {
+        line << " (" << std::fixed << std::setprecision(1) << 100.0 - 100.0 * bytes / fixed_bytes << " % saved)";
+    }
+}
+
+RateScheduler::RateScheduler(TelemetryMonitor &monitor, const RateProfile &profile) :
+    _monitor(monitor),
+    _profile(profile),
+    _phase(FlightPhase::GROUND),
+    _phase_start(monitor.clock().now()),
+    _usage(),
+    _position_hz(-1.0),
+    _attitude_hz(-1.0)
+{
+    _position_handle = _monitor.add_position_listener(
+        [this](const Telemetry::Position &) { count(&PhaseLinkUsage::position_messages); });
+    _ground_speed_handle = _monitor.add_ground_speed_listener(
+        [this](const Telemetry::GroundSpeedNED &) { count(&PhaseLinkUsage::ground_speed_messages); });
+    _attitude_handle = _monitor.add_attitude_listener(
+        [this](const Telemetry::EulerAngle &) { count(&PhaseLinkUsage::attitude_messages); });
+}
+
+RateScheduler::~RateScheduler()
+{
+    _monitor.remove_listener(_position_handle);
+    _monitor.remove_listener(_ground_speed_handle);
+    _monitor.remove_listener(_attitude_handle);
+}
+
+void RateScheduler::count(uint64_t PhaseLinkUsage::*messages)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++(_usage[index_of(_phase)].*messages);
+}
+
+void RateScheduler::switch_phase(FlightPhase phase)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Clock::time_point now = _monitor.clock().now();
+    _usage[index_of(_phase)].seconds += duration_cast<duration<double>>(now - _phase_start).count();
+    _phase = phase;
+    _phase_start = now;
+}
+
+Telemetry::Result RateScheduler::enter(FlightPhase phase)
+{
+    switch_phase(phase);
+
+    Telemetry::Result result = Telemetry::Result::SUCCESS;
+    const PhaseRates &rates = _profile[index_of(phase)];
+    if (rates.position_hz != _position_hz) {
+        _position_hz = rates.position_hz;
+        result = _monitor.set_rate_position(rates.position_hz);
+        const Telemetry::Result speed_result = _monitor.set_rate_ground_speed_ned(rates.position_hz);
+        if (result == Telemetry::Result::SUCCESS) {
+            result = speed_result;
+        }
+    }
+    if (rates.attitude_hz != _attitude_hz) {
+        _attitude_hz = rates.attitude_hz;
+        const Telemetry::Result attitude_result = _monitor.set_rate_attitude(rates.attitude_hz);
+        if (result == Telemetry::Result::SUCCESS) {
+            result = attitude_result;
+        }
+    }
+    return result;
+}
+
+void RateScheduler::enter_async(FlightPhase phase, Telemetry::result_callback_t callback)
+{
+    switch_phase(phase);
+
+    const PhaseRates &rates = _profile[index_of(phase)];
+    const bool position_changes = rates.position_hz != _position_hz;
+    const bool attitude_changes = rates.attitude_hz != _attitude_hz;
+    if (!position_changes && !attitude_changes) {
+        callback(Telemetry::Result::SUCCESS);
+        return;
+    }
+
+    // The results come in on the SDK thread, the last one reports the first failure.
+    struct Pending {
+        std::mutex mutex;
+        unsigned remaining;
+        Telemetry::Result result;
+    };
+    auto pending = std::make_shared<Pending>();
+    pending->remaining = (position_changes ? 2 : 0) + (attitude_changes ? 1 : 0);
+    pending->result = Telemetry::Result::SUCCESS;
+    const Telemetry::result_callback_t confirmed = [pending, callback](Telemetry::Result result) {
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            if (pending->result == Telemetry::Result::SUCCESS) {
+                pending->result = result;
+            }
+            if (--pending->remaining > 0) {
+                return;
+            }
+        }
+        callback(pending->result);
+    };
+
+    if (position_changes) {
+        _position_hz = rates.position_hz;
+        _monitor.set_rate_position_async(rates.position_hz, confirmed);
+        _monitor.set_rate_ground_speed_ned_async(rates.position_hz, confirmed);
+    }
+    if (attitude_changes) {
+        _attitude_hz = rates.attitude_hz;
+        _monitor.set_rate_attitude_async(rates.attitude_hz, confirmed);
+    }
+}
+
+FlightPhase RateScheduler::phase() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _phase;
+}
+
+LinkUsage RateScheduler::usage() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    LinkUsage usage = _usage;
+    usage[index_of(_phase)].seconds +=
+        duration_cast<duration<double>>(_monitor.clock().now() - _phase_start).count();
+    return usage;
+}
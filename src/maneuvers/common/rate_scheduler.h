@@ -0,0 +1,123 @@
+//
+// Telemetry stream rates which follow the phase of the flight.
+//
+// A rate fixed for the whole flight is either too slow where the maneuvers
+// watch the vehicle closely (the takeoff, arriving at a setpoint, the
+// descent of an RTL) or wastes link bandwidth in between. Instead, the
+// steps of a maneuver enter flight phases (Maneuver::enter_flight_phase)
+// and the scheduler sets the rates the profile has for the phase, e.g.
+// 50 Hz position while arriving or descending and 1-2 Hz on the ground and
+// in cruise.
+//
+// It also counts the messages arriving in every phase and the link bytes
+// of their MAVLink frames, so the savings against a fixed rate can be shown
+// (print_link_usage).
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "clock.h"
+#include "telemetry_monitor.h"
+
+enum class FlightPhase {
+    GROUND,   // before takeoff and after landing
+    TAKEOFF,  // climbing to the takeoff altitude
+    CRUISE,   // on the way somewhere, PX4 does the navigation
+    TRACKING, // following setpoints streamed by the maneuver (offboard)
+    ARRIVAL,  // close to a setpoint, until arrival is confirmed
+    RETURN,   // RTL, climbing and flying home
+    DESCENT   // RTL, descending and landing
+};
+
+const size_t flight_phase_count = 7;
+
+const char *flight_phase_str(FlightPhase phase);
+
+// Position and ground speed come in one MAVLink message (GLOBAL_POSITION_INT), so they always
+// run at the same rate.
+struct PhaseRates {
+    double position_hz;
+    double attitude_hz;
+};
+
+// Indexed by FlightPhase.
+typedef std::array<PhaseRates, flight_phase_count> RateProfile;
+
+RateProfile default_rate_profile();
+
+// The highest rates of any phase, what a fixed rate would have to be to watch every phase as closely.
+PhaseRates peak_rates(const RateProfile &profile);
+
+struct PhaseLinkUsage {
+    double seconds;
+    uint64_t position_messages;
+    uint64_t ground_speed_messages;
+    uint64_t attitude_messages;
+
+    // Of the MAVLink 2 frames which carried the messages.
+    uint64_t link_bytes() const;
+};
+
+// Indexed by FlightPhase.
+typedef std::array<PhaseLinkUsage, flight_phase_count> LinkUsage;
+
+void add_link_usage(LinkUsage &total, const LinkUsage &usage);
+
+// The bytes rates would have taken over the time of usage.
+uint64_t fixed_rate_link_bytes(const LinkUsage &usage, const PhaseRates &rates);
+
+// Per phase, and the total against the peak rates of profile for the whole time.
+void print_link_usage(const LinkUsage &usage, const RateProfile &profile);
+
+class RateScheduler {
+public:
+    // Counts from now on, without changing any rate before the first enter().
+    explicit RateScheduler(TelemetryMonitor &monitor, const RateProfile &profile = default_rate_profile());
+    ~RateScheduler();
+
+    // Sets the rates of phase which differ from the current ones and waits for the vehicle to
+    // confirm them, e.g. before the loop starts. Returns the first failure.
+    mavsdk::Telemetry::Result enter(FlightPhase phase);
+
+    // The same without waiting, for the loop thread: callback gets the first failure once all
+    // rates are confirmed, on the SDK thread (or right away if no rate changes).
+    void enter_async(FlightPhase phase, mavsdk::Telemetry::result_callback_t callback);
+
+    FlightPhase phase() const;
+    const RateProfile &profile() const { return _profile; }
+
+    // The current phase is counted up to now.
+    LinkUsage usage() const;
+
+private:
+    RateScheduler(const RateScheduler &) = delete;
+    RateScheduler &operator=(const RateScheduler &) = delete;
+
+    void count(uint64_t PhaseLinkUsage::*messages);
+
+    // Books the time of the current phase and switches to phase.
+    void switch_phase(FlightPhase phase);
+
+    TelemetryMonitor &_monitor;
+    const RateProfile _profile;
+
+    mutable std::mutex _mutex;
+    FlightPhase _phase;
+    Clock::time_point _phase_start;
+    LinkUsage _usage;
+
+    // Only touched by enter() and enter_async(), negative until set.
+    double _position_hz;
+    double _attitude_hz;
+
+    TelemetryMonitor::listener_handle_t _position_handle;
+    TelemetryMonitor::listener_handle_t _ground_speed_handle;
+    TelemetryMonitor::listener_handle_t _attitude_handle;
+};
@@ -0,0 +1,71 @@
+//
+// Value which one writer at a time replaces and any number of threads read
+// without locking.
+//
+// The writer makes the sequence number odd while it copies the value in
+// and even again afterwards. A reader copies the value out and retries if
+// the sequence number was odd or changed in between, so it never sees half
+// of an update and never makes the writer wait. The value is kept in
+// atomic words, which makes the racing copies well defined.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template<typename T>
+class Seqlock {
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock copies the value word by word");
+
+    explicit Seqlock(const T &value = T()) :
+        _sequence(0)
+    {
+        store(value);
+    }
+
+    // Writers have to be serialized by the caller.
+    void store(const T &value)
+    {
+        uint64_t words[word_count] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        const uint64_t sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < word_count; ++i) {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        uint64_t words[word_count];
+        uint64_t before, after;
+        do {
+            before = _sequence.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < word_count; ++i) {
+                words[i] = _words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    Seqlock(const Seqlock &) = delete;
+    Seqlock &operator=(const Seqlock &) = delete;
+
+    static const std::size_t word_count = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> _sequence;
+    std::atomic<uint64_t> _words[word_count];
+};
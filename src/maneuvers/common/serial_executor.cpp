@@ -0,0 +1,41 @@
+#include "serial_executor.h"
+
+SerialExecutor::SerialExecutor() :
+    _stop(false),
+    _thread(&SerialExecutor::run, this)
+{}
+
+SerialExecutor::~SerialExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+void SerialExecutor::post(task_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+}
+
+void SerialExecutor::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+        if (_tasks.empty()) {
+            return;
+        }
+        task_t task = std::move(_tasks.front());
+        _tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
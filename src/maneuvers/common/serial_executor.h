@@ -0,0 +1,38 @@
+//
+// Runs tasks one after the other on its own thread.
+//
+// Gives commands which only exist as blocking calls an asynchronous
+// version, without a thread per command.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class SerialExecutor {
+public:
+    typedef std::function<void()> task_t;
+
+    SerialExecutor();
+
+    // Runs the tasks which are still queued before it returns.
+    ~SerialExecutor();
+
+    void post(task_t task);
+
+private:
+    SerialExecutor(const SerialExecutor &) = delete;
+    SerialExecutor &operator=(const SerialExecutor &) = delete;
+
+    void run();
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<task_t> _tasks;
+    bool _stop;
+    std::thread _thread;
+};
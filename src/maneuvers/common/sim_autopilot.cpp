@@ -0,0 +1,713 @@
+#include "sim_autopilot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "geodesy.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+namespace {
+
+const double gravity_m_s2 = 9.81;
+const double rad_to_deg = 180.0 / M_PI;
+
+// 1/s, how fast the vehicle closes in on its target once it is slower than its limits.
+const double position_gain = 1.0;
+
+// Simulation step, smaller steps are used if the thread wakes up late.
+const double step_s = 0.01;
+
+// The SDK streams at roughly this rate until a rate is requested.
+const double default_stream_rate_hz = 5.0;
+
+// Armed state, flight mode etc. are sent with every heartbeat and whenever they change.
+const milliseconds status_interval(1000);
+
+bool due(Clock::time_point now, Clock::time_point &last, double rate_hz)
+{
+    if (rate_hz < 0.0) {
+        rate_hz = default_stream_rate_hz;
+    }
+    if (rate_hz <= 0.0 || now - last < duration<double>(1.0 / rate_hz)) {
+        return false;
+    }
+    last = now;
+    return true;
+}
+
+// The parameters of the vehicle which have a PX4 name, integers are kept in the float field.
+struct SimParam {
+    const char *name;
+    float SimVehicleParams::*field;
+    ParamValue::Type type;
+};
+
+const SimParam sim_params[] = {
+    {"MIS_TAKEOFF_ALT", &SimVehicleParams::takeoff_altitude_m, ParamValue::Type::FLOAT},
+    {"MPC_XY_CRUISE", &SimVehicleParams::max_horizontal_speed_m_s, ParamValue::Type::FLOAT},
+    {"MPC_Z_VEL_MAX_UP", &SimVehicleParams::max_climb_speed_m_s, ParamValue::Type::FLOAT},
+    {"MPC_Z_VEL_MAX_DN", &SimVehicleParams::max_descent_speed_m_s, ParamValue::Type::FLOAT},
+    {"MPC_LAND_SPEED", &SimVehicleParams::land_speed_m_s, ParamValue::Type::FLOAT},
+    {"RTL_RETURN_ALT", &SimVehicleParams::rtl_return_altitude_m, ParamValue::Type::FLOAT},
+    {"RTL_MIN_DIST", &SimVehicleParams::rtl_cone_distance_m, ParamValue::Type::FLOAT},
+    {"RTL_CONE_ANG", &SimVehicleParams::rtl_cone_angle_deg, ParamValue::Type::INT32},
+    {"NAV_ACC_RAD", &SimVehicleParams::acceptance_radius_m, ParamValue::Type::FLOAT},
+};
+
+const SimParam *find_sim_param(const std::string &name)
+{
+    for (const auto &param : sim_params) {
+        if (name == param.name) {
+            return &param;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+SimAutopilot::SimAutopilot(double speedup, const SimVehicleParams &params) :
+    _params(params),
+    _clock(speedup),
+    _monitor(_clock),
+    _start(_clock.now()),
+    _position({0.0, 0.0, 0.0}),
+    _velocity({0.0, 0.0, 0.0}),
+    _acceleration({0.0, 0.0, 0.0}),
+    _target({0.0, 0.0, 0.0}),
+    _yaw_deg(0.0f),
+    _armed(false),
+    _in_air(false),
+    _landed(true),
+    _flight_mode(Telemetry::FlightMode::READY),
+    _rtl_stage(RtlStage::CLIMB),
+    _mission_current(0),
+    _mission_finished(false),
+    _mission_progress_pending(false),
+    _offboard_setpoint({0.0, 0.0, 0.0}),
+    _offboard_velocity(false),
+    _offboard_setpoint_time(),
+    _published_armed(false),
+    _published_in_air(false),
+    _published_health(false),
+    _published_flight_mode(Telemetry::FlightMode::UNKNOWN),
+    _stop(false)
+{
+    publish(_start);
+    _thread = std::thread(&SimAutopilot::run, this);
+}
+
+SimAutopilot::~SimAutopilot()
+{
+    _stop = true;
+    _thread.join();
+}
+
+void SimAutopilot::run()
+{
+    auto last = _clock.now();
+    while (!_stop) {
+        _clock.sleep_for(duration_cast<Clock::duration>(duration<double>(step_s)));
+
+        const auto now = _clock.now();
+        double remaining_s = duration_cast<duration<double>>(now - last).count();
+        last = now;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            while (remaining_s > 0.0) {
+                const double dt_s = std::min(remaining_s, step_s);
+                step(dt_s, now);
+                remaining_s -= dt_s;
+            }
+        }
+        publish(now);
+    }
+}
+
+bool SimAutopilot::healthy(Clock::time_point now) const
+{
+    return now - _start >= _params.time_to_healthy;
+}
+
+void SimAutopilot::fly_towards(const Vector3 &target, double max_horizontal_speed_m_s, double dt_s)
+{
+    const double max_descent_speed_m_s = _flight_mode == Telemetry::FlightMode::LAND ||
+                                                 (_flight_mode == Telemetry::FlightMode::RETURN_TO_LAUNCH &&
+                                                  _rtl_stage == RtlStage::DESCEND) ?
+                                             _params.land_speed_m_s :
+                                             _params.max_descent_speed_m_s;
+
+    // Desired velocity: proportional to the distance, within the speed limits.
+    double north = (target.north - _position.north) * position_gain;
+    double east = (target.east - _position.east) * position_gain;
+    const double horizontal = std::sqrt(north * north + east * east);
+    if (horizontal > max_horizontal_speed_m_s) {
+        north *= max_horizontal_speed_m_s / horizontal;
+        east *= max_horizontal_speed_m_s / horizontal;
+    }
+    const double up = std::max(-max_descent_speed_m_s,
+                               std::min(double(_params.max_climb_speed_m_s),
+                                        (target.up - _position.up) * position_gain));
+
+    // Reach it with limited acceleration.
+    Vector3 change = {north - _velocity.north, east - _velocity.east, up - _velocity.up};
+    const double change_norm =
+        std::sqrt(change.north * change.north + change.east * change.east + change.up * change.up);
+    const double max_change = _params.max_acceleration_m_s2 * dt_s;
+    if (change_norm > max_change) {
+        change.north *= max_change / change_norm;
+        change.east *= max_change / change_norm;
+        change.up *= max_change / change_norm;
+    }
+
+    _acceleration = {change.north / dt_s, change.east / dt_s, change.up / dt_s};
+    _velocity.north += change.north;
+    _velocity.east += change.east;
+    _velocity.up += change.up;
+    _position.north += _velocity.north * dt_s;
+    _position.east += _velocity.east * dt_s;
+    _position.up += _velocity.up * dt_s;
+}
+
+void SimAutopilot::step(double dt_s, Clock::time_point now)
+{
+    if (!_armed) {
+        _velocity = {0.0, 0.0, 0.0};
+        _acceleration = {0.0, 0.0, 0.0};
+        return;
+    }
+
+    Vector3 target = _position;
+    double max_horizontal_speed_m_s = _params.max_horizontal_speed_m_s;
+
+    switch (_flight_mode) {
+        case Telemetry::FlightMode::TAKEOFF:
+            target = _target;
+            if (std::fabs(_position.up - _target.up) < 0.1) {
+                _flight_mode = Telemetry::FlightMode::HOLD;
+            }
+            break;
+
+        case Telemetry::FlightMode::HOLD:
+            target = _landed ? _position : _target;
+            break;
+
+        case Telemetry::FlightMode::MISSION:
+            if (_mission_current < _mission.size()) {
+                const Waypoint &waypoint = _mission[_mission_current];
+                target = waypoint.position;
+                if (waypoint.speed_m_s > 0.0f) {
+                    max_horizontal_speed_m_s = waypoint.speed_m_s;
+                }
+                // Take off vertically before heading to the first waypoint.
+                if (_position.up < _params.takeoff_altitude_m - 0.1) {
+                    target = {_position.north, _position.east,
+                              std::max(double(_params.takeoff_altitude_m), waypoint.position.up)};
+                }
+
+                const double north = waypoint.position.north - _position.north;
+                const double east = waypoint.position.east - _position.east;
+                const double up = waypoint.position.up - _position.up;
+                if (std::sqrt(north * north + east * east + up * up) < _params.acceptance_radius_m) {
+                    _mission_current++;
+                    _mission_progress_pending = true;
+                    if (_mission_current == _mission.size()) {
+                        _mission_finished = true;
+                        _target = waypoint.position;
+                        _flight_mode = Telemetry::FlightMode::HOLD;
+                    }
+                }
+            } else {
+                target = _target;
+            }
+            break;
+
+        case Telemetry::FlightMode::RETURN_TO_LAUNCH:
+            switch (_rtl_stage) {
+                case RtlStage::CLIMB:
+                    target = _target;
+                    if (std::fabs(_position.up - _target.up) < 0.3) {
+                        _rtl_stage = RtlStage::RETURN;
+                        _target = {0.0, 0.0, _target.up};
+                    }
+                    break;
+                case RtlStage::RETURN:
+                    target = _target;
+                    if (std::sqrt(_position.north * _position.north + _position.east * _position.east) < 0.5) {
+                        _rtl_stage = RtlStage::DESCEND;
+                    }
+                    break;
+                case RtlStage::DESCEND:
+                    target = {0.0, 0.0, -1.0};
+                    break;
+            }
+            break;
+
+        case Telemetry::FlightMode::LAND:
+            target = {_position.north, _position.east, -1.0};
+            break;
+
+        case Telemetry::FlightMode::OFFBOARD:
+            // Holds its position once the setpoints stop coming.
+            if (now - _offboard_setpoint_time > _params.offboard_loss_timeout) {
+                _target = _position;
+                _flight_mode = Telemetry::FlightMode::HOLD;
+                break;
+            }
+            if (_offboard_velocity) {
+                target = {_position.north + _offboard_setpoint.north / position_gain,
+                          _position.east + _offboard_setpoint.east / position_gain,
+                          _position.up + _offboard_setpoint.up / position_gain};
+            } else {
+                target = _offboard_setpoint;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (_landed && target.up <= _position.up) {
+        // Sitting on the ground, waiting for takeoff or the auto-disarm.
+        _velocity = {0.0, 0.0, 0.0};
+        _acceleration = {0.0, 0.0, 0.0};
+    } else {
+        fly_towards(target, max_horizontal_speed_m_s, dt_s);
+    }
+
+    if (_position.up > 0.1) {
+        _in_air = true;
+        _landed = false;
+    }
+    if (_position.up <= 0.0 && !_landed) {
+        _position.up = 0.0;
+        _velocity = {0.0, 0.0, 0.0};
+        _in_air = false;
+        _landed = true;
+        _landed_at = now;
+    }
+
+    const float horizontal_speed = std::sqrt(_velocity.north * _velocity.north + _velocity.east * _velocity.east);
+    if (_flight_mode != Telemetry::FlightMode::HOLD && horizontal_speed > 1.0f) {
+        _yaw_deg = std::atan2(_velocity.east, _velocity.north) * rad_to_deg;
+    }
+
+    // Disarms by itself shortly after landing, or if it doesn't take off after arming.
+    const bool landing = _flight_mode == Telemetry::FlightMode::RETURN_TO_LAUNCH ||
+                         _flight_mode == Telemetry::FlightMode::LAND;
+    if (_landed && now - _landed_at >= (landing ? _params.disarm_after_landing : _params.disarm_preflight)) {
+        _armed = false;
+    }
+}
+
+void SimAutopilot::publish(Clock::time_point now)
+{
+    Vector3 position, velocity, acceleration;
+    float yaw_deg;
+    bool armed, in_air;
+    Telemetry::FlightMode flight_mode;
+    Mission::progress_callback_t progress_callback;
+    int mission_current = 0;
+    int mission_total = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        position = _position;
+        velocity = _velocity;
+        acceleration = _acceleration;
+        yaw_deg = _yaw_deg;
+        armed = _armed;
+        in_air = _in_air;
+        flight_mode = _flight_mode;
+        if (_mission_progress_pending) {
+            _mission_progress_pending = false;
+            progress_callback = _mission_progress_callback;
+            mission_current = static_cast<int>(_mission_current);
+            mission_total = static_cast<int>(_mission.size());
+        }
+    }
+
+    if (due(now, _last_position_publish, _monitor.position_rate_hz())) {
+        Telemetry::Position telemetry_position;
+        geodesy::offset_north_east(_params.home.latitude_deg,
+                                   _params.home.longitude_deg,
+                                   position.north,
+                                   position.east,
+                                   telemetry_position.latitude_deg,
+                                   telemetry_position.longitude_deg);
+        telemetry_position.absolute_altitude_m = _params.home.absolute_altitude_m + float(position.up);
+        telemetry_position.relative_altitude_m = float(position.up);
+        _monitor.publish_position(telemetry_position);
+    }
+
+    if (due(now, _last_ground_speed_publish, _monitor.ground_speed_rate_hz())) {
+        _monitor.publish_ground_speed_ned(
+            {float(velocity.north), float(velocity.east), float(-velocity.up)});
+    }
+
+    if (due(now, _last_attitude_publish, _monitor.attitude_rate_hz())) {
+        // Tilt needed for the horizontal acceleration.
+        _monitor.publish_attitude_euler_angle(
+            {float(std::atan(acceleration.east / gravity_m_s2) * rad_to_deg),
+             float(-std::atan(acceleration.north / gravity_m_s2) * rad_to_deg),
+             yaw_deg});
+    }
+
+    const bool health = healthy(now);
+    const bool changed = armed != _published_armed || in_air != _published_in_air ||
+                         health != _published_health || flight_mode != _published_flight_mode;
+    if (changed || now - _last_status_publish >= status_interval) {
+        _last_status_publish = now;
+        _published_armed = armed;
+        _published_in_air = in_air;
+        _published_health = health;
+        _published_flight_mode = flight_mode;
+        _monitor.publish_health_all_ok(health);
+        _monitor.publish_in_air(in_air);
+        _monitor.publish_flight_mode(flight_mode);
+        _monitor.publish_armed(armed);
+    }
+
+    if (progress_callback) {
+        progress_callback(mission_current, mission_total);
+    }
+}
+
+SimAutopilot::Vector3
+SimAutopilot::to_local(double latitude_deg, double longitude_deg, double altitude_amsl_m) const
+{
+    Vector3 local;
+    geodesy::north_east_between(_params.home.latitude_deg,
+                                _params.home.longitude_deg,
+                                latitude_deg,
+                                longitude_deg,
+                                local.north,
+                                local.east);
+    local.up = altitude_amsl_m - _params.home.absolute_altitude_m;
+    return local;
+}
+
+Action::Result SimAutopilot::arm()
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto now = _clock.now();
+    if (!healthy(now)) {
+        return Action::Result::COMMAND_DENIED;
+    }
+    if (!_armed) {
+        _armed = true;
+        _landed_at = now;
+        _flight_mode = Telemetry::FlightMode::HOLD;
+    }
+    return Action::Result::SUCCESS;
+}
+
+Action::Result SimAutopilot::disarm()
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_in_air) {
+        return Action::Result::COMMAND_DENIED_NOT_LANDED;
+    }
+    _armed = false;
+    return Action::Result::SUCCESS;
+}
+
+Action::Result SimAutopilot::takeoff()
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_armed) {
+        return Action::Result::COMMAND_DENIED;
+    }
+    _target = {_position.north, _position.east, _params.takeoff_altitude_m};
+    _flight_mode = Telemetry::FlightMode::TAKEOFF;
+    return Action::Result::SUCCESS;
+}
+
+std::pair<Action::Result, float> SimAutopilot::get_takeoff_altitude()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::make_pair(Action::Result::SUCCESS, _params.takeoff_altitude_m);
+}
+
+Action::Result SimAutopilot::goto_location(double latitude_deg,
+                                           double longitude_deg,
+                                           float altitude_amsl_m,
+                                           float yaw_deg)
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_armed || !_in_air) {
+        return Action::Result::COMMAND_DENIED;
+    }
+    _target = to_local(latitude_deg, longitude_deg, altitude_amsl_m);
+    if (std::isfinite(yaw_deg)) {
+        _yaw_deg = yaw_deg;
+    }
+    _flight_mode = Telemetry::FlightMode::HOLD;
+    return Action::Result::SUCCESS;
+}
+
+Action::Result SimAutopilot::return_to_launch()
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_armed) {
+        return Action::Result::COMMAND_DENIED;
+    }
+
+    // Climb to the return altitude first, or only up to the cone when close to home.
+    const double distance_m = std::sqrt(_position.north * _position.north + _position.east * _position.east);
+    double return_altitude_m = _params.rtl_return_altitude_m;
+    if (distance_m < _params.rtl_cone_distance_m) {
+        const double cone_altitude_m = distance_m / std::tan(_params.rtl_cone_angle_deg / rad_to_deg);
+        return_altitude_m = std::min(return_altitude_m, cone_altitude_m);
+    }
+    return_altitude_m = std::max(return_altitude_m, _position.up);
+
+    _target = {_position.north, _position.east, return_altitude_m};
+    _rtl_stage = _in_air ? RtlStage::CLIMB : RtlStage::DESCEND;
+    _flight_mode = Telemetry::FlightMode::RETURN_TO_LAUNCH;
+    return Action::Result::SUCCESS;
+}
+
+Mission::Result SimAutopilot::upload_mission(const std::vector<std::shared_ptr<MissionItem>> &mission_items)
+{
+    // One round trip per item, as with the MAVLink mission protocol.
+    _clock.sleep_for(_params.command_latency * (mission_items.size() + 1));
+
+    std::vector<Waypoint> mission;
+    for (const auto &item : mission_items) {
+        if (!item || !item->has_position_set()) {
+            continue;
+        }
+        Waypoint waypoint;
+        waypoint.position = to_local(item->get_latitude_deg(),
+                                     item->get_longitude_deg(),
+                                     _params.home.absolute_altitude_m + item->get_relative_altitude_m());
+        const float speed_m_s = item->get_speed_m_s();
+        waypoint.speed_m_s = std::isfinite(speed_m_s) ? speed_m_s : 0.0f;
+        mission.push_back(waypoint);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_flight_mode == Telemetry::FlightMode::MISSION && !_mission_finished) {
+        return Mission::Result::BUSY;
+    }
+    _mission.swap(mission);
+    _mission_items = mission_items;
+    _mission_current = 0;
+    _mission_finished = false;
+    return Mission::Result::SUCCESS;
+}
+
+Mission::Result SimAutopilot::start_mission()
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_mission.empty()) {
+        return Mission::Result::NO_MISSION_AVAILABLE;
+    }
+    _flight_mode = Telemetry::FlightMode::MISSION;
+    _mission_progress_pending = true;
+    return Mission::Result::SUCCESS;
+}
+
+void SimAutopilot::subscribe_mission_progress(Mission::progress_callback_t callback)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _mission_progress_callback = callback;
+}
+
+bool SimAutopilot::mission_finished()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _mission_finished;
+}
+
+void SimAutopilot::arm_async(Action::result_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(arm()); });
+}
+
+void SimAutopilot::disarm_async(Action::result_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(disarm()); });
+}
+
+void SimAutopilot::takeoff_async(Action::result_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(takeoff()); });
+}
+
+void SimAutopilot::get_takeoff_altitude_async(takeoff_altitude_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(get_takeoff_altitude()); });
+}
+
+void SimAutopilot::goto_location_async(double latitude_deg,
+                                       double longitude_deg,
+                                       float altitude_amsl_m,
+                                       float yaw_deg,
+                                       Action::result_callback_t callback)
+{
+    _commands.post([this, latitude_deg, longitude_deg, altitude_amsl_m, yaw_deg, callback]() {
+        callback(goto_location(latitude_deg, longitude_deg, altitude_amsl_m, yaw_deg));
+    });
+}
+
+void SimAutopilot::return_to_launch_async(Action::result_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(return_to_launch()); });
+}
+
+void SimAutopilot::upload_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
+                                        Mission::result_callback_t callback)
+{
+    _commands.post([this, mission_items, callback]() { callback(upload_mission(mission_items)); });
+}
+
+void SimAutopilot::start_mission_async(Mission::result_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(start_mission()); });
+}
+
+void SimAutopilot::download_mission_async(Mission::mission_items_and_result_callback_t callback)
+{
+    _commands.post([this, callback]() {
+        std::vector<std::shared_ptr<MissionItem>> mission_items;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            mission_items = _mission_items;
+        }
+        _clock.sleep_for(_params.command_latency * (mission_items.size() + 1));
+        callback(mission_items.empty() ? Mission::Result::NO_MISSION_AVAILABLE : Mission::Result::SUCCESS,
+                 mission_items);
+    });
+}
+
+void SimAutopilot::mission_count_async(mission_count_callback_t callback)
+{
+    _commands.post([this, callback]() {
+        _clock.sleep_for(_params.command_latency);
+        int count = 0;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            count = static_cast<int>(_mission_items.size());
+        }
+        callback(std::make_pair(Mission::Result::SUCCESS, count));
+    });
+}
+
+void SimAutopilot::set_offboard_position_ned(const Offboard::PositionNEDYaw &setpoint)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _offboard_setpoint = {setpoint.north_m, setpoint.east_m, -setpoint.down_m};
+    _offboard_velocity = false;
+    _offboard_setpoint_time = _clock.now();
+}
+
+void SimAutopilot::set_offboard_velocity_ned(const Offboard::VelocityNEDYaw &setpoint)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _offboard_setpoint = {setpoint.north_m_s, setpoint.east_m_s, -setpoint.down_m_s};
+    _offboard_velocity = true;
+    _offboard_setpoint_time = _clock.now();
+}
+
+Offboard::Result SimAutopilot::start_offboard()
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_armed) {
+        return Offboard::Result::COMMAND_DENIED;
+    }
+    if (_clock.now() - _offboard_setpoint_time > _params.offboard_loss_timeout) {
+        return Offboard::Result::NO_SETPOINT_SET;
+    }
+    _flight_mode = Telemetry::FlightMode::OFFBOARD;
+    return Offboard::Result::SUCCESS;
+}
+
+Offboard::Result SimAutopilot::stop_offboard()
+{
+    _clock.sleep_for(_params.command_latency);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_flight_mode == Telemetry::FlightMode::OFFBOARD) {
+        _target = _position;
+        _flight_mode = Telemetry::FlightMode::HOLD;
+    }
+    return Offboard::Result::SUCCESS;
+}
+
+void SimAutopilot::start_offboard_async(Offboard::result_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(start_offboard()); });
+}
+
+void SimAutopilot::stop_offboard_async(Offboard::result_callback_t callback)
+{
+    _commands.post([this, callback]() { callback(stop_offboard()); });
+}
+
+bool parse_sim_url(const std::string &url, double &speedup)
+{
+    const std::string prefix = "sim://";
+    if (url.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    const std::string rest = url.substr(prefix.size());
+    if (rest.empty()) {
+        speedup = 10.0;
+        return true;
+    }
+    char *end = nullptr;
+    speedup = std::strtod(rest.c_str(), &end);
+    return *end == '\0' && speedup > 0.0;
+}
+
+void SimAutopilot::get_params_async(const std::vector<std::string> &names, get_params_callback_t callback)
+{
+    _commands.post([this, names, callback]() {
+        _clock.sleep_for(_params.command_latency);
+        ParamTable params;
+        Param::Result result = Param::Result::SUCCESS;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto &name : names) {
+                const SimParam *param = find_sim_param(name);
+                if (!param) {
+                    result = Param::Result::TIMEOUT;
+                    continue;
+                }
+                params[name] = ParamValue::of_type(param->type, _params.*param->field);
+            }
+        }
+        callback(std::make_pair(result, params));
+    });
+}
+
+void SimAutopilot::set_param_async(const std::string &name, const ParamValue &value, param_result_callback_t callback)
+{
+    _commands.post([this, name, value, callback]() {
+        _clock.sleep_for(_params.command_latency);
+        const SimParam *param = find_sim_param(name);
+        if (!param) {
+            callback(Param::Result::TIMEOUT);
+            return;
+        }
+        if (param->type != value.type) {
+            callback(Param::Result::WRONG_TYPE);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _params.*param->field = static_cast<float>(value.as_double());
+        }
+        callback(Param::Result::SUCCESS);
+    });
+}
@@ -0,0 +1,195 @@
+//
+// In-process stand-in for PX4, to run the maneuvers without a simulator.
+//
+// The vehicle is a point mass which flies towards its current target with
+// limited speed and acceleration. It answers the same commands as the real
+// vehicle (arm, takeoff, goto, RTL including the climb/cone logic, missions
+// with progress, offboard setpoints, parameters) and publishes telemetry
+// into its TelemetryMonitor at the rates the maneuvers request, all on a
+// ScaledClock. A maneuver that takes minutes against SITL thus runs in
+// seconds.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "autopilot.h"
+#include "clock.h"
+#include "serial_executor.h"
+#include "telemetry_monitor.h"
+
+// Defaults follow the PX4 multicopter parameters of the same meaning. Those with a name can
+// also be read and set through get_params_async and set_param_async.
+struct SimVehicleParams {
+    mavsdk::Telemetry::Position home;
+    float takeoff_altitude_m;       // MIS_TAKEOFF_ALT
+    float max_horizontal_speed_m_s; // MPC_XY_CRUISE
+    float max_climb_speed_m_s;      // MPC_Z_VEL_MAX_UP
+    float max_descent_speed_m_s;    // MPC_Z_VEL_MAX_DN
+    float land_speed_m_s;           // MPC_LAND_SPEED
+    float max_acceleration_m_s2;
+    float rtl_return_altitude_m; // RTL_RETURN_ALT
+    float rtl_cone_distance_m;   // RTL_MIN_DIST, closer than this RTL only climbs to the cone
+    float rtl_cone_angle_deg;    // RTL_CONE_ANG
+    float acceptance_radius_m;   // NAV_ACC_RAD
+    std::chrono::milliseconds time_to_healthy;
+    std::chrono::milliseconds disarm_after_landing;  // COM_DISARM_LAND
+    std::chrono::milliseconds disarm_preflight;      // COM_DISARM_PRFLT
+    std::chrono::milliseconds offboard_loss_timeout; // COM_OF_LOSS_T
+    std::chrono::milliseconds command_latency;
+
+    SimVehicleParams() :
+        home({47.397742, 8.545594, 488.0f, 0.0f}),
+        takeoff_altitude_m(2.5f),
+        max_horizontal_speed_m_s(5.0f),
+        max_climb_speed_m_s(3.0f),
+        max_descent_speed_m_s(1.0f),
+        land_speed_m_s(0.7f),
+        max_acceleration_m_s2(3.0f),
+        rtl_return_altitude_m(30.0f),
+        rtl_cone_distance_m(5.0f),
+        rtl_cone_angle_deg(45.0f),
+        acceptance_radius_m(1.0f),
+        time_to_healthy(2000),
+        disarm_after_landing(2000),
+        disarm_preflight(10000),
+        offboard_loss_timeout(1000),
+        command_latency(20)
+    {}
+};
+
+class SimAutopilot : public Autopilot {
+public:
+    explicit SimAutopilot(double speedup, const SimVehicleParams &params = SimVehicleParams());
+    ~SimAutopilot();
+
+    TelemetryMonitor &monitor() override { return _monitor; }
+
+    void subscribe_mission_progress(mavsdk::Mission::progress_callback_t callback) override;
+    bool mission_finished() override;
+
+    // The commands take their simulated latency on a worker thread.
+    void arm_async(mavsdk::Action::result_callback_t callback) override;
+    void disarm_async(mavsdk::Action::result_callback_t callback) override;
+    void takeoff_async(mavsdk::Action::result_callback_t callback) override;
+    void get_takeoff_altitude_async(takeoff_altitude_callback_t callback) override;
+    void goto_location_async(double latitude_deg,
+                             double longitude_deg,
+                             float altitude_amsl_m,
+                             float yaw_deg,
+                             mavsdk::Action::result_callback_t callback) override;
+    void return_to_launch_async(mavsdk::Action::result_callback_t callback) override;
+    void upload_mission_async(const std::vector<std::shared_ptr<mavsdk::MissionItem>> &mission_items,
+                              mavsdk::Mission::result_callback_t callback) override;
+    void start_mission_async(mavsdk::Mission::result_callback_t callback) override;
+    void download_mission_async(mavsdk::Mission::mission_items_and_result_callback_t callback) override;
+    void mission_count_async(mission_count_callback_t callback) override;
+
+    void set_offboard_position_ned(const mavsdk::Offboard::PositionNEDYaw &setpoint) override;
+    void set_offboard_velocity_ned(const mavsdk::Offboard::VelocityNEDYaw &setpoint) override;
+    void start_offboard_async(mavsdk::Offboard::result_callback_t callback) override;
+    void stop_offboard_async(mavsdk::Offboard::result_callback_t callback) override;
+
+    // A batch costs a single command latency, as its requests are all in flight together.
+    void get_params_async(const std::vector<std::string> &names, get_params_callback_t callback) override;
+    void set_param_async(const std::string &name, const ParamValue &value, param_result_callback_t callback) override;
+
+private:
+    SimAutopilot(const SimAutopilot &) = delete;
+    SimAutopilot &operator=(const SimAutopilot &) = delete;
+
+    enum class RtlStage { CLIMB, RETURN, DESCEND };
+
+    // Position relative to home, up positive.
+    struct Vector3 {
+        double north;
+        double east;
+        double up;
+    };
+
+    struct Waypoint {
+        Vector3 position;
+        float speed_m_s;
+    };
+
+    // The commands, run on the worker thread.
+    mavsdk::Action::Result arm();
+    mavsdk::Action::Result disarm();
+    mavsdk::Action::Result takeoff();
+    std::pair<mavsdk::Action::Result, float> get_takeoff_altitude();
+    mavsdk::Action::Result goto_location(double latitude_deg,
+                                         double longitude_deg,
+                                         float altitude_amsl_m,
+                                         float yaw_deg);
+    mavsdk::Action::Result return_to_launch();
+
+    mavsdk::Mission::Result
+    upload_mission(const std::vector<std::shared_ptr<mavsdk::MissionItem>> &mission_items);
+    mavsdk::Mission::Result start_mission();
+
+    void run();
+    void step(double dt_s, Clock::time_point now);
+    void fly_towards(const Vector3 &target, double max_horizontal_speed_m_s, double dt_s);
+    void publish(Clock::time_point now);
+    Vector3 to_local(double latitude_deg, double longitude_deg, double altitude_amsl_m) const;
+    bool healthy(Clock::time_point now) const;
+    mavsdk::Offboard::Result start_offboard();
+    mavsdk::Offboard::Result stop_offboard();
+
+    // The named ones are guarded by _mutex, they can be set.
+    SimVehicleParams _params;
+    ScaledClock _clock;
+    TelemetryMonitor _monitor;
+    const Clock::time_point _start;
+
+    std::mutex _mutex;
+    Vector3 _position;
+    Vector3 _velocity;
+    Vector3 _acceleration;
+    Vector3 _target;
+    float _yaw_deg;
+    bool _armed;
+    bool _in_air;
+    bool _landed;
+    Clock::time_point _landed_at;
+    mavsdk::Telemetry::FlightMode _flight_mode;
+    RtlStage _rtl_stage;
+
+    std::vector<Waypoint> _mission;
+    std::vector<std::shared_ptr<mavsdk::MissionItem>> _mission_items; // as uploaded, for downloads
+    size_t _mission_current;
+    bool _mission_finished;
+    bool _mission_progress_pending;
+    mavsdk::Mission::progress_callback_t _mission_progress_callback;
+
+    // Latest offboard setpoint, a velocity or a position.
+    Vector3 _offboard_setpoint;
+    bool _offboard_velocity;
+    Clock::time_point _offboard_setpoint_time;
+
+    // Only touched by the simulation thread.
+    Clock::time_point _last_position_publish;
+    Clock::time_point _last_ground_speed_publish;
+    Clock::time_point _last_attitude_publish;
+    Clock::time_point _last_status_publish;
+    bool _published_armed;
+    bool _published_in_air;
+    bool _published_health;
+    mavsdk::Telemetry::FlightMode _published_flight_mode;
+
+    std::atomic<bool> _stop;
+    std::thread _thread;
+
+    // Declared last, so queued commands still find the vehicle state.
+    SerialExecutor _commands;
+};
+
+// URLs of the form "sim://" or "sim://<speedup>" select the SimAutopilot, by default at 10x.
+bool parse_sim_url(const std::string &url, double &speedup);
@@ -0,0 +1,77 @@
+//
+// Bounded lock-free ring buffer for exactly one producer and one consumer
+// thread.
+//
+// try_push() and try_pop() never block; a full buffer makes try_push()
+// fail, so the producer can count the drop and move on.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template<typename T>
+class SpscRingBuffer {
+public:
+    // The capacity is rounded up to a power of two.
+    explicit SpscRingBuffer(std::size_t capacity) :
+        _buffer(round_up_to_power_of_two(capacity)),
+        _mask(_buffer.size() - 1),
+        _head(0),
+        _tail(0)
+    {}
+
+    std::size_t capacity() const { return _buffer.size(); }
+
+    // Producer side.
+    bool try_push(const T &value)
+    {
+        const std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == _buffer.size()) {
+            return false;
+        }
+        _buffer[head & _mask] = value;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side.
+    bool try_pop(T &value)
+    {
+        const std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = _buffer[tail & _mask];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot when called while the other side is active.
+    std::size_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    SpscRingBuffer(const SpscRingBuffer &) = delete;
+    SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+    static std::size_t round_up_to_power_of_two(std::size_t value)
+    {
+        std::size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::vector<T> _buffer;
+    const std::size_t _mask;
+
+    // Head and tail on their own cache lines, so producer and consumer don't share one.
+    alignas(64) std::atomic<std::size_t> _head;
+    alignas(64) std::atomic<std::size_t> _tail;
+};
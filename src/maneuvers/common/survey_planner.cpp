@@ -0,0 +1,336 @@
+#include "survey_planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "geodesy.h"
+#include "log_sink.h"
+
+using namespace mavsdk;
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const double deg_to_rad = pi / 180.0;
+
+// The SDK default of MissionItem, which MissionItemRecord does not carry.
+const double photo_interval_s = 1.0;
+
+// Largest angle between two spiral waypoints, so the innermost turns stay round.
+const double max_spiral_step_rad = 0.5;
+
+// Widths this close to a multiple of the line spacing count as the multiple, so rounding in the
+// spacing does not add a line.
+const double line_count_tolerance = 1e-9;
+
+// Waypoints as offsets from the origin, converted into positions at the end.
+struct LocalPath {
+    std::vector<double> north_m;
+    std::vector<double> east_m;
+    std::vector<MissionItem::CameraAction> camera_actions;
+
+    void add(double north, double east, MissionItem::CameraAction camera_action)
+    {
+        north_m.push_back(north);
+        east_m.push_back(east);
+        camera_actions.push_back(camera_action);
+    }
+
+    // Camera action of the index-th of count waypoints over the polygon in a row.
+    static MissionItem::CameraAction pass_action(size_t index, size_t count)
+    {
+        if (count == 1) {
+            return MissionItem::CameraAction::TAKE_PHOTO;
+        }
+        if (index == 0) {
+            return MissionItem::CameraAction::START_PHOTO_INTERVAL;
+        }
+        return index + 1 == count ? MissionItem::CameraAction::STOP_PHOTO_INTERVAL
+                                  : MissionItem::CameraAction::NONE;
+    }
+};
+
+// Even-odd rule, points on an edge may be on either side.
+bool inside_polygon(const std::vector<SurveyPoint> &polygon, double north_m, double east_m)
+{
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const SurveyPoint &a = polygon[i];
+        const SurveyPoint &b = polygon[j];
+        if ((a.north_m > north_m) != (b.north_m > north_m) &&
+            east_m < a.east_m + (north_m - a.north_m) * (b.east_m - a.east_m) / (b.north_m - a.north_m)) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+void plan_lawnmower(const std::vector<SurveyPoint> &polygon,
+                    const SurveySettings &settings,
+                    const SurveyGeometry &geometry,
+                    LocalPath &path)
+{
+    // Along the lines is u, across them v.
+    const double heading_rad = settings.line_heading_deg * deg_to_rad;
+    const double along_north = std::cos(heading_rad), along_east = std::sin(heading_rad);
+    const double across_north = -along_east, across_east = along_north;
+
+    std::vector<double> u(polygon.size()), v(polygon.size());
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        u[i] = polygon[i].north_m * along_north + polygon[i].east_m * along_east;
+        v[i] = polygon[i].north_m * across_north + polygon[i].east_m * across_east;
+    }
+    const double v_min = *std::min_element(v.begin(), v.end());
+    const double v_max = *std::max_element(v.begin(), v.end());
+
+    // As few lines as cover the polygon at line spacing, centered over it. The outermost lies
+    // at most half a line spacing inside the edge, exactly half only when the width is a multiple
+    // of the spacing. A polygon narrower than the spacing gets one line through its middle.
+    const double widths = (v_max - v_min) / geometry.line_spacing_m;
+    const size_t line_count = std::max<size_t>(1, std::ceil(widths - line_count_tolerance));
+    const double first_v = v_min + ((v_max - v_min) - (line_count - 1) * geometry.line_spacing_m) / 2.0;
+
+    std::vector<double> crossings;
+    for (size_t line = 0; line < line_count; ++line) {
+        const double line_v = first_v + line * geometry.line_spacing_m;
+
+        crossings.clear();
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+            if ((v[i] > line_v) != (v[j] > line_v)) {
+                crossings.push_back(u[i] + (line_v - v[i]) * (u[j] - u[i]) / (v[j] - v[i]));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Every other line backwards, the parts of a concave polygon in the same order.
+        const bool forward = line % 2 == 0;
+        const size_t parts = crossings.size() / 2;
+        for (size_t p = 0; p < parts; ++p) {
+            const size_t part = forward ? p : parts - 1 - p;
+            const double start_u = crossings[forward ? 2 * part : 2 * part + 1];
+            const double end_u = crossings[forward ? 2 * part + 1 : 2 * part];
+            const double length_m = std::fabs(end_u - start_u);
+
+            size_t legs = 1;
+            if (settings.waypoint_spacing_m > 0.0) {
+                legs = std::max<size_t>(1, std::ceil(length_m / settings.waypoint_spacing_m));
+            }
+            const size_t count = length_m > 0.0 ? legs + 1 : 1;
+            for (size_t i = 0; i < count; ++i) {
+                const double point_u = start_u + (end_u - start_u) * i / legs;
+                path.add(point_u * along_north + line_v * across_north,
+                         point_u * along_east + line_v * across_east,
+                         LocalPath::pass_action(i, count));
+            }
+        }
+    }
+}
+
+void plan_spiral(const std::vector<SurveyPoint> &polygon,
+                 const SurveySettings &settings,
+                 const SurveyGeometry &geometry,
+                 LocalPath &path)
+{
+    SurveyPoint center = {0.0, 0.0};
+    for (const auto &point : polygon) {
+        center.north_m += point.north_m / polygon.size();
+        center.east_m += point.east_m / polygon.size();
+    }
+    double max_radius_m = 0.0;
+    for (const auto &point : polygon) {
+        max_radius_m = std::max(max_radius_m, std::hypot(point.north_m - center.north_m,
+                                                         point.east_m - center.east_m));
+    }
+
+    // Archimedean spiral inwards, one line spacing closer per turn, sampled at equal distances
+    // along the curve.
+    const double step_m = settings.waypoint_spacing_m > 0.0 ? settings.waypoint_spacing_m : geometry.photo_spacing_m;
+    const double radius_per_rad = geometry.line_spacing_m / (2.0 * pi);
+    std::vector<double> angle, radius;
+    double r = max_radius_m - geometry.line_spacing_m / 2.0;
+    double a = 0.0;
+    while (r > 0.0) {
+        angle.push_back(a);
+        radius.push_back(r);
+        const double step_rad = std::min(step_m / r, max_spiral_step_rad);
+        a += step_rad;
+        r -= radius_per_rad * step_rad;
+    }
+    angle.push_back(a);
+    radius.push_back(0.0);
+
+    const size_t count = angle.size();
+    std::vector<double> sin_angle(count), cos_angle(count), north(count), east(count);
+    geodesy::sincos(angle.data(), count, sin_angle.data(), cos_angle.data());
+    for (size_t i = 0; i < count; ++i) {
+        north[i] = center.north_m + radius[i] * cos_angle[i];
+        east[i] = center.east_m + radius[i] * sin_angle[i];
+    }
+
+    // Only the waypoints over the polygon, the camera runs from entering it to leaving it.
+    size_t i = 0;
+    while (i < count) {
+        if (!inside_polygon(polygon, north[i], east[i])) {
+            ++i;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < count && inside_polygon(polygon, north[end], east[end])) {
+            ++end;
+        }
+        for (size_t j = i; j < end; ++j) {
+            path.add(north[j], east[j], LocalPath::pass_action(j - i, end - i));
+        }
+        i = end;
+    }
+}
+
+bool camera_running_after(bool running, uint8_t camera_action)
+{
+    switch (static_cast<MissionItem::CameraAction>(camera_action)) {
+        case MissionItem::CameraAction::START_PHOTO_INTERVAL:
+            return true;
+        case MissionItem::CameraAction::STOP_PHOTO_INTERVAL:
+            return false;
+        default:
+            return running;
+    }
+}
+
+} // namespace
+
+SurveyGeometry survey_geometry(const SurveySettings &settings)
+{
+    const double footprint_width_m = 2.0 * settings.altitude_m * std::tan(settings.horizontal_fov_deg * deg_to_rad / 2.0);
+    const double footprint_length_m = 2.0 * settings.altitude_m * std::tan(settings.vertical_fov_deg * deg_to_rad / 2.0);
+
+    SurveyGeometry geometry;
+    geometry.line_spacing_m = footprint_width_m * (1.0 - settings.side_overlap);
+    geometry.photo_spacing_m = footprint_length_m * (1.0 - settings.front_overlap);
+    geometry.speed_m_s = static_cast<float>(std::min<double>(settings.max_speed_m_s,
+                                                             geometry.photo_spacing_m / photo_interval_s));
+    return geometry;
+}
+
+bool parse_survey_area(const std::string &text, SurveySettings &settings, double &width_m, double &length_m)
+{
+    std::string fields_text = text;
+    std::replace(fields_text.begin(), fields_text.end(), ',', ' ');
+    std::istringstream fields(fields_text);
+
+    std::string pattern;
+    double width, length;
+    if (!(fields >> pattern >> width >> length) || width <= 0.0 || length <= 0.0) {
+        return false;
+    }
+    SurveySettings parsed = settings;
+    if (pattern == "lawnmower") {
+        parsed.pattern = SurveyPattern::LAWNMOWER;
+    } else if (pattern == "spiral") {
+        parsed.pattern = SurveyPattern::SPIRAL;
+    } else {
+        return false;
+    }
+    double spacing;
+    if (fields >> spacing) {
+        parsed.waypoint_spacing_m = spacing;
+    }
+
+    settings = parsed;
+    width_m = width;
+    length_m = length;
+    return true;
+}
+
+std::vector<SurveyPoint> survey_rectangle(double width_m, double length_m)
+{
+    std::vector<SurveyPoint> polygon;
+    polygon.push_back({0.0, 0.0});
+    polygon.push_back({length_m, 0.0});
+    polygon.push_back({length_m, width_m});
+    polygon.push_back({0.0, width_m});
+    return polygon;
+}
+
+bool plan_survey(double origin_lat_deg,
+                 double origin_lon_deg,
+                 const std::vector<SurveyPoint> &polygon,
+                 const SurveySettings &settings,
+                 MissionBuilder &mission)
+{
+    if (polygon.size() < 3) {
+        log_error() << "A survey area needs at least 3 corners";
+        return false;
+    }
+    if (!(settings.altitude_m > 0.0f) ||
+        !(settings.horizontal_fov_deg > 0.0f && settings.horizontal_fov_deg < 180.0f) ||
+        !(settings.vertical_fov_deg > 0.0f && settings.vertical_fov_deg < 180.0f) ||
+        !(settings.side_overlap >= 0.0f && settings.side_overlap < 1.0f) ||
+        !(settings.front_overlap >= 0.0f && settings.front_overlap < 1.0f) ||
+        !(settings.max_speed_m_s > 0.0f) || settings.waypoint_spacing_m < 0.0) {
+        log_error() << "Invalid survey settings";
+        return false;
+    }
+
+    const SurveyGeometry geometry = survey_geometry(settings);
+    LocalPath path;
+    switch (settings.pattern) {
+        case SurveyPattern::LAWNMOWER:
+            plan_lawnmower(polygon, settings, geometry, path);
+            break;
+        case SurveyPattern::SPIRAL:
+            plan_spiral(polygon, settings, geometry, path);
+            break;
+    }
+
+    const size_t count = path.north_m.size();
+    std::vector<double> latitude(count), longitude(count);
+    geodesy::offset_north_east(origin_lat_deg, origin_lon_deg, path.north_m.data(), path.east_m.data(), count,
+                               latitude.data(), longitude.data());
+
+    const size_t first = mission.size();
+    mission.reserve(first + count);
+    mission.add_positions(latitude.data(), longitude.data(), count,
+                          make_mission_item_record(0.0, 0.0, settings.altitude_m, geometry.speed_m_s, true,
+                                                   -90.0f, 0.0f, 0.0f, MissionItem::CameraAction::NONE));
+    for (size_t i = 0; i < count; ++i) {
+        mission[first + i].camera_action = static_cast<uint8_t>(path.camera_actions[i]);
+    }
+    return true;
+}
+
+std::vector<MissionBuilder> split_mission(const MissionBuilder &mission, std::size_t max_items)
+{
+    std::vector<MissionBuilder> segments;
+    max_items = std::max<std::size_t>(max_items, 2);
+
+    const auto &items = mission.items();
+    size_t next = 0;
+    bool camera_running = false;
+    while (next < items.size()) {
+        segments.emplace_back();
+        MissionBuilder &segment = segments.back();
+
+        // Continue from where the last segment ended.
+        if (next > 0) {
+            MissionItemRecord resume = items[next - 1];
+            resume.camera_action = static_cast<uint8_t>(camera_running ? MissionItem::CameraAction::START_PHOTO_INTERVAL
+                                                                       : MissionItem::CameraAction::NONE);
+            segment.add_item(resume);
+        }
+
+        const size_t end = std::min(items.size(), next + max_items - segment.size());
+        segment.reserve(segment.size() + end - next);
+        for (; next < end; ++next) {
+            segment.add_item(items[next]);
+            camera_running = camera_running_after(camera_running, items[next].camera_action);
+        }
+
+        // No photos while the next segment is uploaded.
+        if (next < items.size() && camera_running) {
+            segment[segment.size() - 1].camera_action = static_cast<uint8_t>(MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
+        }
+    }
+    return segments;
+}
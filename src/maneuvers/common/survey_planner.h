@@ -0,0 +1,86 @@
+//
+// Coverage missions over a polygon for a camera looking straight down.
+//
+// The footprint of the camera at the survey altitude and the requested
+// overlaps give the distance between neighbouring lines and between
+// photos. A lawnmower pattern covers the polygon with parallel lines at a
+// given heading, a spiral winds inwards from its outline. The camera takes
+// photos at an interval while over the polygon and stops on the way between
+// lines. Waypoints are generated as north/east offsets first and converted
+// into positions with one batch geodesy call, so planning costs time linear
+// in the number of items (and polygon edges per line).
+//
+// Autopilots only hold a limited number of mission items. split_mission()
+// cuts a long mission into segments which are flown one after the other.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "mission_builder.h"
+
+// Offset from the origin of the survey.
+struct SurveyPoint {
+    double north_m;
+    double east_m;
+};
+
+enum class SurveyPattern { LAWNMOWER, SPIRAL };
+
+struct SurveySettings {
+    SurveyPattern pattern;
+    float altitude_m; // above home
+    float horizontal_fov_deg; // across the track
+    float vertical_fov_deg;   // along the track
+    float side_overlap;       // of neighbouring lines, 0 to below 1
+    float front_overlap;      // of consecutive photos, 0 to below 1
+    float max_speed_m_s;
+    double line_heading_deg; // direction of the lawnmower lines, clockwise from north
+    // Lines are cut into legs no longer than this, 0 for waypoints only where lines start and
+    // end. The spiral uses the photo distance if 0.
+    double waypoint_spacing_m;
+
+    SurveySettings() :
+        pattern(SurveyPattern::LAWNMOWER),
+        altitude_m(30.0f),
+        horizontal_fov_deg(73.0f),
+        vertical_fov_deg(53.0f),
+        side_overlap(0.6f),
+        front_overlap(0.7f),
+        max_speed_m_s(10.0f),
+        line_heading_deg(0.0),
+        waypoint_spacing_m(0.0)
+    {}
+};
+
+struct SurveyGeometry {
+    double line_spacing_m;
+    double photo_spacing_m;
+    // Gives the photo distance at the 1 s photo interval of the mission items.
+    float speed_m_s;
+};
+
+SurveyGeometry survey_geometry(const SurveySettings &settings);
+
+// Reads "pattern,width_m,length_m[,waypoint_spacing_m]" (pattern is lawnmower or spiral) of a
+// rectangular survey, false if malformed.
+bool parse_survey_area(const std::string &text, SurveySettings &settings, double &width_m, double &length_m);
+
+// Rectangle with one corner at the origin, length_m to the north and width_m to the east.
+std::vector<SurveyPoint> survey_rectangle(double width_m, double length_m);
+
+// Appends the items covering polygon, given around (origin_lat_deg, origin_lon_deg), to mission.
+// False if the polygon or the settings are invalid.
+bool plan_survey(double origin_lat_deg,
+                 double origin_lon_deg,
+                 const std::vector<SurveyPoint> &polygon,
+                 const SurveySettings &settings,
+                 MissionBuilder &mission);
+
+// Segments of at most max_items (at least 2) items. A segment after the first starts at the
+// last waypoint of the one before, and the camera is stopped at the end of a segment and
+// started again at the beginning of the next one if it was running.
+std::vector<MissionBuilder> split_mission(const MissionBuilder &mission, std::size_t max_items);
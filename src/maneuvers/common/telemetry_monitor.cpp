@@ -0,0 +1,374 @@
+#include "telemetry_monitor.h"
+
+#include <algorithm>
+
+using namespace mavsdk;
+
+namespace {
+
+// State of a vehicle nothing was heard from yet.
+TelemetrySnapshot initial_snapshot()
+{
+    TelemetrySnapshot snapshot = {};
+    snapshot.flight_mode = Telemetry::FlightMode::UNKNOWN;
+    return snapshot;
+}
+
+// The state the SDK already has.
+TelemetrySnapshot sdk_snapshot(Telemetry &telemetry)
+{
+    TelemetrySnapshot snapshot;
+    snapshot.position = telemetry.position();
+    snapshot.ground_speed = telemetry.ground_speed_ned();
+    snapshot.attitude = telemetry.attitude_euler_angle();
+    snapshot.flight_mode = telemetry.flight_mode();
+    snapshot.armed = telemetry.armed();
+    snapshot.in_air = telemetry.in_air();
+    snapshot.health_all_ok = telemetry.health_all_ok();
+    return snapshot;
+}
+
+} // namespace
+
+TelemetryMonitor::TelemetryMonitor(Telemetry &telemetry, const Clock &clock) :
+    _telemetry(&telemetry),
+    _clock(clock),
+    _state(sdk_snapshot(telemetry)),
+    _snapshot(_state),
+    _next_handle(1),
+    _minimum_rate_hz(0.0),
+    _position_rate_hz(-1.0),
+    _ground_speed_rate_hz(-1.0),
+    _attitude_rate_hz(-1.0),
+    _waiter(clock)
+{
+    _telemetry->position_async([this](Telemetry::Position position) {
+        update(&TelemetrySnapshot::position, position, _position_listeners);
+    });
+
+    _telemetry->ground_speed_ned_async([this](Telemetry::GroundSpeedNED ground_speed) {
+        update(&TelemetrySnapshot::ground_speed, ground_speed, _ground_speed_listeners);
+    });
+
+    _telemetry->attitude_euler_angle_async([this](Telemetry::EulerAngle attitude) {
+        update(&TelemetrySnapshot::attitude, attitude, _attitude_listeners);
+    });
+
+    _telemetry->armed_async([this](bool armed) { update(&TelemetrySnapshot::armed, armed, _armed_listeners); });
+
+    _telemetry->in_air_async([this](bool in_air) { update(&TelemetrySnapshot::in_air, in_air, _no_listeners); });
+
+    // The SDK has already stored the new health when the callback fires, so we can take the
+    // aggregated flag from it instead of re-implementing health_all_ok().
+    _telemetry->health_async([this](Telemetry::Health) {
+        update(&TelemetrySnapshot::health_all_ok, _telemetry->health_all_ok(), _no_listeners);
+    });
+
+    _telemetry->flight_mode_async([this](Telemetry::FlightMode flight_mode) {
+        update(&TelemetrySnapshot::flight_mode, flight_mode, _flight_mode_listeners);
+    });
+}
+
+TelemetryMonitor::TelemetryMonitor(const Clock &clock) :
+    _telemetry(nullptr),
+    _clock(clock),
+    _state(initial_snapshot()),
+    _snapshot(_state),
+    _next_handle(1),
+    _minimum_rate_hz(0.0),
+    _position_rate_hz(-1.0),
+    _ground_speed_rate_hz(-1.0),
+    _attitude_rate_hz(-1.0),
+    _waiter(clock)
+{}
+
+TelemetryMonitor::~TelemetryMonitor()
+{
+    if (!_telemetry) {
+        return;
+    }
+    _telemetry->position_async(nullptr);
+    _telemetry->ground_speed_ned_async(nullptr);
+    _telemetry->attitude_euler_angle_async(nullptr);
+    _telemetry->armed_async(nullptr);
+    _telemetry->in_air_async(nullptr);
+    _telemetry->health_async(nullptr);
+    _telemetry->flight_mode_async(nullptr);
+}
+
+template<typename T>
+void TelemetryMonitor::update(T TelemetrySnapshot::*field, const T &value, const Listeners<T> &listeners)
+{
+    {
+        std::lock_guard<std::mutex> lock(_state_mutex);
+        _state.*field = value;
+        _snapshot.store(_state);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_listeners_mutex);
+        for (const auto &listener : listeners) {
+            listener.second(value);
+        }
+        for (const auto &listener : _update_listeners) {
+            listener.second();
+        }
+    }
+    _waiter.notify();
+}
+
+Telemetry::Position TelemetryMonitor::position() const
+{
+    return _snapshot.load().position;
+}
+
+bool TelemetryMonitor::armed() const
+{
+    return _snapshot.load().armed;
+}
+
+bool TelemetryMonitor::in_air() const
+{
+    return _snapshot.load().in_air;
+}
+
+bool TelemetryMonitor::health_all_ok() const
+{
+    return _snapshot.load().health_all_ok;
+}
+
+Telemetry::FlightMode TelemetryMonitor::flight_mode() const
+{
+    return _snapshot.load().flight_mode;
+}
+
+Telemetry::GroundSpeedNED TelemetryMonitor::ground_speed_ned() const
+{
+    return _snapshot.load().ground_speed;
+}
+
+Telemetry::EulerAngle TelemetryMonitor::attitude_euler_angle() const
+{
+    return _snapshot.load().attitude;
+}
+
+template<typename T>
+TelemetryMonitor::listener_handle_t
+TelemetryMonitor::add_listener(Listeners<T> &listeners, std::function<void(const T &)> listener)
+{
+    std::lock_guard<std::mutex> lock(_listeners_mutex);
+    const listener_handle_t handle = _next_handle++;
+    listeners.push_back(std::make_pair(handle, listener));
+    return handle;
+}
+
+TelemetryMonitor::listener_handle_t
+TelemetryMonitor::add_position_listener(position_listener_t listener)
+{
+    return add_listener(_position_listeners, listener);
+}
+
+TelemetryMonitor::listener_handle_t
+TelemetryMonitor::add_ground_speed_listener(ground_speed_listener_t listener)
+{
+    return add_listener(_ground_speed_listeners, listener);
+}
+
+TelemetryMonitor::listener_handle_t
+TelemetryMonitor::add_attitude_listener(attitude_listener_t listener)
+{
+    return add_listener(_attitude_listeners, listener);
+}
+
+TelemetryMonitor::listener_handle_t
+TelemetryMonitor::add_flight_mode_listener(flight_mode_listener_t listener)
+{
+    return add_listener(_flight_mode_listeners, listener);
+}
+
+TelemetryMonitor::listener_handle_t TelemetryMonitor::add_armed_listener(armed_listener_t listener)
+{
+    return add_listener(_armed_listeners, listener);
+}
+
+TelemetryMonitor::listener_handle_t TelemetryMonitor::add_update_listener(update_listener_t listener)
+{
+    std::lock_guard<std::mutex> lock(_listeners_mutex);
+    const listener_handle_t handle = _next_handle++;
+    _update_listeners.push_back(std::make_pair(handle, listener));
+    return handle;
+}
+
+namespace {
+
+template<typename Listeners>
+void erase_listener(Listeners &listeners, TelemetryMonitor::listener_handle_t handle)
+{
+    for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+        if (it->first == handle) {
+            listeners.erase(it);
+            return;
+        }
+    }
+}
+
+} // namespace
+
+void TelemetryMonitor::remove_listener(listener_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(_listeners_mutex);
+    erase_listener(_position_listeners, handle);
+    erase_listener(_ground_speed_listeners, handle);
+    erase_listener(_attitude_listeners, handle);
+    erase_listener(_flight_mode_listeners, handle);
+    erase_listener(_armed_listeners, handle);
+    erase_listener(_update_listeners, handle);
+}
+
+double TelemetryMonitor::store_rate(double &stream_rate_hz, double rate_hz)
+{
+    std::lock_guard<std::mutex> lock(_rate_mutex);
+    stream_rate_hz = rate_hz;
+    return std::max(rate_hz, _minimum_rate_hz);
+}
+
+Telemetry::Result TelemetryMonitor::set_rate_position(double rate_hz)
+{
+    const double set_hz = store_rate(_position_rate_hz, rate_hz);
+    return _telemetry ? _telemetry->set_rate_position(set_hz) : Telemetry::Result::SUCCESS;
+}
+
+Telemetry::Result TelemetryMonitor::set_rate_ground_speed_ned(double rate_hz)
+{
+    const double set_hz = store_rate(_ground_speed_rate_hz, rate_hz);
+    return _telemetry ? _telemetry->set_rate_ground_speed_ned(set_hz) : Telemetry::Result::SUCCESS;
+}
+
+Telemetry::Result TelemetryMonitor::set_rate_attitude(double rate_hz)
+{
+    const double set_hz = store_rate(_attitude_rate_hz, rate_hz);
+    return _telemetry ? _telemetry->set_rate_attitude(set_hz) : Telemetry::Result::SUCCESS;
+}
+
+void TelemetryMonitor::set_rate_position_async(double rate_hz, Telemetry::result_callback_t callback)
+{
+    const double set_hz = store_rate(_position_rate_hz, rate_hz);
+    if (!_telemetry) {
+        callback(Telemetry::Result::SUCCESS);
+        return;
+    }
+    _telemetry->set_rate_position_async(set_hz, callback);
+}
+
+void TelemetryMonitor::set_rate_ground_speed_ned_async(double rate_hz, Telemetry::result_callback_t callback)
+{
+    const double set_hz = store_rate(_ground_speed_rate_hz, rate_hz);
+    if (!_telemetry) {
+        callback(Telemetry::Result::SUCCESS);
+        return;
+    }
+    _telemetry->set_rate_ground_speed_ned_async(set_hz, callback);
+}
+
+void TelemetryMonitor::set_rate_attitude_async(double rate_hz, Telemetry::result_callback_t callback)
+{
+    const double set_hz = store_rate(_attitude_rate_hz, rate_hz);
+    if (!_telemetry) {
+        callback(Telemetry::Result::SUCCESS);
+        return;
+    }
+    _telemetry->set_rate_attitude_async(set_hz, callback);
+}
+
+void TelemetryMonitor::set_minimum_rate(double rate_hz)
+{
+    // Streams whose rate was never set through the monitor (negative) are only touched while
+    // there is a floor, as there is no rate to go back to.
+    double position_hz, ground_speed_hz, attitude_hz;
+    {
+        std::lock_guard<std::mutex> lock(_rate_mutex);
+        _minimum_rate_hz = rate_hz;
+        position_hz = effective_rate(_position_rate_hz);
+        ground_speed_hz = effective_rate(_ground_speed_rate_hz);
+        attitude_hz = effective_rate(_attitude_rate_hz);
+    }
+    if (!_telemetry) {
+        return;
+    }
+
+    if (position_hz >= 0.0) {
+        _telemetry->set_rate_position(position_hz);
+    }
+    if (ground_speed_hz >= 0.0) {
+        _telemetry->set_rate_ground_speed_ned(ground_speed_hz);
+    }
+    if (attitude_hz >= 0.0) {
+        _telemetry->set_rate_attitude(attitude_hz);
+    }
+}
+
+double TelemetryMonitor::effective_rate(double rate_hz) const
+{
+    if (rate_hz < 0.0 && _minimum_rate_hz <= 0.0) {
+        return -1.0;
+    }
+    return std::max(rate_hz, _minimum_rate_hz);
+}
+
+double TelemetryMonitor::position_rate_hz() const
+{
+    std::lock_guard<std::mutex> lock(_rate_mutex);
+    return effective_rate(_position_rate_hz);
+}
+
+double TelemetryMonitor::ground_speed_rate_hz() const
+{
+    std::lock_guard<std::mutex> lock(_rate_mutex);
+    return effective_rate(_ground_speed_rate_hz);
+}
+
+double TelemetryMonitor::attitude_rate_hz() const
+{
+    std::lock_guard<std::mutex> lock(_rate_mutex);
+    return effective_rate(_attitude_rate_hz);
+}
+
+void TelemetryMonitor::publish_position(const Telemetry::Position &position)
+{
+    update(&TelemetrySnapshot::position, position, _position_listeners);
+}
+
+void TelemetryMonitor::publish_ground_speed_ned(const Telemetry::GroundSpeedNED &ground_speed)
+{
+    update(&TelemetrySnapshot::ground_speed, ground_speed, _ground_speed_listeners);
+}
+
+void TelemetryMonitor::publish_attitude_euler_angle(const Telemetry::EulerAngle &attitude)
+{
+    update(&TelemetrySnapshot::attitude, attitude, _attitude_listeners);
+}
+
+void TelemetryMonitor::publish_armed(bool armed)
+{
+    update(&TelemetrySnapshot::armed, armed, _armed_listeners);
+}
+
+void TelemetryMonitor::publish_in_air(bool in_air)
+{
+    update(&TelemetrySnapshot::in_air, in_air, _no_listeners);
+}
+
+void TelemetryMonitor::publish_health_all_ok(bool health_all_ok)
+{
+    update(&TelemetrySnapshot::health_all_ok, health_all_ok, _no_listeners);
+}
+
+void TelemetryMonitor::publish_flight_mode(Telemetry::FlightMode flight_mode)
+{
+    update(&TelemetrySnapshot::flight_mode, flight_mode, _flight_mode_listeners);
+}
+
+WaitResult TelemetryMonitor::wait_until(const std::function<bool()> &predicate,
+                                        std::chrono::milliseconds timeout)
+{
+    return _waiter.wait_until(predicate, timeout);
+}
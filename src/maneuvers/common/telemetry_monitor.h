@@ -0,0 +1,161 @@
+//
+// Keeps the latest telemetry state, fed by the SDK subscriptions, and wakes
+// up waiters whenever a new message arrives.
+//
+// The SDK only supports one callback per telemetry stream, so all users of a
+// stream have to go through the listeners registered here.
+//
+// A monitor can also be fed by a simulated vehicle through the publish_*
+// functions instead of the SDK, it then only keeps track of the rates.
+//
+// The state is published as one snapshot behind a seqlock: readers on any
+// thread get all fields of the same moment without a lock, and never hold
+// up the SDK callback which stores the next message.
+//
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "clock.h"
+#include "condition_waiter.h"
+#include "seqlock.h"
+
+// The latest message of every stream.
+struct TelemetrySnapshot {
+    mavsdk::Telemetry::Position position;
+    mavsdk::Telemetry::GroundSpeedNED ground_speed;
+    mavsdk::Telemetry::EulerAngle attitude;
+    mavsdk::Telemetry::FlightMode flight_mode;
+    bool armed;
+    bool in_air;
+    bool health_all_ok;
+};
+
+class TelemetryMonitor {
+public:
+    typedef std::function<void(const mavsdk::Telemetry::Position &)> position_listener_t;
+    typedef std::function<void(const mavsdk::Telemetry::GroundSpeedNED &)>
+        ground_speed_listener_t;
+    typedef std::function<void(const mavsdk::Telemetry::EulerAngle &)> attitude_listener_t;
+    typedef std::function<void(const mavsdk::Telemetry::FlightMode &)> flight_mode_listener_t;
+    typedef std::function<void(const bool &)> armed_listener_t;
+    typedef std::function<void()> update_listener_t;
+    typedef unsigned listener_handle_t;
+
+    explicit TelemetryMonitor(mavsdk::Telemetry &telemetry, const Clock &clock = real_clock());
+
+    // Without SDK telemetry, fed through the publish_* functions.
+    explicit TelemetryMonitor(const Clock &clock);
+
+    ~TelemetryMonitor();
+
+    const Clock &clock() const { return _clock; }
+
+    // Lock-free and consistent across fields, e.g. for conditions using several of them.
+    TelemetrySnapshot snapshot() const { return _snapshot.load(); }
+
+    // Lock-free as well, each of them reads a whole snapshot.
+    mavsdk::Telemetry::Position position() const;
+    bool armed() const;
+    bool in_air() const;
+    bool health_all_ok() const;
+    mavsdk::Telemetry::FlightMode flight_mode() const;
+    mavsdk::Telemetry::GroundSpeedNED ground_speed_ned() const;
+    mavsdk::Telemetry::EulerAngle attitude_euler_angle() const;
+
+    // Stream rates should be changed through the monitor, so a recording can keep them from
+    // dropping below its own rate while the maneuvers raise and lower them.
+    mavsdk::Telemetry::Result set_rate_position(double rate_hz);
+    mavsdk::Telemetry::Result set_rate_ground_speed_ned(double rate_hz);
+    mavsdk::Telemetry::Result set_rate_attitude(double rate_hz);
+
+    // The same without waiting for the vehicle, the callback gets the result on the SDK thread
+    // (right away without SDK telemetry). For the loop thread, which must not block.
+    void set_rate_position_async(double rate_hz, mavsdk::Telemetry::result_callback_t callback);
+    void set_rate_ground_speed_ned_async(double rate_hz, mavsdk::Telemetry::result_callback_t callback);
+    void set_rate_attitude_async(double rate_hz, mavsdk::Telemetry::result_callback_t callback);
+
+    // Applies to all three streams above, 0 to remove the floor again.
+    void set_minimum_rate(double rate_hz);
+
+    // Rate the streams should currently run at, negative if it was never set.
+    double position_rate_hz() const;
+    double ground_speed_rate_hz() const;
+    double attitude_rate_hz() const;
+
+    // New state from a source other than the SDK, handled like a telemetry message.
+    void publish_position(const mavsdk::Telemetry::Position &position);
+    void publish_ground_speed_ned(const mavsdk::Telemetry::GroundSpeedNED &ground_speed);
+    void publish_attitude_euler_angle(const mavsdk::Telemetry::EulerAngle &attitude);
+    void publish_armed(bool armed);
+    void publish_in_air(bool in_air);
+    void publish_health_all_ok(bool health_all_ok);
+    void publish_flight_mode(mavsdk::Telemetry::FlightMode flight_mode);
+
+    // Listeners are called from the SDK callback thread and must not block.
+    listener_handle_t add_position_listener(position_listener_t listener);
+    listener_handle_t add_ground_speed_listener(ground_speed_listener_t listener);
+    listener_handle_t add_attitude_listener(attitude_listener_t listener);
+    listener_handle_t add_flight_mode_listener(flight_mode_listener_t listener);
+    listener_handle_t add_armed_listener(armed_listener_t listener);
+    // Called after any of the state above changed, e.g. to re-evaluate a condition.
+    listener_handle_t add_update_listener(update_listener_t listener);
+    void remove_listener(listener_handle_t handle);
+
+    // Wait until predicate() holds, re-evaluated on every telemetry update.
+    WaitResult wait_until(const std::function<bool()> &predicate,
+                          std::chrono::milliseconds timeout);
+
+private:
+    TelemetryMonitor(const TelemetryMonitor &) = delete;
+    TelemetryMonitor &operator=(const TelemetryMonitor &) = delete;
+
+    template<typename T>
+    using Listeners = std::vector<std::pair<listener_handle_t, std::function<void(const T &)>>>;
+
+    // Stores the new value, calls the listeners of the stream and wakes up the waiters.
+    template<typename T>
+    void update(T TelemetrySnapshot::*field, const T &value, const Listeners<T> &listeners);
+
+    template<typename T>
+    listener_handle_t add_listener(Listeners<T> &listeners, std::function<void(const T &)> listener);
+
+    double effective_rate(double rate_hz) const;
+
+    // Stores the rate asked for a stream and returns the one to set, the SDK is called without
+    // holding the lock.
+    double store_rate(double &stream_rate_hz, double rate_hz);
+
+    mavsdk::Telemetry *_telemetry;
+    const Clock &_clock;
+
+    // Only taken by the writers, which update _state and publish it as a whole.
+    std::mutex _state_mutex;
+    TelemetrySnapshot _state;
+    Seqlock<TelemetrySnapshot> _snapshot;
+
+    std::mutex _listeners_mutex;
+    listener_handle_t _next_handle;
+    Listeners<mavsdk::Telemetry::Position> _position_listeners;
+    Listeners<mavsdk::Telemetry::GroundSpeedNED> _ground_speed_listeners;
+    Listeners<mavsdk::Telemetry::EulerAngle> _attitude_listeners;
+    Listeners<mavsdk::Telemetry::FlightMode> _flight_mode_listeners;
+    Listeners<bool> _armed_listeners;
+    Listeners<bool> _no_listeners;
+    std::vector<std::pair<listener_handle_t, update_listener_t>> _update_listeners;
+
+    mutable std::mutex _rate_mutex;
+    double _minimum_rate_hz;
+    double _position_rate_hz;
+    double _ground_speed_rate_hz;
+    double _attitude_rate_hz;
+
+    ConditionWaiter _waiter;
+};
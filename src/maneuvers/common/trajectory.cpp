@@ -0,0 +1,87 @@
+#include "trajectory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "geodesy.h"
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const double rad_to_deg = 180.0 / pi;
+
+} // namespace
+
+bool parse_circle_settings(const std::string &text, CircleSettings &settings)
+{
+    std::string fields_text = text;
+    std::replace(fields_text.begin(), fields_text.end(), ',', ' ');
+    std::istringstream fields(fields_text);
+    CircleSettings parsed = settings;
+    if (!(fields >> parsed.radius_m >> parsed.speed_m_s >> parsed.laps) ||
+        parsed.radius_m <= 0.0f || parsed.speed_m_s <= 0.0f || parsed.laps <= 0.0f) {
+        return false;
+    }
+    settings = parsed;
+    return true;
+}
+
+Trajectory circle_trajectory(const TrajectorySample &start, const CircleSettings &settings, double rate_hz)
+{
+    Trajectory trajectory;
+    trajectory.rate_hz = rate_hz;
+
+    // Trapezoidal speed profile along the circle, a triangle if it is too short to reach the speed.
+    const double radius_m = settings.radius_m;
+    const double length_m = settings.laps * 2.0 * pi * radius_m;
+    const double acceleration = settings.acceleration_m_s2;
+    double speed = settings.speed_m_s;
+    if (speed * speed / acceleration > length_m) {
+        speed = std::sqrt(length_m * acceleration);
+    }
+    const double ramp_s = speed / acceleration;
+    const double ramp_m = speed * ramp_s / 2.0;
+    const double cruise_s = (length_m - 2.0 * ramp_m) / speed;
+    const double total_s = 2.0 * ramp_s + cruise_s;
+    const size_t count = static_cast<size_t>(std::ceil(total_s * rate_hz)) + 1;
+
+    std::vector<double> angle(count), sample_speed(count);
+    for (size_t i = 0; i < count; ++i) {
+        const double t = std::min(i / rate_hz, total_s);
+        double s, v;
+        if (t < ramp_s) {
+            v = acceleration * t;
+            s = v * t / 2.0;
+        } else if (t < ramp_s + cruise_s) {
+            v = speed;
+            s = ramp_m + speed * (t - ramp_s);
+        } else {
+            const double left_s = total_s - t;
+            v = acceleration * left_s;
+            s = length_m - v * left_s / 2.0;
+        }
+        // The start is west of the center.
+        angle[i] = s / radius_m - pi / 2.0;
+        sample_speed[i] = v;
+    }
+
+    std::vector<double> sin_angle(count), cos_angle(count);
+    geodesy::sincos(angle.data(), count, sin_angle.data(), cos_angle.data());
+
+    const double center_north_m = start.north_m;
+    const double center_east_m = start.east_m + radius_m;
+    trajectory.samples.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        TrajectorySample &sample = trajectory.samples[i];
+        sample.north_m = static_cast<float>(center_north_m + radius_m * cos_angle[i]);
+        sample.east_m = static_cast<float>(center_east_m + radius_m * sin_angle[i]);
+        sample.down_m = start.down_m;
+        sample.north_m_s = static_cast<float>(-sample_speed[i] * sin_angle[i]);
+        sample.east_m_s = static_cast<float>(sample_speed[i] * cos_angle[i]);
+        sample.down_m_s = 0.0f;
+        // Facing along the circle.
+        sample.yaw_deg = static_cast<float>(std::remainder((angle[i] + pi / 2.0) * rad_to_deg, 360.0));
+    }
+    return trajectory;
+}
@@ -0,0 +1,52 @@
+//
+// Offboard trajectories, computed ahead of time at the rate they are
+// streamed at.
+//
+// The samples are kept in one contiguous vector, one per setpoint, so the
+// thread which streams them only indexes into it and neither allocates nor
+// does any math while the vehicle flies.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Setpoint in the local NED frame of the vehicle, origin at home.
+struct TrajectorySample {
+    float north_m;
+    float east_m;
+    float down_m;
+    float north_m_s;
+    float east_m_s;
+    float down_m_s;
+    float yaw_deg;
+};
+
+struct Trajectory {
+    double rate_hz;
+    std::vector<TrajectorySample> samples;
+
+    double duration_s() const { return samples.size() / rate_hz; }
+};
+
+struct CircleSettings {
+    float radius_m;
+    float speed_m_s;
+    float laps;
+    float acceleration_m_s2;
+
+    CircleSettings() :
+        radius_m(10.0f),
+        speed_m_s(3.0f),
+        laps(1.0f),
+        acceleration_m_s2(1.0f)
+    {}
+};
+
+// Reads "radius_m,speed_m_s,laps", false if malformed.
+bool parse_circle_settings(const std::string &text, CircleSettings &settings);
+
+// Clockwise circle (seen from above) at constant height, starting at start with its center to
+// the east. Speeds up from and slows down to a standstill with the given acceleration.
+Trajectory circle_trajectory(const TrajectorySample &start, const CircleSettings &settings, double rate_hz);
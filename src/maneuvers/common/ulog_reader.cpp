@@ -0,0 +1,381 @@
+#include "ulog_reader.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint8_t file_magic[7] = {'U', 'L', 'o', 'g', 0x01, 0x12, 0x35};
+const size_t file_header_size = 16;
+const size_t message_header_size = 3;
+
+// Nested formats deeper than this are taken as a broken log rather than followed.
+const unsigned max_format_depth = 8;
+
+struct PrimitiveType {
+    const char *name;
+    ULogType type;
+    size_t size;
+};
+
+const PrimitiveType primitive_types[] = {
+    {"int8_t", ULogType::INT8, 1},     {"uint8_t", ULogType::UINT8, 1},   {"int16_t", ULogType::INT16, 2},
+    {"uint16_t", ULogType::UINT16, 2}, {"int32_t", ULogType::INT32, 4},   {"uint32_t", ULogType::UINT32, 4},
+    {"int64_t", ULogType::INT64, 8},   {"uint64_t", ULogType::UINT64, 8}, {"float", ULogType::FLOAT, 4},
+    {"double", ULogType::DOUBLE, 8},   {"bool", ULogType::BOOL, 1},       {"char", ULogType::CHAR, 1},
+};
+
+bool is_padding(const std::string &field_name)
+{
+    return field_name.compare(0, 8, "_padding") == 0;
+}
+
+const PrimitiveType *find_primitive(const std::string &name)
+{
+    for (const auto &primitive : primitive_types) {
+        if (name == primitive.name) {
+            return &primitive;
+        }
+    }
+    return nullptr;
+}
+
+template<typename T>
+T load(const uint8_t *data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+double ULogField::read(const uint8_t *data) const
+{
+    const uint8_t *field = data + offset;
+    switch (type) {
+        case ULogType::INT8: return load<int8_t>(field);
+        case ULogType::UINT8: return load<uint8_t>(field);
+        case ULogType::INT16: return load<int16_t>(field);
+        case ULogType::UINT16: return load<uint16_t>(field);
+        case ULogType::INT32: return load<int32_t>(field);
+        case ULogType::UINT32: return load<uint32_t>(field);
+        case ULogType::INT64: return static_cast<double>(load<int64_t>(field));
+        case ULogType::UINT64: return static_cast<double>(load<uint64_t>(field));
+        case ULogType::FLOAT: return load<float>(field);
+        case ULogType::DOUBLE: return load<double>(field);
+        case ULogType::BOOL: return load<uint8_t>(field) != 0 ? 1.0 : 0.0;
+        case ULogType::CHAR: return load<char>(field);
+        case ULogType::NONE: break;
+    }
+    return 0.0;
+}
+
+ULogReader::ULogReader() :
+    _mapping(nullptr),
+    _data(nullptr),
+    _size(0),
+    _data_start(0),
+    _truncated(false)
+{}
+
+ULogReader::~ULogReader()
+{
+    close();
+}
+
+bool ULogReader::fail(const std::string &error)
+{
+    close();
+    _error = error;
+    return false;
+}
+
+bool ULogReader::open(const std::string &path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fail("cannot open file");
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < file_header_size) {
+        ::close(fd);
+        return fail("not a ULog file");
+    }
+    _size = file_stat.st_size;
+    _mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (_mapping == MAP_FAILED) {
+        _mapping = nullptr;
+        return fail("cannot map file");
+    }
+    // Read once from front to back.
+    madvise(_mapping, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const uint8_t *>(_mapping);
+
+    if (std::memcmp(_data, file_magic, sizeof(file_magic)) != 0) {
+        return fail("not a ULog file");
+    }
+
+    // The definitions end where the first topic is added.
+    size_t position = file_header_size;
+    while (position + message_header_size <= _size) {
+        const uint16_t message_size = load<uint16_t>(_data + position);
+        const uint8_t type = _data[position + 2];
+        const uint8_t *payload = _data + position + message_header_size;
+        if (position + message_header_size + message_size > _size) {
+            break;
+        }
+        if (type == 'A') {
+            _data_start = position;
+            return true;
+        }
+        if (type == 'F') {
+            read_format(reinterpret_cast<const char *>(payload), message_size);
+        } else if (type == 'P') {
+            read_param(payload, message_size);
+        }
+        position += message_header_size + message_size;
+    }
+    return fail("no data in log");
+}
+
+void ULogReader::close()
+{
+    if (_mapping) {
+        munmap(_mapping, _size);
+    }
+    _error.clear();
+    _mapping = nullptr;
+    _data = nullptr;
+    _size = 0;
+    _data_start = 0;
+    _truncated = false;
+    _formats.clear();
+    _params.clear();
+    _subscriptions.clear();
+    _subscription_by_id.clear();
+}
+
+// "topic:type name;type[n] name;..."
+void ULogReader::read_format(const char *text, size_t size)
+{
+    const std::string format(text, size);
+    const size_t colon = format.find(':');
+    if (colon == std::string::npos) {
+        return;
+    }
+
+    std::vector<FormatField> &fields = _formats[format.substr(0, colon)];
+    fields.clear();
+    size_t start = colon + 1;
+    while (start < format.size()) {
+        size_t end = format.find(';', start);
+        if (end == std::string::npos) {
+            end = format.size();
+        }
+        const std::string field = format.substr(start, end - start);
+        start = end + 1;
+
+        const size_t space = field.find(' ');
+        if (space == std::string::npos) {
+            continue;
+        }
+        FormatField parsed;
+        parsed.type = field.substr(0, space);
+        parsed.name = field.substr(space + 1);
+        parsed.array_length = 0;
+        const size_t bracket = parsed.type.find('[');
+        if (bracket != std::string::npos) {
+            parsed.array_length = std::strtoul(parsed.type.c_str() + bracket + 1, nullptr, 10);
+            parsed.type.resize(bracket);
+        }
+        fields.push_back(parsed);
+    }
+}
+
+// Key "type name", then the value in the bytes of that type.
+void ULogReader::read_param(const uint8_t *payload, size_t size)
+{
+    if (size < 1 || size < 1u + payload[0]) {
+        return;
+    }
+    const std::string key(reinterpret_cast<const char *>(payload + 1), payload[0]);
+    const uint8_t *value = payload + 1 + payload[0];
+    const size_t value_size = size - 1 - payload[0];
+    const size_t space = key.find(' ');
+    if (space == std::string::npos || value_size < 4) {
+        return;
+    }
+
+    const std::string type = key.substr(0, space);
+    if (type == "float") {
+        _params[key.substr(space + 1)] = ParamValue::from_float(load<float>(value));
+    } else if (type == "int32_t") {
+        _params[key.substr(space + 1)] = ParamValue::from_int(load<int32_t>(value));
+    }
+}
+
+// 0 if unknown.
+size_t ULogReader::type_size(const std::string &type, unsigned depth) const
+{
+    const PrimitiveType *primitive = find_primitive(type);
+    if (primitive) {
+        return primitive->size;
+    }
+    const auto format = _formats.find(type);
+    if (format == _formats.end() || depth >= max_format_depth) {
+        return 0;
+    }
+    size_t size = 0;
+    for (const auto &field : format->second) {
+        const size_t field_size = type_size(field.type, depth + 1);
+        if (field_size == 0) {
+            return 0;
+        }
+        size += field_size * (field.array_length > 0 ? field.array_length : 1);
+    }
+    return size;
+}
+
+// PX4 leaves the padding at the end of a topic out of its data messages (o_size_no_padding), so
+// they only have to reach to the end of the last field which is not padding. 0 if unknown.
+size_t ULogReader::data_size(const std::string &topic) const
+{
+    const auto format = _formats.find(topic);
+    if (format == _formats.end()) {
+        return 0;
+    }
+    size_t size = 0;
+    size_t end_of_data = 0;
+    for (const auto &field : format->second) {
+        const size_t field_size = type_size(field.type, 1);
+        if (field_size == 0) {
+            return 0;
+        }
+        size += field_size * (field.array_length > 0 ? field.array_length : 1);
+        if (!is_padding(field.name)) {
+            end_of_data = size;
+        }
+    }
+    return end_of_data;
+}
+
+ULogField ULogReader::field(const std::string &topic, const std::string &name) const
+{
+    ULogField result = {ULogType::NONE, 0};
+    const auto format = _formats.find(topic);
+    if (format == _formats.end()) {
+        return result;
+    }
+
+    size_t offset = 0;
+    for (const auto &field : format->second) {
+        const size_t field_size = type_size(field.type, 1);
+        if (field_size == 0) {
+            return result;
+        }
+        if (field.name == name) {
+            const PrimitiveType *primitive = find_primitive(field.type);
+            if (primitive && field.array_length == 0) {
+                result.type = primitive->type;
+                result.offset = offset;
+            }
+            return result;
+        }
+        offset += field_size * (field.array_length > 0 ? field.array_length : 1);
+    }
+    return result;
+}
+
+bool ULogReader::param(const std::string &name, ParamValue &value) const
+{
+    const auto found = _params.find(name);
+    if (found == _params.end()) {
+        return false;
+    }
+    value = found->second;
+    return true;
+}
+
+void ULogReader::subscribe(const std::string &topic, uint8_t multi_id, data_callback_t callback)
+{
+    Subscription subscription = {topic, multi_id, data_size(topic), callback};
+    _subscriptions.push_back(subscription);
+}
+
+void ULogReader::replay()
+{
+    size_t position = _data_start;
+    while (position + message_header_size <= _size) {
+        const uint16_t message_size = load<uint16_t>(_data + position);
+        const uint8_t type = _data[position + 2];
+        const uint8_t *payload = _data + position + message_header_size;
+        if (position + message_header_size + message_size > _size) {
+            _truncated = true;
+            return;
+        }
+        position += message_header_size + message_size;
+
+        switch (type) {
+            case 'D': {
+                if (message_size < 2) {
+                    break;
+                }
+                const uint16_t id = load<uint16_t>(payload);
+                if (id >= _subscription_by_id.size() || _subscription_by_id[id] < 0) {
+                    break;
+                }
+                const Subscription &subscription = _subscriptions[_subscription_by_id[id]];
+                if (message_size - 2u >= subscription.min_size) {
+                    subscription.callback(payload + 2);
+                }
+                break;
+            }
+            case 'A': {
+                if (message_size < 3) {
+                    break;
+                }
+                const uint8_t multi_id = payload[0];
+                const uint16_t id = load<uint16_t>(payload + 1);
+                const char *name = reinterpret_cast<const char *>(payload + 3);
+                const size_t name_length = message_size - 3u;
+                if (id >= _subscription_by_id.size()) {
+                    _subscription_by_id.resize(id + 1u, -1);
+                }
+                _subscription_by_id[id] = -1;
+                for (size_t i = 0; i < _subscriptions.size(); ++i) {
+                    const Subscription &subscription = _subscriptions[i];
+                    if (subscription.multi_id == multi_id && subscription.min_size > 0 &&
+                        subscription.topic.size() == name_length &&
+                        std::memcmp(subscription.topic.data(), name, name_length) == 0) {
+                        _subscription_by_id[id] = static_cast<int>(i);
+                        break;
+                    }
+                }
+                break;
+            }
+            case 'R': {
+                if (message_size >= 2) {
+                    const uint16_t id = load<uint16_t>(payload);
+                    if (id < _subscription_by_id.size()) {
+                        _subscription_by_id[id] = -1;
+                    }
+                }
+                break;
+            }
+            case 'P':
+                read_param(payload, message_size);
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+//
+// Streaming reader of PX4 ULog files, for replaying recorded flights.
+//
+// The file is memory-mapped. open() reads the definitions section (message
+// formats and the initial parameters), replay() then makes one pass over
+// the data section and hands the data messages of the subscribed topics to
+// their callbacks as raw bytes, in the order they were logged. Fields are
+// read from those bytes at offsets looked up once from the formats, so a
+// message costs a table lookup and a callback, nothing is allocated or
+// parsed per message. Parameter changes in the data section are applied as
+// they come, param() returns the value as of the data replayed so far.
+//
+// The format is described in the PX4 developer guide ("ULog File Format").
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "param_cache.h"
+
+enum class ULogType { NONE, INT8, UINT8, INT16, UINT16, INT32, UINT32, INT64, UINT64, FLOAT, DOUBLE, BOOL, CHAR };
+
+// A scalar field of a topic.
+struct ULogField {
+    ULogType type;
+    size_t offset; // in the data of a message, which starts with the timestamp
+
+    bool valid() const { return type != ULogType::NONE; }
+
+    // The data has to hold the fields of the topic up to its trailing padding (see
+    // ULogReader::subscribe).
+    double read(const uint8_t *data) const;
+};
+
+class ULogReader {
+public:
+    typedef std::function<void(const uint8_t *data)> data_callback_t;
+
+    ULogReader();
+    ~ULogReader();
+
+    // Fails unless the file is a ULog with a complete definitions section, see error().
+    bool open(const std::string &path);
+    void close();
+
+    const std::string &error() const { return _error; }
+    size_t size_bytes() const { return _size; }
+
+    // Offset and type of a field of a topic, type NONE if the log has no such field.
+    ULogField field(const std::string &topic, const std::string &name) const;
+
+    // The parameter as of the data replayed so far, false if it was not logged.
+    bool param(const std::string &name, ParamValue &value) const;
+
+    // Calls callback for every message of one instance of topic which holds all its fields,
+    // the padding at the end of the format aside. Only subscriptions made before replay() are
+    // served.
+    void subscribe(const std::string &topic, uint8_t multi_id, data_callback_t callback);
+
+    // One pass over the data section. A log which ends within a message, as after a power
+    // loss, is read up to there and marked as truncated.
+    void replay();
+    bool truncated() const { return _truncated; }
+
+private:
+    ULogReader(const ULogReader &) = delete;
+    ULogReader &operator=(const ULogReader &) = delete;
+
+    struct FormatField {
+        std::string type;
+        std::string name;
+        size_t array_length; // 0 for a scalar
+    };
+
+    struct Subscription {
+        std::string topic;
+        uint8_t multi_id;
+        size_t min_size;
+        data_callback_t callback;
+    };
+
+    bool fail(const std::string &error);
+    void read_format(const char *text, size_t size);
+    void read_param(const uint8_t *payload, size_t size);
+    size_t type_size(const std::string &type, unsigned depth) const;
+    size_t data_size(const std::string &topic) const;
+
+    std::string _error;
+    void *_mapping;
+    const uint8_t *_data;
+    size_t _size;
+    size_t _data_start;
+    bool _truncated;
+
+    std::map<std::string, std::vector<FormatField>> _formats;
+    std::map<std::string, ParamValue> _params;
+    std::vector<Subscription> _subscriptions;
+
+    // Index into _subscriptions by message id, -1 if not subscribed.
+    std::vector<int> _subscription_by_id;
+};
@@ -0,0 +1,110 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned threads) :
+    _next_worker(0),
+    _steals(0),
+    _queued(0),
+    _pending(0),
+    _stop(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        _workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        _workers[i]->thread = std::thread(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _work_cv.notify_all();
+    for (auto &worker : _workers) {
+        worker->thread.join();
+    }
+}
+
+void WorkStealingPool::post(task_t task)
+{
+    // Counted first, so the count never drops below the tasks in the deques.
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued++;
+        _pending++;
+    }
+    Worker &worker = *_workers[_next_worker++ % _workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    _work_cv.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this]() { return _pending == 0; });
+}
+
+// The newest task of its own deque, else the oldest of another.
+bool WorkStealingPool::take(size_t index, task_t &task)
+{
+    {
+        Worker &own = *_workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < _workers.size(); ++i) {
+        Worker &victim = *_workers[(index + i) % _workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            _steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(size_t index)
+{
+    while (true) {
+        task_t task;
+        if (take(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _queued--;
+            }
+            task();
+            bool done = false;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                done = --_pending == 0;
+            }
+            if (done) {
+                _done_cv.notify_all();
+            }
+            continue;
+        }
+
+        // A task can be counted before it is in a deque, then this just looks again.
+        std::unique_lock<std::mutex> lock(_mutex);
+        _work_cv.wait(lock, [this]() { return _stop || _queued > 0; });
+        if (_stop && _queued == 0) {
+            return;
+        }
+    }
+}
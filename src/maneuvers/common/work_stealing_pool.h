@@ -0,0 +1,68 @@
+//
+// Runs independent tasks on a fixed set of worker threads.
+//
+// Every worker has a deque of its own, the tasks are dealt out round-robin.
+// A worker takes its next task from the back of its own deque and, once
+// that is empty, steals from the front of the others. Workers which got
+// short tasks thus take over the queued work of those stuck with long ones,
+// without all of them contending on one central queue.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+    typedef std::function<void()> task_t;
+
+    // One worker per hardware thread if threads is 0.
+    explicit WorkStealingPool(unsigned threads = 0);
+
+    // Runs the tasks which are still queued before it returns.
+    ~WorkStealingPool();
+
+    void post(task_t task);
+
+    // Returns once all tasks posted so far have run.
+    void wait();
+
+    unsigned threads() const { return static_cast<unsigned>(_workers.size()); }
+
+    // Tasks a worker took from the deque of another.
+    uint64_t steals() const { return _steals; }
+
+private:
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+        std::thread thread;
+    };
+
+    void run(size_t index);
+    bool take(size_t index, task_t &task);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<size_t> _next_worker;
+    std::atomic<uint64_t> _steals;
+
+    // Guards the counts below, idle workers and wait() sleep on it.
+    std::mutex _mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _done_cv;
+    size_t _queued;  // in the deques
+    size_t _pending; // queued or running
+    bool _stop;
+};
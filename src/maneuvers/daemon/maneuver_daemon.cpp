@@ -0,0 +1,362 @@
+//
+// Daemon which stays connected to a vehicle and flies maneuvers on request.
+//
+// Running maneuvers_RTL or maneuvers_mission for every flight means a new
+// Mavsdk instance, discovering the vehicle and waiting for its telemetry
+// each time. The daemon does that once: the connection, the plugins, the
+// telemetry state and the RTL parameters stay warm, and a request which
+// comes in over the control socket (control_socket.h) starts its maneuver
+// on the event loop right away. Requests are flown one after the other in
+// the order they came in, and each client is told when its maneuver starts
+// and how it ended.
+//
+// Requests, one line each:
+//   rtl lat_m,long_m,height_above_home,yaw   fly there and RTL, checked like in maneuvers_RTL
+//   mission <mission_file>                   fly a mission file and RTL, an absolute path
+//   status                                   what the daemon and the vehicle are doing
+//   shutdown                                 exit, only while no maneuver is queued
+// The last line of the replies starts with "ok" or "error".
+//
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "mavsdk.h"
+#include "console.h"
+#include "control_socket.h"
+#include "event_loop.h"
+#include "log_sink.h"
+#include "maneuver.h"
+#include "maneuver_steps.h"
+#include "mission_file.h"
+#include "mission_maneuver.h"
+#include "mission_sync.h"
+#include "param_cache.h"
+#include "phase_stats.h"
+#include "rate_scheduler.h"
+#include "rtl_maneuver.h"
+#include "sim_autopilot.h"
+#include "telemetry_monitor.h"
+
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+// Heartbeats come at 1 Hz, a vehicle which sent none for this long is not there.
+const seconds discovery_timeout(5);
+
+struct Options {
+    std::string connection_url;
+    std::string socket_path;
+    std::string phase_stats_prefix;
+    std::string fingerprint_directory;
+    RtlRules rtl_rules;
+    bool rtl_rules_given;
+};
+
+struct Request {
+    enum class Type { RTL, MISSION };
+
+    Type type;
+    std::string text;
+    std::shared_ptr<ControlConnection> client;
+    steady_clock::time_point received;
+    RTLScenario scenario;
+    std::shared_ptr<MissionFileReader> mission_file; // mapped until the mission is flown
+};
+
+// Only touched on the loop thread.
+struct Daemon {
+    Autopilot &autopilot;
+    EventLoop &loop;
+    RateScheduler &rates;
+    PhaseStats *phases;
+    MissionSync *sync;
+    bool rtl_rules_given;
+    RtlChecks checks;
+    ParamCache params; // fetched for the first RTL, kept for the following ones
+    std::deque<Request> queue;
+    bool running;
+    unsigned flown;
+};
+
+void usage(std::string bin_name)
+{
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " [-s socket_path] [-p phase_stats_prefix] [-m mission_fingerprint_directory] [-r return_alt,cone_dist,cone_angle] <connection_url>" << std::endl
+              << "Stays connected to the vehicle and flies the maneuvers requested through the socket" << std::endl
+              << "(default " << default_control_socket_path << "), e.g. with maneuvers_request:" << std::endl
+              << "  rtl lat_m,long_m,height_above_home,yaw   fly there and RTL" << std::endl
+              << "  mission <mission_file>                   fly a mission file (see maneuvers_mission_convert) and RTL" << std::endl
+              << "  status                                   what the daemon and the vehicle are doing" << std::endl
+              << "  shutdown                                 exit, once no maneuver is queued" << std::endl
+              << "Requests are flown one after the other. -p, -m and -r are those of maneuvers_RTL and maneuvers_mission." << std::endl
+              << "For example: udp://:14540, or sim://10 for the built-in simulated vehicle" << std::endl;
+}
+
+bool parse_options(int argc, char **argv, Options &options)
+{
+    std::vector<std::string> positional;
+    options.socket_path = default_control_socket_path;
+    options.rtl_rules_given = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-s" && i + 1 < argc) {
+            options.socket_path = argv[++i];
+        } else if (arg == "-p" && i + 1 < argc) {
+            options.phase_stats_prefix = argv[++i];
+        } else if (arg == "-m" && i + 1 < argc) {
+            options.fingerprint_directory = argv[++i];
+        } else if (arg == "-r" && i + 1 < argc) {
+            if (!parse_rtl_rules(argv[++i], options.rtl_rules)) {
+                return false;
+            }
+            options.rtl_rules_given = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 1) {
+        return false;
+    }
+    options.connection_url = positional[0];
+    return true;
+}
+
+
+
+// Checks a request before it is queued, so a client learns about mistakes right away.
+bool parse_request(const std::string &text, Request &request, std::string &error)
+{
+    std::istringstream words(text);
+    std::string command, argument;
+    words >> command;
+    std::getline(words >> std::ws, argument);
+
+    request.text = text;
+    if (command == "rtl") {
+        request.type = Request::Type::RTL;
+        if (!parse_rtl_scenario(argument, request.scenario)) {
+            error = "expected rtl lat_m,long_m,height_above_home,yaw";
+            return false;
+        }
+        return true;
+    }
+    if (command == "mission") {
+        request.type = Request::Type::MISSION;
+        // The daemon does not run in the directory of the client, a relative path would be taken
+        // from the wrong place.
+        if (!argument.empty() && argument[0] != '/') {
+            error = "mission file path has to be absolute: " + argument;
+            return false;
+        }
+        request.mission_file = std::make_shared<MissionFileReader>();
+        if (argument.empty() || !request.mission_file->open(argument)) {
+            error = "cannot read mission file " + argument;
+            return false;
+        }
+        return true;
+    }
+    error = "unknown request " + command;
+    return false;
+}
+
+
+
+std::shared_ptr<Maneuver> build_maneuver(Daemon &daemon, const Request &request,
+                                         std::shared_ptr<std::vector<LegTiming>> legs)
+{
+    auto maneuver = std::make_shared<Maneuver>("", daemon.autopilot, daemon.loop);
+    maneuver->set_rate_scheduler(&daemon.rates);
+    maneuver->abort_if("pilot took over", pilot_took_over(daemon.autopilot.monitor()));
+    maneuver->on_failure("return home", return_home_step(daemon.phases));
+
+    if (request.type == Request::Type::RTL) {
+        // Only the first RTL has to fetch the parameters.
+        maneuver->then("check RTL parameters", rtl_params_step(&daemon.params, &daemon.checks, daemon.rtl_rules_given));
+        add_goto_setpoint_and_RTL(*maneuver, request.scenario, legs.get(), daemon.phases, &daemon.checks);
+    } else {
+        // Waits for the landing, so the next request starts on the ground.
+        maneuver->then("wait until ready", ready_step());
+        maneuver->then("upload mission", upload_mission_step(request.mission_file.get(), nullptr, daemon.sync, nullptr, daemon.phases));
+        maneuver->then("arm", arm_step(daemon.phases));
+        maneuver->then("run mission", run_mission_step(daemon.phases));
+        maneuver->then("return to launch", return_to_launch_step(daemon.phases));
+    }
+    return maneuver;
+}
+
+
+
+void start_next(Daemon &daemon);
+
+void maneuver_finished(Daemon &daemon, Maneuver::Result result, size_t verdicts_before,
+                       std::shared_ptr<const std::vector<LegTiming>> legs)
+{
+    const Request request = daemon.queue.front();
+    daemon.queue.pop_front();
+    daemon.running = false;
+    daemon.flown++;
+
+    for (const auto &leg : *legs) {
+        std::ostringstream line;
+        line << "arrived " << (leg.arrived ? "after " : "not ") << leg.time_to_arrive_s << " s";
+        request.client->reply(line.str());
+    }
+    bool rtl_passed = true;
+    for (size_t i = verdicts_before; i < daemon.checks.verdicts.size(); ++i) {
+        const RtlVerdict &verdict = daemon.checks.verdicts[i];
+        rtl_passed = rtl_passed && verdict.passed;
+        request.client->reply(verdict.passed ? "rtl check passed"
+                                             : "rtl check failed: " + rtl_verdict_failures(verdict));
+    }
+
+    const bool succeeded = result == Maneuver::Result::SUCCEEDED && rtl_passed;
+    log_info() << "Request \"" << request.text << "\" " << maneuver_result_str(result);
+    request.client->reply(std::string(succeeded ? "ok " : "error ") + maneuver_result_str(result));
+    start_next(daemon);
+}
+
+void start_next(Daemon &daemon)
+{
+    if (daemon.running || daemon.queue.empty()) {
+        return;
+    }
+    const Request &request = daemon.queue.front();
+    auto legs = std::make_shared<std::vector<LegTiming>>();
+    auto maneuver = build_maneuver(daemon, request, legs);
+    const size_t verdicts_before = daemon.checks.verdicts.size();
+    daemon.running = true;
+
+    const double waited_ms = duration_cast<duration<double, std::milli>>(steady_clock::now() - request.received).count();
+    log_info() << "Starting \"" << request.text << "\", " << waited_ms << " ms after the request";
+    request.client->reply("started " + request.text);
+
+    Daemon *d = &daemon;
+    maneuver->start([d, verdicts_before, legs](Maneuver::Result result) {
+        maneuver_finished(*d, result, verdicts_before, legs);
+    });
+}
+
+
+
+std::string describe_status(Daemon &daemon)
+{
+    TelemetryMonitor &monitor = daemon.autopilot.monitor();
+    const Telemetry::Position position = monitor.position();
+    std::ostringstream status;
+    status << (daemon.running ? "flying \"" + daemon.queue.front().text + "\"" : std::string("idle")) << ", "
+           << (daemon.running ? daemon.queue.size() - 1 : daemon.queue.size()) << " queued, " << daemon.flown
+           << " flown; vehicle " << (monitor.armed() ? "armed" : "disarmed") << ", "
+           << (monitor.in_air() ? "in air" : "on ground") << ", " << Telemetry::flight_mode_str(monitor.flight_mode())
+           << ", " << position.relative_altitude_m << " m above home";
+    return status.str();
+}
+
+// On the loop thread.
+void handle_request(Daemon &daemon, const std::string &text, std::shared_ptr<ControlConnection> client)
+{
+    log_info() << "Request \"" << text << "\"";
+    if (text == "status") {
+        client->reply("ok " + describe_status(daemon));
+        return;
+    }
+    if (text == "shutdown") {
+        if (!daemon.queue.empty()) {
+            client->reply("error maneuvers are queued");
+            return;
+        }
+        client->reply("ok shutting down");
+        daemon.loop.stop();
+        return;
+    }
+
+    Request request;
+    std::string error;
+    if (!parse_request(text, request, error)) {
+        client->reply("error " + error);
+        return;
+    }
+    request.client = client;
+    request.received = steady_clock::now();
+    if (!daemon.queue.empty()) {
+        client->reply("queued behind " + std::to_string(daemon.queue.size()));
+    }
+    daemon.queue.push_back(request);
+    start_next(daemon);
+}
+
+
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Mavsdk dc;
+    std::unique_ptr<Autopilot> autopilot;
+    std::string vehicle_id = "sim";
+    double speedup = 1.0;
+    if (parse_sim_url(options.connection_url, speedup)) {
+        log_info() << "Simulating the vehicle at " << speedup << "x real time";
+        autopilot.reset(new SimAutopilot(speedup));
+    } else {
+        if (!connect_system(dc, options.connection_url, discovery_timeout)) {
+            return 1;
+        }
+        autopilot.reset(new MavsdkAutopilot(dc.system()));
+        vehicle_id = std::to_string(dc.system().get_uuid());
+    }
+
+    // Between maneuvers the vehicle is on the ground, the rates stay low.
+    RateScheduler rates(autopilot->monitor());
+    const Telemetry::Result set_rate_result = rates.enter(FlightPhase::GROUND);
+    if (set_rate_result != Telemetry::Result::SUCCESS) {
+        log_error() << "Setting rate failed:" << Telemetry::result_str(set_rate_result);
+        return 1;
+    }
+
+    std::unique_ptr<MissionSync> sync;
+    if (!options.fingerprint_directory.empty()) {
+        sync.reset(new MissionSync(*autopilot, options.fingerprint_directory + "/mission_" + vehicle_id + ".txt"));
+    }
+    PhaseStats phase_stats;
+    PhaseStats *phases = options.phase_stats_prefix.empty() ? nullptr : &phase_stats;
+
+    EventLoop loop;
+    Daemon daemon = {*autopilot, loop, rates, phases, sync.get(), options.rtl_rules_given, RtlChecks(), ParamCache(),
+                     std::deque<Request>(), false, 0};
+    daemon.checks.rules = options.rtl_rules;
+
+    // Stopped before the daemon goes away, so no request is posted after that.
+    ControlSocket control;
+    Daemon *d = &daemon;
+    if (!control.start(options.socket_path, [d](const std::string &request, std::shared_ptr<ControlConnection> client) {
+            d->loop.post([d, request, client]() { handle_request(*d, request, client); });
+        })) {
+        return 1;
+    }
+    log_info() << "Waiting for requests on " << options.socket_path;
+
+    loop.run();
+    control.stop();
+
+    log_info() << "Flew " << daemon.flown << " maneuvers";
+    print_link_usage(rates.usage(), rates.profile());
+    if (phases && !export_phase_stats(phase_stats, options.phase_stats_prefix)) {
+        return 1;
+    }
+    return 0;
+}
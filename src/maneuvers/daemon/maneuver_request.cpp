@@ -0,0 +1,113 @@
+//
+// Sends a request to the maneuver daemon and prints its replies.
+//
+// Returns once the daemon has answered the request, for a maneuver when it
+// has been flown, with exit code 0 if the last reply starts with "ok".
+//
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "console.h"
+#include "control_socket.h"
+
+
+using namespace std::chrono;
+
+void usage(std::string bin_name)
+{
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " [-s socket_path] <request ...>" << std::endl
+              << "Sends the request to maneuvers_daemon (default socket " << default_control_socket_path << ")," << std::endl
+              << "e.g. \"rtl 10,10,20,0\", \"mission survey.mis\", \"status\" or \"shutdown\"." << std::endl;
+}
+
+
+
+// The daemon takes paths as they are, so a file is sent with its absolute path.
+bool resolve_path(const std::string &path, std::string &absolute_path)
+{
+    char resolved[PATH_MAX];
+    if (!realpath(path.c_str(), resolved)) {
+        return false;
+    }
+    absolute_path = resolved;
+    return true;
+}
+
+
+
+bool send_all(int fd, const std::string &text)
+{
+    size_t sent = 0;
+    while (sent < text.size()) {
+        const ssize_t result = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return false;
+        }
+        sent += result;
+    }
+    return true;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    std::string socket_path = default_control_socket_path;
+    std::string request;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-s" && i + 1 < argc && request.empty()) {
+            socket_path = argv[++i];
+            continue;
+        }
+        if (request == "mission" && !resolve_path(arg, arg)) {
+            std::cerr << "Cannot find mission file " << argv[i] << std::endl;
+            return 1;
+        }
+        request += (request.empty() ? "" : " ") + arg;
+    }
+    if (request.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const int fd = connect_control_socket(socket_path);
+    if (fd < 0) {
+        std::cerr << "No daemon is listening on " << socket_path << std::endl;
+        return 1;
+    }
+
+    const auto sent = steady_clock::now();
+    if (!send_all(fd, request + "\n")) {
+        std::cerr << "Cannot send the request" << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    // The daemon closes the connection after its last reply.
+    std::string received, last_line;
+    char buffer[1024];
+    ssize_t count;
+    while ((count = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        received.append(buffer, count);
+        size_t newline;
+        while ((newline = received.find('\n')) != std::string::npos) {
+            last_line = received.substr(0, newline);
+            received.erase(0, newline + 1);
+            const double elapsed_ms = duration_cast<duration<double, std::milli>>(steady_clock::now() - sent).count();
+            std::cout << "[" << std::fixed << std::setprecision(1) << std::setw(9) << elapsed_ms << " ms] "
+                      << last_line << std::endl;
+        }
+    }
+    close(fd);
+
+    return last_line.compare(0, 2, "ok") == 0 ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+//
+// Measures how long telemetry takes from the wire to the callbacks of the
+// maneuvers, and the rate at which the SDK stops keeping up.
+//
+// A MavlinkStandIn on loopback plays the vehicle, the SDK connects to it
+// like to PX4. The TelemetryMonitor listeners, where the maneuvers get their
+// telemetry, take the time each message arrives at. The rate of position
+// and attitude is swept, both messages at every rate, and for every rate and
+// stream the latency percentiles, the jitter (the mean difference between
+// the latencies of successive messages) and the lost messages are reported.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "mavsdk.h"
+#include "autopilot.h"
+#include "clock.h"
+#include "console.h"
+#include "log_sink.h"
+#include "mavlink_stand_in.h"
+#include "telemetry_monitor.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+const int default_port = 14590;
+const double default_rates_hz[] = {1.0, 10.0, 50.0, 100.0, 200.0, 500.0, 1000.0};
+const double default_step_s = 5.0;
+
+// Heartbeats come at 1 Hz, a vehicle which sent none for this long is not there.
+const seconds discovery_timeout(5);
+
+// Messages of a step still on their way when it ends are counted if they arrive within this.
+const milliseconds drain_time(500);
+
+// A rate saturates the callback path if more of the messages are lost, or if the p99 latency
+// is longer than the period, i.e. messages queue up behind the ones before them.
+const double saturated_lost_fraction = 0.01;
+
+enum class Stream { POSITION, GROUND_SPEED, ATTITUDE };
+const size_t stream_count = 3;
+const char *const stream_names[stream_count] = {"position", "ground_speed", "attitude"};
+
+StandInMessage stream_message(size_t stream)
+{
+    return stream == static_cast<size_t>(Stream::ATTITUDE) ? StandInMessage::ATTITUDE_QUATERNION
+                                                            : StandInMessage::GLOBAL_POSITION_INT;
+}
+
+struct Options {
+    int port;
+    std::vector<double> rates_hz;
+    double step_s;
+    std::string report_path;
+};
+
+struct StepResult {
+    double rate_hz;
+    size_t stream;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t lost;
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+    double jitter_ms;
+    uint64_t missed; // deadlines the stand-in could not keep, not lost messages
+};
+
+bool saturated(const StepResult &result)
+{
+    return result.lost > saturated_lost_fraction * result.sent || result.p99_ms > 1000.0 / result.rate_hz;
+}
+
+// Latencies of the messages of one step, in the order they arrived. Recorded from the SDK
+// callback thread.
+class LatencyRecorder {
+public:
+    explicit LatencyRecorder(const MavlinkStandIn &stand_in) :
+        _stand_in(stand_in),
+        _unmatched(0)
+    {}
+
+    // Messages sent before this are not counted any more.
+    void begin_step(size_t expected_per_stream)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _step_start = real_clock().now();
+        for (auto &latencies : _latencies_ms) {
+            latencies.clear();
+            // Nothing is allocated in the callbacks.
+            latencies.reserve(expected_per_stream + expected_per_stream / 10 + 16);
+        }
+    }
+
+    void record(Stream stream, uint32_t sequence)
+    {
+        const Clock::time_point now = real_clock().now();
+        const size_t index = static_cast<size_t>(stream);
+        Clock::time_point sent;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_stand_in.sent_at(stream_message(index), sequence, sent)) {
+            ++_unmatched;
+            return;
+        }
+        if (sent >= _step_start) {
+            _latencies_ms[index].push_back(duration_cast<duration<double, std::milli>>(now - sent).count());
+        }
+    }
+
+    std::vector<double> latencies_ms(size_t stream)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _latencies_ms[stream];
+    }
+
+    uint64_t unmatched()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _unmatched;
+    }
+
+private:
+    const MavlinkStandIn &_stand_in;
+    std::mutex _mutex;
+    Clock::time_point _step_start;
+    std::vector<double> _latencies_ms[stream_count];
+    uint64_t _unmatched; // sequence numbers never sent, the SDK changed a value
+};
+
+void usage(std::string bin_name)
+{
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " [-p port] [-r rate_hz[,rate_hz...]] [-d step_s] [-o report.csv]" << std::endl
+              << "Streams position and attitude over UDP on 127.0.0.1:port (default " << default_port << ") to the SDK at each" << std::endl
+              << "rate (default 1,10,50,100,200,500,1000 Hz) for step_s seconds (default " << default_step_s << "), and reports how long" << std::endl
+              << "the messages took to the telemetry callbacks. No vehicle is needed, the port must be free." << std::endl;
+}
+
+bool parse_rates(const std::string &text, std::vector<double> &rates_hz)
+{
+    std::string values_text = text;
+    std::replace(values_text.begin(), values_text.end(), ',', ' ');
+    std::istringstream fields(values_text);
+    std::vector<double> parsed;
+    double rate_hz;
+    while (fields >> rate_hz) {
+        if (rate_hz <= 0.0) {
+            return false;
+        }
+        parsed.push_back(rate_hz);
+    }
+    if (!fields.eof() || parsed.empty()) {
+        return false;
+    }
+    rates_hz = parsed;
+    return true;
+}
+
+bool parse_options(int argc, char **argv, Options &options)
+{
+    options.port = default_port;
+    options.rates_hz.assign(std::begin(default_rates_hz), std::end(default_rates_hz));
+    options.step_s = default_step_s;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-p" && i + 1 < argc) {
+            options.port = std::atoi(argv[++i]);
+            if (options.port <= 0 || options.port > 65535) {
+                return false;
+            }
+        } else if (arg == "-r" && i + 1 < argc) {
+            if (!parse_rates(argv[++i], options.rates_hz)) {
+                return false;
+            }
+        } else if (arg == "-d" && i + 1 < argc) {
+            options.step_s = std::strtod(argv[++i], nullptr);
+            if (options.step_s <= 0.0) {
+                return false;
+            }
+        } else if (arg == "-o" && i + 1 < argc) {
+            options.report_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Nearest rank of sorted latencies.
+double percentile_ms(const std::vector<double> &sorted_ms, double fraction)
+{
+    if (sorted_ms.empty()) {
+        return 0.0;
+    }
+    const size_t rank = static_cast<size_t>(std::ceil(fraction * sorted_ms.size()));
+    return sorted_ms[std::min(sorted_ms.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+StepResult summarize(double rate_hz, size_t stream, uint64_t sent, uint64_t missed, const std::vector<double> &latencies_ms)
+{
+    StepResult result;
+    result.rate_hz = rate_hz;
+    result.stream = stream;
+    result.sent = sent;
+    result.received = latencies_ms.size();
+    result.lost = sent > result.received ? sent - result.received : 0;
+    result.missed = missed;
+
+    double jitter_sum_ms = 0.0;
+    for (size_t i = 1; i < latencies_ms.size(); ++i) {
+        jitter_sum_ms += std::fabs(latencies_ms[i] - latencies_ms[i - 1]);
+    }
+    result.jitter_ms = latencies_ms.size() > 1 ? jitter_sum_ms / (latencies_ms.size() - 1) : 0.0;
+
+    std::vector<double> sorted_ms = latencies_ms;
+    std::sort(sorted_ms.begin(), sorted_ms.end());
+    result.p50_ms = percentile_ms(sorted_ms, 0.5);
+    result.p99_ms = percentile_ms(sorted_ms, 0.99);
+    result.max_ms = sorted_ms.empty() ? 0.0 : sorted_ms.back();
+    return result;
+}
+
+void print_header()
+{
+    log_info() << std::right << std::setw(8) << "rate_hz" << " " << std::left << std::setw(13) << "stream"
+               << std::right << std::setw(8) << "sent" << std::setw(10) << "received" << std::setw(8) << "lost"
+               << std::setw(9) << "p50_ms" << std::setw(9) << "p99_ms" << std::setw(9) << "max_ms"
+               << std::setw(11) << "jitter_ms";
+}
+
+void print_result(const StepResult &result)
+{
+    log_info() << std::right << std::setw(8) << result.rate_hz << " " << std::left << std::setw(13)
+               << stream_names[result.stream] << std::right << std::setw(8) << result.sent << std::setw(10)
+               << result.received << std::setw(8) << result.lost << std::fixed << std::setprecision(3)
+               << std::setw(9) << result.p50_ms << std::setw(9) << result.p99_ms << std::setw(9) << result.max_ms
+               << std::setw(11) << result.jitter_ms << std::defaultfloat << (saturated(result) ? "  saturated" : "");
+}
+
+bool write_csv_report(const std::string &path, const std::vector<StepResult> &results)
+{
+    std::ofstream file(path);
+    if (!file) {
+        log_error() << "Cannot write report " << path;
+        return false;
+    }
+
+    file << "rate_hz,stream,sent,received,lost,p50_ms,p99_ms,max_ms,jitter_ms,missed_deadlines,saturated\n";
+    for (const auto &result : results) {
+        file << result.rate_hz << "," << stream_names[result.stream] << "," << result.sent << ","
+             << result.received << "," << result.lost << "," << result.p50_ms << "," << result.p99_ms << ","
+             << result.max_ms << "," << result.jitter_ms << "," << result.missed << "," << saturated(result) << "\n";
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    MavlinkStandIn stand_in(options.port);
+    if (!stand_in.start()) {
+        log_error() << "Cannot open a UDP socket to port " << options.port;
+        return 1;
+    }
+
+    Mavsdk dc;
+    if (!connect_system(dc, "udp://:" + std::to_string(options.port), discovery_timeout)) {
+        return 1;
+    }
+    Telemetry telemetry(dc.system());
+    TelemetryMonitor monitor(telemetry);
+
+    LatencyRecorder recorder(stand_in);
+    std::vector<TelemetryMonitor::listener_handle_t> listeners;
+    listeners.push_back(monitor.add_position_listener([&recorder](const Telemetry::Position &position) {
+        recorder.record(Stream::POSITION, MavlinkStandIn::sequence_of(position));
+    }));
+    listeners.push_back(monitor.add_ground_speed_listener([&recorder](const Telemetry::GroundSpeedNED &ground_speed) {
+        recorder.record(Stream::GROUND_SPEED, MavlinkStandIn::sequence_of(ground_speed));
+    }));
+    listeners.push_back(monitor.add_attitude_listener([&recorder](const Telemetry::EulerAngle &attitude) {
+        recorder.record(Stream::ATTITUDE, MavlinkStandIn::sequence_of(attitude));
+    }));
+
+    log_info() << "Sweeping " << options.rates_hz.size() << " rates, " << options.step_s << " s each";
+    print_header();
+    std::vector<StepResult> results;
+    const duration<double> step_time(options.step_s);
+    for (const double rate_hz : options.rates_hz) {
+        recorder.begin_step(static_cast<size_t>(rate_hz * options.step_s));
+        const uint64_t position_sent = stand_in.sent(StandInMessage::GLOBAL_POSITION_INT);
+        const uint64_t attitude_sent = stand_in.sent(StandInMessage::ATTITUDE_QUATERNION);
+        const uint64_t missed = stand_in.missed();
+
+        stand_in.set_rate(rate_hz);
+        real_clock().sleep_for(duration_cast<Clock::duration>(step_time));
+        stand_in.set_rate(0.0);
+        real_clock().sleep_for(drain_time);
+
+        const uint64_t sent[stream_count] = {
+            stand_in.sent(StandInMessage::GLOBAL_POSITION_INT) - position_sent,
+            stand_in.sent(StandInMessage::GLOBAL_POSITION_INT) - position_sent,
+            stand_in.sent(StandInMessage::ATTITUDE_QUATERNION) - attitude_sent};
+        for (size_t stream = 0; stream < stream_count; ++stream) {
+            results.push_back(summarize(rate_hz, stream, sent[stream], stand_in.missed() - missed,
+                                        recorder.latencies_ms(stream)));
+            print_result(results.back());
+        }
+        if (stand_in.missed() > missed) {
+            log_info() << "The stand-in missed " << stand_in.missed() - missed << " deadlines at " << rate_hz
+                       << " Hz, the rate sent was lower";
+        }
+    }
+
+    for (const auto handle : listeners) {
+        monitor.remove_listener(handle);
+    }
+    stand_in.stop();
+
+    if (recorder.unmatched() > 0) {
+        log_error() << recorder.unmatched() << " messages arrived with a sequence number never sent";
+    }
+    const auto first_saturated = std::find_if(results.begin(), results.end(), saturated);
+    if (first_saturated == results.end()) {
+        log_info() << "The callbacks kept up with all rates up to "
+                   << *std::max_element(options.rates_hz.begin(), options.rates_hz.end()) << " Hz";
+    } else {
+        log_info() << "The callbacks saturate at " << first_saturated->rate_hz << " Hz ("
+                   << stream_names[first_saturated->stream] << ")";
+    }
+
+    if (!options.report_path.empty() && !write_csv_report(options.report_path, results)) {
+        return 1;
+    }
+    return 0;
+}
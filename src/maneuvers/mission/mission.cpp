@@ -4,136 +4,135 @@
 
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
-#include <thread>
 #include <unistd.h>
-#include <future>
+#include <memory>
+#include <vector>
 
 #include "plugins/action/action.h"
-#include "plugins/offboard/offboard.h"
 #include "plugins/telemetry/telemetry.h"
 #include "plugins/mission/mission.h"
 #include "plugins/param/param.h"
 #include "mavsdk.h"
+#include "console.h"
+#include "event_loop.h"
+#include "flight_recorder.h"
+#include "geofence.h"
+#include "log_sink.h"
+#include "maneuver.h"
+#include "maneuver_steps.h"
+#include "mission_builder.h"
+#include "mission_file.h"
+#include "mission_maneuver.h"
+#include "mission_sync.h"
+#include "phase_stats.h"
+#include "rate_scheduler.h"
+#include "sim_autopilot.h"
+#include "survey_planner.h"
+#include "telemetry_monitor.h"
 
 
 using namespace mavsdk;
 using std::chrono::milliseconds;
 using std::chrono::seconds;
-using std::this_thread::sleep_for;
 
-#define ERROR_CONSOLE_TEXT "\033[31m"     // Turn text on console red
-#define TELEMETRY_CONSOLE_TEXT "\033[34m" // Turn text on console blue
-#define NORMAL_CONSOLE_TEXT "\033[0m"     // Restore normal console colour
+const double flight_record_rate_hz = 100.0;
 
-// Handles Action's result
-inline void action_error_exit(Action::Result result, const std::string &message)
-{
-    if (result != Action::Result::SUCCESS)
-    {
-        std::cerr << ERROR_CONSOLE_TEXT << message << Action::result_str(result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
-// Handles Offboard's result
-inline void offboard_error_exit(Offboard::Result result, const std::string &message)
-{
-    if (result != Offboard::Result::SUCCESS)
-    {
-        std::cerr << ERROR_CONSOLE_TEXT << message << Offboard::result_str(result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
-// Handles connection result
-inline void connection_error_exit(ConnectionResult result, const std::string &message)
-{
-    if (result != ConnectionResult::SUCCESS)
-    {
-        std::cerr << ERROR_CONSOLE_TEXT << message << connection_result_str(result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
-// Handles Mission's result
-inline void handle_mission_err_exit(Mission::Result result, const std::string &message)
-{
-    if (result != Mission::Result::SUCCESS)
-    {
-        std::cerr << ERROR_CONSOLE_TEXT << message << Mission::result_str(result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
-// Logs during Offboard control
-inline void offboard_log(const std::string &offb_mode, const std::string msg)
-{
-    std::cout << "[" << offb_mode << "] " << msg << std::endl;
-}
-
-Telemetry::Position computeHorizontalLocation(Telemetry::Position pos, double radius, double bearing)
-{
-    double earthRadius = 6371000;
-    double bearingRadius = ((M_PI * bearing) / 180);
-    double latitudeRadius = ((M_PI * (pos.latitude_deg)) / 180);
-    double longitudeRadius = ((M_PI * (pos.longitude_deg)) / 180);
-    double computedLatitude = asin(sin(latitudeRadius) * cos(radius / earthRadius) + cos(latitudeRadius) * sin(radius / earthRadius) * cos(bearingRadius));
-    double computedLongitude = longitudeRadius + atan2(sin(bearingRadius) * sin(radius / earthRadius) * cos(latitudeRadius),
-                                                       cos(radius / earthRadius) - sin(latitudeRadius) * sin(computedLatitude));
-    Telemetry::Position computepos = {((computedLatitude) * (180.0 / M_PI)), ((computedLongitude) * (180.0 / M_PI)), pos.absolute_altitude_m, pos.relative_altitude_m};
-    return computepos;
-}
+// Heartbeats come at 1 Hz, a vehicle which sent none for this long is not there.
+const seconds discovery_timeout(5);
 
-// convenience functin for missiont item
-static std::shared_ptr<MissionItem> make_mission_item(double latitude_deg,
-                                                      double longitude_deg,
-                                                      float relative_altitude_m,
-                                                      float speed_m_s,
-                                                      bool is_fly_through,
-                                                      float gimbal_pitch_deg,
-                                                      float gimbal_yaw_deg,
-                                                      float loiter_time_s,
-                                                      MissionItem::CameraAction camera_action)
-{
-    std::shared_ptr<MissionItem> new_item(new MissionItem());
-    new_item->set_position(latitude_deg, longitude_deg);
-    new_item->set_relative_altitude(relative_altitude_m);
-    new_item->set_speed(speed_m_s);
-    new_item->set_fly_through(is_fly_through);
-    new_item->set_gimbal_pitch_and_yaw(gimbal_pitch_deg, gimbal_yaw_deg);
-    new_item->set_loiter_time(loiter_time_s);
-    new_item->set_camera_action(camera_action);
-    return new_item;
-}
+// Items PX4 stores per mission.
+const size_t default_max_mission_items = 2000;
 
 void usage(std::string bin_name)
 {
-    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " <connection_url>" << std::endl
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " [-p phase_stats_prefix] [-m mission_fingerprint_directory [-v]] [-f mission_file | -s survey [-n max_items]] [-g geofence_file] <connection_url> [flight_record_file]" << std::endl
               << "Connection URL format should be :" << std::endl
               << " For TCP : tcp://[server_host][:server_port]" << std::endl
               << " For UDP : udp://[bind_host][:bind_port]" << std::endl
               << " For Serial : serial:///path/to/serial/dev[:baudrate]" << std::endl
-              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl;
+              << " For the built-in simulated vehicle : sim://[speedup], e.g. sim://50 runs 50x faster than real time" << std::endl
+              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl
+              << "If a flight record file is given, telemetry is recorded into it at " << flight_record_rate_hz << " Hz." << std::endl
+              << "With -p, command latencies are appended to <prefix>.csv and summarized over all runs in <prefix>.json." << std::endl
+              << "With -m, the mission is only uploaded if it differs from the last one uploaded to the vehicle," << std::endl
+              << "which is remembered in that directory. -v downloads the mission to compare instead of only checking its size." << std::endl
+              << "With -f, the mission of that file (see maneuvers_mission_convert) is flown instead of the default one." << std::endl
+              << "With -s lawnmower|spiral,width_m,length_m[,waypoint_spacing_m], a survey of the area north east of the" << std::endl
+              << "vehicle is flown instead, in segments of at most max_items items (default " << default_max_mission_items << ")." << std::endl
+              << "With -g, every leg of the mission is checked against the fence and zones of the file before it is uploaded," << std::endl
+              << "one \"fence|zone altitude_m|- lat,lon lat,lon lat,lon ...\" polygon per line." << std::endl;
 }
 
 int main(int argc, char **argv)
 {
     Mavsdk dc;
     std::string connection_url;
-    ConnectionResult connection_result;
 
-    auto prom = std::make_shared<std::promise<void>>();
-    auto future_result = prom->get_future();
+    std::string flight_record_file;
+    std::string phase_stats_prefix;
+    std::string fingerprint_directory;
+    std::string mission_file_path;
+    bool verify_mission = false;
+    std::string survey_text;
+    std::string geofence_path;
+    size_t max_mission_items = default_max_mission_items;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-p" && i + 1 < argc)
+        {
+            phase_stats_prefix = argv[++i];
+        }
+        else if (arg == "-m" && i + 1 < argc)
+        {
+            fingerprint_directory = argv[++i];
+        }
+        else if (arg == "-f" && i + 1 < argc)
+        {
+            mission_file_path = argv[++i];
+        }
+        else if (arg == "-s" && i + 1 < argc)
+        {
+            survey_text = argv[++i];
+        }
+        else if (arg == "-n" && i + 1 < argc)
+        {
+            max_mission_items = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "-g" && i + 1 < argc)
+        {
+            geofence_path = argv[++i];
+        }
+        else if (arg == "-v")
+        {
+            verify_mission = true;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
 
-    if (argc == 2)
+    SurveySettings survey_settings;
+    double survey_width_m = 0.0, survey_length_m = 0.0;
+    const bool survey = !survey_text.empty();
+    if (survey && (!mission_file_path.empty() || max_mission_items < 2 ||
+                   !parse_survey_area(survey_text, survey_settings, survey_width_m, survey_length_m)))
     {
-        connection_url = argv[1];
-        connection_result = dc.add_any_connection(connection_url);
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (positional.size() == 1 || positional.size() == 2)
+    {
+        connection_url = positional[0];
+        if (positional.size() == 2)
+        {
+            flight_record_file = positional[1];
+        }
     }
     else
     {
@@ -141,157 +140,118 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    if (connection_result != ConnectionResult::SUCCESS)
+    // Rejected before connecting if it is damaged.
+    MissionFileReader mission_file;
+    if (!mission_file_path.empty() && !mission_file.open(mission_file_path))
     {
-        std::cout << ERROR_CONSOLE_TEXT
-                  << "Connection failed: " << connection_result_str(connection_result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
+        log_error() << "Cannot read mission file " << mission_file_path;
         return 1;
     }
 
-    // Wait for the system to connect via heartbeat
-    while (!dc.is_connected())
+    std::vector<FencePolygon> fence_polygons;
+    Geofence geofence;
+    if (!geofence_path.empty() && (!load_geofence(geofence_path, fence_polygons) || !geofence.build(fence_polygons)))
     {
-        std::cout << "Wait for system to connect via heartbeat" << std::endl;
-        sleep_for(seconds(1));
+        log_error() << "Cannot use geofence file " << geofence_path;
+        return 1;
     }
+    const Geofence *fence = geofence.empty() ? nullptr : &geofence;
 
-    // System got discovered.
-    System &system = dc.system();
-    auto action = std::make_shared<Action>(system);
-    auto offboard = std::make_shared<Offboard>(system);
-    auto telemetry = std::make_shared<Telemetry>(system);
-    auto mission = std::make_shared<Mission>(system);
-    auto param = std::make_shared<Param>(system);
-
-    while (!telemetry->health_all_ok())
+    std::unique_ptr<Autopilot> autopilot;
+    std::string vehicle_id = "sim";
+    double speedup = 1.0;
+    if (parse_sim_url(connection_url, speedup))
     {
-        std::cout << "Waiting for system to be ready" << std::endl;
-        sleep_for(seconds(3));
+        log_info() << "Simulating the vehicle at " << speedup << "x real time";
+        autopilot.reset(new SimAutopilot(speedup));
     }
-
-    std::cout << "System is ready" << std::endl;
-    std::cout << "Creating and uploading mission" << std::endl;
-
-    // get current position
-    Telemetry::Position pos = {telemetry->position().latitude_deg, telemetry->position().longitude_deg, telemetry->position().absolute_altitude_m, telemetry->position().relative_altitude_m};
-
-    std::vector<std::shared_ptr<MissionItem>> mission_items;
-    mission_items.push_back(make_mission_item(pos.latitude_deg,
-                                              pos.longitude_deg,
-                                              10.0f,
-                                              2.0f,
-                                              true,
-                                              -60.f,
-                                              -90.f,
-                                              0.0f,
-                                              MissionItem::CameraAction::START_PHOTO_INTERVAL));
-
-    Telemetry::Position next = computeHorizontalLocation(pos, 20, 270);
-    mission_items.push_back(make_mission_item(next.latitude_deg,
-                                              next.longitude_deg,
-                                              10.0f,
-                                              2.0f,
-                                              true,
-                                              -60.f,
-                                              -70.0f,
-                                              0.0f,
-                                              MissionItem::CameraAction::START_PHOTO_INTERVAL));
-
-    next = computeHorizontalLocation(pos, 30, 180);
-    mission_items.push_back(make_mission_item(next.latitude_deg,
-                                              next.longitude_deg,
-                                              10.0f,
-                                              2.0f,
-                                              true,
-                                              -60.f,
-                                              -90.0f,
-                                              0.0f,
-                                              MissionItem::CameraAction::START_PHOTO_INTERVAL));
-
-    next = computeHorizontalLocation(pos, 10, 90);
-    mission_items.push_back(make_mission_item(next.latitude_deg,
-                                              next.longitude_deg,
-                                              10.0f,
-                                              2.0f,
-                                              true,
-                                              -60.f,
-                                              -20.0f,
-                                              0.0f,
-                                              MissionItem::CameraAction::START_PHOTO_INTERVAL));
-
+    else
     {
-        std::cout << "Uploading mission..." << std::endl;
-        // We only have the upload_mission function asynchronous for now, so we wrap it using
-        // std::future.
-        auto prom = std::make_shared<std::promise<Mission::Result>>();
-        auto future_result = prom->get_future();
-        mission->upload_mission_async(mission_items,
-                                      [prom](Mission::Result result) { prom->set_value(result); });
-
-        const Mission::Result result = future_result.get();
-
-        if (result != Mission::Result::SUCCESS)
+        // Goes on with the first heartbeat instead of polling for it.
+        if (!connect_system(dc, connection_url, discovery_timeout))
         {
-            std::cout << "Mission upload failed (" << Mission::result_str(result) << "), exiting."
-                      << std::endl;
             return 1;
         }
 
-        std::cout << "Mission uploaded." << std::endl;
+        // System got discovered.
+        autopilot.reset(new MavsdkAutopilot(dc.system()));
+        vehicle_id = std::to_string(dc.system().get_uuid());
+    }
+    TelemetryMonitor &monitor = autopilot->monitor();
+
+    std::unique_ptr<MissionSync> sync;
+    if (!fingerprint_directory.empty())
+    {
+        sync.reset(new MissionSync(*autopilot, fingerprint_directory + "/mission_" + vehicle_id + ".txt",
+                                   verify_mission));
+    }
+    PhaseStats phase_stats;
+    PhaseStats *phases = phase_stats_prefix.empty() ? nullptr : &phase_stats;
+
+    FlightRecorder recorder(monitor);
+    if (!flight_record_file.empty() && !recorder.start(flight_record_file, flight_record_rate_hz))
+    {
+        return 1;
     }
 
-    // We want to listen to the local posiiton of the drone at 1 Hz.
-    const Telemetry::Result set_rate_result = telemetry->set_rate_position_velocity_ned(1.0);
+    // The telemetry rates follow the phases of the flight, starting low on the ground.
+    RateScheduler rates(monitor);
+    const Telemetry::Result set_rate_result = rates.enter(FlightPhase::GROUND);
 
     if (set_rate_result != Telemetry::Result::SUCCESS)
     {
-        std::cout << ERROR_CONSOLE_TEXT
-                  << "Setting rate failed:" << Telemetry::result_str(set_rate_result)
-                  << NORMAL_CONSOLE_TEXT << std::endl;
+        log_error() << "Setting rate failed:" << Telemetry::result_str(set_rate_result);
         return 1;
     };
 
-    // Arm
-    Action::Result arm_result = action->arm();
-
-    action_error_exit(arm_result, "Arming failed");
+    EventLoop loop;
+    auto maneuver = std::make_shared<Maneuver>("", *autopilot, loop);
+    maneuver->set_rate_scheduler(&rates);
+    maneuver->abort_if("pilot took over", pilot_took_over(monitor));
+    maneuver->then("wait until ready", ready_step());
+    std::shared_ptr<MissionSegments> survey_segments;
+    if (survey)
+    {
+        survey_segments = std::make_shared<MissionSegments>();
+        maneuver->then("plan survey", plan_survey_step(survey_settings, survey_rectangle(survey_width_m, survey_length_m),
+                                                       max_mission_items, survey_segments, fence));
+    }
+    maneuver->then("upload mission", upload_mission_step(mission_file_path.empty() ? nullptr : &mission_file,
+                                                         survey_segments, sync.get(), fence, phases));
+    maneuver->then("arm", arm_step(phases));
+    maneuver->then("run mission", run_mission_step(phases));
+    if (survey)
+    {
+        maneuver->then("fly remaining survey segments", fly_remaining_segments_step(survey_segments, sync.get(), phases));
+    }
 
-    std::cout << "Armed" << std::endl;
+    // Keep recording the way home.
+    const bool wait_for_landing = !flight_record_file.empty() || phases;
+    maneuver->then("return to launch", wait_for_landing ? return_to_launch_step(phases) : command_rtl_step(phases));
 
-    std::atomic<bool> want_to_pause{false};
+    // Bring the vehicle home even if the mission did not finish.
+    maneuver->on_failure("return home", return_home_step(phases));
 
-    // Before starting the mission, we want to be sure to subscribe to the mission progress.
-    mission->subscribe_progress([&want_to_pause](int current, int total) {
-        std::cout << "Mission status update: " << current << " / " << total << std::endl;
+    Maneuver::Result result = Maneuver::Result::FAILED;
+    maneuver->start([&loop, &result](Maneuver::Result maneuver_result)
+    {
+        result = maneuver_result;
+        loop.stop();
     });
+    loop.run();
 
+    if (!flight_record_file.empty())
     {
-        auto prom = std::make_shared<std::promise<Mission::Result>>();
-        auto future_result = prom->get_future();
-        mission->start_mission_async([prom](Mission::Result result) {
-            prom->set_value(result);
-        });
-
-        const Mission::Result result = future_result.get();
-        handle_mission_err_exit(result, "Mission start failed: ");
+        recorder.stop();
+        log_info() << "Recorded " << recorder.records_written() << " telemetry samples to " << flight_record_file;
     }
 
-    while (!mission->mission_finished())
-    {
-        sleep_for(seconds(1));
-    }
+    print_link_usage(rates.usage(), rates.profile());
 
+    if (phases && !export_phase_stats(phase_stats, phase_stats_prefix))
     {
-        // We are done, and can do RTL to go home.
-        std::cout << "Commanding RTL" << std::endl;
-        const Action::Result result = action->return_to_launch();
-
-        if (result != Action::Result::SUCCESS)
-        {
-            std::cout << "Failed to command RTL (" << Action::result_str(result) << ")" << std::endl;
-        }
+        return EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    return result == Maneuver::Result::SUCCEEDED ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,63 @@
+/**
+ * Converts a QGroundControl plan into a mission file for maneuvers_mission -f
+ **/
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "plugins/mission/mission.h"
+#include "console.h"
+#include "mission_builder.h"
+#include "mission_file.h"
+
+using namespace mavsdk;
+
+void usage(std::string bin_name)
+{
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " <qgc_plan_file> <mission_file>" << std::endl
+              << "Reads the mission items of a QGroundControl plan (.plan) and writes them into a mission file." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string plan_path = argv[1];
+    const std::string mission_path = argv[2];
+
+    Mission::mission_items_t mission_items;
+    const Mission::Result import_result = Mission::import_qgroundcontrol_mission(mission_items, plan_path);
+    if (import_result != Mission::Result::SUCCESS)
+    {
+        std::cout << ERROR_CONSOLE_TEXT << "Importing " << plan_path << " failed: "
+                  << Mission::result_str(import_result) << NORMAL_CONSOLE_TEXT << std::endl;
+        return 1;
+    }
+
+    // maneuvers_mission does not fly an empty mission file.
+    if (mission_items.empty())
+    {
+        std::cout << ERROR_CONSOLE_TEXT << plan_path << " has no mission items" << NORMAL_CONSOLE_TEXT << std::endl;
+        return 1;
+    }
+
+    std::vector<MissionItemRecord> records;
+    records.reserve(mission_items.size());
+    for (const auto &item : mission_items)
+    {
+        records.push_back(make_mission_item_record(*item));
+    }
+
+    if (!write_mission_file(mission_path, records))
+    {
+        std::cout << ERROR_CONSOLE_TEXT << "Writing " << mission_path << " failed" << NORMAL_CONSOLE_TEXT << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << records.size() << " mission items to " << mission_path << std::endl;
+    return 0;
+}
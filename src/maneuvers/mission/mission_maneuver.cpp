@@ -0,0 +1,305 @@
+//
+// Building blocks of the mission maneuver, shared by maneuvers_mission and
+// the maneuver daemon.
+//
+
+#include "mission_maneuver.h"
+
+#include "geodesy.h"
+#include "log_sink.h"
+
+using namespace mavsdk;
+
+namespace
+{
+
+bool within_fence(Maneuver &maneuver, const Geofence &fence, const Telemetry::Position &start,
+                  const MissionBuilder &mission)
+{
+    const std::vector<FenceViolation> violations =
+        fence.check_mission(start.latitude_deg, start.longitude_deg, start.relative_altitude_m, mission);
+    if (!violations.empty())
+    {
+        maneuver.log(LogLevel::ERROR) << "Mission of " << mission.size() << " items violates the geofence "
+                                      << violations.size() << " times, not flying it:";
+        print_fence_violations(violations);
+        return false;
+    }
+    maneuver.log() << "All legs of the mission are within the geofence";
+    return true;
+}
+
+} // namespace
+
+void add_default_mission(MissionBuilder &mission_builder, const Telemetry::Position &pos)
+{
+    mission_builder.reserve(4);
+    mission_builder.add_item(pos.latitude_deg,
+                             pos.longitude_deg,
+                             10.0f,
+                             2.0f,
+                             true,
+                             -60.f,
+                             -90.f,
+                             0.0f,
+                             MissionItem::CameraAction::START_PHOTO_INTERVAL);
+
+    Telemetry::Position next = computeHorizontalLocation(pos, 20, 270);
+    mission_builder.add_item(next.latitude_deg,
+                             next.longitude_deg,
+                             10.0f,
+                             2.0f,
+                             true,
+                             -60.f,
+                             -70.0f,
+                             0.0f,
+                             MissionItem::CameraAction::START_PHOTO_INTERVAL);
+
+    next = computeHorizontalLocation(pos, 30, 180);
+    mission_builder.add_item(next.latitude_deg,
+                             next.longitude_deg,
+                             10.0f,
+                             2.0f,
+                             true,
+                             -60.f,
+                             -90.0f,
+                             0.0f,
+                             MissionItem::CameraAction::START_PHOTO_INTERVAL);
+
+    next = computeHorizontalLocation(pos, 10, 90);
+    mission_builder.add_item(next.latitude_deg,
+                             next.longitude_deg,
+                             10.0f,
+                             2.0f,
+                             true,
+                             -60.f,
+                             -20.0f,
+                             0.0f,
+                             MissionItem::CameraAction::START_PHOTO_INTERVAL);
+}
+
+Maneuver::step_t plan_survey_step(const SurveySettings &settings, const std::vector<SurveyPoint> &area, size_t max_items,
+                                  std::shared_ptr<MissionSegments> survey, const Geofence *fence)
+{
+    return [settings, area, max_items, survey, fence](Maneuver &maneuver, Maneuver::done_t done)
+    {
+        const Telemetry::Position position = maneuver.monitor().position();
+        MissionBuilder mission;
+        if (!plan_survey(position.latitude_deg, position.longitude_deg, area, settings, mission))
+        {
+            done(false);
+            return;
+        }
+        // As a whole, the segments are flown one after the other.
+        if (fence && !within_fence(maneuver, *fence, position, mission))
+        {
+            done(false);
+            return;
+        }
+        survey->segments = split_mission(mission, max_items);
+        survey->current = 0;
+
+        const SurveyGeometry geometry = survey_geometry(settings);
+        maneuver.log() << "Survey of " << mission.size() << " items in " << survey->segments.size()
+                       << " segments, lines " << geometry.line_spacing_m << " m and photos " << geometry.photo_spacing_m
+                       << " m apart at " << geometry.speed_m_s << " m/s";
+        done(!mission.empty());
+    };
+}
+
+Maneuver::step_t upload_mission_step(const MissionFileReader *mission_file, std::shared_ptr<const MissionSegments> survey,
+                                     MissionSync *sync, const Geofence *fence, PhaseStats *phases)
+{
+    return [mission_file, survey, sync, fence, phases](Maneuver &maneuver, Maneuver::done_t done)
+    {
+        Maneuver *m = &maneuver;
+        m->log() << "Creating and uploading mission";
+
+        // Straight from the mapped records to the SDK items, unless the mission has to be looked at
+        // first.
+        const bool from_mapped_file = mission_file && !survey && !sync && !fence;
+
+        // Built once from one position, so the mission checked against the fence is the one uploaded.
+        const Telemetry::Position position = maneuver.monitor().position();
+        MissionBuilder mission_builder;
+        const MissionBuilder *mission = &mission_builder;
+        if (survey)
+        {
+            mission = &survey->segments[survey->current];
+        }
+        else if (mission_file)
+        {
+            if (!from_mapped_file)
+            {
+                mission_file->append_to(mission_builder);
+            }
+        }
+        else
+        {
+            add_default_mission(mission_builder, position);
+        }
+
+        // A survey was checked as a whole when it was planned.
+        if (fence && !survey && !within_fence(maneuver, *fence, position, *mission))
+        {
+            done(false);
+            return;
+        }
+
+        auto timer = std::make_shared<PhaseTimer>(phases, "upload_mission", maneuver.autopilot().clock());
+        auto uploaded = m->in_step<MissionSyncReport>([m, timer, done](MissionSyncReport report)
+        {
+            timer->completed(report.result == Mission::Result::SUCCESS);
+            if (report.result != Mission::Result::SUCCESS)
+            {
+                m->log(LogLevel::ERROR) << "Mission upload failed: " << Mission::result_str(report.result);
+                done(false);
+                return;
+            }
+            if (!report.uploaded)
+            {
+                m->log() << "Vehicle already has the mission, upload skipped.";
+            }
+            else if (report.changed_first == 0 && report.changed_count >= report.items)
+            {
+                m->log() << "Mission of " << report.items << " items uploaded in full.";
+            }
+            else
+            {
+                m->log() << "Mission of " << report.items << " items uploaded (" << report.changed_count
+                         << " changed since the last upload).";
+            }
+            done(true);
+        });
+
+        m->log() << "Uploading mission...";
+        if (from_mapped_file)
+        {
+            const size_t items = mission_file->record_count();
+            maneuver.autopilot().upload_mission_async(
+                mission_file->mission_items(),
+                [uploaded, items](Mission::Result result)
+                {
+                    uploaded({result, true, items, 0, items});
+                });
+            return;
+        }
+        if (sync)
+        {
+            sync->sync_async(*mission, uploaded);
+            return;
+        }
+        const size_t items = mission->size();
+        maneuver.autopilot().upload_mission_async(
+            mission->build(),
+            [uploaded, items](Mission::Result result)
+            {
+                uploaded({result, true, items, 0, items});
+            });
+    };
+}
+
+Maneuver::step_t run_mission_step(PhaseStats *phases)
+{
+    return [phases](Maneuver &maneuver, Maneuver::done_t done)
+    {
+        Maneuver *m = &maneuver;
+        Autopilot *autopilot = &maneuver.autopilot();
+
+        // Before starting the mission, we want to be sure to subscribe to the mission progress.
+        auto progress = m->in_step<std::pair<int, int>>([m](std::pair<int, int> current_total)
+        {
+            m->log() << "Mission status update: " << current_total.first << " / " << current_total.second;
+            m->notify();
+        });
+        autopilot->subscribe_mission_progress([progress](int current, int total)
+        {
+            progress(std::make_pair(current, total));
+        });
+        maneuver.on_step_end([autopilot]() { autopilot->subscribe_mission_progress(nullptr); });
+
+        maneuver.enter_flight_phase(FlightPhase::CRUISE);
+        auto timer = std::make_shared<PhaseTimer>(phases, "start_mission", autopilot->clock());
+        autopilot->start_mission_async(m->in_step<Mission::Result>([m, autopilot, timer, done](Mission::Result result)
+        {
+            timer->acked(result == Mission::Result::SUCCESS);
+            if (result != Mission::Result::SUCCESS)
+            {
+                m->log(LogLevel::ERROR) << "Mission start failed: " << Mission::result_str(result);
+                done(false);
+                return;
+            }
+
+            m->wait_until([autopilot]() { return autopilot->mission_finished(); },
+                          std::chrono::minutes(30),
+                          [m, timer, done](bool finished, double elapsed_s)
+            {
+                timer->completed(finished);
+                if (!finished)
+                {
+                    m->log(LogLevel::ERROR) << "Mission not finished after " << elapsed_s << " s";
+                }
+                else
+                {
+                    m->log() << "Mission finished after " << elapsed_s << " s";
+                }
+                done(finished);
+            });
+        }));
+    };
+}
+
+Maneuver::step_t fly_remaining_segments_step(std::shared_ptr<MissionSegments> survey, MissionSync *sync, PhaseStats *phases)
+{
+    const Maneuver::step_t upload = upload_mission_step(nullptr, survey, sync, nullptr, phases);
+    const Maneuver::step_t run = run_mission_step(phases);
+    return [survey, upload, run](Maneuver &maneuver, Maneuver::done_t done)
+    {
+        Maneuver *m = &maneuver;
+        auto next_segment = std::make_shared<Maneuver::done_t>();
+        *next_segment = [m, survey, upload, run, next_segment, done](bool success)
+        {
+            if (!success || survey->current + 1 >= survey->segments.size())
+            {
+                // Ends the cycle through next_segment, which destroys this function.
+                const Maneuver::done_t finished = done;
+                *next_segment = nullptr;
+                finished(success);
+                return;
+            }
+            ++survey->current;
+            m->log() << "Survey segment " << survey->current + 1 << " of " << survey->segments.size();
+            upload(*m, [m, run, next_segment](bool uploaded)
+            {
+                if (!uploaded)
+                {
+                    (*next_segment)(false);
+                    return;
+                }
+                run(*m, *next_segment);
+            });
+        };
+        (*next_segment)(true);
+    };
+}
+
+Maneuver::step_t command_rtl_step(PhaseStats *phases)
+{
+    return [phases](Maneuver &maneuver, Maneuver::done_t done)
+    {
+        Maneuver *m = &maneuver;
+
+        // We are done, and can do RTL to go home.
+        m->log() << "Commanding RTL";
+        auto timer = std::make_shared<PhaseTimer>(phases, "return_to_launch", maneuver.autopilot().clock());
+        maneuver.autopilot().return_to_launch_async(m->in_step<Action::Result>([m, timer, done](Action::Result result)
+        {
+            timer->acked(result == Action::Result::SUCCESS);
+            if (result != Action::Result::SUCCESS)
+            {
+                m->log(LogLevel::ERROR) << "Failed to command RTL (" << Action::result_str(result) << ")";
+            }
+            done(result == Action::Result::SUCCESS);
+        }));
+    };
+}
@@ -0,0 +1,53 @@
+//
+// Building blocks of the mission maneuver, shared by maneuvers_mission and
+// the maneuver daemon.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <plugins/telemetry/telemetry.h>
+
+#include "geofence.h"
+#include "maneuver.h"
+#include "mission_builder.h"
+#include "mission_file.h"
+#include "mission_sync.h"
+#include "phase_stats.h"
+#include "survey_planner.h"
+
+// A planned mission, flown one segment after the other.
+struct MissionSegments
+{
+    std::vector<MissionBuilder> segments;
+    size_t current;
+};
+
+// Adds the default mission around the current position.
+void add_default_mission(MissionBuilder &mission_builder, const mavsdk::Telemetry::Position &pos);
+
+// The steps below run on a Maneuver (maneuver.h). If phases is given, the ack and completion
+// latency of every command is recorded into it. If fence is given, missions are checked against
+// it from the current position on and not flown if a leg violates it.
+
+// Plans the survey over the area with its corner at the current position.
+Maneuver::step_t plan_survey_step(const SurveySettings &settings, const std::vector<SurveyPoint> &area, size_t max_items,
+                                  std::shared_ptr<MissionSegments> survey, const Geofence *fence = nullptr);
+
+// Uploads the current segment of survey, the mission of mission_file or the default one, through
+// sync if given. A survey is checked against the fence when it is planned, not here.
+Maneuver::step_t upload_mission_step(const MissionFileReader *mission_file, std::shared_ptr<const MissionSegments> survey,
+                                     MissionSync *sync, const Geofence *fence, PhaseStats *phases = nullptr);
+
+// Starts the mission and waits until it is finished.
+Maneuver::step_t run_mission_step(PhaseStats *phases = nullptr);
+
+// Uploads and flies the segments of survey after the current one.
+Maneuver::step_t fly_remaining_segments_step(std::shared_ptr<MissionSegments> survey, MissionSync *sync,
+                                             PhaseStats *phases = nullptr);
+
+// Commands RTL without waiting for the landing.
+Maneuver::step_t command_rtl_step(PhaseStats *phases = nullptr);
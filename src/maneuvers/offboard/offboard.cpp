@@ -0,0 +1,242 @@
+//
+// Maneuver which flies a precomputed trajectory under offboard control.
+//
+// The trajectory (a circle starting where the vehicle hovers after the
+// takeoff) is computed before offboard control starts, and streamed by an
+// OffboardSender at a fixed rate. Afterwards the vehicle returns home and
+// the timing of the setpoints is reported.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <plugins/offboard/offboard.h>
+#include <plugins/telemetry/telemetry.h>
+
+#include "mavsdk.h"
+#include "console.h"
+#include "event_loop.h"
+#include "geodesy.h"
+#include "log_sink.h"
+#include "maneuver.h"
+#include "maneuver_steps.h"
+#include "offboard_sender.h"
+#include "rate_scheduler.h"
+#include "sim_autopilot.h"
+#include "telemetry_monitor.h"
+#include "trajectory.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+const double default_rate_hz = 50.0;
+
+// Heartbeats come at 1 Hz, a vehicle which sent none for this long is not there.
+const seconds discovery_timeout(5);
+
+struct Options {
+    std::string connection_url;
+    double rate_hz;
+    SetpointType setpoint_type;
+    CircleSettings circle;
+};
+
+// The trajectory and its sender, once offboard control starts.
+struct OffboardFlight {
+    std::shared_ptr<const Trajectory> trajectory;
+    std::unique_ptr<OffboardSender> sender;
+};
+
+void usage(std::string bin_name)
+{
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " [-r rate_hz] [-v] [-c radius_m,speed_m_s,laps] <connection_url>" << std::endl
+              << "Connection URL format should be :" << std::endl
+              << " For TCP : tcp://[server_host][:server_port]" << std::endl
+              << " For UDP : udp://[bind_host][:bind_port]" << std::endl
+              << " For Serial : serial:///path/to/serial/dev[:baudrate]" << std::endl
+              << " For the built-in simulated vehicle : sim://[speedup], e.g. sim://5 runs 5x faster than real time" << std::endl
+              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl
+              << "Flies a circle (default 10 m radius at 3 m/s, one lap) under offboard control, streaming" << std::endl
+              << "position setpoints at rate_hz (default " << default_rate_hz << " Hz), or velocity setpoints with -v." << std::endl
+              << "The setpoints follow the clock of a simulated vehicle, keep its speedup low at high rates." << std::endl;
+}
+
+bool parse_options(int argc, char **argv, Options &options)
+{
+    options.rate_hz = default_rate_hz;
+    options.setpoint_type = SetpointType::POSITION;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-r" && i + 1 < argc) {
+            options.rate_hz = std::strtod(argv[++i], nullptr);
+            if (options.rate_hz <= 0.0) {
+                return false;
+            }
+        } else if (arg == "-v") {
+            options.setpoint_type = SetpointType::VELOCITY;
+        } else if (arg == "-c" && i + 1 < argc) {
+            if (!parse_circle_settings(argv[++i], options.circle)) {
+                return false;
+            }
+        } else if (options.connection_url.empty()) {
+            options.connection_url = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.connection_url.empty();
+}
+
+// Remembers where the vehicle is, the origin of the local frame.
+Maneuver::step_t remember_home_step(std::shared_ptr<Telemetry::Position> home)
+{
+    return [home](Maneuver &maneuver, Maneuver::done_t done) {
+        *home = maneuver.monitor().position();
+        done(true);
+    };
+}
+
+// Computes the trajectory from the current position, starts streaming it and switches to
+// offboard control, then waits until the last setpoint has been sent.
+Maneuver::step_t fly_trajectory_step(const Options &options, std::shared_ptr<const Telemetry::Position> home,
+                                     std::shared_ptr<OffboardFlight> flight)
+{
+    return [options, home, flight](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        TelemetryMonitor *monitor = &maneuver.monitor();
+
+        const Telemetry::Position position = monitor->position();
+        double north_m, east_m;
+        geodesy::north_east_between(home->latitude_deg, home->longitude_deg,
+                                    position.latitude_deg, position.longitude_deg, north_m, east_m);
+        TrajectorySample start = {};
+        start.north_m = static_cast<float>(north_m);
+        start.east_m = static_cast<float>(east_m);
+        start.down_m = -position.relative_altitude_m;
+        start.yaw_deg = monitor->attitude_euler_angle().yaw_deg;
+
+        auto trajectory = std::make_shared<Trajectory>(circle_trajectory(start, options.circle, options.rate_hz));
+        flight->trajectory = trajectory;
+        flight->sender.reset(new OffboardSender(maneuver.autopilot(), trajectory, options.setpoint_type));
+        m->log() << "Streaming " << trajectory->samples.size() << " setpoints at " << options.rate_hz << " Hz ("
+                 << trajectory->duration_s() << " s)";
+
+        maneuver.enter_flight_phase(FlightPhase::TRACKING);
+
+        OffboardSender *sender = flight->sender.get();
+        sender->start();
+        // Only a flown trajectory is streamed on until stop_offboard_step, however else the step
+        // ends, the vehicle is not left to a stream the maneuver has given up on.
+        auto flown = std::make_shared<bool>(false);
+        maneuver.on_step_end([sender, flown]() {
+            if (!*flown) {
+                sender->stop();
+            }
+        });
+        const milliseconds timeout(static_cast<int64_t>(trajectory->duration_s() * 2000.0) + 30000);
+        maneuver.autopilot().start_offboard_async(m->in_step<Offboard::Result>([m, sender, flown, timeout, done](Offboard::Result result) {
+            if (result != Offboard::Result::SUCCESS) {
+                m->log(LogLevel::ERROR) << "Starting offboard control failed: " << Offboard::result_str(result);
+                done(false);
+                return;
+            }
+            sender->play();
+            m->wait_until([sender]() { return sender->finished(); }, timeout,
+                          [m, flown, done](bool finished, double elapsed_s) {
+                if (!finished) {
+                    m->log(LogLevel::ERROR) << "Trajectory not finished after " << elapsed_s << " s";
+                } else {
+                    m->log() << "Trajectory finished after " << elapsed_s << " s";
+                }
+                *flown = finished;
+                done(finished);
+            });
+        }));
+    };
+}
+
+// Hands the vehicle back to hold and stops streaming.
+Maneuver::step_t stop_offboard_step(std::shared_ptr<OffboardFlight> flight)
+{
+    return [flight](Maneuver &maneuver, Maneuver::done_t done) {
+        Maneuver *m = &maneuver;
+        maneuver.autopilot().stop_offboard_async(m->in_step<Offboard::Result>([m, flight, done](Offboard::Result result) {
+            flight->sender->stop();
+            if (result != Offboard::Result::SUCCESS) {
+                m->log(LogLevel::ERROR) << "Stopping offboard control failed: " << Offboard::result_str(result);
+            }
+            done(result == Offboard::Result::SUCCESS);
+        }));
+    };
+}
+
+void print_send_stats(const OffboardSendStats &stats, double rate_hz)
+{
+    log_info() << "Setpoints at " << rate_hz << " Hz: " << stats.sent << " sent, " << stats.missed
+               << " deadlines missed, jitter mean " << stats.mean_jitter_ms << " ms, p99 < "
+               << stats.p99_jitter_ms << " ms, max " << stats.max_jitter_ms << " ms";
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Mavsdk dc;
+    std::unique_ptr<Autopilot> autopilot;
+    double speedup = 1.0;
+    if (parse_sim_url(options.connection_url, speedup)) {
+        log_info() << "Simulating the vehicle at " << speedup << "x real time";
+        autopilot.reset(new SimAutopilot(speedup));
+    } else {
+        // Goes on with the first heartbeat instead of polling for it.
+        if (!connect_system(dc, options.connection_url, discovery_timeout)) {
+            return 1;
+        }
+        autopilot.reset(new MavsdkAutopilot(dc.system()));
+    }
+    TelemetryMonitor &monitor = autopilot->monitor();
+
+    RateScheduler rates(monitor);
+    const Telemetry::Result set_rate_result = rates.enter(FlightPhase::GROUND);
+    if (set_rate_result != Telemetry::Result::SUCCESS) {
+        log_error() << "Setting rate failed:" << Telemetry::result_str(set_rate_result);
+        return 1;
+    }
+
+    auto home = std::make_shared<Telemetry::Position>();
+    auto flight = std::make_shared<OffboardFlight>();
+
+    EventLoop loop;
+    auto maneuver = std::make_shared<Maneuver>("", *autopilot, loop);
+    maneuver->set_rate_scheduler(&rates);
+    maneuver->abort_if("pilot took over", pilot_took_over(monitor));
+    maneuver->then("wait until ready", ready_step());
+    maneuver->then("remember home", remember_home_step(home));
+    maneuver->then("arm", arm_step(nullptr));
+    maneuver->then("take off", takeoff_step(nullptr));
+    maneuver->then("fly trajectory", fly_trajectory_step(options, home, flight));
+    maneuver->then("stop offboard", stop_offboard_step(flight));
+    maneuver->then("return to launch", return_to_launch_step(nullptr));
+    maneuver->on_failure("return home", return_home_step(nullptr));
+
+    int return_value = 1;
+    maneuver->start([&loop, &return_value](Maneuver::Result result) {
+        return_value = result == Maneuver::Result::SUCCEEDED ? 0 : 1;
+        loop.stop();
+    });
+    loop.run();
+
+    if (flight->sender) {
+        flight->sender->stop();
+        print_send_stats(flight->sender->stats(), options.rate_hz);
+    }
+    print_link_usage(rates.usage(), rates.profile());
+    return return_value;
+}
@@ -0,0 +1,241 @@
+//
+// Records telemetry published through a monitor without a vehicle and reads
+// the file back: records, index and footer. Then reads the same file cut off
+// before its index, as after a crash, and with damaged footers, which have
+// to be rejected rather than followed outside the file.
+//
+// Exits with 1 if a check fails.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "flight_recorder.h"
+#include "telemetry_monitor.h"
+
+using namespace mavsdk;
+
+namespace {
+
+// More than two index blocks, fewer than a ring buffer holds.
+const unsigned position_count = 3000;
+const unsigned speed_count = 10;
+const unsigned record_count = position_count + speed_count + 1;
+
+const double home_latitude_deg = 47.397742;
+const double home_longitude_deg = 8.545594;
+
+bool check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "failed: " << what << std::endl;
+    }
+    return condition;
+}
+
+// Removed with the test.
+struct TemporaryFile {
+    std::string path;
+
+    TemporaryFile()
+    {
+        char name[] = "/tmp/maneuvers_flight_record_test_XXXXXX";
+        const int fd = mkstemp(name);
+        if (fd >= 0) {
+            close(fd);
+            path = name;
+        }
+    }
+    ~TemporaryFile()
+    {
+        if (!path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+};
+
+std::vector<char> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+bool write_file(const std::string &path, const std::vector<char> &bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), bytes.size());
+    return static_cast<bool>(file);
+}
+
+bool record(const std::string &path)
+{
+    TelemetryMonitor monitor(real_clock());
+    FlightRecorder recorder(monitor);
+    if (!check(recorder.start(path, 10.0), "recording started")) {
+        return false;
+    }
+    monitor.publish_armed(true);
+    for (unsigned i = 0; i < position_count; ++i) {
+        Telemetry::Position position;
+        position.latitude_deg = home_latitude_deg + i * 1e-6;
+        position.longitude_deg = home_longitude_deg;
+        position.absolute_altitude_m = 500.0f;
+        position.relative_altitude_m = 12.0f;
+        monitor.publish_position(position);
+    }
+    for (unsigned i = 0; i < speed_count; ++i) {
+        Telemetry::GroundSpeedNED speed;
+        speed.velocity_north_m_s = float(i);
+        speed.velocity_east_m_s = 0.0f;
+        speed.velocity_down_m_s = 0.0f;
+        monitor.publish_ground_speed_ned(speed);
+    }
+    recorder.stop();
+
+    bool passed = check(recorder.records_written() == record_count, "every sample written");
+    passed &= check(recorder.dropped(FlightRecordType::POSITION) == 0, "no position dropped");
+    return passed;
+}
+
+bool test_round_trip(const std::string &path)
+{
+    FlightRecordReader reader;
+    if (!check(reader.open(path), "recording opened") || !check(reader.footer() != nullptr, "footer found")) {
+        return false;
+    }
+    bool passed = check(reader.header()->record_size == sizeof(FlightRecord), "record size in the header");
+    passed &= check(reader.record_count() == record_count && reader.footer()->record_count == record_count,
+                    "record count");
+    for (unsigned i = 0; i < flight_record_type_count; ++i) {
+        passed &= check(reader.footer()->dropped[i] == 0, "nothing dropped");
+    }
+
+    unsigned positions = 0, speeds = 0, armed = 0;
+    bool in_order = true, values = true;
+    for (size_t i = 0; i < reader.record_count(); ++i) {
+        const FlightRecord &record = reader.records()[i];
+        switch (static_cast<FlightRecordType>(record.type)) {
+            case FlightRecordType::POSITION:
+                in_order = in_order && record.sequence == positions;
+                values = values && record.position.latitude_deg == home_latitude_deg + positions * 1e-6 &&
+                         record.position.relative_altitude_m == 12.0f;
+                ++positions;
+                break;
+            case FlightRecordType::VELOCITY:
+                in_order = in_order && record.sequence == speeds;
+                values = values && record.velocity.north_m_s == float(speeds);
+                ++speeds;
+                break;
+            case FlightRecordType::ARMED:
+                values = values && record.armed == 1;
+                ++armed;
+                break;
+            default:
+                values = false;
+                break;
+        }
+    }
+    passed &= check(positions == position_count && speeds == speed_count && armed == 1, "records of every stream");
+    passed &= check(in_order, "sequence numbers without gaps");
+    passed &= check(values, "values recorded");
+
+    // Blocks of 1024 records, one after the other, each within its time range.
+    passed &= check(reader.index_count() == (record_count + 1023) / 1024, "one index entry per block");
+    uint64_t next = 0;
+    for (size_t i = 0; i < reader.index_count(); ++i) {
+        const FlightRecordIndexEntry &entry = reader.index()[i];
+        passed &= check(entry.first_record == next, "index entry " + std::to_string(i) + " follows the one before");
+        for (uint64_t r = entry.first_record; r < entry.first_record + entry.records; ++r) {
+            const uint64_t time_us = reader.records()[r].time_us;
+            passed &= check(entry.min_time_us <= time_us && time_us <= entry.max_time_us,
+                            "record " + std::to_string(r) + " within the time range of its block");
+        }
+        next += entry.records;
+    }
+    passed &= check(next == record_count, "index covers every record");
+    return passed;
+}
+
+// As if the recorder never got to write the index and footer, ending within a record.
+bool test_cut_off(const std::vector<char> &bytes)
+{
+    std::vector<char> cut(bytes.begin(), bytes.begin() + sizeof(FlightRecordFileHeader) + 100 * sizeof(FlightRecord) + 20);
+    TemporaryFile file;
+    FlightRecordReader reader;
+    if (!check(write_file(file.path, cut) && reader.open(file.path), "cut off recording opened")) {
+        return false;
+    }
+    bool passed = check(reader.footer() == nullptr && reader.index_count() == 0, "no footer or index");
+    passed &= check(reader.record_count() == 100, "complete records before the cut");
+    return passed;
+}
+
+bool opens_with_footer(const std::vector<char> &bytes, const FlightRecordFileFooter &footer)
+{
+    std::vector<char> damaged = bytes;
+    std::memcpy(damaged.data() + damaged.size() - sizeof(footer), &footer, sizeof(footer));
+    TemporaryFile file;
+    FlightRecordReader reader;
+    return write_file(file.path, damaged) && reader.open(file.path);
+}
+
+bool test_damaged_footer(const std::vector<char> &bytes)
+{
+    FlightRecordFileFooter footer;
+    std::memcpy(&footer, bytes.data() + bytes.size() - sizeof(footer), sizeof(footer));
+    bool passed = check(opens_with_footer(bytes, footer), "intact footer accepted");
+
+    FlightRecordFileFooter damaged = footer;
+    damaged.index_offset = 1ull << 60;
+    passed &= check(!opens_with_footer(bytes, damaged), "index beyond the file rejected");
+
+    damaged = footer;
+    damaged.index_offset -= sizeof(FlightRecord);
+    passed &= check(!opens_with_footer(bytes, damaged), "index within the records rejected");
+
+    damaged = footer;
+    damaged.index_count = 1ull << 61;
+    passed &= check(!opens_with_footer(bytes, damaged), "too many index entries rejected");
+
+    damaged = footer;
+    damaged.record_count = bytes.size();
+    passed &= check(!opens_with_footer(bytes, damaged), "too many records rejected");
+
+    // Fewer records than the index refers to.
+    damaged = footer;
+    damaged.record_count = 1000;
+    passed &= check(!opens_with_footer(bytes, damaged), "index beyond the records rejected");
+
+    std::vector<char> other = bytes;
+    std::memcpy(other.data(), "NOTAFLT1", 8);
+    TemporaryFile file;
+    FlightRecordReader reader;
+    passed &= check(write_file(file.path, other) && !reader.open(file.path), "other file rejected");
+
+    std::vector<char> tiny(bytes.begin(), bytes.begin() + 10);
+    passed &= check(write_file(file.path, tiny) && !reader.open(file.path), "file shorter than a header rejected");
+    return passed;
+}
+
+} // namespace
+
+int main()
+{
+    TemporaryFile file;
+    bool passed = record(file.path);
+    passed &= test_round_trip(file.path);
+    const std::vector<char> bytes = read_file(file.path);
+    passed &= test_cut_off(bytes);
+    passed &= test_damaged_footer(bytes);
+
+    std::cout << (passed ? "passed" : "failed") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,412 @@
+//
+// Checks legs and missions against a small fence with two zones, where the
+// expected violations are known, and against a grid of many zones, where
+// they are compared with a plain check of every leg against every edge.
+// Also reads geofence files, valid and malformed ones.
+//
+// Exits with 1 if a check fails.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "geodesy.h"
+#include "geofence.h"
+
+using namespace mavsdk;
+
+namespace {
+
+const double home_latitude_deg = 47.397742;
+const double home_longitude_deg = 8.545594;
+
+FenceVertex vertex(double north_m, double east_m)
+{
+    FenceVertex result;
+    geodesy::offset_north_east(home_latitude_deg, home_longitude_deg, north_m, east_m, result.latitude_deg,
+                               result.longitude_deg);
+    return result;
+}
+
+Telemetry::Position position(double north_m, double east_m, float altitude_m)
+{
+    const FenceVertex point = vertex(north_m, east_m);
+    Telemetry::Position result;
+    result.latitude_deg = point.latitude_deg;
+    result.longitude_deg = point.longitude_deg;
+    result.absolute_altitude_m = altitude_m;
+    result.relative_altitude_m = altitude_m;
+    return result;
+}
+
+FencePolygon rectangle(FenceKind kind, float altitude_m, double south_m, double west_m, double north_m,
+                       double east_m)
+{
+    FencePolygon polygon;
+    polygon.kind = kind;
+    polygon.altitude_m = altitude_m;
+    polygon.vertices = {vertex(south_m, west_m), vertex(north_m, west_m), vertex(north_m, east_m),
+                        vertex(south_m, east_m)};
+    return polygon;
+}
+
+void add_item(MissionBuilder &mission, double north_m, double east_m, float altitude_m)
+{
+    const FenceVertex point = vertex(north_m, east_m);
+    mission.add_item(point.latitude_deg, point.longitude_deg, altitude_m, 5.0f, true, 0.0f, 0.0f, 0.0f,
+                     MissionItem::CameraAction::NONE);
+}
+
+bool check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "failed: " << what << std::endl;
+    }
+    return condition;
+}
+
+bool has(const std::vector<FenceViolation> &violations, size_t item, size_t polygon, FenceViolationType type)
+{
+    for (const auto &violation : violations) {
+        if (violation.item == item && violation.polygon == polygon && violation.type == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The fence, 1 km wide up to 120 m, a zone north of home up to 60 m and
+// one south of it without a top.
+const size_t fence_polygon = 0;
+const size_t low_zone = 1;
+const size_t no_fly_zone = 2;
+
+bool build_small_fence(Geofence &fence)
+{
+    std::vector<FencePolygon> polygons;
+    polygons.push_back(rectangle(FenceKind::INCLUSION, 120.0f, -500.0, -500.0, 500.0, 500.0));
+    polygons.push_back(rectangle(FenceKind::EXCLUSION, 60.0f, 100.0, -50.0, 200.0, 50.0));
+    polygons.push_back(rectangle(FenceKind::EXCLUSION, INFINITY, -300.0, -50.0, -200.0, 50.0));
+    return fence.build(polygons);
+}
+
+bool test_leg_ends()
+{
+    Geofence fence;
+    if (!check(build_small_fence(fence), "small fence built")) {
+        return false;
+    }
+    bool passed = check(fence.polygon_count() == 3 && fence.edge_count() == 12, "polygons and edges kept");
+
+    passed &= check(fence.check_leg(position(0, 0, 50), position(50, 300, 50)).empty(), "leg inside the fence");
+
+    auto violations = fence.check_leg(position(0, 0, 50), position(0, 600, 50));
+    passed &= check(violations.size() == 1 && has(violations, 0, fence_polygon, FenceViolationType::OUTSIDE_FENCE),
+                    "leg leaving the fence");
+
+    violations = fence.check_leg(position(600, 0, 50), position(700, 0, 50));
+    passed &= check(violations.size() == 1 && has(violations, 0, fence_polygon, FenceViolationType::OUTSIDE_FENCE),
+                    "leg outside the fence");
+
+    violations = fence.check_leg(position(0, 0, 50), position(0, 100, 150));
+    passed &= check(violations.size() == 1 && has(violations, 0, fence_polygon, FenceViolationType::ABOVE_FENCE),
+                    "leg climbing above the fence");
+
+    violations = fence.check_leg(position(0, 0, 30), position(150, 0, 30));
+    passed &= check(violations.size() == 1 && has(violations, 0, low_zone, FenceViolationType::IN_ZONE),
+                    "leg ending in a zone");
+
+    violations = fence.check_leg(position(150, 0, 30), position(150, 20, 30));
+    passed &= check(violations.size() == 1 && has(violations, 0, low_zone, FenceViolationType::IN_ZONE),
+                    "leg within a zone");
+
+    passed &= check(fence.check_leg(position(150, 0, 70), position(150, 20, 80)).empty(), "leg above a zone");
+    return passed;
+}
+
+// Legs which cross a zone with both ends outside of it.
+bool test_leg_crossings()
+{
+    Geofence fence;
+    if (!check(build_small_fence(fence), "small fence built")) {
+        return false;
+    }
+
+    auto violations = fence.check_leg(position(50, 0, 30), position(250, 0, 30));
+    bool passed = check(violations.size() == 1 && has(violations, 0, low_zone, FenceViolationType::IN_ZONE),
+                        "leg through a zone");
+
+    violations = fence.check_leg(position(70, 20, 30), position(130, 70, 30));
+    passed &= check(violations.size() == 1 && has(violations, 0, low_zone, FenceViolationType::IN_ZONE),
+                    "leg across the corner of a zone");
+
+    violations = fence.check_leg(position(50, 0, 80), position(250, 0, 30));
+    passed &= check(violations.size() == 1 && has(violations, 0, low_zone, FenceViolationType::IN_ZONE),
+                    "leg descending through a zone");
+
+    passed &= check(fence.check_leg(position(50, 0, 80), position(250, 0, 70)).empty(), "leg over a zone");
+    passed &= check(fence.check_leg(position(50, 100, 30), position(250, 100, 30)).empty(), "leg beside a zone");
+
+    violations = fence.check_leg(position(-100, 0, 110), position(-400, 0, 110));
+    passed &= check(violations.size() == 1 && has(violations, 0, no_fly_zone, FenceViolationType::IN_ZONE),
+                    "leg through a zone without a top");
+    return passed;
+}
+
+bool test_mission()
+{
+    Geofence fence;
+    if (!check(build_small_fence(fence), "small fence built")) {
+        return false;
+    }
+
+    MissionBuilder mission;
+    add_item(mission, 50, 0, 30);    // fine
+    add_item(mission, 250, 0, 30);   // through the low zone
+    add_item(mission, 250, 0, 130);  // above the fence
+    add_item(mission, 250, 600, 30); // out of the fence
+    add_item(mission, 250, 0, 30);   // back into it
+    add_item(mission, 0, 0, 30);     // through the low zone again
+
+    const FenceVertex start = vertex(0, 0);
+    const auto violations = fence.check_mission(start.latitude_deg, start.longitude_deg, 30.0f, mission);
+    bool passed = check(violations.size() == 5, "one violation per bad leg");
+    passed &= check(has(violations, 1, low_zone, FenceViolationType::IN_ZONE), "item 1 in the zone");
+    passed &= check(has(violations, 2, fence_polygon, FenceViolationType::ABOVE_FENCE), "item 2 above the fence");
+    passed &= check(has(violations, 3, fence_polygon, FenceViolationType::OUTSIDE_FENCE), "item 3 out of the fence");
+    passed &= check(has(violations, 4, fence_polygon, FenceViolationType::OUTSIDE_FENCE), "item 4 from outside");
+    passed &= check(has(violations, 5, low_zone, FenceViolationType::IN_ZONE), "item 5 in the zone");
+
+    Geofence empty;
+    passed &= check(empty.build(std::vector<FencePolygon>()) && empty.empty(), "no polygons");
+    passed &= check(empty.check_mission(start.latitude_deg, start.longitude_deg, 30.0f, mission).empty(),
+                    "nothing to violate");
+    return passed;
+}
+
+bool test_build_rejected()
+{
+    std::vector<FencePolygon> polygons;
+    polygons.push_back(rectangle(FenceKind::EXCLUSION, 60.0f, 100.0, -50.0, 200.0, 50.0));
+    polygons.push_back(rectangle(FenceKind::EXCLUSION, 60.0f, 300.0, -50.0, 400.0, 50.0));
+    polygons.back().vertices.resize(2);
+
+    Geofence fence;
+    bool passed = check(!fence.build(polygons) && fence.empty(), "polygon with two vertices rejected");
+
+    polygons.pop_back();
+    polygons.push_back(rectangle(FenceKind::INCLUSION, 120.0f, -500.0, -500.0, 500.0, 500.0));
+    polygons.push_back(rectangle(FenceKind::INCLUSION, 120.0f, -400.0, -400.0, 400.0, 400.0));
+    passed &= check(!fence.build(polygons) && fence.empty(), "second fence rejected");
+    passed &= check(fence.check_leg(position(0, 0, 30), position(900, 0, 30)).empty(), "rejected fence checks nothing");
+    return passed;
+}
+
+// Plain versions of the checks, for the local frame of the first vertex.
+struct Point {
+    double north_m;
+    double east_m;
+};
+
+Point local(const FenceVertex &origin, double latitude_deg, double longitude_deg)
+{
+    Point point;
+    geodesy::north_east_between(origin.latitude_deg, origin.longitude_deg, latitude_deg, longitude_deg,
+                                point.north_m, point.east_m);
+    return point;
+}
+
+double side(const Point &a, const Point &b, const Point &c)
+{
+    return (b.north_m - a.north_m) * (c.east_m - a.east_m) - (b.east_m - a.east_m) * (c.north_m - a.north_m);
+}
+
+bool crosses(const Point &a, const Point &b, const Point &c, const Point &d)
+{
+    return (side(a, b, c) > 0.0) != (side(a, b, d) > 0.0) && (side(c, d, a) > 0.0) != (side(c, d, b) > 0.0);
+}
+
+bool inside(const std::vector<Point> &corners, const Point &point)
+{
+    bool result = false;
+    for (size_t i = 0; i < corners.size(); ++i) {
+        const Point &a = corners[i];
+        const Point &b = corners[(i + 1) % corners.size()];
+        if ((a.north_m > point.north_m) != (b.north_m > point.north_m) &&
+            point.east_m < a.east_m + (point.north_m - a.north_m) * (b.east_m - a.east_m) / (b.north_m - a.north_m)) {
+            result = !result;
+        }
+    }
+    return result;
+}
+
+// 900 tilted zones, every other one with a top at 40 m, and a random flight
+// across them, so legs go through many grid cells and zones.
+bool test_many_zones()
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> tilt(-0.4, 0.4);
+    std::vector<FencePolygon> polygons;
+    for (int row = 0; row < 30; ++row) {
+        for (int column = 0; column < 30; ++column) {
+            const double north_m = row * 25.0;
+            const double east_m = column * 25.0;
+            const double angle = tilt(random);
+            FencePolygon polygon;
+            polygon.kind = FenceKind::EXCLUSION;
+            polygon.altitude_m = (row + column) % 2 ? 40.0f : INFINITY;
+            for (int corner = 0; corner < 4; ++corner) {
+                const double bearing = angle + corner * M_PI / 2.0;
+                polygon.vertices.push_back(vertex(north_m + 7.0 * std::cos(bearing), east_m + 7.0 * std::sin(bearing)));
+            }
+            polygons.push_back(polygon);
+        }
+    }
+    Geofence fence;
+    if (!check(fence.build(polygons), "zones built")) {
+        return false;
+    }
+    bool passed = check(fence.edge_count() == 4 * polygons.size(), "every edge kept");
+
+    const FenceVertex origin = polygons[0].vertices[0];
+    std::vector<std::vector<Point>> corners(polygons.size());
+    for (size_t i = 0; i < polygons.size(); ++i) {
+        for (const auto &corner : polygons[i].vertices) {
+            corners[i].push_back(local(origin, corner.latitude_deg, corner.longitude_deg));
+        }
+    }
+
+    std::uniform_real_distribution<double> place(-50.0, 780.0);
+    std::uniform_real_distribution<double> altitude(0.0, 80.0);
+    std::vector<Telemetry::Position> path;
+    for (int i = 0; i < 400; ++i) {
+        path.push_back(position(place(random), place(random), float(altitude(random))));
+    }
+    MissionBuilder mission;
+    for (size_t i = 1; i < path.size(); ++i) {
+        mission.add_item(path[i].latitude_deg, path[i].longitude_deg, path[i].relative_altitude_m, 5.0f, true,
+                         0.0f, 0.0f, 0.0f, MissionItem::CameraAction::NONE);
+    }
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t leg = 1; leg < path.size(); ++leg) {
+        const Point from = local(origin, path[leg - 1].latitude_deg, path[leg - 1].longitude_deg);
+        const Point to = local(origin, path[leg].latitude_deg, path[leg].longitude_deg);
+        const float lowest_m = std::min(path[leg - 1].relative_altitude_m, path[leg].relative_altitude_m);
+        for (size_t polygon = 0; polygon < polygons.size(); ++polygon) {
+            if (lowest_m >= polygons[polygon].altitude_m) {
+                continue;
+            }
+            bool met = inside(corners[polygon], from) || inside(corners[polygon], to);
+            for (size_t i = 0; !met && i < corners[polygon].size(); ++i) {
+                met = crosses(from, to, corners[polygon][i], corners[polygon][(i + 1) % corners[polygon].size()]);
+            }
+            if (met) {
+                expected.push_back(std::make_pair(leg - 1, polygon));
+            }
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> found;
+    for (const auto &violation : fence.check_mission(path[0].latitude_deg, path[0].longitude_deg,
+                                                     path[0].relative_altitude_m, mission)) {
+        passed &= check(violation.type == FenceViolationType::IN_ZONE, "only zone violations");
+        found.push_back(std::make_pair(violation.item, violation.polygon));
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    passed &= check(!expected.empty(), "flight meets zones");
+    passed &= check(found == expected, "same zones as checking every edge (" + std::to_string(found.size()) +
+                                           " found, " + std::to_string(expected.size()) + " expected)");
+    return passed;
+}
+
+// Removed with the test.
+struct TemporaryFile {
+    std::string path;
+
+    explicit TemporaryFile(const std::string &text)
+    {
+        char name[] = "/tmp/maneuvers_geofence_test_XXXXXX";
+        const int fd = mkstemp(name);
+        if (fd >= 0) {
+            close(fd);
+            path = name;
+            FILE *file = std::fopen(name, "w");
+            std::fputs(text.c_str(), file);
+            std::fclose(file);
+        }
+    }
+    ~TemporaryFile()
+    {
+        if (!path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+};
+
+bool test_load()
+{
+    TemporaryFile file("# test fence\n"
+                       "fence 120 47.39,8.54 47.40,8.54 47.40,8.55 47.39,8.55\n"
+                       "\n"
+                       "zone - 47.395,8.545 47.396,8.545 47.396,8.546\n"
+                       "zone 35.5 47.397,8.545 47.398,8.545 47.398,8.546 47.397,8.546\n");
+    std::vector<FencePolygon> polygons;
+    if (!check(load_geofence(file.path, polygons), "file read") || !check(polygons.size() == 3, "three polygons")) {
+        return false;
+    }
+    bool passed = check(polygons[0].kind == FenceKind::INCLUSION && polygons[0].altitude_m == 120.0f &&
+                            polygons[0].vertices.size() == 4,
+                        "fence read");
+    passed &= check(polygons[0].vertices[2].latitude_deg == 47.40 && polygons[0].vertices[2].longitude_deg == 8.55,
+                    "vertex read");
+    passed &= check(polygons[1].kind == FenceKind::EXCLUSION && std::isinf(polygons[1].altitude_m) &&
+                        polygons[1].vertices.size() == 3,
+                    "zone without a top read");
+    passed &= check(polygons[2].kind == FenceKind::EXCLUSION && polygons[2].altitude_m == 35.5f &&
+                        polygons[2].vertices.size() == 4,
+                    "zone with a top read");
+
+    const char *malformed[] = {
+        "zone 30 47.39,8.54 47.40,8.54\n",              // two vertices
+        "wall 30 47.39,8.54 47.40,8.54 47.40,8.55\n",   // unknown kind
+        "zone 30m 47.39,8.54 47.40,8.54 47.40,8.55\n",  // altitude with a unit
+        "zone 30 47.39,8.54 47.40,8.54 47.40,8.55 47\n", // odd coordinate count
+        "zone 30 47.39,8.54 47.40,8.54 north,8.55\n",   // not a number
+    };
+    for (const char *text : malformed) {
+        TemporaryFile bad(text);
+        std::vector<FencePolygon> ignored;
+        passed &= check(!load_geofence(bad.path, ignored), std::string("rejected: ") + text);
+    }
+
+    std::vector<FencePolygon> ignored;
+    passed &= check(!load_geofence("/nonexistent/fence.txt", ignored), "missing file rejected");
+    return passed;
+}
+
+} // namespace
+
+int main()
+{
+    bool passed = true;
+    passed &= test_leg_ends();
+    passed &= test_leg_crossings();
+    passed &= test_mission();
+    passed &= test_build_rejected();
+    passed &= test_many_zones();
+    passed &= test_load();
+
+    std::cout << (passed ? "passed" : "failed") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,88 @@
+//
+// The range of changed items mission sync reports, for missions which
+// changed in the middle, grew, shrank or stayed the same, and saving and
+// loading the fingerprint.
+//
+// Exits with 1 if a check fails.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "mission_sync.h"
+
+namespace {
+
+MissionFingerprint fingerprint_of(const std::vector<uint64_t> &item_hashes)
+{
+    MissionFingerprint fingerprint;
+    fingerprint.mission_hash = 0;
+    fingerprint.vehicle_item_count = static_cast<int>(item_hashes.size());
+    fingerprint.item_hashes = item_hashes;
+    return fingerprint;
+}
+
+bool check_range(const std::string &name, const std::vector<uint64_t> &previous, const std::vector<uint64_t> &current,
+                 size_t expected_first, size_t expected_count)
+{
+    size_t first = 0;
+    size_t count = 0;
+    mission_changed_range(fingerprint_of(previous), fingerprint_of(current), first, count);
+    if (first != expected_first || count != expected_count) {
+        std::cerr << name << ": changed " << first << "+" << count << ", expected " << expected_first << "+"
+                  << expected_count << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// A fingerprint survives saving and loading, a save which cannot be written fails.
+bool check_save_and_load()
+{
+    char directory[] = "/tmp/maneuvers_mission_sync_test_XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cerr << "cannot create a directory" << std::endl;
+        return false;
+    }
+    const std::string path = std::string(directory) + "/fingerprint.txt";
+    const MissionFingerprint saved = fingerprint_of({1, 2, 0xfedcba9876543210ull});
+    MissionFingerprint loaded;
+    bool passed = save_mission_fingerprint(path, saved) && load_mission_fingerprint(path, loaded) &&
+                  loaded.mission_hash == saved.mission_hash &&
+                  loaded.vehicle_item_count == saved.vehicle_item_count && loaded.item_hashes == saved.item_hashes;
+    if (!passed) {
+        std::cerr << "saved fingerprint not loaded back" << std::endl;
+    }
+    std::remove(path.c_str());
+
+    const std::string missing_path = std::string(directory) + "/missing/fingerprint.txt";
+    if (save_mission_fingerprint(missing_path, saved)) {
+        std::cerr << "save into a missing directory succeeded" << std::endl;
+        passed = false;
+    }
+    rmdir(directory);
+    return passed;
+}
+
+} // namespace
+
+int main()
+{
+    bool passed = true;
+    passed &= check_range("unchanged", {1, 2, 3, 4}, {1, 2, 3, 4}, 4, 0);
+    passed &= check_range("changed in the middle", {1, 2, 3, 4}, {1, 5, 6, 4}, 1, 2);
+    passed &= check_range("appended", {1, 2, 3}, {1, 2, 3, 4, 5}, 3, 2);
+    passed &= check_range("prefix of the previous", {1, 2, 3, 4, 5}, {1, 2, 3}, 3, 2);
+    passed &= check_range("shorter and changed", {1, 2, 3, 4, 5}, {1, 6, 3}, 1, 4);
+    passed &= check_range("emptied", {1, 2}, {}, 0, 2);
+    passed &= check_range("no previous items", {}, {1, 2}, 0, 2);
+    passed &= check_save_and_load();
+
+    std::cout << (passed ? "passed" : "failed") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
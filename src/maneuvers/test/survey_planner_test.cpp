@@ -0,0 +1,301 @@
+//
+// Plans surveys over rectangles and a U-shaped area with settings that give
+// round line spacings, and checks where the lines lie, the camera actions,
+// the spiral, parsing of survey areas, and that split missions fly the same
+// waypoints with the camera off between segments.
+//
+// Exits with 1 if a check fails.
+//
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "geodesy.h"
+#include "survey_planner.h"
+
+using namespace mavsdk;
+
+namespace {
+
+const double home_latitude_deg = 47.397742;
+const double home_longitude_deg = 8.545594;
+
+// Within a millimeter, what the round trip through latitude and longitude keeps.
+const double tolerance_m = 1e-3;
+
+bool check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "failed: " << what << std::endl;
+    }
+    return condition;
+}
+
+SurveyPoint local(const MissionItemRecord &item)
+{
+    SurveyPoint point;
+    geodesy::north_east_between(home_latitude_deg, home_longitude_deg, item.latitude_deg, item.longitude_deg,
+                                point.north_m, point.east_m);
+    return point;
+}
+
+bool at(const MissionItemRecord &item, double north_m, double east_m)
+{
+    const SurveyPoint point = local(item);
+    return std::fabs(point.north_m - north_m) < tolerance_m && std::fabs(point.east_m - east_m) < tolerance_m;
+}
+
+MissionItem::CameraAction camera(const MissionItemRecord &item)
+{
+    return static_cast<MissionItem::CameraAction>(item.camera_action);
+}
+
+// A 60 m wide and 30 m long footprint at 30 m, half of it overlapping: 30 m
+// between lines, 15 m between photos.
+SurveySettings round_settings()
+{
+    SurveySettings settings;
+    settings.altitude_m = 30.0f;
+    settings.horizontal_fov_deg = 90.0f;
+    settings.vertical_fov_deg = 2.0f * std::atan(0.5f) * 180.0f / 3.14159265f;
+    settings.side_overlap = 0.5f;
+    settings.front_overlap = 0.5f;
+    settings.max_speed_m_s = 10.0f;
+    return settings;
+}
+
+bool test_geometry()
+{
+    const SurveyGeometry geometry = survey_geometry(round_settings());
+    bool passed = check(std::fabs(geometry.line_spacing_m - 30.0) < 1e-4, "line spacing");
+    passed &= check(std::fabs(geometry.photo_spacing_m - 15.0) < 1e-4, "photo spacing");
+    passed &= check(geometry.speed_m_s == 10.0f, "speed limited to the maximum");
+
+    SurveySettings slow = round_settings();
+    slow.max_speed_m_s = 20.0f;
+    passed &= check(std::fabs(survey_geometry(slow).speed_m_s - 15.0f) < 1e-4f, "speed of one photo per second");
+    return passed;
+}
+
+// Lines to the north, 100 m wide: four lines, 5 m inside the edges.
+bool test_lawnmower()
+{
+    MissionBuilder mission;
+    if (!check(plan_survey(home_latitude_deg, home_longitude_deg, survey_rectangle(100.0, 200.0), round_settings(),
+                           mission),
+               "lawnmower planned")) {
+        return false;
+    }
+    if (!check(mission.size() == 8, "two waypoints per line")) {
+        return false;
+    }
+    const double line_east_m[] = {5.0, 35.0, 65.0, 95.0};
+    bool passed = true;
+    for (size_t line = 0; line < 4; ++line) {
+        const MissionItemRecord &start = mission[2 * line];
+        const MissionItemRecord &end = mission[2 * line + 1];
+        const double start_north_m = line % 2 == 0 ? 0.0 : 200.0;
+        passed &= check(at(start, start_north_m, line_east_m[line]) && at(end, 200.0 - start_north_m, line_east_m[line]),
+                        "line " + std::to_string(line) + " in place, every other one backwards");
+        passed &= check(camera(start) == MissionItem::CameraAction::START_PHOTO_INTERVAL &&
+                            camera(end) == MissionItem::CameraAction::STOP_PHOTO_INTERVAL,
+                        "photos along line " + std::to_string(line));
+    }
+    passed &= check(mission[0].relative_altitude_m == 30.0f && mission[0].speed_m_s == 10.0f &&
+                        mission[0].gimbal_pitch_deg == -90.0f,
+                    "altitude, speed and camera looking down");
+
+    // A width of three spacings puts the outer lines half a spacing inside.
+    mission.clear();
+    plan_survey(home_latitude_deg, home_longitude_deg, survey_rectangle(90.0, 200.0), round_settings(), mission);
+    passed &= check(mission.size() == 6 && at(mission[0], 0.0, 15.0) && at(mission[5], 200.0, 75.0),
+                    "three lines over a multiple of the spacing");
+
+    mission.clear();
+    plan_survey(home_latitude_deg, home_longitude_deg, survey_rectangle(10.0, 200.0), round_settings(), mission);
+    passed &= check(mission.size() == 2 && at(mission[0], 0.0, 5.0) && at(mission[1], 200.0, 5.0),
+                    "one line through a narrow area");
+
+    SurveySettings spaced = round_settings();
+    spaced.waypoint_spacing_m = 50.0;
+    mission.clear();
+    plan_survey(home_latitude_deg, home_longitude_deg, survey_rectangle(10.0, 200.0), spaced, mission);
+    passed &= check(mission.size() == 5 && at(mission[2], 100.0, 5.0), "line cut into legs");
+    passed &= check(camera(mission[0]) == MissionItem::CameraAction::START_PHOTO_INTERVAL &&
+                        camera(mission[2]) == MissionItem::CameraAction::NONE &&
+                        camera(mission[4]) == MissionItem::CameraAction::STOP_PHOTO_INTERVAL,
+                    "photos from the first to the last waypoint of the line");
+    return passed;
+}
+
+// Lines to the east over a U opening to the north, the northern lines cross it twice.
+bool test_concave()
+{
+    std::vector<SurveyPoint> polygon = {{0.0, 0.0},    {200.0, 0.0},  {200.0, 30.0}, {50.0, 30.0},
+                                        {50.0, 70.0},  {200.0, 70.0}, {200.0, 100.0}, {0.0, 100.0}};
+    SurveySettings settings = round_settings();
+    settings.line_heading_deg = 90.0;
+
+    MissionBuilder mission;
+    if (!check(plan_survey(home_latitude_deg, home_longitude_deg, polygon, settings, mission), "U planned")) {
+        return false;
+    }
+    // Lines at 190, 160, 130, 100 and 70 m north cross both arms, at 40 and 10 m the base.
+    bool passed = check(mission.size() == 5 * 4 + 2 * 2, "both arms of the northern lines");
+    passed &= check(at(mission[0], 190.0, 0.0) && at(mission[1], 190.0, 30.0) && at(mission[2], 190.0, 70.0) &&
+                        at(mission[3], 190.0, 100.0),
+                    "first line over both arms");
+    passed &= check(at(mission[4], 160.0, 100.0) && at(mission[7], 160.0, 0.0), "second line backwards");
+    for (size_t i = 0; i < mission.size(); ++i) {
+        const SurveyPoint point = local(mission[i]);
+        passed &= check(!(point.north_m > 50.0 + tolerance_m && point.east_m > 30.0 + tolerance_m &&
+                          point.east_m < 70.0 - tolerance_m),
+                        "waypoint " + std::to_string(i) + " outside the notch");
+    }
+    return passed;
+}
+
+bool test_spiral()
+{
+    SurveySettings settings = round_settings();
+    settings.pattern = SurveyPattern::SPIRAL;
+    MissionBuilder mission;
+    if (!check(plan_survey(home_latitude_deg, home_longitude_deg, survey_rectangle(100.0, 100.0), settings, mission),
+               "spiral planned")) {
+        return false;
+    }
+    bool passed = check(mission.size() > 10, "spiral waypoints");
+
+    // Winds inwards to the center, never leaving the square.
+    double last_radius_m = INFINITY;
+    bool inwards = true, inside = true;
+    for (size_t i = 0; i < mission.size(); ++i) {
+        const SurveyPoint point = local(mission[i]);
+        const double radius_m = std::hypot(point.north_m - 50.0, point.east_m - 50.0);
+        inwards = inwards && radius_m <= last_radius_m + tolerance_m;
+        inside = inside && point.north_m > 0.0 && point.north_m < 100.0 && point.east_m > 0.0 && point.east_m < 100.0;
+        last_radius_m = radius_m;
+    }
+    passed &= check(inwards, "radius shrinking");
+    passed &= check(inside, "waypoints over the area");
+    passed &= check(last_radius_m < tolerance_m, "ends in the center");
+    passed &= check(camera(mission[mission.size() - 1]) == MissionItem::CameraAction::STOP_PHOTO_INTERVAL,
+                    "photos stopped at the end");
+    return passed;
+}
+
+bool test_invalid()
+{
+    MissionBuilder mission;
+    std::vector<SurveyPoint> line = {{0.0, 0.0}, {100.0, 0.0}};
+    bool passed = check(!plan_survey(home_latitude_deg, home_longitude_deg, line, round_settings(), mission),
+                        "two corners rejected");
+
+    SurveySettings settings = round_settings();
+    settings.side_overlap = 1.0f;
+    passed &= check(!plan_survey(home_latitude_deg, home_longitude_deg, survey_rectangle(100.0, 100.0), settings,
+                                 mission),
+                    "full overlap rejected");
+    passed &= check(mission.empty(), "nothing planned");
+    return passed;
+}
+
+bool test_parse()
+{
+    SurveySettings settings;
+    double width_m = 0.0, length_m = 0.0;
+    bool passed = check(parse_survey_area("spiral,50,60,5", settings, width_m, length_m) &&
+                            settings.pattern == SurveyPattern::SPIRAL && width_m == 50.0 && length_m == 60.0 &&
+                            settings.waypoint_spacing_m == 5.0,
+                        "spiral with waypoint spacing");
+    passed &= check(parse_survey_area("lawnmower,100,200", settings, width_m, length_m) &&
+                        settings.pattern == SurveyPattern::LAWNMOWER && width_m == 100.0 && length_m == 200.0,
+                    "lawnmower");
+
+    const char *malformed[] = {"circle,1,2", "lawnmower,-1,2", "lawnmower,1", "lawnmower,a,b", ""};
+    for (const char *text : malformed) {
+        passed &= check(!parse_survey_area(text, settings, width_m, length_m), std::string("rejected: ") + text);
+    }
+    passed &= check(settings.pattern == SurveyPattern::LAWNMOWER && width_m == 100.0, "kept after rejecting");
+    return passed;
+}
+
+bool running_after(bool running, const MissionItemRecord &item)
+{
+    if (camera(item) == MissionItem::CameraAction::START_PHOTO_INTERVAL) {
+        return true;
+    }
+    return camera(item) == MissionItem::CameraAction::STOP_PHOTO_INTERVAL ? false : running;
+}
+
+bool test_split()
+{
+    SurveySettings settings = round_settings();
+    settings.waypoint_spacing_m = 50.0;
+    MissionBuilder mission;
+    plan_survey(home_latitude_deg, home_longitude_deg, survey_rectangle(100.0, 200.0), settings, mission);
+    if (!check(mission.size() == 20, "survey to split")) {
+        return false;
+    }
+
+    const std::vector<MissionBuilder> segments = split_mission(mission, 7);
+    bool passed = check(segments.size() == 4, "segments of 7 items, 6 new ones after the first");
+
+    // Camera state after each item of the whole mission.
+    std::vector<bool> running(mission.size());
+    bool state = false;
+    for (size_t i = 0; i < mission.size(); ++i) {
+        state = running_after(state, mission[i]);
+        running[i] = state;
+    }
+
+    size_t next = 0;
+    for (size_t s = 0; s < segments.size(); ++s) {
+        const MissionBuilder &segment = segments[s];
+        const std::string name = "segment " + std::to_string(s);
+        passed &= check(segment.size() <= 7, name + " fits");
+
+        size_t first = 0;
+        state = false;
+        if (s > 0) {
+            passed &= check(segment[0].latitude_deg == mission[next - 1].latitude_deg &&
+                                segment[0].longitude_deg == mission[next - 1].longitude_deg,
+                            name + " resumes at the last waypoint");
+            state = running_after(state, segment[0]);
+            passed &= check(state == running[next - 1], name + " restarts the camera");
+            first = 1;
+        }
+        for (size_t i = first; i < segment.size(); ++i, ++next) {
+            passed &= check(segment[i].latitude_deg == mission[next].latitude_deg &&
+                                segment[i].longitude_deg == mission[next].longitude_deg,
+                            name + " keeps the waypoints");
+            state = running_after(state, segment[i]);
+            if (i + 1 < segment.size()) {
+                passed &= check(state == running[next], name + " keeps the camera actions");
+            }
+        }
+        passed &= check(!state, name + " ends with the camera off");
+    }
+    passed &= check(next == mission.size(), "every item in a segment");
+    return passed;
+}
+
+} // namespace
+
+int main()
+{
+    bool passed = true;
+    passed &= test_geometry();
+    passed &= test_lawnmower();
+    passed &= test_concave();
+    passed &= test_spiral();
+    passed &= test_invalid();
+    passed &= test_parse();
+    passed &= test_split();
+
+    std::cout << (passed ? "passed" : "failed") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,341 @@
+//
+// Replays small ULog files written here the way PX4 writes them: data
+// messages leave out the padding at the end of their format. Checks the
+// messages the reader hands on, parameters, truncated logs, and that the
+// RTL replay finds and checks the RTL of a synthetic flight.
+//
+// Exits with 1 if a check fails.
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include "rtl_replay.h"
+#include "ulog_reader.h"
+
+namespace {
+
+const char global_position_format[] =
+    "vehicle_global_position:uint64_t timestamp;double lat;double lon;float alt;uint8_t[4] _padding0";
+const char home_position_format[] =
+    "home_position:uint64_t timestamp;double lat;double lon;float alt;uint8_t[4] _padding0";
+const char vehicle_status_format[] =
+    "vehicle_status:uint64_t timestamp;uint8_t nav_state;uint8_t arming_state;uint8_t[6] _padding0";
+
+const uint16_t global_position_id = 1;
+const uint16_t home_position_id = 2;
+const uint16_t vehicle_status_id = 3;
+
+const uint8_t nav_state_hold = 4;
+const uint8_t nav_state_auto_rtl = 5;
+const uint8_t arming_state_standby = 1;
+const uint8_t arming_state_armed = 2;
+
+const double home_latitude_deg = 47.397742;
+const double home_longitude_deg = 8.545594;
+const float home_altitude_m = 488.0f;
+
+// About 1.1 m north per step.
+const double latitude_step_deg = 1e-5;
+
+// A ULog file built message by message.
+class ULogWriter {
+public:
+    ULogWriter()
+    {
+        const uint8_t magic[8] = {'U', 'L', 'o', 'g', 0x01, 0x12, 0x35, 0x01};
+        _bytes.append(reinterpret_cast<const char *>(magic), sizeof(magic));
+        append<uint64_t>(_bytes, 0);
+    }
+
+    void format(const std::string &text) { message('F', text); }
+
+    void param(const std::string &name, float value)
+    {
+        const std::string key = "float " + name;
+        std::string payload(1, static_cast<char>(key.size()));
+        payload += key;
+        append(payload, value);
+        message('P', payload);
+    }
+
+    void add_logged(uint16_t id, const std::string &topic)
+    {
+        std::string payload(1, '\0');
+        append(payload, id);
+        payload += topic;
+        message('A', payload);
+    }
+
+    // Without the trailing padding, like PX4.
+    void position(uint16_t id, uint64_t timestamp_us, double latitude_deg, double longitude_deg, float altitude_m)
+    {
+        std::string payload;
+        append(payload, id);
+        append(payload, timestamp_us);
+        append(payload, latitude_deg);
+        append(payload, longitude_deg);
+        append(payload, altitude_m);
+        message('D', payload);
+    }
+
+    void status(uint64_t timestamp_us, uint8_t nav_state, uint8_t arming_state)
+    {
+        std::string payload;
+        append(payload, vehicle_status_id);
+        append(payload, timestamp_us);
+        payload += static_cast<char>(nav_state);
+        payload += static_cast<char>(arming_state);
+        message('D', payload);
+    }
+
+    void timestamp_only(uint16_t id, uint64_t timestamp_us)
+    {
+        std::string payload;
+        append(payload, id);
+        append(payload, timestamp_us);
+        message('D', payload);
+    }
+
+    // The first bytes of a message, as if the logger stopped within it.
+    void cut_message() { _bytes.append("\x20\x00\x44\x01", 4); }
+
+    bool save(const std::string &path) const
+    {
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        const bool written = std::fwrite(_bytes.data(), 1, _bytes.size(), file) == _bytes.size();
+        return std::fclose(file) == 0 && written;
+    }
+
+private:
+    template<typename T>
+    static void append(std::string &bytes, T value)
+    {
+        char raw[sizeof(T)];
+        std::memcpy(raw, &value, sizeof(T));
+        bytes.append(raw, sizeof(T));
+    }
+
+    void message(char type, const std::string &payload)
+    {
+        append<uint16_t>(_bytes, static_cast<uint16_t>(payload.size()));
+        _bytes += type;
+        _bytes += payload;
+    }
+
+    std::string _bytes;
+};
+
+// Definitions and the topics of the RTL replay, the data is up to the test.
+ULogWriter rtl_log()
+{
+    ULogWriter log;
+    log.format(global_position_format);
+    log.format(home_position_format);
+    log.format(vehicle_status_format);
+    log.param("RTL_RETURN_ALT", 30.0f);
+    log.add_logged(global_position_id, "vehicle_global_position");
+    log.add_logged(home_position_id, "home_position");
+    log.add_logged(vehicle_status_id, "vehicle_status");
+    return log;
+}
+
+// Removed with the test.
+struct TemporaryLog {
+    std::string path;
+
+    TemporaryLog()
+    {
+        char name[] = "/tmp/maneuvers_ulog_test_XXXXXX";
+        const int fd = mkstemp(name);
+        if (fd >= 0) {
+            close(fd);
+            path = name;
+        }
+    }
+    ~TemporaryLog()
+    {
+        if (!path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+};
+
+bool check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "failed: " << what << std::endl;
+    }
+    return condition;
+}
+
+bool test_unpadded_messages()
+{
+    ULogWriter writer = rtl_log();
+    for (unsigned i = 0; i < 10; ++i) {
+        writer.position(global_position_id, i * 100000u, home_latitude_deg + i * latitude_step_deg, home_longitude_deg,
+                        home_altitude_m + i);
+    }
+    TemporaryLog file;
+    if (!check(writer.save(file.path), "writing the log")) {
+        return false;
+    }
+
+    ULogReader log;
+    if (!check(log.open(file.path), "opening the log: " + log.error())) {
+        return false;
+    }
+    const ULogField timestamp = log.field("vehicle_global_position", "timestamp");
+    const ULogField latitude = log.field("vehicle_global_position", "lat");
+    const ULogField altitude = log.field("vehicle_global_position", "alt");
+    bool passed = check(timestamp.valid() && latitude.valid() && altitude.valid(), "fields found");
+    passed &= check(altitude.offset == 24, "offset of alt");
+    passed &= check(!log.field("vehicle_global_position", "vel_n").valid(), "missing field not found");
+
+    unsigned messages = 0;
+    double last_latitude_deg = 0.0;
+    double last_altitude_m = 0.0;
+    log.subscribe("vehicle_global_position", 0, [&](const uint8_t *data) {
+        ++messages;
+        last_latitude_deg = latitude.read(data);
+        last_altitude_m = altitude.read(data);
+    });
+    log.replay();
+
+    passed &= check(messages == 10, "every message without padding replayed");
+    passed &= check(last_latitude_deg == home_latitude_deg + 9 * latitude_step_deg, "latitude of the last message");
+    passed &= check(last_altitude_m == home_altitude_m + 9, "altitude of the last message");
+    passed &= check(!log.truncated(), "complete log not truncated");
+
+    ParamValue return_altitude;
+    passed &= check(log.param("RTL_RETURN_ALT", return_altitude) && return_altitude.float_value == 30.0f,
+                    "parameter read");
+    return passed;
+}
+
+bool test_short_message_skipped()
+{
+    ULogWriter writer = rtl_log();
+    writer.status(0, nav_state_hold, arming_state_armed);
+    // Ends before lat, lon and alt.
+    writer.timestamp_only(home_position_id, 0);
+    TemporaryLog file;
+    if (!check(writer.save(file.path), "writing the log")) {
+        return false;
+    }
+
+    ULogReader log;
+    if (!check(log.open(file.path), "opening the log: " + log.error())) {
+        return false;
+    }
+    unsigned statuses = 0;
+    unsigned homes = 0;
+    log.subscribe("vehicle_status", 0, [&](const uint8_t *) { ++statuses; });
+    log.subscribe("home_position", 0, [&](const uint8_t *) { ++homes; });
+    log.replay();
+    bool passed = check(statuses == 1, "vehicle_status replayed");
+    passed &= check(homes == 0, "message without all fields skipped");
+    return passed;
+}
+
+bool test_truncated_log()
+{
+    ULogWriter writer = rtl_log();
+    writer.position(global_position_id, 0, home_latitude_deg, home_longitude_deg, home_altitude_m);
+    writer.cut_message();
+    TemporaryLog file;
+    if (!check(writer.save(file.path), "writing the log")) {
+        return false;
+    }
+
+    ULogReader log;
+    if (!check(log.open(file.path), "opening the log: " + log.error())) {
+        return false;
+    }
+    unsigned messages = 0;
+    log.subscribe("vehicle_global_position", 0, [&](const uint8_t *) { ++messages; });
+    log.replay();
+    bool passed = check(messages == 1, "message before the cut replayed");
+    passed &= check(log.truncated(), "log marked as truncated");
+    return passed;
+}
+
+bool test_not_a_log()
+{
+    TemporaryLog file;
+    FILE *out = std::fopen(file.path.c_str(), "wb");
+    std::fputs("not a ULog file at all", out);
+    std::fclose(out);
+
+    ULogReader log;
+    return check(!log.open(file.path) && !log.error().empty(), "other file rejected");
+}
+
+// Triggered 22 m north of home at 10 m, climbs to 30 m, returns, descends and disarms.
+bool test_rtl_replay()
+{
+    ULogWriter writer = rtl_log();
+    uint64_t time_us = 0;
+    double latitude_deg = home_latitude_deg + 20 * latitude_step_deg;
+    float altitude_m = home_altitude_m + 10.0f;
+    auto sample = [&]() {
+        writer.position(global_position_id, time_us, latitude_deg, home_longitude_deg, altitude_m);
+        time_us += 100000;
+    };
+
+    writer.position(home_position_id, 0, home_latitude_deg, home_longitude_deg, home_altitude_m);
+    writer.status(time_us, nav_state_hold, arming_state_armed);
+    sample();
+    writer.status(time_us, nav_state_auto_rtl, arming_state_armed);
+    for (; altitude_m < home_altitude_m + 30.0f; altitude_m += 1.0f) {
+        sample();
+    }
+    for (; latitude_deg > home_latitude_deg; latitude_deg -= latitude_step_deg) {
+        sample();
+    }
+    latitude_deg = home_latitude_deg;
+    for (; altitude_m > home_altitude_m; altitude_m -= 1.0f) {
+        sample();
+    }
+    altitude_m = home_altitude_m;
+    sample();
+    writer.status(time_us, nav_state_auto_rtl, arming_state_standby);
+
+    TemporaryLog file;
+    if (!check(writer.save(file.path), "writing the log")) {
+        return false;
+    }
+    const LogReplayResult result = replay_rtl_log(file.path, RtlRules());
+    bool passed = check(result.read, "log read: " + result.error);
+    passed &= check(!result.truncated, "log not truncated");
+    passed &= check(result.interrupted == 0, "no interrupted RTL");
+    if (!check(result.verdicts.size() == 1, "one RTL found")) {
+        return false;
+    }
+    passed &= check(result.verdicts[0].passed, "RTL passed: " + rtl_verdict_failures(result.verdicts[0]));
+    return passed;
+}
+
+} // namespace
+
+int main()
+{
+    bool passed = true;
+    passed &= test_unpadded_messages();
+    passed &= test_short_message_skipped();
+    passed &= test_truncated_log();
+    passed &= test_not_a_log();
+    passed &= test_rtl_replay();
+
+    std::cout << (passed ? "passed" : "failed") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}